@@ -0,0 +1,359 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 字符串位图的计算内核：BITCOUNT的popcount、BITOP的按位运算、BITPOS的查找。
+//
+// 默认的构建没有-mavx2等编译选项，x86上用target属性单独编译AVX2、POPCNT版本的内核，
+// 第一次调用时按CPU支持的指令集选择，其余平台使用按64位字计算的标量版本。
+// BITOP按BITOPS_BLOCK_BYTES分块：每一块依次与所有源key运算后再处理下一块，
+// 几百个几MB的位图做AND/OR时结果不必在每个源key之间反复读写内存。
+
+#include <string.h>
+#include <limits.h>
+#include "bitops.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITOPS_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+typedef size_t (bitopsPopcountFunction)(const unsigned char *p, size_t count);
+typedef void (bitopsBitwiseFunction)(unsigned char *dst, const unsigned char *src, size_t len, int op);
+
+static inline uint64_t bitopsLoad64(const unsigned char *p) {
+    uint64_t w;
+
+    memcpy(&w,p,sizeof(w));
+    return w;
+}
+
+static inline void bitopsStore64(unsigned char *p, uint64_t w) {
+    memcpy(p,&w,sizeof(w));
+}
+
+/*-----------------------------------------------------------------------------
+ * Scalar kernels
+ *----------------------------------------------------------------------------*/
+
+static inline uint64_t bitopsPopcount64(uint64_t w) {
+    w = w-((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL)+((w >> 2) & 0x3333333333333333ULL);
+    w = (w+(w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (w*0x0101010101010101ULL) >> 56;
+}
+
+/* 按64位字的SWAR popcount，不依赖POPCNT指令 */
+static size_t bitopsPopcountScalar(const unsigned char *p, size_t count) {
+    size_t i = 0, bits = 0;
+
+    for (; i+32 <= count; i += 32) {
+        bits += bitopsPopcount64(bitopsLoad64(p+i));
+        bits += bitopsPopcount64(bitopsLoad64(p+i+8));
+        bits += bitopsPopcount64(bitopsLoad64(p+i+16));
+        bits += bitopsPopcount64(bitopsLoad64(p+i+24));
+    }
+    for (; i+8 <= count; i += 8) bits += bitopsPopcount64(bitopsLoad64(p+i));
+    for (; i < count; i++) bits += bitopsPopcount64(p[i]);
+    return bits;
+}
+
+#define BITOPS_SCALAR_LOOP(expr) do { \
+    for (; i+32 <= len; i += 32) { \
+        bitopsStore64(dst+i,bitopsLoad64(dst+i) expr bitopsLoad64(src+i)); \
+        bitopsStore64(dst+i+8,bitopsLoad64(dst+i+8) expr bitopsLoad64(src+i+8)); \
+        bitopsStore64(dst+i+16,bitopsLoad64(dst+i+16) expr bitopsLoad64(src+i+16)); \
+        bitopsStore64(dst+i+24,bitopsLoad64(dst+i+24) expr bitopsLoad64(src+i+24)); \
+    } \
+    for (; i+8 <= len; i += 8) \
+        bitopsStore64(dst+i,bitopsLoad64(dst+i) expr bitopsLoad64(src+i)); \
+    for (; i < len; i++) dst[i] = dst[i] expr src[i]; \
+} while(0)
+
+/* dst[0..len) = dst op src，op为BITOP_AND、BITOP_OR或BITOP_XOR */
+static void bitopsBitwiseScalar(unsigned char *dst, const unsigned char *src, size_t len, int op) {
+    size_t i = 0;
+
+    switch(op) {
+    case BITOP_AND: BITOPS_SCALAR_LOOP(&); break;
+    case BITOP_OR: BITOPS_SCALAR_LOOP(|); break;
+    case BITOP_XOR: BITOPS_SCALAR_LOOP(^); break;
+    }
+}
+
+static void bitopsNot(unsigned char *dst, const unsigned char *src, size_t len) {
+    size_t i = 0;
+
+    for (; i+8 <= len; i += 8) bitopsStore64(dst+i,~bitopsLoad64(src+i));
+    for (; i < len; i++) dst[i] = ~src[i];
+}
+
+/*-----------------------------------------------------------------------------
+ * x86 kernels
+ *----------------------------------------------------------------------------*/
+
+#ifdef BITOPS_X86_DISPATCH
+__attribute__((target("popcnt")))
+static size_t bitopsPopcountPopcnt(const unsigned char *p, size_t count) {
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    size_t i = 0;
+
+    /* 4个独立的累加器，避免popcnt之间的依赖链 */
+    for (; i+32 <= count; i += 32) {
+        c0 += __builtin_popcountll(bitopsLoad64(p+i));
+        c1 += __builtin_popcountll(bitopsLoad64(p+i+8));
+        c2 += __builtin_popcountll(bitopsLoad64(p+i+16));
+        c3 += __builtin_popcountll(bitopsLoad64(p+i+24));
+    }
+    for (; i+8 <= count; i += 8) c0 += __builtin_popcountll(bitopsLoad64(p+i));
+    for (; i < count; i++) c0 += __builtin_popcount(p[i]);
+    return c0+c1+c2+c3;
+}
+
+/* 每个字节的高低4位分别查16项的表(vpshufb)得到置位数量，按字节累加，
+ * 在字节计数溢出前用vpsadbw汇总到64位通道 */
+__attribute__((target("avx2")))
+static size_t bitopsPopcountAVX2(const unsigned char *p, size_t count) {
+    const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                            0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    uint64_t lanes[4];
+    size_t i = 0;
+
+    while (i+64 <= count) {
+        __m256i local = _mm256_setzero_si256();
+        /* 每次迭代每个字节最多加16，15次迭代不会超过255 */
+        size_t end = i+64*15 < count ? i+64*15 : count;
+
+        for (; i+64 <= end; i += 64) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(p+i));
+            __m256i b = _mm256_loadu_si256((const __m256i*)(p+i+32));
+
+            local = _mm256_add_epi8(local,_mm256_shuffle_epi8(lookup,_mm256_and_si256(a,low)));
+            local = _mm256_add_epi8(local,_mm256_shuffle_epi8(lookup,
+                        _mm256_and_si256(_mm256_srli_epi16(a,4),low)));
+            local = _mm256_add_epi8(local,_mm256_shuffle_epi8(lookup,_mm256_and_si256(b,low)));
+            local = _mm256_add_epi8(local,_mm256_shuffle_epi8(lookup,
+                        _mm256_and_si256(_mm256_srli_epi16(b,4),low)));
+        }
+        total = _mm256_add_epi64(total,_mm256_sad_epu8(local,_mm256_setzero_si256()));
+    }
+    _mm256_storeu_si256((__m256i*)lanes,total);
+    return (size_t)(lanes[0]+lanes[1]+lanes[2]+lanes[3])+bitopsPopcountPopcnt(p+i,count-i);
+}
+
+#define BITOPS_AVX2_LOOP(intrin) do { \
+    for (; i+128 <= len; i += 128) { \
+        __m256i d0 = _mm256_loadu_si256((const __m256i*)(dst+i)); \
+        __m256i d1 = _mm256_loadu_si256((const __m256i*)(dst+i+32)); \
+        __m256i d2 = _mm256_loadu_si256((const __m256i*)(dst+i+64)); \
+        __m256i d3 = _mm256_loadu_si256((const __m256i*)(dst+i+96)); \
+        d0 = intrin(d0,_mm256_loadu_si256((const __m256i*)(src+i))); \
+        d1 = intrin(d1,_mm256_loadu_si256((const __m256i*)(src+i+32))); \
+        d2 = intrin(d2,_mm256_loadu_si256((const __m256i*)(src+i+64))); \
+        d3 = intrin(d3,_mm256_loadu_si256((const __m256i*)(src+i+96))); \
+        _mm256_storeu_si256((__m256i*)(dst+i),d0); \
+        _mm256_storeu_si256((__m256i*)(dst+i+32),d1); \
+        _mm256_storeu_si256((__m256i*)(dst+i+64),d2); \
+        _mm256_storeu_si256((__m256i*)(dst+i+96),d3); \
+    } \
+    for (; i+32 <= len; i += 32) \
+        _mm256_storeu_si256((__m256i*)(dst+i),intrin(_mm256_loadu_si256((const __m256i*)(dst+i)), \
+                                                     _mm256_loadu_si256((const __m256i*)(src+i)))); \
+} while(0)
+
+__attribute__((target("avx2")))
+static void bitopsBitwiseAVX2(unsigned char *dst, const unsigned char *src, size_t len, int op) {
+    size_t i = 0;
+
+    switch(op) {
+    case BITOP_AND: BITOPS_AVX2_LOOP(_mm256_and_si256); break;
+    case BITOP_OR: BITOPS_AVX2_LOOP(_mm256_or_si256); break;
+    case BITOP_XOR: BITOPS_AVX2_LOOP(_mm256_xor_si256); break;
+    }
+    bitopsBitwiseScalar(dst+i,src+i,len-i,op);
+}
+#endif
+
+/*-----------------------------------------------------------------------------
+ * Kernel selection
+ *----------------------------------------------------------------------------*/
+
+static bitopsPopcountFunction *popcountKernel = NULL;
+static bitopsBitwiseFunction *bitwiseKernel = NULL;
+static const char *kernelName = NULL;
+
+static void bitopsSelectKernels(void) {
+    popcountKernel = bitopsPopcountScalar;
+    bitwiseKernel = bitopsBitwiseScalar;
+    kernelName = "scalar";
+#ifdef BITOPS_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        popcountKernel = bitopsPopcountAVX2;
+        bitwiseKernel = bitopsBitwiseAVX2;
+        kernelName = "avx2";
+    } else if (__builtin_cpu_supports("popcnt")) {
+        popcountKernel = bitopsPopcountPopcnt;
+        kernelName = "popcnt";
+    }
+#endif
+}
+
+/* 当前使用的内核："avx2"、"popcnt"或"scalar" */
+const char *bitopsKernelName(void) {
+    if (kernelName == NULL) bitopsSelectKernels();
+    return kernelName;
+}
+
+/*-----------------------------------------------------------------------------
+ * Bitmap operations
+ *----------------------------------------------------------------------------*/
+
+/* s[0..count)中置位的数量 */
+size_t bitopsPopcount(const void *s, size_t count) {
+    if (popcountKernel == NULL) bitopsSelectKernels();
+    return popcountKernel(s,count);
+}
+
+static void bitopsCombineWith(bitopsBitwiseFunction *kernel, size_t block, unsigned char *dst,
+                              size_t dstlen, const unsigned char **src, const size_t *len,
+                              int numkeys, int op)
+{
+    size_t b, e, n;
+    int j;
+
+    if (op == BITOP_NOT) {
+        bitopsNot(dst,src[0],dstlen);
+        return;
+    }
+    for (b = 0; b < dstlen; b = e) {
+        e = dstlen-b > block ? b+block : dstlen;
+        n = len[0] > b ? (len[0] < e ? len[0] : e)-b : 0;
+        memcpy(dst+b,src[0]+b,n);
+        memset(dst+b+n,0,e-b-n);
+        for (j = 1; j < numkeys; j++) {
+            n = len[j] > b ? (len[j] < e ? len[j] : e)-b : 0;
+            if (n) kernel(dst+b,src[j]+b,n,op);
+            /* 较短的源key超出部分视为0，只影响AND */
+            if (op == BITOP_AND && n < e-b) memset(dst+b+n,0,e-b-n);
+        }
+    }
+}
+
+/* dst[0..dstlen) = src[0] op src[1] op ... op src[numkeys-1]，与Redis的BITOP一致：
+ * dstlen为最长源key的长度，较短的源key不足的部分视为0；BITOP_NOT只有一个源key */
+void bitopsCombine(unsigned char *dst, size_t dstlen, const unsigned char **src,
+                   const size_t *len, int numkeys, int op)
+{
+    if (bitwiseKernel == NULL) bitopsSelectKernels();
+    bitopsCombineWith(bitwiseKernel,BITOPS_BLOCK_BYTES,dst,dstlen,src,len,numkeys,op);
+}
+
+/* s[0..count)中第一个值为bit的位的位置(字节内从最高位算起)。
+ * 没有找到时，bit为1返回-1，bit为0返回count*8，由调用者按Redis BITPOS的规则处理 */
+long long bitopsFirstBit(const unsigned char *s, size_t count, int bit) {
+    const uint64_t skip = bit ? 0 : UINT64_MAX;
+    size_t i = 0;
+
+    /* 按64位字跳过全部为0(查找1时)或全部为1(查找0时)的部分 */
+    for (; i+32 <= count; i += 32) {
+        if (bitopsLoad64(s+i) != skip || bitopsLoad64(s+i+8) != skip ||
+            bitopsLoad64(s+i+16) != skip || bitopsLoad64(s+i+24) != skip) break;
+    }
+    for (; i+8 <= count; i += 8) {
+        if (bitopsLoad64(s+i) != skip) break;
+    }
+    for (; i < count; i++) {
+        unsigned int c = bit ? s[i] : (unsigned char)~s[i];
+
+        if (c) return (long long)i*8+__builtin_clz(c)-(int)(sizeof(unsigned int)*CHAR_BIT-8);
+    }
+    return bit ? -1 : (long long)count*8;
+}
+
+/* ------------------------------- Benchmark ---------------------------------*/
+
+#ifdef BITOPS_BENCHMARK_MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double benchmarkSeconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static void benchmarkPopcount(const char *name, bitopsPopcountFunction *fn,
+                              const unsigned char *buf, size_t bytes, int rounds)
+{
+    double start = benchmarkSeconds(), elapsed;
+    size_t bits = 0;
+    int j;
+
+    for (j = 0; j < rounds; j++) bits += fn(buf,bytes);
+    elapsed = benchmarkSeconds()-start;
+    printf("popcount %-8s %6.2f GB/s (%zu bits)\n", name,
+        (double)bytes*rounds/elapsed/1e9, bits/rounds);
+}
+
+static void benchmarkCombine(const char *name, bitopsBitwiseFunction *fn, size_t block,
+                             unsigned char *dst, const unsigned char **src, const size_t *len,
+                             int numkeys, int op)
+{
+    double start = benchmarkSeconds(), elapsed;
+
+    bitopsCombineWith(fn,block,dst,len[0],src,len,numkeys,op);
+    elapsed = benchmarkSeconds()-start;
+    printf("bitop %s %-16s %6.2f GB/s (%.1f ms, popcount %zu)\n", op == BITOP_AND ? "and" : "or ",
+        name, (double)len[0]*numkeys/elapsed/1e9, elapsed*1000, bitopsPopcountScalar(dst,len[0]));
+}
+
+/* bitops-benchmark [mb] [keys]
+ * 统计mb MB的popcount，以及keys个mb MB的位图做BITOP AND/OR，吞吐量按读取的源数据计算 */
+int main(int argc, char **argv) {
+    size_t bytes = (argc >= 2 ? strtoul(argv[1],NULL,10) : 4)*1024*1024;
+    int numkeys = argc >= 3 ? atoi(argv[2]) : 100;
+    const unsigned char **src = malloc(sizeof(*src)*numkeys);
+    size_t *len = malloc(sizeof(*len)*numkeys), i;
+    unsigned char *dst = malloc(bytes);
+    int rounds = (int)(1024*1024*1024/bytes), j, k;
+    static const int ops[] = {BITOP_AND, BITOP_OR};
+
+    if (rounds < 1) rounds = 1;
+    srand(1);
+    for (j = 0; j < numkeys; j++) {
+        unsigned char *p = malloc(bytes);
+
+        /* AND之后仍有约1/4的位为1，结果不会很快变为全0 */
+        for (i = 0; i < bytes; i++) p[i] = (unsigned char)(rand() | (j ? 0xee : 0));
+        src[j] = p;
+        len[j] = bytes;
+    }
+    printf("Kernel: %s, %d keys of %zu MB\n", bitopsKernelName(), numkeys, bytes/(1024*1024));
+
+    benchmarkPopcount("scalar",bitopsPopcountScalar,src[0],bytes,rounds);
+#ifdef BITOPS_X86_DISPATCH
+    if (__builtin_cpu_supports("popcnt"))
+        benchmarkPopcount("popcnt",bitopsPopcountPopcnt,src[0],bytes,rounds);
+    if (__builtin_cpu_supports("avx2"))
+        benchmarkPopcount("avx2",bitopsPopcountAVX2,src[0],bytes,rounds);
+#endif
+
+    for (k = 0; k < 2; k++) {
+        benchmarkCombine("scalar",bitopsBitwiseScalar,bytes,dst,src,len,numkeys,ops[k]);
+        benchmarkCombine("scalar blocked",bitopsBitwiseScalar,BITOPS_BLOCK_BYTES,dst,src,len,numkeys,ops[k]);
+#ifdef BITOPS_X86_DISPATCH
+        if (__builtin_cpu_supports("avx2")) {
+            benchmarkCombine("avx2",bitopsBitwiseAVX2,bytes,dst,src,len,numkeys,ops[k]);
+            benchmarkCombine("avx2 blocked",bitopsBitwiseAVX2,BITOPS_BLOCK_BYTES,dst,src,len,numkeys,ops[k]);
+        }
+#endif
+    }
+    return 0;
+}
+
+#endif
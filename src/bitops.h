@@ -0,0 +1,27 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_BITOPS_H
+#define RESP_SERVER_BITOPS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* bitopsCombine()支持的运算 */
+#define BITOP_AND 0
+#define BITOP_OR 1
+#define BITOP_XOR 2
+#define BITOP_NOT 3
+
+/* bitopsCombine()每次处理的目标字节数：所有源key依次作用于同一块结果，
+ * 使这一块一直留在L1/L2缓存中，而不是每个源key都把整个结果读写一遍 */
+#define BITOPS_BLOCK_BYTES (16*1024)
+
+size_t bitopsPopcount(const void *s, size_t count);
+void bitopsCombine(unsigned char *dst, size_t dstlen, const unsigned char **src,
+                   const size_t *len, int numkeys, int op);
+long long bitopsFirstBit(const unsigned char *s, size_t count, int bit);
+const char *bitopsKernelName(void);
+
+#endif //RESP_SERVER_BITOPS_H
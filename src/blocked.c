@@ -0,0 +1,81 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 增量任务：耗时与数据规模成正比的命令(如向量的精确搜索)不在命令处理函数中一次执行完毕，
+// 而是把客户端挂起在一个任务上，由beforeSleep每轮事件循环执行一段，其他客户端的请求在两段
+// 之间照常处理。
+//
+// 挂起的客户端打上CLIENT_BLOCKED标志，processInputBuffer不再处理其后续的请求，
+// 任务完成后解除挂起并继续处理已读取的请求，同一个客户端的回复顺序不变。
+// 有任务时事件循环不在epoll_wait中等待，任务在没有其他事件时也能连续执行。
+
+#include <unistd.h>
+#include "server.h"
+#include "blocked.h"
+#include "zmalloc.h"
+#include "log.h"
+
+typedef struct blockedJob {
+    blockedJobProc *proc;
+    blockedJobFreeProc *freeproc;
+    void *privdata;
+    listNode *node;             /* 在server.blocked_clients中的节点 */
+} blockedJob;
+
+/* 挂起客户端c，之后由processBlockedJobs()执行proc直到任务完成 */
+void blockClientOnJob(client *c, blockedJobProc *proc, blockedJobFreeProc *freeproc,
+                      void *privdata)
+{
+    blockedJob *job = zmalloc(sizeof(*job));
+
+    serverAssert(!(c->flags & CLIENT_BLOCKED));
+    job->proc = proc;
+    job->freeproc = freeproc;
+    job->privdata = privdata;
+    listAddNodeTail(server.blocked_clients,c);
+    job->node = listLast(server.blocked_clients);
+    c->job = job;
+    c->flags |= CLIENT_BLOCKED;
+    setDontWait(server.el,1);
+}
+
+/* 解除挂起并释放任务，任务未完成时(如客户端断开)直接丢弃 */
+void unblockClient(client *c) {
+    blockedJob *job = c->job;
+
+    if (!(c->flags & CLIENT_BLOCKED)) return;
+    listDelNode(server.blocked_clients,job->node);
+    if (job->freeproc) job->freeproc(job->privdata);
+    zfree(job);
+    c->job = NULL;
+    c->flags &= ~CLIENT_BLOCKED;
+    if (listLength(server.blocked_clients) == 0) setDontWait(server.el,0);
+}
+
+/* 每个任务依次执行，本轮剩余的时间由尚未执行的任务平分 */
+void processBlockedJobs(void) {
+    unsigned long left = listLength(server.blocked_clients);
+    long long now, end;
+    listIter li;
+    listNode *ln;
+
+    if (left == 0) return;
+    now = ustime();
+    end = now+server.job_slice_us;
+    listRewind(server.blocked_clients,&li);
+    while (left-- && (ln = listNext(&li)) != NULL) {
+        client *c = listNodeValue(ln);
+        blockedJob *job = c->job;
+
+        if (c->flags & CLIENT_CLOSE_ASAP) continue;
+        if (!job->proc(c,job->privdata,now+(end-now)/(long long)(left+1))) {
+            now = ustime();
+            continue;
+        }
+
+        /* 任务完成，继续处理挂起期间读取的请求，其中的命令可能再次挂起客户端 */
+        unblockClient(c);
+        if (sdslen(c->querybuf) > c->qb_pos) processInputBuffer(c);
+        now = ustime();
+    }
+}
@@ -0,0 +1,22 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_BLOCKED_H
+#define RESP_SERVER_BLOCKED_H
+
+#include "server.h"
+
+/* 每轮事件循环执行增量任务的总时间(微秒) */
+#define CONFIG_DEFAULT_JOB_SLICE_US 1000
+
+/* 增量任务的一步，最多执行到deadline(微秒)。任务完成时回复客户端并返回1，否则返回0 */
+typedef int blockedJobProc(client *c, void *privdata, long long deadline);
+typedef void blockedJobFreeProc(void *privdata);
+
+void blockClientOnJob(client *c, blockedJobProc *proc, blockedJobFreeProc *freeproc,
+                      void *privdata);
+void unblockClient(client *c);
+void processBlockedJobs(void);
+
+#endif //RESP_SERVER_BLOCKED_H
@@ -0,0 +1,272 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#include <strings.h>
+#include <limits.h>
+#include "config.h"
+#include "reply.h"
+#include "util.h"
+#include "slowlog.h"
+#include "debug.h"
+#include "log.h"
+#include "metrics.h"
+#include "hotkeys.h"
+#include "expire.h"
+#include "evict.h"
+#include "tinylfu.h"
+#include "db.h"
+#include "t_list.h"
+#include "t_hash.h"
+#include "t_set.h"
+#include "t_zset.h"
+#include "hyperloglog.h"
+#include "t_stream.h"
+#include "t_timeseries.h"
+#include "quicklist.h"
+
+static int applySlowlogMaxLen(long long val) {
+    slowlogResize((unsigned long)val);
+    return C_OK;
+}
+
+static int applyWatchdogPeriod(long long val) {
+    if (val)
+        watchdogEnable((int)val);
+    else
+        watchdogDisable();
+    return C_OK;
+}
+
+static int applyHotkeysTopK(long long val) {
+    return hotkeysSetTopK(val);
+}
+
+static int applyMetricsPort(long long val) {
+    return metricsSetPort((int)val);
+}
+
+static int applyMaxmemoryAdmission(long long val) {
+    return tinylfuSetAdmission(val);
+}
+
+static int applyTinylfuCapacity(long long val) {
+    return tinylfuSetCapacity(val);
+}
+
+static int applyKeyspaceHash(long long val) {
+    return dbSetHashFunction(val);
+}
+
+configEnum maxmemoryPolicyEnum[] = {
+        {"volatile-lru", MAXMEMORY_VOLATILE_LRU},
+        {"volatile-lfu", MAXMEMORY_VOLATILE_LFU},
+        {"volatile-random", MAXMEMORY_VOLATILE_RANDOM},
+        {"volatile-ttl", MAXMEMORY_VOLATILE_TTL},
+        {"allkeys-lru", MAXMEMORY_ALLKEYS_LRU},
+        {"allkeys-lfu", MAXMEMORY_ALLKEYS_LFU},
+        {"allkeys-random", MAXMEMORY_ALLKEYS_RANDOM},
+        {"noeviction", MAXMEMORY_NO_EVICTION},
+        {NULL, 0}
+};
+
+configEnum maxmemoryAdmissionEnum[] = {
+        {"none", MAXMEMORY_ADMISSION_NONE},
+        {"tinylfu", MAXMEMORY_ADMISSION_TINYLFU},
+        {NULL, 0}
+};
+
+configEnum keyspaceHashEnum[] = {
+        {"siphash", KEYSPACE_HASH_SIPHASH},
+        {"wyhash", KEYSPACE_HASH_WYHASH},
+        {NULL, 0}
+};
+
+/* 可在运行时通过CONFIG GET/SET读取与修改的配置项 */
+numericConfig configTable[] = {
+        {"slowlog-log-slower-than", CONFIG_TYPE_LONG_LONG, &server.slowlog_log_slower_than,
+                -1, LLONG_MAX, NULL},
+        {"slowlog-max-len", CONFIG_TYPE_ULONG, &server.slowlog_max_len,
+                0, LONG_MAX, applySlowlogMaxLen},
+        {"watchdog-period", CONFIG_TYPE_INT, &server.watchdog_period,
+                0, INT_MAX, applyWatchdogPeriod},
+        {"verbosity", CONFIG_TYPE_INT, &server.verbosity,
+                LL_DEBUG, LL_WARNING, NULL},
+        {"metrics-port", CONFIG_TYPE_INT, &server.metrics_port,
+                0, 65535, applyMetricsPort},
+        {"hz", CONFIG_TYPE_INT, &server.hz,
+                CONFIG_MIN_HZ, CONFIG_MAX_HZ, NULL},
+        {"hotkeys-topk", CONFIG_TYPE_INT, &server.hotkeys_topk,
+                0, HOTKEYS_MAX_TOPK, applyHotkeysTopK},
+        {"hotkeys-decay-period", CONFIG_TYPE_INT, &server.hotkeys_decay_period,
+                1, 86400, NULL},
+        {"active-expire-effort", CONFIG_TYPE_INT, &server.active_expire_effort,
+                1, CONFIG_MAX_ACTIVE_EXPIRE_EFFORT, NULL},
+        {"maxmemory", CONFIG_TYPE_MEMORY, &server.maxmemory,
+                0, LLONG_MAX, NULL},
+        {"maxmemory-policy", CONFIG_TYPE_ENUM, &server.maxmemory_policy,
+                0, 0, NULL, maxmemoryPolicyEnum},
+        {"maxmemory-samples", CONFIG_TYPE_INT, &server.maxmemory_samples,
+                1, 64, NULL},
+        {"lfu-log-factor", CONFIG_TYPE_INT, &server.lfu_log_factor,
+                0, INT_MAX, NULL},
+        {"lfu-decay-time", CONFIG_TYPE_INT, &server.lfu_decay_time,
+                0, INT_MAX, NULL},
+        {"maxmemory-admission", CONFIG_TYPE_ENUM, &server.maxmemory_admission,
+                0, 0, applyMaxmemoryAdmission, maxmemoryAdmissionEnum},
+        {"tinylfu-capacity", CONFIG_TYPE_INT, &server.tinylfu_capacity,
+                1024, TINYLFU_MAX_CAPACITY, applyTinylfuCapacity},
+        {"active-rehashing-budget", CONFIG_TYPE_INT, &server.active_rehashing_budget,
+                0, 1000000, NULL},
+        {"job-slice-us", CONFIG_TYPE_INT, &server.job_slice_us,
+                100, 1000000, NULL},
+        {"keyspace-hash", CONFIG_TYPE_ENUM, &server.keyspace_hash,
+                0, 0, applyKeyspaceHash, keyspaceHashEnum},
+        {"list-max-listpack-size", CONFIG_TYPE_INT, &server.list_max_listpack_size,
+                QUICKLIST_FILL_MIN, QUICKLIST_FILL_MAX, NULL},
+        {"list-compress-depth", CONFIG_TYPE_INT, &server.list_compress_depth,
+                0, QUICKLIST_COMPRESS_MAX, NULL},
+        {"hash-max-listpack-entries", CONFIG_TYPE_ULONG, &server.hash_max_listpack_entries,
+                0, LONG_MAX, NULL},
+        {"hash-max-listpack-value", CONFIG_TYPE_ULONG, &server.hash_max_listpack_value,
+                0, LONG_MAX, NULL},
+        {"set-max-intset-entries", CONFIG_TYPE_ULONG, &server.set_max_intset_entries,
+                0, 1L<<30, NULL},
+        {"zset-max-listpack-entries", CONFIG_TYPE_ULONG, &server.zset_max_listpack_entries,
+                0, LONG_MAX, NULL},
+        {"zset-max-listpack-value", CONFIG_TYPE_ULONG, &server.zset_max_listpack_value,
+                0, LONG_MAX, NULL},
+        {"hll-sparse-max-bytes", CONFIG_TYPE_ULONG, &server.hll_sparse_max_bytes,
+                0, LONG_MAX, NULL},
+        {"stream-node-max-bytes", CONFIG_TYPE_ULONG, &server.stream_node_max_bytes,
+                0, LONG_MAX, NULL},
+        {"stream-node-max-entries", CONFIG_TYPE_ULONG, &server.stream_node_max_entries,
+                0, LONG_MAX, NULL},
+        {"ts-chunk-size", CONFIG_TYPE_ULONG, &server.ts_chunk_size,
+                64, 1<<20, NULL},
+};
+
+#define CONFIG_TABLE_SIZE (sizeof(configTable)/sizeof(configTable[0]))
+
+static long long configGetValue(numericConfig *config) {
+    switch (config->type) {
+    case CONFIG_TYPE_INT:
+    case CONFIG_TYPE_ENUM: return *(int*)config->field;
+    case CONFIG_TYPE_LONG_LONG:
+    case CONFIG_TYPE_MEMORY: return *(long long*)config->field;
+    default: return (long long)*(unsigned long*)config->field;
+    }
+}
+
+static int configSetValue(numericConfig *config, long long val) {
+    if (config->apply) return config->apply(val);
+    switch (config->type) {
+    case CONFIG_TYPE_INT:
+    case CONFIG_TYPE_ENUM: *(int*)config->field = (int)val; break;
+    case CONFIG_TYPE_LONG_LONG:
+    case CONFIG_TYPE_MEMORY: *(long long*)config->field = val; break;
+    default: *(unsigned long*)config->field = (unsigned long)val; break;
+    }
+    return C_OK;
+}
+
+/* 将配置值解析为数值，成功返回C_OK */
+static int configParseValue(numericConfig *config, sds arg, long long *val) {
+    configEnum *e;
+    int err;
+
+    switch (config->type) {
+    case CONFIG_TYPE_ENUM:
+        for (e = config->enum_vals; e->name; e++) {
+            if (!strcasecmp(e->name,arg)) {
+                *val = e->val;
+                return C_OK;
+            }
+        }
+        return C_ERR;
+    case CONFIG_TYPE_MEMORY:
+        *val = memtoll(arg,&err);
+        if (err) return C_ERR;
+        break;
+    default:
+        if (!string2ll(arg,sdslen(arg),val)) return C_ERR;
+        break;
+    }
+    if (*val < config->lower || *val > config->upper) return C_ERR;
+    return C_OK;
+}
+
+/* CONFIG GET回复配置值，枚举类型回复名称 */
+static void addReplyConfigValue(client *c, numericConfig *config) {
+    long long val = configGetValue(config);
+    configEnum *e;
+
+    if (config->type == CONFIG_TYPE_ENUM) {
+        for (e = config->enum_vals; e->name; e++) {
+            if (e->val == val) {
+                addReplyBulkCString(c,e->name);
+                return;
+            }
+        }
+    }
+    addReplyBulkLongLong(c,val);
+}
+
+static numericConfig *lookupConfig(const char *name) {
+    unsigned long j;
+
+    for (j = 0; j < CONFIG_TABLE_SIZE; j++) {
+        if (!strcasecmp(configTable[j].name,name)) return configTable+j;
+    }
+    return NULL;
+}
+
+/* CONFIG GET <pattern> 返回所有匹配的配置项及其值 */
+void configGetCommand(client *c) {
+    char *pattern = c->argv[2]->ptr;
+    unsigned long j, matches = 0;
+
+    for (j = 0; j < CONFIG_TABLE_SIZE; j++) {
+        if (stringmatch(pattern,configTable[j].name,1)) matches++;
+    }
+    addReplyArrayLen(c,matches*2);
+    for (j = 0; j < CONFIG_TABLE_SIZE; j++) {
+        if (!stringmatch(pattern,configTable[j].name,1)) continue;
+        addReplyBulkCString(c,configTable[j].name);
+        addReplyConfigValue(c,configTable+j);
+    }
+}
+
+/* CONFIG SET <name> <value> 修改配置项，立即生效 */
+void configSetCommand(client *c) {
+    numericConfig *config = lookupConfig(c->argv[2]->ptr);
+    long long val;
+
+    if (config == NULL) {
+        addReplyErrorFormat(c,"Unsupported CONFIG parameter: %s",
+                            (char*)c->argv[2]->ptr);
+        return;
+    }
+    if (configParseValue(config,c->argv[3]->ptr,&val) != C_OK) {
+        addReplyErrorFormat(c,"Invalid argument '%s' for CONFIG SET '%s'",
+                            (char*)c->argv[3]->ptr,config->name);
+        return;
+    }
+    if (configSetValue(config,val) != C_OK) {
+        addReplyErrorFormat(c,"Failed to apply '%s' for CONFIG SET '%s'",
+                            (char*)c->argv[3]->ptr,config->name);
+        return;
+    }
+    addReply(c,shared.ok);
+}
+
+void configCommand(client *c) {
+    if (c->argc == 3 && !strcasecmp(c->argv[1]->ptr,"get")) {
+        configGetCommand(c);
+    } else if (c->argc == 4 && !strcasecmp(c->argv[1]->ptr,"set")) {
+        configSetCommand(c);
+    } else {
+        addReplyErrorFormat(c,"Unknown subcommand or wrong number of arguments for '%s'. Try CONFIG GET <pattern> or CONFIG SET <name> <value>.",
+                            (char*)c->argv[1]->ptr);
+    }
+}
@@ -0,0 +1,33 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_CONFIG_H
+#define RESP_SERVER_CONFIG_H
+
+#include "server.h"
+
+/* Types of the server fields behind a numeric config. */
+#define CONFIG_TYPE_INT 0
+#define CONFIG_TYPE_LONG_LONG 1
+#define CONFIG_TYPE_ULONG 2
+#define CONFIG_TYPE_MEMORY 3    /* long long字段，取值支持kb、mb、gb等单位 */
+#define CONFIG_TYPE_ENUM 4      /* int字段，取值为enum_vals中的名称 */
+
+typedef struct configEnum {
+    const char *name;
+    int val;
+} configEnum;
+
+typedef struct numericConfig {
+    const char *name;                   /* 配置项名称 */
+    int type;                           /* 字段类型，见CONFIG_TYPE_* */
+    void *field;                        /* 对应的server字段 */
+    long long lower, upper;             /* 取值范围 */
+    int (*apply)(long long val);        /* 非NULL时由其负责设置字段并生效，失败返回C_ERR */
+    configEnum *enum_vals;              /* CONFIG_TYPE_ENUM的可选值，以{NULL,0}结尾 */
+} numericConfig;
+
+void configCommand(client *c);
+
+#endif //RESP_SERVER_CONFIG_H
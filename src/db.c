@@ -0,0 +1,252 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 内置键空间。键以sds保存在dict中，值为robj，命令参数中的值对象通过引用计数直接存入键空间，
+// 无需复制。
+
+#include <unistd.h>
+#include "server.h"
+#include "db.h"
+#include "reply.h"
+#include "zmalloc.h"
+#include "evict.h"
+#include "tinylfu.h"
+#include "log.h"
+
+void initDb(void) {
+    respDb *db = zmalloc(sizeof(*db));
+
+    db->dict = dictCreate(&dbDictType,NULL);
+    db->expires = dictCreate(&keyptrDictType,NULL);
+    db->id = 0;
+    server.db = db;
+    registerCronDict(db->dict);
+    registerCronDict(db->expires);
+}
+
+/*============================ Low level db API ============================ */
+
+static robj *lookupKey(respDb *db, robj *key) {
+    dictEntry *de = dictFind(db->dict,key->ptr);
+    if (de) {
+        robj *val = dictGetVal(de);
+
+        /* Update the access time for the ageing algorithm. */
+        updateObjectAccessTime(val);
+        return val;
+    } else {
+        return NULL;
+    }
+}
+
+/* 读取前先检查key是否过期，已过期的key会被删除。未命中的访问同样计入TinyLFU频率 */
+robj *lookupKeyRead(respDb *db, robj *key) {
+    robj *val;
+
+    expireIfNeeded(db,key);
+    tinylfuRecordAccess(key->ptr);
+    val = lookupKey(db,key);
+    if (val)
+        server.stat_keyspace_hits++;
+    else
+        server.stat_keyspace_misses++;
+    return val;
+}
+
+robj *lookupKeyWrite(respDb *db, robj *key) {
+    expireIfNeeded(db,key);
+    tinylfuRecordAccess(key->ptr);
+    return lookupKey(db,key);
+}
+
+robj *lookupKeyReadOrReply(client *c, robj *key, robj *reply) {
+    robj *o = lookupKeyRead(server.db, key);
+    if (!o) addReply(c,reply);
+    return o;
+}
+
+/* Add the key to the DB. It's up to the caller to increment the reference
+ * counter of the value if needed.
+ *
+ * The program is aborted if the key already exists. */
+void dbAdd(respDb *db, robj *key, robj *val) {
+    int retval = dictAdd(db->dict, key->ptr, val);
+
+    serverAssert(retval == DICT_OK);
+    tinylfuSetCandidate(key->ptr);
+}
+
+/* Overwrite an existing key with a new value. Incrementing the reference
+ * count of the new value is up to the caller.
+ *
+ * The program is aborted if the key was not already present. */
+void dbOverwrite(respDb *db, robj *key, robj *val) {
+    dictEntry *de = dictFind(db->dict,key->ptr);
+
+    serverAssert(de != NULL);
+    robj *old = dictGetVal(de);
+    dictSetVal(db->dict, de, val);
+    decrRefCount(old);
+}
+
+/* 原地修改字符串值(如SETBIT)之前调用：标记指针、共享的或不是RAW编码的值替换为
+ * 内容相同的私有RAW对象，返回可以修改的对象 */
+robj *dbUnshareStringValue(respDb *db, robj *key, robj *o) {
+    serverAssert(objType(o) == OBJ_STRING);
+    if (objIsTagged(o) || o->refcount != 1 || o->encoding != OBJ_ENCODING_RAW) {
+        robj *decoded = getDecodedObject(o);
+
+        o = createRawStringObject(decoded->ptr,sdslen(decoded->ptr));
+        decrRefCount(decoded);
+        dbOverwrite(db,key,o);
+    }
+    return o;
+}
+
+/* High level Set operation. This function can be used in order to set
+ * a key, whatever it was existing or not, to a new object.
+ *
+ * 1) The ref count of the value object is incremented.
+ * 2) If the key already exists its old value is released.
+ * 3) The expire time of the key is reset (the key is made persistent). */
+void setKey(respDb *db, robj *key, robj *val) {
+    dictEntry *existing, *de;
+
+    tinylfuRecordAccess(key->ptr);
+    de = dictAddRaw(db->dict,key->ptr,&existing);
+    if (de) {
+        /* The key is new: the dict stored a copy of it in the entry. */
+        dictSetVal(db->dict,de,val);
+        tinylfuSetCandidate(key->ptr);
+    } else {
+        robj *old = dictGetVal(existing);
+        dictSetVal(db->dict,existing,val);
+        decrRefCount(old);
+        removeExpire(db,key);
+    }
+    incrRefCount(val);
+}
+
+/* Delete a key and its associated value from the DB.
+ * Return 1 if the key was deleted, 0 if it did not exist. */
+int dbDelete(respDb *db, robj *key) {
+    /* Deleting an entry from the expires dict will not free the sds of
+     * the key, because it is shared with the main dictionary. */
+    if (dictSize(db->expires) > 0) dictDelete(db->expires,key->ptr);
+    return dictDelete(db->dict,key->ptr) == DICT_OK;
+}
+
+/* Remove all keys from the database, returning the number of keys removed. */
+long long emptyDb(respDb *db) {
+    long long removed = dictSize(db->dict);
+
+    dictEmpty(db->expires,NULL);
+    dictEmpty(db->dict,NULL);
+    return removed;
+}
+
+/* 切换键空间与过期字典的hash函数。已有的key按原来的hash存放，因此只能在键空间为空时切换 */
+int dbSetHashFunction(long long hash) {
+    respDb *db = server.db;
+
+    if (db && (dictSize(db->dict) || dictSize(db->expires))) return C_ERR;
+    if (hash == KEYSPACE_HASH_WYHASH) {
+        dbDictType.hashFunction = keyptrDictType.hashFunction = dictSdsWyHash;
+        dbDictType.hashBatchFunction = keyptrDictType.hashBatchFunction = dictSdsWyHashBatch;
+    } else {
+        dbDictType.hashFunction = keyptrDictType.hashFunction = dictSdsHash;
+        dbDictType.hashBatchFunction = keyptrDictType.hashBatchFunction = NULL;
+    }
+    server.keyspace_hash = (int)hash;
+    return C_OK;
+}
+
+/* 检查值的类型，类型不符时回复WRONGTYPE错误并返回1 */
+int checkType(client *c, robj *o, int type) {
+    if (objType(o) != type) {
+        addReply(c,shared.wrongtypeerr);
+        return 1;
+    }
+    return 0;
+}
+
+/*============================ Expires API ================================= */
+
+/* Set an expire to the specified key. The key must already exist, the
+ * expires dict shares its sds with the main dictionary. 'when' is an
+ * absolute unix time in milliseconds. */
+void setExpire(respDb *db, robj *key, long long when) {
+    dictEntry *kde, *de;
+
+    kde = dictFind(db->dict,key->ptr);
+    serverAssert(kde != NULL);
+    de = dictAddOrFind(db->expires,dictGetKey(kde));
+    dictSetSignedIntegerVal(de,when);
+}
+
+/* Return the expire time of the specified key, or -1 if no expire
+ * is associated with this key (i.e. the key is non volatile) */
+long long getExpire(respDb *db, robj *key) {
+    dictEntry *de;
+
+    if (dictSize(db->expires) == 0 ||
+       (de = dictFind(db->expires,key->ptr)) == NULL) return -1;
+
+    return dictGetSignedIntegerVal(de);
+}
+
+int removeExpire(respDb *db, robj *key) {
+    if (dictSize(db->expires) == 0) return 0;
+    return dictDelete(db->expires,key->ptr) == DICT_OK;
+}
+
+/* Check if the key is expired. */
+int keyIsExpired(respDb *db, robj *key) {
+    long long when = getExpire(db,key);
+
+    if (when < 0) return 0; /* No expire for this key */
+    return server.mstime > when;
+}
+
+/* 惰性删除: 访问key时如已过期则立即删除，返回1代表key已被删除 */
+int expireIfNeeded(respDb *db, robj *key) {
+    if (!keyIsExpired(db,key)) return 0;
+
+    server.stat_expiredkeys++;
+    return dbDelete(db,key);
+}
+
+/*============================ Keyspace commands =========================== */
+
+/* DEL key [key ...] */
+void delCommand(client *c) {
+    int numdel = 0, j;
+
+    for (j = 1; j < c->argc; j++) {
+        if (dbDelete(server.db,c->argv[j])) numdel++;
+    }
+    addReplyLongLong(c,numdel);
+}
+
+/* EXISTS key [key ...]
+ * 返回存在的key的数量，重复的key会被重复计数 */
+void existsCommand(client *c) {
+    long long count = 0;
+    int j;
+
+    for (j = 1; j < c->argc; j++) {
+        if (lookupKeyRead(server.db,c->argv[j])) count++;
+    }
+    addReplyLongLong(c,count);
+}
+
+/* DBSIZE */
+void dbsizeCommand(client *c) {
+    addReplyLongLong(c,dictSize(server.db->dict));
+}
+
+/* FLUSHDB */
+void flushdbCommand(client *c) {
+    emptyDb(server.db);
+    addReply(c,shared.ok);
+}
@@ -0,0 +1,45 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_DB_H
+#define RESP_SERVER_DB_H
+
+#include "server.h"
+
+/* 键空间的hash函数。SipHash可以防御刻意构造的碰撞key，wyhash更快，适用于客户端可信的场景 */
+#define KEYSPACE_HASH_SIPHASH 0
+#define KEYSPACE_HASH_WYHASH 1
+#define CONFIG_DEFAULT_KEYSPACE_HASH KEYSPACE_HASH_SIPHASH
+
+/* 键空间 */
+typedef struct respDb {
+    dict *dict;                 /* 键空间，sds -> robj */
+    dict *expires;              /* 设置了过期时间的key，与dict共享key，值为毫秒时间戳 */
+    int id;                     /* 数据库编号 */
+} respDb;
+
+void initDb(void);
+robj *lookupKeyRead(respDb *db, robj *key);
+robj *lookupKeyWrite(respDb *db, robj *key);
+robj *lookupKeyReadOrReply(client *c, robj *key, robj *reply);
+void dbAdd(respDb *db, robj *key, robj *val);
+void dbOverwrite(respDb *db, robj *key, robj *val);
+robj *dbUnshareStringValue(respDb *db, robj *key, robj *o);
+void setKey(respDb *db, robj *key, robj *val);
+int dbDelete(respDb *db, robj *key);
+long long emptyDb(respDb *db);
+int dbSetHashFunction(long long hash);
+int checkType(client *c, robj *o, int type);
+void setExpire(respDb *db, robj *key, long long when);
+long long getExpire(respDb *db, robj *key);
+int removeExpire(respDb *db, robj *key);
+int keyIsExpired(respDb *db, robj *key);
+int expireIfNeeded(respDb *db, robj *key);
+
+void delCommand(client *c);
+void existsCommand(client *c);
+void dbsizeCommand(client *c);
+void flushdbCommand(client *c);
+
+#endif //RESP_SERVER_DB_H
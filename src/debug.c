@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE /* dladdr() */
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include "server.h"
+#include "debug.h"
+#include "util.h"
+#include "log.h"
+#include "zmalloc.h"
+#include "reply.h"
+
+#ifdef HAVE_BACKTRACE
+#include <execinfo.h>
+#include <dlfcn.h>
+#endif
+
+/* =========================== Software Watchdog ============================
+ * The watchdog is a SIGALRM driven timer that checks how long the current
+ * event loop iteration has been running. The loop marks itself busy when
+ * it returns from the poll and idle right before going back to sleep, so the
+ * time spent waiting for events is never reported. When an iteration runs
+ * for more than 'watchdog_period' milliseconds, the current client, command
+ * and the stack trace of the main thread are logged, once per iteration.
+ *
+ * Everything called from the signal handler must be async-signal-safe, so
+ * messages are composed by hand in a stack buffer and written with
+ * serverLogFromHandler(). */
+
+/* Append the string 's' to 'buf' of total size 'size', truncating if needed. */
+static void watchdogBufCat(char *buf, size_t size, const char *s) {
+    size_t len = strlen(buf);
+
+    while (*s && len < size-1) buf[len++] = *s++;
+    buf[len] = '\0';
+}
+
+static void watchdogBufCatLongLong(char *buf, size_t size, long long ll) {
+    char num[LONG_STR_SIZE];
+
+    ll2string(num,sizeof(num),ll);
+    watchdogBufCat(buf,size,num);
+}
+
+/* Signal-safe version of ustime(). */
+static long long watchdogUstime(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME,&ts);
+    return ((long long)ts.tv_sec)*1000000 + ts.tv_nsec/1000;
+}
+
+/* Log the stack trace of the interrupted main thread. Since the signal is
+ * delivered to the main thread, the trace contains the handler frames
+ * followed by the frames of the code that was running. */
+static void watchdogLogStackTrace(void) {
+#ifdef HAVE_BACKTRACE
+    void *trace[100];
+    int trace_size, fd;
+
+    fd = serverLogOpenFromHandler();
+    if (fd == -1) return;
+    trace_size = backtrace(trace,100);
+    backtrace_symbols_fd(trace,trace_size,fd);
+    if (fd != STDOUT_FILENO) close(fd);
+#else
+    serverLogFromHandler(LL_WARNING,"Stack trace not available on this platform.");
+#endif
+}
+
+void watchdogSignalHandler(int sig, siginfo_t *info, void *secret) {
+    int saved_errno = errno;
+    long long busy_since = server.loop_busy_since;
+    long long elapsed;
+    client *c;
+    char msg[256];
+    UNUSED(sig);
+    UNUSED(info);
+    UNUSED(secret);
+
+    if (!busy_since || busy_since == server.watchdog_reported) goto done;
+    elapsed = (watchdogUstime() - busy_since)/1000;
+    if (elapsed < server.watchdog_period) goto done;
+    server.watchdog_reported = busy_since;
+
+    msg[0] = '\0';
+    watchdogBufCat(msg,sizeof(msg),"--- WATCHDOG TIMER EXPIRED (event loop busy for ");
+    watchdogBufCatLongLong(msg,sizeof(msg),elapsed);
+    watchdogBufCat(msg,sizeof(msg)," ms) ---");
+    serverLogFromHandler(LL_WARNING,msg);
+
+    c = server.current_client;
+    msg[0] = '\0';
+    if (c) {
+        watchdogBufCat(msg,sizeof(msg),"current client id=");
+        watchdogBufCatLongLong(msg,sizeof(msg),(long long)c->id);
+        watchdogBufCat(msg,sizeof(msg)," cmd=");
+        watchdogBufCat(msg,sizeof(msg),c->cmd ? c->cmd->name : "(none)");
+        watchdogBufCat(msg,sizeof(msg)," argc=");
+        watchdogBufCatLongLong(msg,sizeof(msg),c->argc);
+        if (c->conn) {
+            watchdogBufCat(msg,sizeof(msg)," fd=");
+            watchdogBufCatLongLong(msg,sizeof(msg),c->conn->fd);
+        }
+    } else {
+        watchdogBufCat(msg,sizeof(msg),"no client command is running");
+    }
+    serverLogFromHandler(LL_WARNING,msg);
+    watchdogLogStackTrace();
+    serverLogFromHandler(LL_WARNING,"--------");
+done:
+    errno = saved_errno;
+}
+
+/* Enable the software watchdog with the specified period in milliseconds.
+ * The timer ticks twice per period, so a stall is reported after at most
+ * 1.5 periods. Calling it again just changes the period. */
+void watchdogEnable(int period) {
+    struct sigaction act;
+    struct itimerval it;
+    int tick = period/2 ? period/2 : 1;
+
+#ifdef HAVE_BACKTRACE
+    /* backtrace() loads libgcc the first time it is called, which is not
+     * safe from a signal handler: do it now. */
+    void *trace[1];
+    backtrace(trace,1);
+#endif
+
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = SA_SIGINFO | SA_RESTART;
+    act.sa_sigaction = watchdogSignalHandler;
+    sigaction(SIGALRM, &act, NULL);
+
+    it.it_value.tv_sec = tick/1000;
+    it.it_value.tv_usec = (tick%1000)*1000;
+    it.it_interval = it.it_value;
+    setitimer(ITIMER_REAL, &it, NULL);
+    server.watchdog_period = period;
+}
+
+/* Disable the software watchdog. */
+void watchdogDisable(void) {
+    struct sigaction act;
+    struct itimerval it;
+
+    if (server.watchdog_period == 0) return; /* Already disabled. */
+    /* Stop timer */
+    it.it_value.tv_sec = 0;
+    it.it_value.tv_usec = 0;
+    it.it_interval.tv_sec = 0;
+    it.it_interval.tv_usec = 0;
+    setitimer(ITIMER_REAL, &it, NULL);
+
+    /* Set the signal handler to SIG_IGN, this will also remove pending
+     * signals from the queue. */
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = 0;
+    act.sa_handler = SIG_IGN;
+    sigaction(SIGALRM, &act, NULL);
+    server.watchdog_period = 0;
+}
+
+/* Called when the event loop wakes up from the poll. */
+void watchdogLoopBusy(long long now) {
+    if (server.watchdog_period) server.loop_busy_since = now;
+}
+
+/* Called right before the event loop goes back to sleep. */
+void watchdogLoopIdle(void) {
+    server.loop_busy_since = 0;
+}
+
+/* =========================== Sampling Profiler ============================
+ * DEBUG PROFILE START arms ITIMER_PROF, so SIGPROF is delivered every
+ * 1/hz seconds of CPU time consumed by the process. The handler captures
+ * the stack of the interrupted main thread into a buffer preallocated by
+ * START, without any allocation or locking. DEBUG PROFILE STOP disarms the
+ * timer, aggregates identical stacks and symbolizes them, returning them
+ * in the collapsed format understood by flamegraph.pl:
+ *
+ *   main;eventMain;processEvents;readQueryFromClient;... <count>
+ *
+ * Symbols are resolved with dladdr(), so only functions exported in the
+ * dynamic symbol table (see -rdynamic) get a name: samples inside static
+ * functions are attributed to the closest preceding exported symbol.
+ *
+ * The buffer is mapped directly with mmap(): it is not counted in the used
+ * memory, so profiling never triggers maxmemory evictions, and pages are
+ * only touched as samples are taken. Its size is capped by
+ * PROFILE_MAX_BUFFER. */
+
+/* Frames added by the signal delivery itself: the handler and the kernel
+ * sigreturn trampoline. */
+#define PROFILE_SKIP_FRAMES 2
+
+static volatile sig_atomic_t profile_active = 0;
+static void **profile_frames = NULL;    /* max_samples * PROFILE_MAX_DEPTH */
+static unsigned char *profile_depths = NULL;
+static size_t profile_buffer_size = 0;
+static long profile_max_samples = 0;
+static volatile long profile_samples = 0;
+static long profile_dropped = 0;
+static int profile_hz = 0;
+
+static void profileSignalHandler(int sig) {
+    int saved_errno = errno;
+    UNUSED(sig);
+
+    if (!profile_active) goto done;
+    if (profile_samples >= profile_max_samples) {
+        profile_dropped++;
+        goto done;
+    }
+#ifdef HAVE_BACKTRACE
+    void **frames = profile_frames + profile_samples*PROFILE_MAX_DEPTH;
+    profile_depths[profile_samples] = (unsigned char)backtrace(frames,PROFILE_MAX_DEPTH);
+    profile_samples++;
+#endif
+done:
+    errno = saved_errno;
+}
+
+static void profileSetTimer(int hz) {
+    struct itimerval it;
+
+    it.it_value.tv_sec = 0;
+    it.it_value.tv_usec = hz ? 1000000/hz : 0;
+    it.it_interval = it.it_value;
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+static void profileFreeBuffer(void) {
+    if (profile_frames) munmap(profile_frames,profile_buffer_size);
+    profile_frames = NULL;
+    profile_depths = NULL;
+    profile_samples = 0;
+    profile_dropped = 0;
+}
+
+int profileStart(int hz, long max_samples) {
+    struct sigaction act;
+
+    void *buf;
+    size_t size;
+
+    if (profile_active) return C_ERR;
+    profileFreeBuffer();
+    size = (sizeof(void*)*PROFILE_MAX_DEPTH+1)*max_samples;
+    buf = mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+    if (buf == MAP_FAILED) return C_ERR;
+    profile_frames = buf;
+    profile_depths = (unsigned char*)(profile_frames+PROFILE_MAX_DEPTH*max_samples);
+    profile_buffer_size = size;
+    profile_max_samples = max_samples;
+    profile_hz = hz;
+
+#ifdef HAVE_BACKTRACE
+    /* backtrace() loads libgcc the first time it is called, which is not
+     * safe from a signal handler: do it now. */
+    void *trace[1];
+    backtrace(trace,1);
+#endif
+
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = SA_RESTART;
+    act.sa_handler = profileSignalHandler;
+    sigaction(SIGPROF, &act, NULL);
+    profile_active = 1;
+    profileSetTimer(hz);
+    return C_OK;
+}
+
+/* Return the name of the function containing 'addr' as a new sds string. */
+static sds profileSymbolName(void *addr) {
+#ifdef HAVE_BACKTRACE
+    Dl_info info;
+
+    if (!dladdr(addr,&info)) return sdscatprintf(sdsempty(),"%p",addr);
+    if (info.dli_sname)
+        return sdsnew(info.dli_sname);
+    if (info.dli_fname) {
+        const char *base = strrchr(info.dli_fname,'/');
+        return sdscatprintf(sdsempty(),"[%s]",base ? base+1 : info.dli_fname);
+    }
+#endif
+    return sdscatprintf(sdsempty(),"%p",addr);
+}
+
+static uint64_t profileAddrHash(const void *key) {
+    return dictGenWyHashFunction(&key,sizeof(key));
+}
+
+static int profileAddrCompare(void *privdata, const void *key1, const void *key2) {
+    DICT_NOTUSED(privdata);
+    return key1 == key2;
+}
+
+/* Raw stack (sds of frame addresses) or collapsed stack -> number of samples. */
+static dictType profileDictType = {
+        dictSdsWyHash,              /* hash function */
+        NULL,                       /* key dup */
+        NULL,                       /* val dup */
+        dictSdsKeyCompare,          /* key compare */
+        dictSdsDestructor,          /* key destructor */
+        NULL                        /* val destructor */
+};
+
+/* Frame address -> symbol name. */
+static dictType profileSymbolDictType = {
+        profileAddrHash,            /* hash function */
+        NULL,                       /* key dup */
+        NULL,                       /* val dup */
+        profileAddrCompare,         /* key compare */
+        NULL,                       /* key destructor */
+        dictSdsDestructor           /* val destructor */
+};
+
+/* Add 'count' samples to the stack 'stack', taking ownership of it. */
+static void profileCountStack(dict *stacks, sds stack, unsigned long long count) {
+    dictEntry *de = dictAddOrFind(stacks,stack);
+
+    if (dictGetKey(de) != stack)
+        sdsfree(stack);
+    else
+        dictSetUnsignedIntegerVal(de,0);
+    dictSetUnsignedIntegerVal(de,dictGetUnsignedIntegerVal(de)+count);
+}
+
+/* Stop the profiler and return the samples in collapsed format. Identical
+ * raw stacks are counted first and every distinct address is resolved only
+ * once, since dladdr() is by far the most expensive step. */
+sds profileStop(void) {
+    dict *raw, *stacks, *symbols;
+    dictIterator *di;
+    dictEntry *de;
+    long j;
+    int k;
+    sds report = sdsempty();
+
+    profile_active = 0;
+    profileSetTimer(0);
+    signal(SIGPROF, SIG_IGN);
+
+    raw = dictCreate(&profileDictType,NULL);
+    for (j = 0; j < profile_samples; j++) {
+        int depth = profile_depths[j] > PROFILE_SKIP_FRAMES ?
+                    profile_depths[j]-PROFILE_SKIP_FRAMES : 0;
+
+        profileCountStack(raw,sdsnewlen(profile_frames+j*PROFILE_MAX_DEPTH+PROFILE_SKIP_FRAMES,
+                                        sizeof(void*)*depth),1);
+    }
+
+    stacks = dictCreate(&profileDictType,NULL);
+    symbols = dictCreate(&profileSymbolDictType,NULL);
+    di = dictGetIterator(raw);
+    while((de = dictNext(di)) != NULL) {
+        void **frames = dictGetKey(de);
+        int depth = sdslen((sds)frames)/sizeof(void*);
+        sds stack = sdsempty();
+
+        /* Collapsed stacks go from the root to the leaf. */
+        for (k = depth-1; k >= 0; k--) {
+            dictEntry *sym = dictFind(symbols,frames[k]);
+
+            if (sym == NULL) {
+                sym = dictAddRaw(symbols,frames[k],NULL);
+                dictSetVal(symbols,sym,profileSymbolName(frames[k]));
+            }
+            if (sdslen(stack)) stack = sdscatlen(stack,";",1);
+            stack = sdscatsds(stack,dictGetVal(sym));
+        }
+        if (sdslen(stack) == 0) stack = sdscat(stack,"[unknown]");
+        profileCountStack(stacks,stack,dictGetUnsignedIntegerVal(de));
+    }
+    dictReleaseIterator(di);
+    dictRelease(symbols);
+    dictRelease(raw);
+
+    di = dictGetIterator(stacks);
+    while((de = dictNext(di)) != NULL) {
+        report = sdscatprintf(report,"%s %llu\n",(char*)dictGetKey(de),
+                              (unsigned long long)dictGetUnsignedIntegerVal(de));
+    }
+    dictReleaseIterator(di);
+    dictRelease(stacks);
+    serverLog(LL_NOTICE,"Profiler stopped: %ld samples at %d Hz, %ld dropped.",
+              profile_samples,profile_hz,profile_dropped);
+    profileFreeBuffer();
+    return report;
+}
+
+void debugCommand(client *c) {
+    if (c->argc == 2 && !strcasecmp(c->argv[1]->ptr,"help")) {
+        const char *help[] = {
+"PROFILE START [hz] [max-samples] -- Start sampling the main thread stack every",
+"1/hz seconds of CPU time (default 99 Hz, 100000 samples).",
+"PROFILE STOP -- Stop the profiler and return the samples as collapsed stacks,",
+"ready for flamegraph.pl.",
+"PROFILE STATUS -- Return whether the profiler is running and the samples taken.",
+        };
+        int j, n = sizeof(help)/sizeof(help[0]);
+
+        addReplyArrayLen(c,n);
+        for (j = 0; j < n; j++) addReplyStatus(c,help[j]);
+    } else if (c->argc >= 3 && c->argc <= 5 &&
+               !strcasecmp(c->argv[1]->ptr,"profile") &&
+               !strcasecmp(c->argv[2]->ptr,"start"))
+    {
+        long long hz = PROFILE_DEFAULT_HZ, max = PROFILE_DEFAULT_MAX_SAMPLES;
+
+        if ((c->argc >= 4 &&
+             (!string2ll(c->argv[3]->ptr,sdslen(c->argv[3]->ptr),&hz) ||
+              hz < 1 || hz > PROFILE_MAX_HZ)) ||
+            (c->argc == 5 &&
+             (!string2ll(c->argv[4]->ptr,sdslen(c->argv[4]->ptr),&max) ||
+              max < 1 || max > (long long)PROFILE_MAX_SAMPLES)))
+        {
+            addReplyError(c,"Invalid profiler hz or max-samples");
+            return;
+        }
+        if (profile_active) {
+            addReplyError(c,"Profiler already running");
+            return;
+        }
+        if (profileStart((int)hz,(long)max) != C_OK) {
+            addReplyErrorFormat(c,"Can't allocate the profiler buffer: %s",strerror(errno));
+            return;
+        }
+        addReply(c,shared.ok);
+    } else if (c->argc == 3 && !strcasecmp(c->argv[1]->ptr,"profile") &&
+               !strcasecmp(c->argv[2]->ptr,"stop"))
+    {
+        if (!profile_active) {
+            addReplyError(c,"Profiler not running");
+            return;
+        }
+        sds report = profileStop();
+        addReplyBulkCBuffer(c,report,sdslen(report));
+        sdsfree(report);
+    } else if (c->argc == 3 && !strcasecmp(c->argv[1]->ptr,"profile") &&
+               !strcasecmp(c->argv[2]->ptr,"status"))
+    {
+        addReplyArrayLen(c,6);
+        addReplyBulkCString(c,"running");
+        addReplyLongLong(c,profile_active);
+        addReplyBulkCString(c,"samples");
+        addReplyLongLong(c,profile_samples);
+        addReplyBulkCString(c,"dropped");
+        addReplyLongLong(c,profile_dropped);
+    } else {
+        addReplyErrorFormat(c,"Unknown subcommand or wrong number of arguments for '%s'. Try DEBUG HELP.",
+                            (char*)c->argv[1]->ptr);
+    }
+}
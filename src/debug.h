@@ -0,0 +1,33 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_DEBUG_H
+#define RESP_SERVER_DEBUG_H
+
+#if defined(__linux__) || defined(__APPLE__)
+#define HAVE_BACKTRACE 1
+#endif
+
+#include "server.h"
+
+#define CONFIG_DEFAULT_WATCHDOG_PERIOD 0
+
+/* Sampling profiler */
+#define PROFILE_MAX_DEPTH 64
+#define PROFILE_DEFAULT_HZ 99
+#define PROFILE_MAX_HZ 10000
+#define PROFILE_DEFAULT_MAX_SAMPLES 100000
+/* 采样缓冲区的上限，每个样本占PROFILE_MAX_DEPTH个帧地址加1字节的深度 */
+#define PROFILE_MAX_BUFFER (64*1024*1024)
+#define PROFILE_MAX_SAMPLES (PROFILE_MAX_BUFFER/(PROFILE_MAX_DEPTH*sizeof(void*)+1))
+
+void watchdogEnable(int period);
+void watchdogDisable(void);
+void watchdogLoopBusy(long long now);
+void watchdogLoopIdle(void);
+int profileStart(int hz, long max_samples);
+sds profileStop(void);
+void debugCommand(client *c);
+
+#endif //RESP_SERVER_DEBUG_H
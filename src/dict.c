@@ -38,10 +38,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdarg.h>
 #include <limits.h>
 #include <sys/time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "dict.h"
 #include "zmalloc.h"
@@ -69,6 +73,9 @@ static int _dictExpandIfNeeded(dict *ht);
 static unsigned long _dictNextPower(unsigned long size);
 static long _dictKeyIndex(dict *ht, const void *key, uint64_t hash, dictEntry **existing);
 static int _dictInit(dict *ht, dictType *type, void *privDataPtr);
+static void _dictRehashStep(dict *d);
+long long dictFingerprint(dict *d);
+static unsigned long rev(unsigned long v);
 
 /* -------------------------- hash functions -------------------------------- */
 
@@ -96,6 +103,34 @@ uint64_t dictGenCaseHashFunction(const unsigned char *buf, int len) {
     return siphash_nocase(buf,len,dict_hash_function_seed);
 }
 
+/* wyhash in wyhash.c is several times faster than SipHash on short keys,
+ * but it gives no guarantee against keys crafted to collide: use it for
+ * the tables whose keys are not chosen by the clients. */
+
+uint64_t wyhash(const uint8_t *in, const size_t inlen, const uint8_t *k);
+void wyhash_batch(const uint8_t *const *in, const size_t *inlen, int count,
+                  const uint8_t *k, uint64_t *out);
+
+uint64_t dictGenWyHashFunction(const void *key, int len) {
+    return wyhash(key,len,dict_hash_function_seed);
+}
+
+void dictGenWyHashFunctionBatch(const void *const *keys, const size_t *lens, int count, uint64_t *hashes) {
+    wyhash_batch((const uint8_t *const *)keys,lens,count,dict_hash_function_seed,hashes);
+}
+
+/* Hash 'count' keys at once with the batch function of the type, if any. */
+static void _dictHashKeys(dict *d, const void *const *keys, int count, uint64_t *hashes) {
+    int j;
+
+    if (d->type->hashBatchFunction) {
+        d->type->hashBatchFunction(keys,count,hashes);
+        return;
+    }
+    for (j = 0; j < count; j++)
+        hashes[j] = dictHashKey(d,keys[j]);
+}
+
 /* ----------------------------- API implementation ------------------------- */
 
 /* Reset a hash table already initialized with ht_init().
@@ -106,6 +141,8 @@ static void _dictReset(dictht *ht)
     ht->size = 0;
     ht->sizemask = 0;
     ht->used = 0;
+    ht->segments = NULL;
+    ht->resizing = NULL;
 }
 
 /* Create a new hash table */
@@ -114,6 +151,7 @@ dict *dictCreate(dictType *type,
 {
     dict *d = zmalloc(sizeof(*d));
 
+    assert(type->embedKey == NULL || type->openAddressing);
     _dictInit(d,type,privDataPtr);
     return d;
 }
@@ -131,13 +169,762 @@ int _dictInit(dict *d, dictType *type,
     return DICT_OK;
 }
 
+/* ------------------------ open addressing tables --------------------------
+ *
+ * A dict whose type has 'openAddressing' set stores the entries directly in
+ * flat arrays of slots, instead of chaining a malloc'ed dictEntry per key:
+ * no allocation per insert, no pointer chasing per probe and 16 bytes plus
+ * one control byte per slot.
+ *
+ * The table is split in segments of at most DICT_OA_SEGMENT_SLOTS slots,
+ * found via a directory indexed by the low bits of the hash (extendible
+ * hashing). Every segment has a depth: all its keys share the low 'depth'
+ * bits of the hash, so it is referenced by all the directory entries ending
+ * with these bits. A small segment that fills up is replaced by one twice
+ * as big, a segment of the max size is split in two segments of depth+1,
+ * doubling the directory first if needed. So the table grows one segment
+ * at a time: there is never a second copy of the whole table, nor a big
+ * allocation, but the directory that is just an array of pointers. The
+ * elements of the old segment are moved incrementally like the buckets of
+ * a chained table during rehashing, so dictIsRehashing() is true until the
+ * old segment is empty, and only one segment is resized at a time.
+ * dictResize() shrinks the table the same way backward: a segment merges
+ * its buddy (the segment whose keys only differ in the highest bit of the
+ * depth) if both fit in half a segment, and a single segment is replaced
+ * by a smaller one.
+ *
+ * Inside a segment, the slots are divided in groups of DICT_OA_GROUP_SIZE.
+ * Every slot has a control byte that is either DICT_OA_EMPTY or the 7 high
+ * bits of the hash of the key stored there. A lookup loads the control
+ * bytes of a group and compares them all at once (with SSE2 when available)
+ * against the hash bits of the key, so usually only one key comparison is
+ * needed. The home group of a key is given by the bits 32 and up of the
+ * hash, and collisions are resolved by linear probing over groups. Every
+ * group has an "ever full" flag, set the first time the group has no empty
+ * slot left: a lookup moves to the next group only if the flag is set, so
+ * deleting an element just empties its slot and no tombstone is needed.
+ * Rebuilding the segment on growth clears the flags.
+ *
+ * A slot only holds the 'key' and 'v' fields of dictEntry, without 'next',
+ * and is accessed via a dictEntry pointer so that dictGetKey(), dictSetVal()
+ * and friends work the same on both layouts. Such pointers are only valid
+ * until the next insertion in the dict, that may move the elements: they
+ * must not be kept around.
+ *
+ * When the type has 'embedKey', the key is copied at the end of a small
+ * dictEmbeddedEntry allocation holding the value as well, and the slot
+ * only holds the pointer to it, tagged with DICT_ENTRY_EMBEDDED: 8 bytes
+ * per slot, and a single allocation per key instead of the key plus its
+ * share of a 16 bytes slot. The entry returned is the tagged pointer, that
+ * stays valid until the element is deleted.
+ *
+ * Segments don't grow while there are safe iterators (or a dictScan() call)
+ * active, unless they are completely full: adding a lot of elements while
+ * iterating may make the iterator report some element twice or miss it. */
+
+#define DICT_OA_GROUP_SIZE 16
+#define DICT_OA_SEGMENT_BITS 12
+#define DICT_OA_SEGMENT_SLOTS (1 << DICT_OA_SEGMENT_BITS)
+#define DICT_OA_SEGMENT_GROUPS (DICT_OA_SEGMENT_SLOTS/DICT_OA_GROUP_SIZE)
+#define DICT_OA_MAX_DEPTH 32
+#define DICT_OA_RESIZE_HELP 4   /* Groups moved by inserts over the max fill. */
+#define DICT_OA_EMPTY 0x80
+#define DICT_OA_SLOT_SIZE (offsetof(dictEntry,next))
+#define DICT_OA_EMBEDDED_SLOT_SIZE (sizeof(dictEntry*))
+#define DICT_OA_GROUP_FULL ((1u<<DICT_OA_GROUP_SIZE)-1)
+
+/* The header is followed by 'size' control bytes and then by the slots.
+ * All the segments have the max size, but when there is just one: so the
+ * lookups find the control bytes and slots of big tables without reading
+ * the header, that would cost one more cache miss. */
+typedef struct dictSegment {
+    unsigned long size;         /* Number of slots. */
+    unsigned long groupmask;    /* Number of groups - 1. */
+    unsigned long used;
+    uint64_t everfull[(DICT_OA_SEGMENT_GROUPS+63)/64]; /* Ever full flags. */
+    unsigned long pattern;      /* While resized: the low bits of its keys. */
+    int depth;                  /* Low hash bits shared by all the keys. */
+} dictSegment;
+
+#define DICT_OA_SEGMENT_HDR ((sizeof(dictSegment)+15) & ~(size_t)15)
+
+#define _dictOaH2(hash) ((uint8_t)((hash) >> 57))
+#define _dictOaHomeGroup(groupmask, hash) (((hash) >> 32) & (groupmask))
+#define _dictOaSegment(ht, hash) ((ht)->segments[(hash) & (ht)->sizemask])
+#define _dictOaGroupMask(ht, seg) \
+    ((ht)->sizemask ? DICT_OA_SEGMENT_GROUPS-1 : (seg)->groupmask)
+#define _dictOaCtrl(seg, g) ((uint8_t*)(seg) + DICT_OA_SEGMENT_HDR + (g)*DICT_OA_GROUP_SIZE)
+#define _dictOaSlotSize(d) \
+    ((d)->type->embedKey ? DICT_OA_EMBEDDED_SLOT_SIZE : DICT_OA_SLOT_SIZE)
+#define _dictOaSlot(seg, size, idx, slotsize) \
+    ((char*)(seg) + DICT_OA_SEGMENT_HDR + (size) + (idx)*(slotsize))
+#define _dictOaSlotIndex(seg, slot, slotsize) \
+    ((unsigned long)(((char*)(slot) - _dictOaSlot(seg,(seg)->size,0,slotsize))/(slotsize)))
+/* The entry stored in a slot: the slot itself, or the pointer it holds. */
+#define _dictOaSlotEntry(d, slot) \
+    ((d)->type->embedKey ? *(dictEntry**)(slot) : (dictEntry*)(slot))
+#define _dictOaEntry(d, seg, idx) \
+    _dictOaSlotEntry(d,_dictOaSlot(seg,(seg)->size,idx,_dictOaSlotSize(d)))
+#define _dictOaIsEmpty(seg, idx) (_dictOaCtrl(seg,0)[idx] & DICT_OA_EMPTY)
+#define _dictOaEverFull(seg, g) ((seg)->everfull[(g)/64] & ((uint64_t)1 << ((g)%64)))
+#define _dictOaSetEverFull(seg, g) ((seg)->everfull[(g)/64] |= (uint64_t)1 << ((g)%64))
+#define _dictOaMaxFill(size) ((size) - (size)/8)
+#define _dictOaFullMask(seg, g) (~_dictOaMatchEmpty(_dictOaCtrl(seg,g)) & DICT_OA_GROUP_FULL)
+/* A segment is referenced by the directory entries ending with its 'depth'
+ * bits: the first of them, smaller than 1<<depth, is the canonical one. */
+#define _dictOaIsCanonical(seg, idx) ((idx) < (1UL << (seg)->depth))
+
+/* Return a bitmap of the slots of the group whose control byte is 'h2'. */
+static inline unsigned int _dictOaMatch(const uint8_t *ctrl, uint8_t h2) {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(group,_mm_set1_epi8((char)h2)));
+#else
+    unsigned int mask = 0;
+    int j;
+
+    for (j = 0; j < DICT_OA_GROUP_SIZE; j++)
+        if (ctrl[j] == h2) mask |= 1u << j;
+    return mask;
+#endif
+}
+
+/* Return a bitmap of the empty slots of the group: only the empty control
+ * byte has the high bit set. */
+static inline unsigned int _dictOaMatchEmpty(const uint8_t *ctrl) {
+#if defined(__SSE2__)
+    return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    unsigned int mask = 0;
+    int j;
+
+    for (j = 0; j < DICT_OA_GROUP_SIZE; j++)
+        if (ctrl[j] & DICT_OA_EMPTY) mask |= 1u << j;
+    return mask;
+#endif
+}
+
+/* Create an empty segment of 'size' slots, a power of two multiple of the
+ * group size, up to 64 groups. Header, control bytes and slots share one
+ * allocation. */
+static dictSegment *_dictOaSegmentCreate(dict *d, unsigned long size, int depth) {
+    dictSegment *seg = zmalloc(DICT_OA_SEGMENT_HDR+size+size*_dictOaSlotSize(d));
+
+    seg->size = size;
+    seg->groupmask = size/DICT_OA_GROUP_SIZE-1;
+    seg->used = 0;
+    memset(seg->everfull,0,sizeof(seg->everfull));
+    seg->depth = depth;
+    memset(_dictOaCtrl(seg,0),DICT_OA_EMPTY,size);
+    return seg;
+}
+
+/* Return the slot holding the key, or NULL. */
+static char *_dictOaFindInSegment(dict *d, dictSegment *seg, const void *key, uint64_t hash) {
+    unsigned long groupmask = _dictOaGroupMask(&d->ht[0],seg);
+    unsigned long size = (groupmask+1)*DICT_OA_GROUP_SIZE, g, probes;
+    size_t slotsize = _dictOaSlotSize(d);
+    uint8_t h2 = _dictOaH2(hash);
+
+    g = _dictOaHomeGroup(groupmask,hash);
+    for (probes = 0; probes <= groupmask; probes++) {
+        unsigned int match = _dictOaMatch(_dictOaCtrl(seg,g),h2);
+
+        while (match) {
+            char *slot = _dictOaSlot(seg,size,g*DICT_OA_GROUP_SIZE+__builtin_ctz(match),slotsize);
+            void *hekey = dictGetKey(_dictOaSlotEntry(d,slot));
+
+            if (key==hekey || dictCompareKeys(d, key, hekey))
+                return slot;
+            match &= match-1;
+        }
+        if (!_dictOaEverFull(seg,g)) break;
+        g = (g+1) & groupmask;
+    }
+    return NULL;
+}
+
+/* Take the first empty slot in the probe sequence of 'hash'. The caller
+ * makes sure the key is not already there and the segment has room. */
+static char *_dictOaInsertSlot(dictSegment *seg, uint64_t hash, size_t slotsize) {
+    unsigned long g = _dictOaHomeGroup(seg->groupmask,hash);
+
+    while (1) {
+        uint8_t *ctrl = _dictOaCtrl(seg,g);
+        unsigned int empty = _dictOaMatchEmpty(ctrl);
+
+        if (empty) {
+            int j = __builtin_ctz(empty);
+
+            ctrl[j] = _dictOaH2(hash);
+            if ((empty & (empty-1)) == 0) _dictOaSetEverFull(seg,g);
+            seg->used++;
+            return _dictOaSlot(seg,seg->size,g*DICT_OA_GROUP_SIZE+j,slotsize);
+        }
+        g = (g+1) & seg->groupmask;
+    }
+}
+
+/* Return the number of elements still in the segment being resized that
+ * may be moved to the segment of 'hash', whose depth is 'depth'. Only the
+ * bits shared by both segments are compared: a segment merging its buddy
+ * has one bit less than the buddy. Pass DICT_OA_MAX_DEPTH to know if the
+ * key itself may still be in the segment being resized. */
+static unsigned long _dictOaPending(dictht *ht, uint64_t hash, int depth) {
+    dictSegment *from = ht->resizing;
+
+    if (from) {
+        if (depth > from->depth) depth = from->depth;
+        if (((hash ^ from->pattern) & ((1UL << depth)-1)) == 0)
+            return from->used;
+    }
+    return 0;
+}
+
+/* Start growing the segment where 'hash' belongs: replace it with one
+ * twice as big if it is smaller than the max segment size, otherwise with
+ * two segments of depth+1, each for the keys having the bit 'depth' of the
+ * hash clear or set. The old segment becomes 'ht->resizing' and its
+ * elements are moved incrementally by dictRehash(), one group per step,
+ * 'rehashidx' being the next group to move. */
+static void _dictOaStartResize(dict *d, uint64_t hash) {
+    dictht *ht = &d->ht[0];
+    dictSegment *seg = _dictOaSegment(ht,hash), *to, *to1;
+    unsigned long step = 1UL << seg->depth, j;
+
+    if (seg->size < DICT_OA_SEGMENT_SLOTS) {
+        to = to1 = _dictOaSegmentCreate(d,seg->size*2,seg->depth);
+        ht->size += to->size;
+    } else {
+        assert(seg->depth < DICT_OA_MAX_DEPTH);
+        if (step == ht->sizemask+1) {
+            /* The directory has no bit left to tell the two halves apart,
+             * double it: the new entries point where the old ones do. */
+            unsigned long dirsize = ht->sizemask+1;
+
+            ht->segments = zrealloc(ht->segments,sizeof(dictSegment*)*dirsize*2);
+            memcpy(ht->segments+dirsize,ht->segments,sizeof(dictSegment*)*dirsize);
+            ht->sizemask = dirsize*2-1;
+        }
+        to = _dictOaSegmentCreate(d,seg->size,seg->depth+1);
+        to1 = _dictOaSegmentCreate(d,seg->size,seg->depth+1);
+        ht->size += to->size + to1->size;
+    }
+
+    seg->pattern = hash & (step-1);
+    for (j = seg->pattern; j <= ht->sizemask; j += step)
+        ht->segments[j] = (j & step) ? to1 : to;
+    ht->resizing = seg;
+    d->rehashidx = 0;
+}
+
+/* Move up to 'n' groups of the segment being resized to the new segments,
+ * see dictRehash(). */
+static int _dictOaRehash(dict *d, int n) {
+    int empty_visits = n*10;
+    dictht *ht = &d->ht[0];
+    dictSegment *from = ht->resizing;
+    const void *keys[DICT_OA_GROUP_SIZE];
+    uint64_t hashes[DICT_OA_GROUP_SIZE];
+    int slots[DICT_OA_GROUP_SIZE], count, j;
+    size_t slotsize = _dictOaSlotSize(d);
+    unsigned long base;
+    uint8_t *ctrl;
+
+    while(n-- && from->used != 0) {
+        unsigned int full;
+
+        assert(from->groupmask >= (unsigned long)d->rehashidx);
+        while ((full = _dictOaFullMask(from,d->rehashidx)) == 0) {
+            d->rehashidx++;
+            if (--empty_visits == 0) return 1;
+        }
+        /* The hash is not stored in the slot: load all the keys of the
+         * group first and hash them in a batch, so that the cache misses
+         * on the keys overlap. */
+        ctrl = _dictOaCtrl(from,d->rehashidx);
+        base = d->rehashidx*DICT_OA_GROUP_SIZE;
+        for (count = 0; full; full &= full-1) {
+            slots[count] = __builtin_ctz(full);
+            keys[count] = dictGetKey(_dictOaEntry(d,from,base+slots[count]));
+            __builtin_prefetch(keys[count]);
+            count++;
+        }
+        _dictHashKeys(d,keys,count,hashes);
+        for (j = 0; j < count; j++) {
+            uint64_t h = hashes[j];
+
+            memcpy(_dictOaInsertSlot(_dictOaSegment(ht,h),h,slotsize),
+                   _dictOaSlot(from,from->size,base+slots[j],slotsize),slotsize);
+            ctrl[slots[j]] = DICT_OA_EMPTY;
+        }
+        from->used -= count;
+        d->rehashidx++;
+    }
+
+    if (from->used == 0) {
+        ht->size -= from->size;
+        zfree(from);
+        ht->resizing = NULL;
+        d->rehashidx = -1;
+        return 0;
+    }
+    return 1;
+}
+
+/* Return the segment where to add an element with the given hash, after
+ * growing it if needed. A segment over the max fill is not grown while
+ * another one is being resized, it takes some more elements and helps the
+ * resizing to go on instead: so that when many segments fill up at the
+ * same time the work is spread over the next operations. */
+static dictSegment *_dictOaMakeRoom(dict *d, uint64_t hash) {
+    dictht *ht = &d->ht[0];
+
+    while (1) {
+        dictSegment *seg = _dictOaSegment(ht,hash);
+
+        if (seg->used + _dictOaPending(ht,hash,seg->depth) < seg->size) {
+            if (seg->used < _dictOaMaxFill(seg->size) || d->iterators)
+                return seg;
+            if (ht->resizing) {
+                dictRehash(d,DICT_OA_RESIZE_HELP);
+                if (ht->resizing) return seg;
+                continue;
+            }
+        } else if (ht->resizing) {
+            /* Not enough room for the elements still to be moved here:
+             * complete the resizing now. */
+            while (dictRehash(d,100));
+            continue;
+        }
+        _dictOaStartResize(d,hash);
+    }
+}
+
+/* Find the slot of the element in its segment, or in the segment being
+ * resized. */
+static char *_dictOaLookup(dict *d, const void *key, uint64_t hash, dictSegment **segptr) {
+    dictht *ht = &d->ht[0];
+    dictSegment *seg = _dictOaSegment(ht,hash);
+    char *slot;
+
+    if ((slot = _dictOaFindInSegment(d,seg,key,hash)) == NULL &&
+        _dictOaPending(ht,hash,DICT_OA_MAX_DEPTH))
+    {
+        seg = ht->resizing;
+        slot = _dictOaFindInSegment(d,seg,key,hash);
+    }
+    if (segptr) *segptr = seg;
+    return slot;
+}
+
+/* Pre-size an empty table for 'size' elements, using 2^n segments. */
+static int _dictOaExpand(dict *d, unsigned long size) {
+    dictht *ht = &d->ht[0];
+    unsigned long segsize = DICT_OA_GROUP_SIZE, nseg = 1, j;
+    int depth = 0;
+
+    if (ht->segments != NULL) return DICT_ERR;
+    while (_dictOaMaxFill(segsize*nseg) < size) {
+        if (segsize < DICT_OA_SEGMENT_SLOTS) {
+            segsize *= 2;
+        } else {
+            if (depth == DICT_OA_MAX_DEPTH) return DICT_ERR;
+            nseg *= 2;
+            depth++;
+        }
+    }
+
+    ht->segments = zmalloc(sizeof(dictSegment*)*nseg);
+    for (j = 0; j < nseg; j++)
+        ht->segments[j] = _dictOaSegmentCreate(d,segsize,depth);
+    ht->size = segsize*nseg;
+    ht->sizemask = nseg-1;
+    ht->used = 0;
+    return DICT_OK;
+}
+
+/* Halve the directory while every segment is referenced by both halves. */
+static void _dictOaShrinkDirectory(dictht *ht) {
+    unsigned long half, j;
+
+    while (ht->sizemask) {
+        half = (ht->sizemask+1)/2;
+        for (j = 0; j < half; j++)
+            if (ht->segments[j] != ht->segments[j+half]) return;
+        ht->segments = zrealloc(ht->segments,sizeof(dictSegment*)*half);
+        ht->sizemask = half-1;
+    }
+}
+
+/* Start shrinking the table, see dictResize(). The segment that goes away
+ * becomes 'ht->resizing' and its elements are moved by dictRehash() like
+ * when growing. A single segment is replaced by the smallest one that is
+ * at most half full. Otherwise the first pair of buddy segments that fit
+ * in half a segment is merged: the segment with the bit depth-1 of its
+ * keys clear loses one bit of depth and takes the directory entries of the
+ * other one, that stays canonical. */
+static int _dictOaShrink(dict *d) {
+    dictht *ht = &d->ht[0];
+    dictSegment *seg, *buddy;
+    unsigned long j, b, step;
+
+    if (ht->segments == NULL) return DICT_ERR;
+    _dictOaShrinkDirectory(ht);
+
+    if (ht->sizemask == 0) {
+        unsigned long size = DICT_OA_GROUP_SIZE;
+
+        seg = ht->segments[0];
+        while (size < ht->used*2) size *= 2;
+        if (size >= seg->size) return DICT_ERR;
+        ht->segments[0] = _dictOaSegmentCreate(d,size,0);
+        ht->size += size;
+        seg->pattern = 0;
+        ht->resizing = seg;
+        d->rehashidx = 0;
+        return DICT_OK;
+    }
+
+    for (j = 0; j <= ht->sizemask; j++) {
+        seg = ht->segments[j];
+        if (seg->depth == 0 || j >= (1UL << (seg->depth-1))) continue;
+        b = j | (1UL << (seg->depth-1));
+        buddy = ht->segments[b];
+        if (buddy->depth != seg->depth ||
+            seg->used + buddy->used > DICT_OA_SEGMENT_SLOTS/2) continue;
+
+        step = 1UL << seg->depth;
+        for (; b <= ht->sizemask; b += step)
+            ht->segments[b] = seg;
+        seg->depth--;
+        buddy->pattern = j | (step >> 1);
+        ht->resizing = buddy;
+        d->rehashidx = 0;
+        return DICT_OK;
+    }
+    return DICT_ERR;
+}
+
+/* Allocate an entry with a copy of 'key' for a type with 'embedKey'. */
+static dictEntry *_dictOaCreateEmbeddedEntry(dict *d, const void *key) {
+    size_t len = d->type->embedKey(NULL,0,key,NULL);
+    dictEmbeddedEntry *e = zmalloc(offsetof(dictEmbeddedEntry,buf)+len);
+
+    e->v.val = NULL;
+    d->type->embedKey(e->buf,len,key,&e->keyoff);
+    return (dictEntry*)((uintptr_t)e | DICT_ENTRY_EMBEDDED);
+}
+
+static dictEntry *_dictOaAddRaw(dict *d, void *key, dictEntry **existing) {
+    dictht *ht = &d->ht[0];
+    uint64_t hash = dictHashKey(d,key);
+    dictSegment *seg;
+    dictEntry *he;
+    char *slot;
+
+    if (existing) *existing = NULL;
+    if (dictIsRehashing(d)) _dictRehashStep(d);
+    if (ht->segments == NULL) _dictOaExpand(d,1);
+    if ((slot = _dictOaLookup(d,key,hash,NULL)) != NULL) {
+        if (existing) *existing = _dictOaSlotEntry(d,slot);
+        return NULL;
+    }
+
+    seg = _dictOaMakeRoom(d,hash);
+    slot = _dictOaInsertSlot(seg,hash,_dictOaSlotSize(d));
+    ht->used++;
+    if (d->type->embedKey) {
+        he = _dictOaCreateEmbeddedEntry(d,key);
+        *(dictEntry**)slot = he;
+    } else {
+        he = (dictEntry*)slot;
+        dictSetKey(d, he, key);
+    }
+    return he;
+}
+
+static dictEntry *_dictOaFind(dict *d, const void *key) {
+    char *slot;
+
+    if (dictSize(d) == 0) return NULL;
+    if (dictIsRehashing(d)) _dictRehashStep(d);
+    slot = _dictOaLookup(d,key,dictHashKey(d,key),NULL);
+    return slot ? _dictOaSlotEntry(d,slot) : NULL;
+}
+
+/* Release the key and the value of an element, and its entry if it was
+ * allocated apart from the table. */
+static void _dictOaFreeEntry(dict *d, dictEntry *he) {
+    dictFreeKey(d, he);
+    dictFreeVal(d, he);
+    if (dictEntryIsEmbedded(he)) zfree(dictEmbeddedEntry(he));
+}
+
+/* Empty the slot of the element. The returned entry still holds the key
+ * and the value until the next insertion, which is enough for dictUnlink()
+ * users that release it right away with dictFreeUnlinkedEntry(). An
+ * embedded entry is not in the table, it is valid until released. */
+static dictEntry *_dictOaGenericDelete(dict *d, const void *key, int nofree) {
+    dictht *ht = &d->ht[0];
+    size_t slotsize = _dictOaSlotSize(d);
+    dictSegment *seg;
+    dictEntry *he;
+    char *slot;
+    uint64_t h;
+
+    if (dictSize(d) == 0) return NULL;
+    if (dictIsRehashing(d)) _dictRehashStep(d);
+    h = dictHashKey(d, key);
+    if ((slot = _dictOaLookup(d,key,h,&seg)) == NULL) return NULL;
+
+    _dictOaCtrl(seg,0)[_dictOaSlotIndex(seg,slot,slotsize)] = DICT_OA_EMPTY;
+    seg->used--;
+    ht->used--;
+    he = _dictOaSlotEntry(d,slot);
+    if (!nofree) _dictOaFreeEntry(d,he);
+    return he;
+}
+
+static void _dictOaClear(dict *d, dictht *ht, void(callback)(void *)) {
+    unsigned long j, i, visited = 0;
+
+    /* Walk the directory backward: the canonical entry of a segment is the
+     * last one to be visited, so it is safe to release it there. */
+    for (j = ht->segments ? ht->sizemask+1 : 0; j-- > 0; ) {
+        dictSegment *seg = ht->segments[j];
+
+        if (!_dictOaIsCanonical(seg,j)) continue;
+        for (i = 0; i < seg->size && seg->used > 0; i++) {
+            dictEntry *he;
+
+            if (callback && (visited++ & 65535) == 0) callback(d->privdata);
+            if (_dictOaIsEmpty(seg,i)) continue;
+            he = _dictOaEntry(d,seg,i);
+            _dictOaFreeEntry(d,he);
+            seg->used--;
+        }
+        zfree(seg);
+    }
+    if (ht->resizing) {
+        dictSegment *seg = ht->resizing;
+
+        for (i = 0; i < seg->size && seg->used > 0; i++) {
+            dictEntry *he;
+
+            if (_dictOaIsEmpty(seg,i)) continue;
+            he = _dictOaEntry(d,seg,i);
+            _dictOaFreeEntry(d,he);
+            seg->used--;
+        }
+        zfree(seg);
+    }
+    zfree(ht->segments);
+    _dictReset(ht);
+}
+
+/* The iterator visits the segments of the directory, with the directory
+ * entry in the high bits of 'index' and the slot in the low
+ * DICT_OA_SEGMENT_BITS bits, then sets 'table' to 1 to visit the segment
+ * being resized, if any, with the slot in 'index'. */
+static dictEntry *_dictOaNext(dictIterator *iter) {
+    dictht *ht = &iter->d->ht[0];
+    long pos = iter->index+1;
+
+    if (iter->index == -1 && iter->table == 0) {
+        if (iter->safe)
+            iter->d->iterators++;
+        else
+            iter->fingerprint = dictFingerprint(iter->d);
+    }
+    while (ht->segments != NULL) {
+        unsigned long j = pos >> DICT_OA_SEGMENT_BITS;
+        unsigned long i = pos & (DICT_OA_SEGMENT_SLOTS-1);
+        dictSegment *seg;
+
+        if (iter->table == 1) {
+            seg = ht->resizing;
+            if (seg == NULL || (unsigned long)pos >= seg->size) break;
+            i = pos;
+        } else if (j > ht->sizemask) {
+            if (ht->resizing == NULL) break;
+            iter->table = 1;
+            pos = 0;
+            continue;
+        } else {
+            seg = ht->segments[j];
+            if (!_dictOaIsCanonical(seg,j) || i >= seg->size) {
+                pos = (j+1) << DICT_OA_SEGMENT_BITS;
+                continue;
+            }
+        }
+        if (!_dictOaIsEmpty(seg,i)) {
+            iter->index = pos;
+            iter->entry = _dictOaEntry(iter->d,seg,i);
+            return iter->entry;
+        }
+        pos++;
+    }
+    iter->index = pos;
+    iter->entry = NULL;
+    return NULL;
+}
+
+/* Return the segment at the position 'j' of the directory, where the
+ * position past the end is the segment being resized, if any. */
+#define _dictOaSegmentAt(ht, j) \
+    ((j) > (ht)->sizemask ? (ht)->resizing : (ht)->segments[j])
+
+/* Pick a random directory entry, then a random slot of the segment: the
+ * segments are picked proportionally to the hash range they cover. */
+static dictEntry *_dictOaGetRandomKey(dict *d) {
+    dictht *ht = &d->ht[0];
+    unsigned long positions = ht->sizemask+1+(ht->resizing != NULL);
+    dictSegment *seg;
+    unsigned long h;
+
+    do {
+        h = random() % positions;
+        seg = _dictOaSegmentAt(ht,h);
+        if (seg->used == 0) continue;
+        h = random() & (seg->size-1);
+        if (!_dictOaIsEmpty(seg,h)) return _dictOaEntry(d,seg,h);
+    } while(1);
+}
+
+/* Same as dictGetSomeKeys(), walking the groups of the segments starting
+ * at a random position. Adjacent directory entries always point to
+ * different segments, unless there is a single one. */
+static unsigned int _dictOaGetSomeKeys(dict *d, dictEntry **des, unsigned int count) {
+    dictht *ht = &d->ht[0];
+    unsigned long positions = ht->sizemask+1+(ht->resizing != NULL);
+    unsigned long stored = 0, maxsteps = count*10, emptylen = 0, j, g;
+    dictSegment *seg;
+
+    if (count == 0) return 0;
+    j = random() % positions;
+    seg = _dictOaSegmentAt(ht,j);
+    g = random() & seg->groupmask;
+    while(stored < count && maxsteps--) {
+        unsigned int full = _dictOaFullMask(seg,g);
+
+        if (full == 0) {
+            emptylen++;
+            if (emptylen >= 5 && emptylen > count) {
+                j = random() % positions;
+                seg = _dictOaSegmentAt(ht,j);
+                g = random() & seg->groupmask;
+                emptylen = 0;
+                continue;
+            }
+        } else {
+            emptylen = 0;
+            while (full) {
+                *des++ = _dictOaEntry(d,seg,g*DICT_OA_GROUP_SIZE+__builtin_ctz(full));
+                full &= full-1;
+                if (++stored == count) return stored;
+            }
+        }
+        if (++g > seg->groupmask) {
+            j = (j+1) % positions;
+            seg = _dictOaSegmentAt(ht,j);
+            g = 0;
+        }
+    }
+    return stored;
+}
+
+/* dictScan() for open addressing tables: the cursor addresses the directory
+ * like it addresses the buckets of a chained table. All the elements of the
+ * segment at cursor are emitted, then the cursor is incremented over the
+ * bits of the segment depth only, since the segment covers all the
+ * combinations of the higher bits. Splitting segments and doubling the
+ * directory is the same as a table growing, merging them and halving the
+ * directory the same as a table shrinking. The segment being resized
+ * covers the same keys as the new ones, or as a part of the segment that
+ * merges it: it is emitted as well when the cursor is on one of them. */
+static unsigned long _dictOaScan(dict *d, unsigned long v, dictScanFunction *fn,
+                                 void *privdata)
+{
+    dictht *ht = &d->ht[0];
+    dictSegment *seg = _dictOaSegment(ht,v);
+    unsigned long i;
+
+    for (i = 0; i < seg->size; i++) {
+        if (_dictOaIsEmpty(seg,i)) continue;
+        fn(privdata, _dictOaEntry(d,seg,i));
+    }
+    if (_dictOaPending(ht,v,seg->depth)) {
+        dictSegment *from = ht->resizing;
+
+        for (i = 0; i < from->size; i++) {
+            if (_dictOaIsEmpty(from,i)) continue;
+            fn(privdata, _dictOaEntry(d,from,i));
+        }
+    }
+
+    v |= ~((1UL << seg->depth)-1);
+    v = rev(v);
+    v++;
+    v = rev(v);
+    return v;
+}
+
+static size_t _dictOaGetStatsHt(char *buf, size_t bufsize, dict *d, dictht *ht) {
+    unsigned long j, i, segments = 0, probelen, maxprobelen = 0, totprobelen = 0;
+    int mindepth = DICT_OA_MAX_DEPTH, maxdepth = 0;
+
+    if (ht->used == 0) {
+        return snprintf(buf,bufsize,
+            "No stats available for empty dictionaries\n");
+    }
+    for (j = 0; j <= ht->sizemask; j++) {
+        dictSegment *seg = ht->segments[j];
+
+        if (!_dictOaIsCanonical(seg,j)) continue;
+        segments++;
+        if (seg->depth < mindepth) mindepth = seg->depth;
+        if (seg->depth > maxdepth) maxdepth = seg->depth;
+        for (i = 0; i < seg->size; i++) {
+            uint64_t h;
+
+            if (_dictOaIsEmpty(seg,i)) continue;
+            /* Number of groups probed past the home group to find the key. */
+            h = dictHashKey(d,dictGetKey(_dictOaEntry(d,seg,i)));
+            probelen = (i/DICT_OA_GROUP_SIZE - _dictOaHomeGroup(seg->groupmask,h)) & seg->groupmask;
+            if (probelen > maxprobelen) maxprobelen = probelen;
+            totprobelen += probelen;
+        }
+    }
+    snprintf(buf,bufsize,
+        "Hash table 0 stats (main hash table, open addressing):\n"
+        " table size: %ld\n"
+        " number of elements: %ld\n"
+        " load factor: %.02f\n"
+        " segments: %ld (directory size %ld, depth %d-%d)\n"
+        " resizing segment: %ld elements left\n"
+        " max probe length: %ld\n"
+        " avg probe length: %.02f\n",
+        ht->size, ht->used, (float)ht->used/ht->size,
+        segments, ht->sizemask+1, mindepth, maxdepth,
+        ht->resizing ? ht->resizing->used : 0,
+        maxprobelen, (float)totprobelen/ht->used);
+    if (bufsize) buf[bufsize-1] = '\0';
+    return strlen(buf);
+}
+
 /* Resize the table to the minimal size that contains all the elements,
- * but with the invariant of a USED/BUCKETS ratio near to <= 1 */
+ * but with the invariant of a USED/BUCKETS ratio near to <= 1
+ *
+ * Open addressing tables are shrunk one segment at a time instead, so this
+ * must be called again once the rehashing is done to shrink them more. */
 int dictResize(dict *d)
 {
     unsigned long minimal;
 
     if (!dict_can_resize || dictIsRehashing(d)) return DICT_ERR;
+    if (dictIsOpenAddressing(d))
+        return d->iterators ? DICT_ERR : _dictOaShrink(d);
     minimal = d->ht[0].used;
     if (minimal < DICT_HT_INITIAL_SIZE)
         minimal = DICT_HT_INITIAL_SIZE;
@@ -150,6 +937,7 @@ int dictExpand(dict *d, unsigned long size)
     /* the size is invalid if it is smaller than the number of
      * elements already inside the hash table */
     /* 正在扩容或者扩容后的大小小于已使用的数量视作异常情况 */
+    if (dictIsOpenAddressing(d)) return _dictOaExpand(d,size);
     if (dictIsRehashing(d) || d->ht[0].used > size)
         return DICT_ERR;
 
@@ -165,6 +953,8 @@ int dictExpand(dict *d, unsigned long size)
     n.sizemask = realsize-1;
     n.table = zcalloc(realsize*sizeof(dictEntry*));
     n.used = 0;
+    n.segments = NULL;
+    n.resizing = NULL;
 
     /* Is this the first initialization? If so it's not really a rehashing
      * we just set the first hash table so that it can accept keys. */
@@ -194,6 +984,7 @@ int dictRehash(dict *d, int n) {
     int empty_visits = n*10; /* Max number of empty buckets to visit. */
     /* 如果当前字典没有扩容，则直接退出函数 */
     if (!dictIsRehashing(d)) return 0;
+    if (dictIsOpenAddressing(d)) return _dictOaRehash(d,n);
 
     while(n-- && d->ht[0].used != 0) {
         dictEntry *de, *nextde;
@@ -253,20 +1044,35 @@ long long timeInMilliseconds(void) {
     return (((long long)tv.tv_sec)*1000)+(tv.tv_usec/1000);
 }
 
-/* Rehash in ms+"delta" milliseconds. The value of "delta" is larger 
- * than 0, and is smaller than 1 in most cases. The exact upper bound 
- * depends on the running time of dictRehash(d,100).*/
-int dictRehashMilliseconds(dict *d, int ms) {
-    long long start = timeInMilliseconds();
+static long long timeInMicroseconds(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv,NULL);
+    return (((long long)tv.tv_sec)*1000000)+tv.tv_usec;
+}
+
+/* Rehash in us+"delta" microseconds. The value of "delta" depends on the
+ * running time of dictRehash(d,100), usually some ten microseconds.
+ * Nothing is done while there are safe iterators, like _dictRehashStep(). */
+int dictRehashMicroseconds(dict *d, long long us) {
+    long long start = timeInMicroseconds();
     int rehashes = 0;
 
+    if (d->iterators) return 0;
     while(dictRehash(d,100)) {
         rehashes += 100;
-        if (timeInMilliseconds()-start > ms) break;
+        if (timeInMicroseconds()-start >= us) break;
     }
     return rehashes;
 }
 
+/* Rehash in ms+"delta" milliseconds. The value of "delta" is larger 
+ * than 0, and is smaller than 1 in most cases. The exact upper bound 
+ * depends on the running time of dictRehash(d,100).*/
+int dictRehashMilliseconds(dict *d, int ms) {
+    return dictRehashMicroseconds(d,(long long)ms*1000);
+}
+
 /* This function performs just a step of rehashing, and only if there are
  * no safe iterators bound to our hash table. When we have iterators in the
  * middle of a rehashing we can't mess with the two hash tables otherwise
@@ -313,6 +1119,7 @@ dictEntry *dictAddRaw(dict *d, void *key, dictEntry **existing)
     dictEntry *entry;
     dictht *ht;
 
+    if (dictIsOpenAddressing(d)) return _dictOaAddRaw(d,key,existing);
     if (dictIsRehashing(d)) _dictRehashStep(d);
 
     /* Get the index of the new element, or -1 if
@@ -361,7 +1168,7 @@ int dictReplace(dict *d, void *key, void *val)
      * as the previous one. In this context, think to reference counting,
      * you want to increment (set), and then decrement (free), and not the
      * reverse. */
-    auxentry = *existing;
+    auxentry.v = *dictEntryValue(existing);
     dictSetVal(d, existing, val);
     dictFreeVal(d, &auxentry);
     return 0;
@@ -388,6 +1195,7 @@ static dictEntry *dictGenericDelete(dict *d, const void *key, int nofree) {
     dictEntry *he, *prevHe;
     int table;
 
+    if (dictIsOpenAddressing(d)) return _dictOaGenericDelete(d,key,nofree);
     if (d->ht[0].used == 0 && d->ht[1].used == 0) return NULL;
 
     if (dictIsRehashing(d)) _dictRehashStep(d);
@@ -452,9 +1260,15 @@ dictEntry *dictUnlink(dict *ht, const void *key) {
 }
 
 /* You need to call this function to really free the entry after a call
- * to dictUnlink(). It's safe to call this function with 'he' = NULL. */
+ * to dictUnlink(). It's safe to call this function with 'he' = NULL.
+ * With open addressing the entry is a slot of the table, that is reused by
+ * the next insertion: call it before adding elements to the dict. */
 void dictFreeUnlinkedEntry(dict *d, dictEntry *he) {
     if (he == NULL) return;
+    if (dictIsOpenAddressing(d)) {
+        _dictOaFreeEntry(d,he);
+        return;
+    }
     dictFreeKey(d, he);
     dictFreeVal(d, he);
     zfree(he);
@@ -464,6 +1278,10 @@ void dictFreeUnlinkedEntry(dict *d, dictEntry *he) {
 int _dictClear(dict *d, dictht *ht, void(callback)(void *)) {
     unsigned long i;
 
+    if (dictIsOpenAddressing(d)) {
+        _dictOaClear(d,ht,callback);
+        return DICT_OK;
+    }
     /* Free all the elements */
     for (i = 0; i < ht->size && ht->used > 0; i++) {
         dictEntry *he, *nextHe;
@@ -500,6 +1318,7 @@ dictEntry *dictFind(dict *d, const void *key)
     dictEntry *he;
     uint64_t h, idx, table;
 
+    if (dictIsOpenAddressing(d)) return _dictOaFind(d,key);
     if (dictSize(d) == 0) return NULL; /* dict is empty */
     if (dictIsRehashing(d)) _dictRehashStep(d);
     h = dictHashKey(d, key);
@@ -533,12 +1352,15 @@ long long dictFingerprint(dict *d) {
     long long integers[6], hash = 0;
     int j;
 
-    integers[0] = (long) d->ht[0].table;
+    integers[0] = (long) d->ht[0].table ^ (long) d->ht[0].segments;
     integers[1] = d->ht[0].size;
     integers[2] = d->ht[0].used;
-    integers[3] = (long) d->ht[1].table;
+    integers[3] = (long) d->ht[1].table ^ (long) d->ht[1].segments;
     integers[4] = d->ht[1].size;
     integers[5] = d->ht[1].used;
+    /* Open addressing tables move elements between segments without
+     * changing the above, and don't use the second table. */
+    if (dictIsOpenAddressing(d)) integers[4] = d->rehashidx;
 
     /* We hash N integers by summing every successive integer with the integer
      * hashing of the previous sum. Basically:
@@ -583,6 +1405,7 @@ dictIterator *dictGetSafeIterator(dict *d) {
 
 dictEntry *dictNext(dictIterator *iter)
 {
+    if (dictIsOpenAddressing(iter->d)) return _dictOaNext(iter);
     while (1) {
         if (iter->entry == NULL) {
             dictht *ht = &iter->d->ht[iter->table];
@@ -637,6 +1460,7 @@ dictEntry *dictGetRandomKey(dict *d)
 
     if (dictSize(d) == 0) return NULL;
     if (dictIsRehashing(d)) _dictRehashStep(d);
+    if (dictIsOpenAddressing(d)) return _dictOaGetRandomKey(d);
     if (dictIsRehashing(d)) {
         do {
             /* We are sure there are no elements in indexes from 0
@@ -708,6 +1532,7 @@ unsigned int dictGetSomeKeys(dict *d, dictEntry **des, unsigned int count) {
         else
             break;
     }
+    if (dictIsOpenAddressing(d)) return _dictOaGetSomeKeys(d,des,count);
 
     tables = dictIsRehashing(d) ? 2 : 1;
     maxsizemask = d->ht[0].sizemask;
@@ -797,6 +1622,23 @@ static unsigned long rev(unsigned long v) {
     return v;
 }
 
+/* Emit the elements of the bucket 'idx' of the table for dictScan(). */
+static void _dictScanBucket(dict *d, dictht *ht, unsigned long idx,
+                            dictScanFunction *fn,
+                            dictScanBucketFunction* bucketfn,
+                            void *privdata)
+{
+    const dictEntry *de, *next;
+
+    if (bucketfn) bucketfn(privdata, &ht->table[idx]);
+    de = ht->table[idx];
+    while (de) {
+        next = de->next;
+        fn(privdata, de);
+        de = next;
+    }
+}
+
 /* dictScan() is used to iterate over the elements of a dictionary.
  *
  * Iterating works the following way:
@@ -880,6 +1722,12 @@ static unsigned long rev(unsigned long v) {
  *    we are sure we don't miss keys moving during rehashing.
  * 3) The reverse cursor is somewhat hard to understand at first, but this
  *    comment is supposed to help.
+ *
+ * OPEN ADDRESSING
+ *
+ * With open addressing the cursor addresses the segment directory instead
+ * of the buckets, see _dictOaScan(), so all the above still applies. The
+ * bucket callback is not called, since there are no buckets to pass to it.
  */
 unsigned long dictScan(dict *d,
                        unsigned long v,
@@ -888,7 +1736,6 @@ unsigned long dictScan(dict *d,
                        void *privdata)
 {
     dictht *t0, *t1;
-    const dictEntry *de, *next;
     unsigned long m0, m1;
 
     if (dictSize(d) == 0) return 0;
@@ -897,18 +1744,14 @@ unsigned long dictScan(dict *d,
      * This is needed in case the scan callback tries to do dictFind or alike. */
     d->iterators++;
 
-    if (!dictIsRehashing(d)) {
+    if (dictIsOpenAddressing(d)) {
+        v = _dictOaScan(d,v,fn,privdata);
+    } else if (!dictIsRehashing(d)) {
         t0 = &(d->ht[0]);
         m0 = t0->sizemask;
 
         /* Emit entries at cursor */
-        if (bucketfn) bucketfn(privdata, &t0->table[v & m0]);
-        de = t0->table[v & m0];
-        while (de) {
-            next = de->next;
-            fn(privdata, de);
-            de = next;
-        }
+        _dictScanBucket(d,t0,v & m0,fn,bucketfn,privdata);
 
         /* Set unmasked bits so incrementing the reversed cursor
          * operates on the masked bits */
@@ -933,25 +1776,13 @@ unsigned long dictScan(dict *d,
         m1 = t1->sizemask;
 
         /* Emit entries at cursor */
-        if (bucketfn) bucketfn(privdata, &t0->table[v & m0]);
-        de = t0->table[v & m0];
-        while (de) {
-            next = de->next;
-            fn(privdata, de);
-            de = next;
-        }
+        _dictScanBucket(d,t0,v & m0,fn,bucketfn,privdata);
 
         /* Iterate over indices in larger table that are the expansion
          * of the index pointed to by the cursor in the smaller table */
         do {
             /* Emit entries at cursor */
-            if (bucketfn) bucketfn(privdata, &t1->table[v & m1]);
-            de = t1->table[v & m1];
-            while (de) {
-                next = de->next;
-                fn(privdata, de);
-                de = next;
-            }
+            _dictScanBucket(d,t1,v & m1,fn,bucketfn,privdata);
 
             /* Increment the reverse cursor not covered by the smaller mask.*/
             v |= ~m1;
@@ -1064,6 +1895,10 @@ void dictDisableResize(void) {
     dict_can_resize = 0;
 }
 
+int dictResizeEnabled(void) {
+    return dict_can_resize;
+}
+
 uint64_t dictGetHash(dict *d, const void *key) {
     return dictHashKey(d, key);
 }
@@ -1077,7 +1912,8 @@ dictEntry **dictFindEntryRefByPtrAndHash(dict *d, const void *oldptr, uint64_t h
     dictEntry *he, **heref;
     unsigned long idx, table;
 
-    if (dictSize(d) == 0) return NULL; /* dict is empty */
+    /* Open addressing tables have no entry references. */
+    if (dictSize(d) == 0 || dictIsOpenAddressing(d)) return NULL;
     for (table = 0; table <= 1; table++) {
         idx = hash & d->ht[table].sizemask;
         heref = &d->ht[table].table[idx];
@@ -1162,6 +1998,10 @@ void dictGetStats(char *buf, size_t bufsize, dict *d) {
     char *orig_buf = buf;
     size_t orig_bufsize = bufsize;
 
+    if (dictIsOpenAddressing(d)) {
+        _dictOaGetStatsHt(buf,bufsize,d,&d->ht[0]);
+        return;
+    }
     l = _dictGetStatsHt(buf,bufsize,&d->ht[0],0);
     buf += l;
     bufsize -= l;
@@ -1178,10 +2018,26 @@ void dictGetStats(char *buf, size_t bufsize, dict *d) {
 
 #include "sds.h"
 
+static int benchmark_wyhash = 0;
+
 uint64_t hashCallback(const void *key) {
+    if (benchmark_wyhash)
+        return dictGenWyHashFunction((unsigned char*)key, sdslen((char*)key));
     return dictGenHashFunction((unsigned char*)key, sdslen((char*)key));
 }
 
+void hashBatchCallback(const void *const *keys, int count, uint64_t *hashes) {
+    size_t lens[DICT_OA_GROUP_SIZE];
+    int j;
+
+    if (!benchmark_wyhash) {
+        for (j = 0; j < count; j++) hashes[j] = hashCallback(keys[j]);
+        return;
+    }
+    for (j = 0; j < count; j++) lens[j] = sdslen((sds)keys[j]);
+    dictGenWyHashFunctionBatch(keys,lens,count,hashes);
+}
+
 int compareCallback(void *privdata, const void *key1, const void *key2) {
     int l1,l2;
     DICT_NOTUSED(privdata);
@@ -1204,7 +2060,41 @@ dictType BenchmarkDictType = {
     NULL,
     compareCallback,
     freeCallback,
-    NULL
+    NULL,
+    0
+};
+
+dictType BenchmarkOaDictType = {
+    hashCallback,
+    NULL,
+    NULL,
+    compareCallback,
+    freeCallback,
+    NULL,
+    1,
+    hashBatchCallback
+};
+
+size_t embedKeyCallback(void *buf, size_t buflen, const void *key, unsigned char *keyoff) {
+    size_t len = sdslen((sds)key);
+    sds s;
+
+    if (buf == NULL) return sdswritelen(len);
+    s = sdswrite(buf,buflen,key,len);
+    *keyoff = (unsigned char)(s-(char*)buf);
+    return buflen;
+}
+
+dictType BenchmarkEmbedDictType = {
+    hashCallback,
+    NULL,
+    NULL,
+    compareCallback,
+    NULL,
+    NULL,
+    1,
+    hashBatchCallback,
+    embedKeyCallback
 };
 
 #define start_benchmark() start = timeInMilliseconds()
@@ -1213,23 +2103,84 @@ dictType BenchmarkDictType = {
     printf(msg ": %ld items in %lld ms\n", count, elapsed); \
 } while(0);
 
-/* dict-benchmark [count] */
+/* Time the hash functions on keys of 8 to 64 bytes, one at a time and in
+ * batches of 16 keys like when moving a group of an open addressing table. */
+static void hashBenchmark(long count) {
+    static const int lengths[] = {8, 16, 32, 64};
+    unsigned char buf[16][64];
+    const void *keys[16];
+    size_t lens[16];
+    uint64_t hashes[16], sum = 0;
+    long long start;
+    long j;
+    int l, k;
+
+    for (k = 0; k < 16; k++) {
+        for (l = 0; l < 64; l++) buf[k][l] = (unsigned char)rand();
+        keys[k] = buf[k];
+    }
+    for (l = 0; l < (int)(sizeof(lengths)/sizeof(lengths[0])); l++) {
+        double ns[3];
+
+        for (k = 0; k < 16; k++) lens[k] = lengths[l];
+        start = timeInMicroseconds();
+        for (j = 0; j < count; j++)
+            sum += dictGenHashFunction(keys[j&15],lengths[l]);
+        ns[0] = (double)(timeInMicroseconds()-start)*1000/count;
+        start = timeInMicroseconds();
+        for (j = 0; j < count; j++)
+            sum += dictGenWyHashFunction(keys[j&15],lengths[l]);
+        ns[1] = (double)(timeInMicroseconds()-start)*1000/count;
+        start = timeInMicroseconds();
+        for (j = 0; j < count; j += 16) {
+            dictGenWyHashFunctionBatch(keys,lens,16,hashes);
+            sum += hashes[j&15];
+        }
+        ns[2] = (double)(timeInMicroseconds()-start)*1000/count;
+        printf("%2d bytes: siphash %.2f ns, wyhash %.2f ns, wyhash batch %.2f ns\n",
+            lengths[l], ns[0], ns[1], ns[2]);
+    }
+    printf("(checksum %llu)\n", (unsigned long long)sum);
+}
+
+/* dict-benchmark [count] [chained|oa|embed] [siphash|wyhash]
+ * dict-benchmark hash [count] */
 int main(int argc, char **argv) {
     long j;
     long long start, elapsed;
-    dict *dict = dictCreate(&BenchmarkDictType,NULL);
+    dict *dict;
     long count = 0;
+    size_t basemem, peakmem = 0;
 
-    if (argc == 2) {
+    if (argc >= 2 && !strcmp(argv[1],"hash")) {
+        hashBenchmark(argc >= 3 ? strtol(argv[2],NULL,10) : 50000000);
+        return 0;
+    }
+    if (argc >= 2) {
         count = strtol(argv[1],NULL,10);
     } else {
         count = 5000000;
     }
+    if (argc >= 4 && !strcmp(argv[3],"wyhash")) benchmark_wyhash = 1;
+    if (argc >= 3 && !strcmp(argv[2],"oa")) {
+        dict = dictCreate(&BenchmarkOaDictType,NULL);
+    } else if (argc >= 3 && !strcmp(argv[2],"embed")) {
+        dict = dictCreate(&BenchmarkEmbedDictType,NULL);
+    } else {
+        dict = dictCreate(&BenchmarkDictType,NULL);
+    }
+    printf("Layout: %s%s, hash: %s\n", dictIsOpenAddressing(dict) ? "open addressing" : "chained",
+        dict->type->embedKey ? " with embedded keys" : "",
+        benchmark_wyhash ? "wyhash" : "siphash");
+    basemem = zmalloc_used_memory();
 
     start_benchmark();
     for (j = 0; j < count; j++) {
-        int retval = dictAdd(dict,sdsfromlonglong(j),(void*)j);
+        sds key = sdsfromlonglong(j);
+        int retval = dictAdd(dict,key,(void*)j);
         assert(retval == DICT_OK);
+        if (dict->type->embedKey) sdsfree(key);
+        if (zmalloc_used_memory() > peakmem) peakmem = zmalloc_used_memory();
     }
     end_benchmark("Inserting");
     assert((long)dictSize(dict) == count);
@@ -1239,6 +2190,12 @@ int main(int argc, char **argv) {
         dictRehashMilliseconds(dict,100);
     }
 
+    /* Report the memory used by the table, the entries and the keys, since
+     * embedded keys share the allocation of their entry. */
+    printf("Memory: %.1f bytes/key (%lu slots), peak while inserting +%.1f MB\n",
+        (double)(zmalloc_used_memory()-basemem)/count, dictSlots(dict),
+        (double)(peakmem-zmalloc_used_memory())/(1024*1024));
+
     start_benchmark();
     for (j = 0; j < count; j++) {
         sds key = sdsfromlonglong(j);
@@ -1284,6 +2241,7 @@ int main(int argc, char **argv) {
         key[0] += 17; /* Change first number to letter. */
         retval = dictAdd(dict,key,(void*)j);
         assert(retval == DICT_OK);
+        if (dict->type->embedKey) sdsfree(key);
     }
     end_benchmark("Removing and adding");
 }
@@ -44,17 +44,29 @@
 /* Unused arguments generate annoying warnings... */
 #define DICT_NOTUSED(V) ((void) V)
 
+typedef union dictValue {
+    void *val;
+    uint64_t u64;
+    int64_t s64;
+    double d;
+} dictValue;
+
 typedef struct dictEntry {
     void *key;
-    union {
-        void *val;
-        uint64_t u64;
-        int64_t s64;
-        double d;
-    } v;
+    dictValue v;
     struct dictEntry *next;
 } dictEntry;
 
+/* key嵌入在同一次内存分配中的entry，见dictType.embedKey。
+ * 指向它的dictEntry指针最低位为DICT_ENTRY_EMBEDDED，需通过下方的宏访问 */
+typedef struct dictEmbeddedEntry {
+    dictValue v;
+    unsigned char keyoff;   /* key在buf中的偏移 */
+    unsigned char buf[];
+} dictEmbeddedEntry;
+
+#define DICT_ENTRY_EMBEDDED 1
+
 typedef struct dictType {
     uint64_t (*hashFunction)(const void *key);
     void *(*keyDup)(void *privdata, const void *key);
@@ -62,6 +74,13 @@ typedef struct dictType {
     int (*keyCompare)(void *privdata, const void *key1, const void *key2);
     void (*keyDestructor)(void *privdata, void *key);
     void (*valDestructor)(void *privdata, void *obj);
+    int openAddressing;     /* 非0时使用开放寻址表代替链式hash表，见dict.c */
+    /* 可选，一次计算多个key的hash，结果须与hashFunction相同。迁移开放寻址表的段时使用 */
+    void (*hashBatchFunction)(const void *const *keys, int count, uint64_t *hashes);
+    /* 可选，仅用于开放寻址表。设置时key复制到entry的分配中，槽位只保存entry指针：
+     * buf为NULL时返回需要的字节数，否则写入buf并在keyoff中返回key的偏移。
+     * dictAdd等不会接管传入的key，也不会调用keyDup与keyDestructor */
+    size_t (*embedKey)(void *buf, size_t buflen, const void *key, unsigned char *keyoff);
 } dictType;
 
 /* This is our hash table structure. Every dictionary has two of this as we
@@ -71,6 +90,9 @@ typedef struct dictht {
     unsigned long size;
     unsigned long sizemask;
     unsigned long used; /* hash表中存储键值对的数量，即此hash表中各个冲突链中dictEntry的和 */
+    struct dictSegment **segments; /* 开放寻址表: 段目录，以hash低位索引，多个目录项可指向同一个段。
+                                    * 此时size为所有段的槽位数之和，sizemask为目录大小-1 */
+    struct dictSegment *resizing;  /* 开放寻址表: 正在渐进式迁移到新段的旧段，rehashidx为下一个迁移的组 */
 } dictht;
 
 typedef struct dict {
@@ -101,28 +123,35 @@ typedef void (dictScanBucketFunction)(void *privdata, dictEntry **bucketref);
 #define DICT_HT_INITIAL_SIZE     4
 
 /* ------------------------------- Macros ------------------------------------*/
+#define dictEntryIsEmbedded(entry) ((uintptr_t)(entry) & DICT_ENTRY_EMBEDDED)
+#define dictEmbeddedEntry(entry) \
+    ((dictEmbeddedEntry*)((uintptr_t)(entry) & ~(uintptr_t)DICT_ENTRY_EMBEDDED))
+#define dictEntryValue(entry) \
+    (dictEntryIsEmbedded(entry) ? &dictEmbeddedEntry(entry)->v : &(entry)->v)
+
 #define dictFreeVal(d, entry) \
     if ((d)->type->valDestructor) \
-        (d)->type->valDestructor((d)->privdata, (entry)->v.val)
+        (d)->type->valDestructor((d)->privdata, dictEntryValue(entry)->val)
 
 #define dictSetVal(d, entry, _val_) do { \
     if ((d)->type->valDup) \
-        (entry)->v.val = (d)->type->valDup((d)->privdata, _val_); \
+        dictEntryValue(entry)->val = (d)->type->valDup((d)->privdata, _val_); \
     else \
-        (entry)->v.val = (_val_); \
+        dictEntryValue(entry)->val = (_val_); \
 } while(0)
 
 #define dictSetSignedIntegerVal(entry, _val_) \
-    do { (entry)->v.s64 = _val_; } while(0)
+    do { dictEntryValue(entry)->s64 = _val_; } while(0)
 
 #define dictSetUnsignedIntegerVal(entry, _val_) \
-    do { (entry)->v.u64 = _val_; } while(0)
+    do { dictEntryValue(entry)->u64 = _val_; } while(0)
 
 #define dictSetDoubleVal(entry, _val_) \
-    do { (entry)->v.d = _val_; } while(0)
+    do { dictEntryValue(entry)->d = _val_; } while(0)
 
+/* Embedded keys are released with their entry. */
 #define dictFreeKey(d, entry) \
-    if ((d)->type->keyDestructor) \
+    if ((d)->type->keyDestructor && !dictEntryIsEmbedded(entry)) \
         (d)->type->keyDestructor((d)->privdata, (entry)->key)
 
 #define dictSetKey(d, entry, _key_) do { \
@@ -138,14 +167,16 @@ typedef void (dictScanBucketFunction)(void *privdata, dictEntry **bucketref);
         (key1) == (key2))
 
 #define dictHashKey(d, key) (d)->type->hashFunction(key)
-#define dictGetKey(he) ((he)->key)
-#define dictGetVal(he) ((he)->v.val)
-#define dictGetSignedIntegerVal(he) ((he)->v.s64)
-#define dictGetUnsignedIntegerVal(he) ((he)->v.u64)
-#define dictGetDoubleVal(he) ((he)->v.d)
+#define dictGetKey(he) (dictEntryIsEmbedded(he) ? \
+    (void*)(dictEmbeddedEntry(he)->buf+dictEmbeddedEntry(he)->keyoff) : (he)->key)
+#define dictGetVal(he) (dictEntryValue(he)->val)
+#define dictGetSignedIntegerVal(he) (dictEntryValue(he)->s64)
+#define dictGetUnsignedIntegerVal(he) (dictEntryValue(he)->u64)
+#define dictGetDoubleVal(he) (dictEntryValue(he)->d)
 #define dictSlots(d) ((d)->ht[0].size+(d)->ht[1].size)
 #define dictSize(d) ((d)->ht[0].used+(d)->ht[1].used)
 #define dictIsRehashing(d) ((d)->rehashidx != -1) /* 等于-1 代表没有在扩容 */
+#define dictIsOpenAddressing(d) ((d)->type->openAddressing)
 
 /* API */
 dict *dictCreate(dictType *type, void *privDataPtr);
@@ -171,11 +202,15 @@ unsigned int dictGetSomeKeys(dict *d, dictEntry **des, unsigned int count);
 void dictGetStats(char *buf, size_t bufsize, dict *d);
 uint64_t dictGenHashFunction(const void *key, int len);
 uint64_t dictGenCaseHashFunction(const unsigned char *buf, int len);
+uint64_t dictGenWyHashFunction(const void *key, int len);
+void dictGenWyHashFunctionBatch(const void *const *keys, const size_t *lens, int count, uint64_t *hashes);
 void dictEmpty(dict *d, void(callback)(void*));
 void dictEnableResize(void);
 void dictDisableResize(void);
+int dictResizeEnabled(void);
 int dictRehash(dict *d, int n);
 int dictRehashMilliseconds(dict *d, int ms);
+int dictRehashMicroseconds(dict *d, long long us);
 void dictSetHashFunctionSeed(uint8_t *seed);
 uint8_t *dictGetHashFunctionSeed(void);
 unsigned long dictScan(dict *d, unsigned long v, dictScanFunction *fn, dictScanBucketFunction *bucketfn, void *privdata);
@@ -36,6 +36,7 @@ int createEpollData(eventLoop *el) {
     el->timeEventHead = NULL;
     el->lastTime = time(NULL);
     el->beforeSleep = NULL;
+    el->afterSleep = NULL;
     el->flags = 0;
 
     return 0;
@@ -57,6 +58,9 @@ eventLoop *createEventLoop(int maxSize) {
         serverLog(LL_WARNING, "malloc fileEvents failed.");
         return NULL;
     }
+    for (int i = 0; i < maxSize; i++) {
+        el->fileEvents[i].mask = EVENT_NONE;
+    }
     el->firedFileEvents = zmalloc(sizeof(firedFileEvent) * maxSize);
     if (NULL == el->firedFileEvents) {
         zfree(el->fileEvents);
@@ -110,6 +114,7 @@ void deleteEpollEvent(eventLoop *el, int fd, int delMask) {
     if(mask & EVENT_WRITABLE) {
         ee.events |= EPOLLOUT;
     }
+    ee.data.fd = fd;
 
     if (EVENT_NONE != mask) {
         epoll_ctl(state->epollFd, EPOLL_CTL_MOD, fd, &ee);
@@ -209,6 +214,18 @@ void setBeforeSleepProc(eventLoop *el, beforeSleepProc *beforeSleep) {
     el->beforeSleep = beforeSleep;
 }
 
+void setAfterSleepProc(eventLoop *el, afterSleepProc *afterSleep) {
+    el->afterSleep = afterSleep;
+}
+
+/* noWait为1时eventPoll不阻塞，用于还有待执行的增量任务时 */
+void setDontWait(eventLoop *el, int noWait) {
+    if (noWait)
+        el->flags |= EVENT_DONT_WAIT;
+    else
+        el->flags &= ~EVENT_DONT_WAIT;
+}
+
 static void getTime(long *seconds, long *milliseconds)
 {
     struct timeval tv;
@@ -415,6 +432,11 @@ int processEvents(eventLoop *el, int flags)
             el->beforeSleep(el);
 
         numEvents = eventPoll(el, tvp);
+
+        /* 进程被唤醒后，执行钩子函数afterSleep */
+        if (el->afterSleep != NULL && flags & EVENT_CALL_AFTER_SLEEP)
+            el->afterSleep(el);
+
         for (j = 0; j < numEvents; j++) {
             fileEvent *fe = &el->fileEvents[el->firedFileEvents[j].fd];
             int mask = el->firedFileEvents[j].mask;
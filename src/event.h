@@ -17,6 +17,7 @@
 #define EVENT_ALL_EVENTS (EVENT_FILE_EVENTS|EVENT_TIME_EVENTS)
 #define EVENT_DONT_WAIT (1<<2)
 #define EVENT_CALL_BEFORE_SLEEP (1<<3)
+#define EVENT_CALL_AFTER_SLEEP (1<<4)
 
 #define EVENT_NOMORE -1
 #define EVENT_DELETED_EVENT_ID -1
@@ -29,6 +30,7 @@ typedef void fileProc(struct eventLoop *eventLoop, int fd, void *clientData, int
 typedef int timeProc(struct eventLoop *eventLoop, long long id, void *clientData);
 typedef void eventFinalizerProc(struct eventLoop *eventLoop, void *clientData);
 typedef void beforeSleepProc(struct eventLoop *eventLoop);
+typedef void afterSleepProc(struct eventLoop *eventLoop);
 
 typedef struct epollData {
     int epollFd;
@@ -70,6 +72,7 @@ typedef struct eventLoop {
     timeEvent *timeEventHead;
     time_t lastTime;     /* Used to detect system clock skew */
     beforeSleepProc *beforeSleep;
+    afterSleepProc *afterSleep;
     int flags;
 }eventLoop;
 
@@ -78,6 +81,8 @@ int createFileEvent(eventLoop *el, int fd, int mask, void *proc, void *clientDat
 void deleteFileEvent(eventLoop *el, int fd, int mask);
 int eventPoll(eventLoop *el, struct timeval *tvp);
 void setBeforeSleepProc(eventLoop *el, beforeSleepProc *beforeSleep);
+void setAfterSleepProc(eventLoop *el, afterSleepProc *afterSleep);
+void setDontWait(eventLoop *el, int noWait);
 unsigned long createTimeEvent(eventLoop *el, long long milliseconds,
                               timeProc *proc, void *clientData,
                               eventFinalizerProc *finalizerProc);
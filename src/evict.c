@@ -0,0 +1,487 @@
+/* Maxmemory directive handling (LRU eviction and other policies).
+ *
+ * ----------------------------------------------------------------------------
+ *
+ * Copyright (c) 2009-2016, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "server.h"
+#include "evict.h"
+#include "db.h"
+#include "tinylfu.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/* ----------------------------------------------------------------------------
+ * Data structures
+ * --------------------------------------------------------------------------*/
+
+/* To improve the quality of the LRU approximation we take a set of keys
+ * that are good candidate for eviction across freeMemoryIfNeeded() calls.
+ *
+ * Entries inside the eviction pool are taken ordered by idle time, putting
+ * greater idle times to the right (ascending order).
+ *
+ * When an LFU policy is used instead, a reverse frequency indication is used
+ * instead of the idle time, so that we still evict by larger value (larger
+ * inverse frequency means to evict keys with the least frequent accesses).
+ *
+ * Empty entries have the key pointer set to NULL. */
+#define EVPOOL_SIZE 16
+#define EVPOOL_CACHED_SDS_SIZE 255
+struct evictionPoolEntry {
+    unsigned long long idle;    /* Object idle time (inverse frequency for LFU) */
+    sds key;                    /* Key name. */
+    sds cached;                 /* Cached SDS object for key name. */
+};
+
+static struct evictionPoolEntry *EvictionPoolLRU;
+
+/* 单次淘汰的时间上限(微秒)，超出后剩余的淘汰工作由下一个写命令或serverCron继续 */
+#define EVICTION_TIME_LIMIT_US 500
+
+/* ----------------------------------------------------------------------------
+ * Implementation of eviction, aging and LRU
+ * --------------------------------------------------------------------------*/
+
+/* Return the LRU clock, based on the clock resolution. This is a time
+ * in a reduced-bits format that can be used to set and check the
+ * object->lru field of objects. */
+unsigned int getLRUClock(void) {
+    return (mstime()/LRU_CLOCK_RESOLUTION) & LRU_CLOCK_MAX;
+}
+
+/* Given an object returns the min number of milliseconds the object was never
+ * requested, using an approximated LRU algorithm. Tagged values, created
+ * before switching to an LRU policy, have no access time: they are seen
+ * as accessed at the LRU clock 0. */
+unsigned long long estimateObjectIdleTime(robj *o) {
+    unsigned long long lruclock = LRU_CLOCK();
+    unsigned int lru = objIsTagged(o) ? 0 : o->lru;
+
+    if (lruclock >= lru) {
+        return (lruclock - lru) * LRU_CLOCK_RESOLUTION;
+    } else {
+        return (lruclock + (LRU_CLOCK_MAX - lru)) *
+                    LRU_CLOCK_RESOLUTION;
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * LFU (Least Frequently Used) implementation.
+
+ * We have 24 total bits of space in each object in order to implement
+ * an LFU (Least Frequently Used) eviction policy, since we re-use the
+ * LRU field for this purpose.
+ *
+ * We split the 24 bits into two fields:
+ *
+ *          16 bits      8 bits
+ *     +----------------+--------+
+ *     + Last decr time | LOG_C  |
+ *     +----------------+--------+
+ *
+ * LOG_C is a logarithmic counter that provides an indication of the access
+ * frequency. However this field must also be decremented otherwise what used
+ * to be a frequently accessed key in the past, will remain ranked like that
+ * forever, while we want the algorithm to adapt to access pattern changes.
+ *
+ * So the remaining 16 bits are used in order to store the "decrement time",
+ * a reduced-precision Unix time (we take 16 bits of the time converted
+ * in minutes since we don't care about wrapping around) where the LOG_C
+ * counter is halved if it has an high value, or just decremented if it
+ * has a low value.
+ *
+ * New keys don't start at zero, in order to have the ability to collect
+ * some accesses before being trashed away, so they start at LFU_INIT_VAL.
+ * The logarithmic increment performed on LOG_C takes care of LFU_INIT_VAL
+ * when incrementing the key, so that keys starting at LFU_INIT_VAL
+ * (or having a smaller value) have a very high chance of being incremented
+ * on access.
+ *
+ * During decrement, the value of the logarithmic counter is halved if
+ * its current value is greater than two times the LFU_INIT_VAL, otherwise
+ * it is just decremented by one.
+ * --------------------------------------------------------------------------*/
+
+/* Return the current time in minutes, just taking the least significant
+ * 16 bits. The returned time is suitable to be stored as LDT (last decrement
+ * time) for the LFU implementation. */
+unsigned long LFUGetTimeInMinutes(void) {
+    return (server.unixtime/60) & 65535;
+}
+
+/* Given an object last access time, compute the minimum number of minutes
+ * that elapsed since the last access. Handle overflow (ldt greater than
+ * the current 16 bits minutes time) considering the time as wrapping
+ * exactly once. */
+static unsigned long LFUTimeElapsed(unsigned long ldt) {
+    unsigned long now = LFUGetTimeInMinutes();
+    if (now >= ldt) return now-ldt;
+    return 65535-ldt+now;
+}
+
+/* Logarithmically increment a counter. The greater is the current counter value
+ * the less likely is that it gets really implemented. Saturate it at 255. */
+uint8_t LFULogIncr(uint8_t counter) {
+    if (counter == 255) return 255;
+    double r = (double)rand()/RAND_MAX;
+    double baseval = counter - LFU_INIT_VAL;
+    if (baseval < 0) baseval = 0;
+    double p = 1.0/(baseval*server.lfu_log_factor+1);
+    if (r < p) counter++;
+    return counter;
+}
+
+/* If the object decrement time is reached decrement the LFU counter but
+ * do not update LFU fields of the object, we update the access time
+ * and counter in an explicit way when the object is really accessed.
+ * And we will times halve the counter according to the times of
+ * elapsed time than server.lfu_decay_time.
+ * Return the object frequency counter.
+ *
+ * This function is used in order to scan the dataset for the best object
+ * to fit: as we check for the candidate, we incrementally decrement the
+ * counter of the scanned objects if needed. */
+unsigned long LFUDecrAndReturn(robj *o) {
+    unsigned long ldt, counter, num_periods;
+
+    if (objIsTagged(o)) return 0; /* Tagged values have no counter. */
+    ldt = o->lru >> 8;
+    counter = o->lru & 255;
+    num_periods = server.lfu_decay_time ? LFUTimeElapsed(ldt) / server.lfu_decay_time : 0;
+    if (num_periods)
+        counter = (num_periods > counter) ? 0 : counter - num_periods;
+    return counter;
+}
+
+/* 新建对象时初始化访问信息: LFU策略下为当前时间与初始计数，否则为LRU时钟 */
+void initObjectAccessTime(robj *o) {
+    if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU) {
+        o->lru = (LFUGetTimeInMinutes()<<8) | LFU_INIT_VAL;
+    } else {
+        o->lru = LRU_CLOCK();
+    }
+}
+
+/* Update LFU when an object is accessed.
+ * Firstly, decrement the counter if the decrement time is reached.
+ * Then logarithmically increment the counter, and update the access time. */
+static void updateLFU(robj *o) {
+    unsigned long counter = LFUDecrAndReturn(o);
+    counter = LFULogIncr(counter);
+    o->lru = (LFUGetTimeInMinutes()<<8) | counter;
+}
+
+/* 命中key时更新其访问信息，共享对象与标记指针的访问信息不做维护 */
+void updateObjectAccessTime(robj *o) {
+    if (objIsTagged(o) || o->refcount == OBJ_SHARED_REFCOUNT) return;
+    if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU) {
+        updateLFU(o);
+    } else {
+        o->lru = LRU_CLOCK();
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * Eviction pool
+ * --------------------------------------------------------------------------*/
+
+/* Create a new eviction pool. */
+void evictionPoolAlloc(void) {
+    struct evictionPoolEntry *ep;
+    int j;
+
+    ep = zmalloc(sizeof(*ep)*EVPOOL_SIZE);
+    for (j = 0; j < EVPOOL_SIZE; j++) {
+        ep[j].idle = 0;
+        ep[j].key = NULL;
+        ep[j].cached = sdsnewlen(NULL,EVPOOL_CACHED_SDS_SIZE);
+    }
+    EvictionPoolLRU = ep;
+}
+
+/* This is an helper function for freeMemoryIfNeeded(), it is used in order
+ * to populate the evictionPool with a few entries every time we want to
+ * expire a key. Keys with idle time bigger than one of the current
+ * keys are added. Keys are always added if there are free entries.
+ *
+ * We insert keys on place in ascending order, so keys with the smaller
+ * idle time are on the left, and keys with the higher idle time on the
+ * right. */
+static void evictionPoolPopulate(dict *sampledict, dict *keydict,
+                                 struct evictionPoolEntry *pool)
+{
+    int j, k, count;
+    dictEntry *samples[server.maxmemory_samples];
+
+    count = dictGetSomeKeys(sampledict,samples,server.maxmemory_samples);
+    for (j = 0; j < count; j++) {
+        unsigned long long idle;
+        sds key;
+        robj *o = NULL;
+        dictEntry *de;
+
+        de = samples[j];
+        key = dictGetKey(de);
+
+        /* If the dictionary we are sampling from is not the main
+         * dictionary (but the expires one) we need to lookup the key
+         * again in the key dictionary to obtain the value object. */
+        if (server.maxmemory_policy != MAXMEMORY_VOLATILE_TTL) {
+            if (sampledict != keydict) de = dictFind(keydict, key);
+            o = dictGetVal(de);
+        }
+
+        /* Calculate the idle time according to the policy. This is called
+         * idle just because the code initially handled LRU, but is in fact
+         * just a score where an higher score means better candidate. */
+        if (server.maxmemory_policy & MAXMEMORY_FLAG_LRU) {
+            idle = estimateObjectIdleTime(o);
+        } else if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU) {
+            /* When we use an LRU policy, we sort the keys by idle time
+             * so that we expire keys starting from greater idle time.
+             * However when the policy is an LFU one, we have a frequency
+             * estimation, and we want to evict keys with lower frequency
+             * first. So inside the pool we put objects using the inverted
+             * frequency subtracting the actual frequency to the maximum
+             * frequency of 255. */
+            idle = 255-LFUDecrAndReturn(o);
+        } else if (server.maxmemory_policy == MAXMEMORY_VOLATILE_TTL) {
+            /* In this case the sooner the expire the better. */
+            idle = ULLONG_MAX - dictGetSignedIntegerVal(de);
+        } else {
+            serverPanic("Unknown eviction policy in evictionPoolPopulate()");
+        }
+
+        /* Insert the element inside the pool.
+         * First, find the first empty bucket or the first populated
+         * bucket that has an idle time smaller than our idle time. */
+        k = 0;
+        while (k < EVPOOL_SIZE &&
+               pool[k].key &&
+               pool[k].idle < idle) k++;
+        if (k == 0 && pool[EVPOOL_SIZE-1].key != NULL) {
+            /* Can't insert if the element is < the worst element we have
+             * and there are no empty buckets. */
+            continue;
+        } else if (k < EVPOOL_SIZE && pool[k].key == NULL) {
+            /* Inserting into empty position. No setup needed before insert. */
+        } else {
+            /* Inserting in the middle. Now k points to the first element
+             * greater than the element to insert.  */
+            if (pool[EVPOOL_SIZE-1].key == NULL) {
+                /* Free space on the right? Insert at k shifting
+                 * all the elements from k to end to the right. */
+
+                /* Save SDS before overwriting. */
+                sds cached = pool[EVPOOL_SIZE-1].cached;
+                memmove(pool+k+1,pool+k,
+                    sizeof(pool[0])*(EVPOOL_SIZE-k-1));
+                pool[k].cached = cached;
+            } else {
+                /* No free space on right? Insert at k-1 */
+                k--;
+                /* Shift all elements on the left of k (included) to the
+                 * left, so we discard the element with smaller idle time. */
+                sds cached = pool[0].cached; /* Save SDS before overwriting. */
+                if (pool[0].key != pool[0].cached) sdsfree(pool[0].key);
+                memmove(pool,pool+1,sizeof(pool[0])*k);
+                pool[k].cached = cached;
+            }
+        }
+
+        /* Try to reuse the cached SDS string allocated in the pool entry,
+         * because allocating and deallocating this object is costly
+         * (according to the profiler, not my fantasy. Remember:
+         * premature optimization bla bla bla. */
+        int klen = sdslen(key);
+        if (klen > EVPOOL_CACHED_SDS_SIZE) {
+            pool[k].key = sdsdup(key);
+        } else {
+            memcpy(pool[k].cached,key,klen+1);
+            sdssetlen(pool[k].cached,klen);
+            pool[k].key = pool[k].cached;
+        }
+        pool[k].idle = idle;
+    }
+}
+
+/* 从淘汰池中取出最佳的候选key，返回其在键空间中的sds，池为空时返回NULL */
+static sds evictionPoolPopBest(respDb *db) {
+    struct evictionPoolEntry *pool = EvictionPoolLRU;
+    dictEntry *de;
+    int k;
+
+    /* Go backward from best to worst element to evict. */
+    for (k = EVPOOL_SIZE-1; k >= 0; k--) {
+        if (pool[k].key == NULL) continue;
+
+        if (server.maxmemory_policy & MAXMEMORY_FLAG_ALLKEYS) {
+            de = dictFind(db->dict,pool[k].key);
+        } else {
+            de = dictFind(db->expires,pool[k].key);
+        }
+
+        /* Remove the entry from the pool. */
+        if (pool[k].key != pool[k].cached)
+            sdsfree(pool[k].key);
+        pool[k].key = NULL;
+        pool[k].idle = 0;
+
+        /* If the key exists, is our pick. Otherwise it is
+         * a ghost and we need to try the next element. */
+        if (de) return dictGetKey(de);
+    }
+    return NULL;
+}
+
+/* With the TinyLFU admission policy the key added last must be accessed
+ * more frequently than the victim to stay in memory, otherwise it is the
+ * one evicted. Returns the key to evict. */
+static sds evictionAdmissionFilter(respDb *db, sds victim, sds candidate) {
+    dictEntry *de;
+
+    if (sdscmp(victim,candidate) == 0) return victim;
+    if (server.maxmemory_policy & MAXMEMORY_FLAG_ALLKEYS) {
+        de = dictFind(db->dict,candidate);
+    } else {
+        de = dictFind(db->expires,candidate);
+    }
+    if (de == NULL || tinylfuAdmit(candidate,victim)) return victim;
+    server.stat_admission_rejected++;
+    return dictGetKey(de);
+}
+
+/* ----------------------------------------------------------------------------
+ * The external API for eviction: freeMemoryIfNeeded() is called by the
+ * server when there is data to add in order to make space if needed.
+ * --------------------------------------------------------------------------*/
+
+/* Return the amount of memory that is not counted when checking maxmemory:
+ * the TinyLFU sketch is sized by tinylfu-capacity and allocated up front,
+ * counting it would make it compete with the keys it is meant to protect. */
+size_t freeMemoryGetNotCountedMemory(void) {
+    return tinylfuMemoryUsage();
+}
+
+/* This function is periodically called to see if there is memory to free
+ * according to the current "maxmemory" settings. In case we are over the
+ * memory limit, the function will try to free some memory to return back
+ * under the limit.
+ *
+ * The function returns C_OK if we are under the memory limit or if we
+ * were over the limit, but the attempt to free memory was successful.
+ * Otherwise if we are over the memory limit, but not enough memory
+ * was freed to return back under the limit, the function returns C_ERR. */
+int freeMemoryIfNeeded(void) {
+    respDb *db = server.db;
+    size_t mem_reported, mem_used, mem_tofree, mem_freed, overhead;
+    long long start, delta;
+    long long keys_freed = 0;
+    int iterations = 0;
+
+    mem_reported = zmalloc_used_memory();
+    if (server.maxmemory == 0 || mem_reported <= (size_t)server.maxmemory) {
+        /* 内存充足时新增的key无需比较即被接纳 */
+        tinylfuClearCandidate();
+        return C_OK;
+    }
+
+    /* Remove the size of the TinyLFU sketch from the used memory. */
+    mem_used = mem_reported;
+    overhead = freeMemoryGetNotCountedMemory();
+    mem_used = (mem_used > overhead) ? mem_used-overhead : 0;
+    if (mem_used <= (size_t)server.maxmemory) {
+        tinylfuClearCandidate();
+        return C_OK;
+    }
+    mem_tofree = mem_used - server.maxmemory;
+
+    if (server.maxmemory_policy == MAXMEMORY_NO_EVICTION)
+        return C_ERR; /* We need to free memory, but policy forbids. */
+
+    start = ustime();
+    mem_freed = 0;
+    while (mem_freed < mem_tofree) {
+        sds bestkey = NULL, candidate;
+
+        if (server.maxmemory_policy & (MAXMEMORY_FLAG_LRU|MAXMEMORY_FLAG_LFU) ||
+            server.maxmemory_policy == MAXMEMORY_VOLATILE_TTL)
+        {
+            dict *sampledict = (server.maxmemory_policy & MAXMEMORY_FLAG_ALLKEYS) ?
+                               db->dict : db->expires;
+
+            while (bestkey == NULL && dictSize(sampledict) != 0) {
+                evictionPoolPopulate(sampledict,db->dict,EvictionPoolLRU);
+                bestkey = evictionPoolPopBest(db);
+            }
+        } else {
+            /* volatile-random and allkeys-random policy */
+            dict *dict = (server.maxmemory_policy == MAXMEMORY_ALLKEYS_RANDOM) ?
+                         db->dict : db->expires;
+            if (dictSize(dict) != 0) {
+                dictEntry *de = dictGetRandomKey(dict);
+                bestkey = dictGetKey(de);
+            }
+        }
+
+        /* Nothing to free... */
+        if (bestkey == NULL) break;
+
+        if ((candidate = tinylfuGetCandidate()) != NULL) {
+            bestkey = evictionAdmissionFilter(db,bestkey,candidate);
+            tinylfuClearCandidate();
+        }
+
+        /* Finally remove the selected key. We compute the amount of memory
+         * freed by dbDelete() alone. */
+        robj keyobj;
+        initStaticStringObject(keyobj,bestkey);
+        delta = (long long) zmalloc_used_memory();
+        dbDelete(db,&keyobj);
+        delta -= (long long) zmalloc_used_memory();
+        mem_freed += delta;
+        server.stat_evictedkeys++;
+        keys_freed++;
+
+        /* Don't block the event loop for too long: check the time every
+         * 16 keys and leave the rest of the work to the next call. */
+        if ((++iterations & 0xf) == 0 && ustime()-start > EVICTION_TIME_LIMIT_US) {
+            server.stat_eviction_time_cap_reached_count++;
+            break;
+        }
+    }
+
+    /* 未能回到限制以下，但本轮释放了部分内存时仍允许写入，剩余部分由后续调用继续淘汰 */
+    if (mem_freed < mem_tofree && keys_freed == 0) return C_ERR;
+    return C_OK;
+}
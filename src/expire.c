@@ -0,0 +1,281 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// key过期。过期时间保存在db->expires中，删除分为两种:
+// 1. 惰性删除: 访问key时检查是否过期，见expireIfNeeded。
+// 2. 主动删除: serverCron每次执行慢速周期，beforeSleep在上一轮过期key较多时执行快速周期。
+//    每轮用dictGetSomeKeys采样一批key并删除其中已过期的，只要已过期比例高于阈值就继续采样，
+//    直至超出时间预算，因此内存能被及时回收，且单次执行耗时有上限。
+
+#include <unistd.h>
+#include "server.h"
+#include "expire.h"
+#include "db.h"
+#include "reply.h"
+#include "util.h"
+#include "log.h"
+
+/*-----------------------------------------------------------------------------
+ * Incremental collection of expired keys.
+ *----------------------------------------------------------------------------*/
+
+#define ACTIVE_EXPIRE_CYCLE_MAX_KEYS_PER_LOOP \
+    (ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP + \
+     ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP/4*(CONFIG_MAX_ACTIVE_EXPIRE_EFFORT-1))
+
+/* Sample up to 'num' keys with an expire and delete the ones already
+ * expired. Returns the number of deleted keys, '*sampled' is set to the
+ * number of keys actually sampled. */
+static unsigned long activeExpireSample(respDb *db, unsigned long num,
+                                        unsigned long *sampled, long long now)
+{
+    dictEntry *des[ACTIVE_EXPIRE_CYCLE_MAX_KEYS_PER_LOOP];
+    sds keys[ACTIVE_EXPIRE_CYCLE_MAX_KEYS_PER_LOOP];
+    unsigned long count, expired = 0, j, k;
+
+    count = dictGetSomeKeys(db->expires,des,num);
+    *sampled = count;
+
+    /* dictGetSomeKeys() may return the same entry twice: collect the
+     * distinct expired keys first, the entries are invalid once a key
+     * is deleted. */
+    for (j = 0; j < count; j++) {
+        sds key = dictGetKey(des[j]);
+
+        if (dictGetSignedIntegerVal(des[j]) >= now) continue;
+        for (k = 0; k < expired; k++) {
+            if (keys[k] == key) break;
+        }
+        if (k == expired) keys[expired++] = key;
+    }
+
+    for (j = 0; j < expired; j++) {
+        robj keyobj;
+
+        initStaticStringObject(keyobj,keys[j]);
+        dbDelete(db,&keyobj);
+    }
+    server.stat_expiredkeys += expired;
+    return expired;
+}
+
+/* Try to expire a few timed out keys. The algorithm used is adaptive and
+ * will use few CPU cycles if there are few expiring keys, otherwise
+ * it will get more aggressive to avoid that too much memory is used by
+ * keys that can be removed from the keyspace.
+ *
+ * If type is ACTIVE_EXPIRE_CYCLE_FAST the function will try to run a
+ * "fast" expire cycle that takes no longer than the fast duration, and
+ * will not be repeated again before the same amount of time. The cycle
+ * is only run when the previous slow cycle exited for time limit or the
+ * estimated ratio of stale keys is above the acceptable level.
+ *
+ * If type is ACTIVE_EXPIRE_CYCLE_SLOW, that normal expire cycle is
+ * executed, where the time limit is a percentage of the server.hz period
+ * as specified by the slow time percentage. */
+void activeExpireCycle(int type) {
+    /* Adjust the running parameters according to the configured expire
+     * effort. The default effort is 1, and the maximum configurable effort
+     * is 10. */
+    unsigned long effort = server.active_expire_effort-1, /* Rescale from 0 to 9. */
+    config_keys_per_loop = ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP +
+                           ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP/4*effort,
+    config_cycle_fast_duration = ACTIVE_EXPIRE_CYCLE_FAST_DURATION +
+                                 ACTIVE_EXPIRE_CYCLE_FAST_DURATION/4*effort,
+    config_cycle_slow_time_perc = ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC +
+                                  2*effort,
+    config_cycle_acceptable_stale = ACTIVE_EXPIRE_CYCLE_ACCEPTABLE_STALE-
+                                    effort;
+
+    static int timelimit_exit = 0;      /* Time limit hit in previous call? */
+    static long long last_fast_cycle = 0; /* When last fast cycle ran. */
+
+    respDb *db = server.db;
+    int iteration = 0;
+    long long start = ustime(), timelimit, elapsed;
+    unsigned long total_sampled = 0, total_expired = 0;
+    unsigned long sampled, expired;
+
+    if (db == NULL) return;
+
+    if (type == ACTIVE_EXPIRE_CYCLE_FAST) {
+        /* Don't start a fast cycle if the previous cycle did not exit
+         * for time limit, unless the percentage of estimated stale keys is
+         * too high. Also never repeat a fast cycle for the same period
+         * as the fast cycle total duration itself. */
+        if (!timelimit_exit &&
+            server.stat_expired_stale_perc < config_cycle_acceptable_stale)
+            return;
+
+        if (start < last_fast_cycle + (long long)config_cycle_fast_duration*2)
+            return;
+
+        last_fast_cycle = start;
+    }
+
+    /* We can use at max 'config_cycle_slow_time_perc' percentage of CPU
+     * time per iteration. Since this function gets called with a frequency of
+     * server.hz times per second, the following is the max amount of
+     * microseconds we can spend in this function. */
+    timelimit = config_cycle_slow_time_perc*1000000/server.hz/100;
+    timelimit_exit = 0;
+    if (timelimit <= 0) timelimit = 1;
+
+    if (type == ACTIVE_EXPIRE_CYCLE_FAST)
+        timelimit = config_cycle_fast_duration; /* in microseconds. */
+
+    do {
+        unsigned long num = dictSize(db->expires);
+
+        if (num == 0) break;
+
+        if (num > config_keys_per_loop) num = config_keys_per_loop;
+        expired = activeExpireSample(db,num,&sampled,server.mstime);
+        total_sampled += sampled;
+        total_expired += expired;
+
+        /* We can't block forever here even if there are many keys to
+         * expire. So after a given amount of milliseconds return to the
+         * caller waiting for the other active expire cycle. */
+        if ((++iteration & 0xf) == 0) {
+            elapsed = ustime()-start;
+            if (elapsed > timelimit) {
+                timelimit_exit = 1;
+                server.stat_expired_time_cap_reached_count++;
+                break;
+            }
+        }
+
+        /* We don't repeat the cycle if there are less than an acceptable
+         * amount of stale keys logically existing in the database. */
+    } while (sampled == 0 ||
+             expired*100/sampled > config_cycle_acceptable_stale);
+
+    elapsed = ustime()-start;
+    server.stat_expire_cycle_time_used += elapsed;
+
+    /* Update our estimate of keys existing but yet to be expired.
+     * Running average with this sample accounting for 5%. */
+    double current_perc;
+    if (total_sampled) {
+        current_perc = (double)total_expired*100/total_sampled;
+    } else
+        current_perc = 0;
+    server.stat_expired_stale_perc = (current_perc*0.05)+
+                                     (server.stat_expired_stale_perc*0.95);
+}
+
+/*-----------------------------------------------------------------------------
+ * Expires Commands
+ *----------------------------------------------------------------------------*/
+
+/* This is the generic command implementation for EXPIRE, PEXPIRE, EXPIREAT
+ * and PEXPIREAT. Because the command second argument may be relative or
+ * absolute the "basetime" argument is used to signal what the base time is
+ * (either 0 for *AT variants of the command, or the current time for
+ * relative expires).
+ *
+ * unit is either UNIT_SECONDS or UNIT_MILLISECONDS, and is only used for
+ * the argv[2] parameter. The basetime is always specified in milliseconds. */
+#define UNIT_SECONDS 0
+#define UNIT_MILLISECONDS 1
+
+static void expireGenericCommand(client *c, long long basetime, int unit) {
+    robj *key = c->argv[1], *param = c->argv[2];
+    long long when; /* unix time in milliseconds when the key will expire. */
+
+    if (getLongLongFromObjectOrReply(c, param, &when, NULL) != C_OK)
+        return;
+
+    if (unit == UNIT_SECONDS) {
+        if (when > LLONG_MAX/1000 || when < LLONG_MIN/1000) {
+            addReplyError(c,"invalid expire time");
+            return;
+        }
+        when *= 1000;
+    }
+    if ((when > 0 && basetime > LLONG_MAX-when) ||
+        (when < 0 && basetime < LLONG_MIN-when))
+    {
+        addReplyError(c,"invalid expire time");
+        return;
+    }
+    when += basetime;
+
+    /* No key, return zero. */
+    if (lookupKeyWrite(server.db,key) == NULL) {
+        addReply(c,shared.czero);
+        return;
+    }
+
+    /* An expire in the past deletes the key right away. */
+    if (when <= server.mstime) {
+        dbDelete(server.db,key);
+        server.stat_expiredkeys++;
+    } else {
+        setExpire(server.db,key,when);
+    }
+    addReply(c,shared.cone);
+}
+
+/* EXPIRE key seconds */
+void expireCommand(client *c) {
+    expireGenericCommand(c,server.mstime,UNIT_SECONDS);
+}
+
+/* PEXPIRE key milliseconds */
+void pexpireCommand(client *c) {
+    expireGenericCommand(c,server.mstime,UNIT_MILLISECONDS);
+}
+
+/* EXPIREAT key unix-time-seconds */
+void expireatCommand(client *c) {
+    expireGenericCommand(c,0,UNIT_SECONDS);
+}
+
+/* PEXPIREAT key unix-time-milliseconds */
+void pexpireatCommand(client *c) {
+    expireGenericCommand(c,0,UNIT_MILLISECONDS);
+}
+
+/* Implements TTL and PTTL */
+static void ttlGenericCommand(client *c, int output_ms) {
+    long long expire, ttl = -1;
+
+    /* If the key does not exist at all, return -2 */
+    if (lookupKeyRead(server.db,c->argv[1]) == NULL) {
+        addReplyLongLong(c,-2);
+        return;
+    }
+    /* The key exists. Return -1 if it has no expire, or the actual
+     * TTL value otherwise. */
+    expire = getExpire(server.db,c->argv[1]);
+    if (expire != -1) {
+        ttl = expire-server.mstime;
+        if (ttl < 0) ttl = 0;
+    }
+    if (ttl == -1) {
+        addReplyLongLong(c,-1);
+    } else {
+        addReplyLongLong(c,output_ms ? ttl : ((ttl+500)/1000));
+    }
+}
+
+/* TTL key */
+void ttlCommand(client *c) {
+    ttlGenericCommand(c, 0);
+}
+
+/* PTTL key */
+void pttlCommand(client *c) {
+    ttlGenericCommand(c, 1);
+}
+
+/* PERSIST key */
+void persistCommand(client *c) {
+    if (lookupKeyWrite(server.db,c->argv[1])) {
+        addReplyLongLong(c,removeExpire(server.db,c->argv[1]));
+    } else {
+        addReply(c,shared.czero);
+    }
+}
@@ -0,0 +1,35 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_EXPIRE_H
+#define RESP_SERVER_EXPIRE_H
+
+#include "server.h"
+
+/* Active expire cycle tuning, at effort 1. Every point of effort above 1
+ * adds a quarter of the keys per loop and of the fast cycle duration, two
+ * percent of CPU to the slow cycle and lowers the acceptable stale ratio. */
+#define ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP 20    /* Keys sampled per loop. */
+#define ACTIVE_EXPIRE_CYCLE_FAST_DURATION 1000  /* Microseconds. */
+#define ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC 25   /* Max % of CPU to use. */
+#define ACTIVE_EXPIRE_CYCLE_ACCEPTABLE_STALE 10 /* % of stale keys after which
+                                                   we do extra efforts. */
+
+#define ACTIVE_EXPIRE_CYCLE_SLOW 0
+#define ACTIVE_EXPIRE_CYCLE_FAST 1
+
+#define CONFIG_DEFAULT_ACTIVE_EXPIRE_EFFORT 1
+#define CONFIG_MAX_ACTIVE_EXPIRE_EFFORT 10
+
+void activeExpireCycle(int type);
+
+void expireCommand(client *c);
+void pexpireCommand(client *c);
+void expireatCommand(client *c);
+void pexpireatCommand(client *c);
+void ttlCommand(client *c);
+void pttlCommand(client *c);
+void persistCommand(client *c);
+
+#endif //RESP_SERVER_EXPIRE_H
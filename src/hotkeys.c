@@ -0,0 +1,339 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 热点key检测。使用count-min sketch估计每个key的访问次数，并用一个容量为K的最小堆
+// 维护估计次数最高的K个key。每个key计算一次哈希并更新4个计数器；堆满后估计次数不超过堆顶的
+// key不可能在top-K中，直接返回，其余的key通过以哈希值为键的小索引表找到在堆中的位置，与K的
+// 大小无关。每个key约40~70ns，访问均匀、堆顶频繁被替换且K较大时约120ns(见README)。
+// 计数器在serverCron中定期减半，使结果反映最近的访问情况。
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <strings.h>
+#include "hotkeys.h"
+#include "zmalloc.h"
+#include "reply.h"
+#include "util.h"
+#include "log.h"
+
+/* Fast non cryptographic 64 bit hash, processing 8 bytes at a time. The
+ * per process seed makes it hard to craft keys that hide behind collisions. */
+static inline uint64_t hotkeysHash(uint64_t seed, const unsigned char *p, size_t len) {
+    uint64_t h = seed ^ (len * 0x9E3779B97F4A7C15ULL);
+    uint64_t v;
+
+    while (len >= 8) {
+        memcpy(&v,p,8);
+        h = (h ^ v) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+        p += 8;
+        len -= 8;
+    }
+    /* The last 1~7 bytes are read with fixed size loads, overlapping when
+     * needed, instead of a variable length memcpy() call. */
+    if (len >= 4) {
+        uint32_t lo, hi;
+        memcpy(&lo,p,4);
+        memcpy(&hi,p+len-4,4);
+        v = ((uint64_t)hi << 32) | lo;
+    } else if (len) {
+        v = ((uint64_t)p[0] << 16) | ((uint64_t)p[len>>1] << 8) | p[len-1];
+    } else {
+        v = 0;
+    }
+    h = (h ^ v) * 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 29;
+    /* The low bits select the counters and the index slot: mix the high
+     * half, where the end of short keys lands, back into them. */
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+    return h;
+}
+
+/* 返回索引中保存堆位置pos的槽，hash为该位置上key的哈希值 */
+static int *hotkeysIndexSlot(hotkeys *hk, uint64_t hash, int pos) {
+    uint32_t s = (uint32_t)hash & hk->indexmask;
+
+    while (hk->index[s] != pos) s = (s+1) & hk->indexmask;
+    return hk->index+s;
+}
+
+static void hotkeysIndexAdd(hotkeys *hk, uint64_t hash, int pos) {
+    uint32_t s = (uint32_t)hash & hk->indexmask;
+
+    while (hk->index[s] != -1) s = (s+1) & hk->indexmask;
+    hk->index[s] = pos;
+}
+
+/* 删除堆位置pos的索引，之后的槽向前移动以保持线性探测的连续性 */
+static void hotkeysIndexDelete(hotkeys *hk, uint64_t hash, int pos) {
+    uint32_t mask = hk->indexmask;
+    uint32_t i = (uint32_t)(hotkeysIndexSlot(hk,hash,pos)-hk->index), j = i, home;
+
+    while (1) {
+        j = (j+1) & mask;
+        if (hk->index[j] == -1) break;
+        home = (uint32_t)hk->heap[hk->index[j]].hash & mask;
+        /* The entry can only move back to i if i is not before its home slot. */
+        if (((j-home) & mask) < ((j-i) & mask)) continue;
+        hk->index[i] = hk->index[j];
+        i = j;
+    }
+    hk->index[i] = -1;
+}
+
+/* 返回key在堆中的位置，不在top-K中时返回-1 */
+static int hotkeysIndexFind(hotkeys *hk, uint64_t hash, const char *key, size_t len) {
+    uint32_t s = (uint32_t)hash & hk->indexmask;
+    int pos;
+
+    while ((pos = hk->index[s]) != -1) {
+        hotkeyEntry *he = hk->heap+pos;
+        if (he->hash == hash && sdslen(he->key) == len &&
+            memcmp(he->key,key,len) == 0) return pos;
+        s = (s+1) & hk->indexmask;
+    }
+    return -1;
+}
+
+static void hotkeysSwap(hotkeys *hk, int i, int j) {
+    int *si = hotkeysIndexSlot(hk,hk->heap[i].hash,i);
+    int *sj = hotkeysIndexSlot(hk,hk->heap[j].hash,j);
+    hotkeyEntry tmp = hk->heap[i];
+
+    hk->heap[i] = hk->heap[j];
+    hk->heap[j] = tmp;
+    *si = j;
+    *sj = i;
+}
+
+static void hotkeysSiftUp(hotkeys *hk, int pos) {
+    hotkeyEntry *heap = hk->heap;
+
+    while (pos > 0) {
+        int parent = (pos-1)/2;
+        if (heap[parent].count <= heap[pos].count) break;
+        hotkeysSwap(hk,parent,pos);
+        pos = parent;
+    }
+}
+
+static void hotkeysSiftDown(hotkeys *hk, int pos) {
+    hotkeyEntry *heap = hk->heap;
+
+    while (1) {
+        int min = pos, l = pos*2+1, r = pos*2+2;
+
+        if (l < hk->used && heap[l].count < heap[min].count) min = l;
+        if (r < hk->used && heap[r].count < heap[min].count) min = r;
+        if (min == pos) break;
+        hotkeysSwap(hk,min,pos);
+        pos = min;
+    }
+}
+
+static void hotkeysFree(hotkeys *hk) {
+    int j;
+
+    for (j = 0; j < hk->used; j++) sdsfree(hk->heap[j].key);
+    zfree(hk->heap);
+    zfree(hk->index);
+    zfree(hk);
+}
+
+/* 清空统计，保留已分配的空间 */
+static void hotkeysClear(hotkeys *hk) {
+    int j;
+
+    for (j = 0; j < hk->used; j++) sdsfree(hk->heap[j].key);
+    hk->used = 0;
+    memset(hk->sketch,0,sizeof(hk->sketch));
+    memset(hk->index,-1,sizeof(int)*(hk->indexmask+1));
+}
+
+/* 设置top-K的容量，0代表关闭。修改容量会清空已有统计 */
+int hotkeysSetTopK(long long k) {
+    if (server.hotkeys) {
+        hotkeysFree(server.hotkeys);
+        server.hotkeys = NULL;
+    }
+    server.hotkeys_topk = (int)k;
+    if (k == 0) return C_OK;
+
+    hotkeys *hk = zcalloc(sizeof(*hk));
+    uint32_t size = 2;
+
+    while (size < 2*k) size <<= 1;
+    hk->heap = zcalloc(sizeof(hotkeyEntry)*k);
+    hk->index = zmalloc(sizeof(int)*size);
+    memset(hk->index,-1,sizeof(int)*size);
+    hk->indexmask = size-1;
+    hk->k = (int)k;
+    hk->used = 0;
+    hk->seed = ((uint64_t)ustime() << 16) ^ (uint64_t)getpid();
+    server.hotkeys = hk;
+    return C_OK;
+}
+
+#define hotkeysCounter(hk,hash,j) \
+    (&(hk)->sketch[j][((uint32_t)(hash) + (j)*((uint32_t)((hash) >> 32) | 1)) & (HOTKEYS_SKETCH_WIDTH-1)])
+
+/* 哈希值为hash的key当前的估计次数 */
+static uint32_t hotkeysEstimate(hotkeys *hk, uint64_t hash) {
+    uint32_t min = UINT32_MAX, v;
+    int j;
+
+    for (j = 0; j < HOTKEYS_SKETCH_DEPTH; j++) {
+        v = *hotkeysCounter(hk,hash,j);
+        if (v < min) min = v;
+    }
+    return min;
+}
+
+/* 记录一次key访问 */
+static void hotkeysAdd(hotkeys *hk, const char *key, size_t len) {
+    uint64_t hash = hotkeysHash(hk->seed,(const unsigned char*)key,len);
+    uint32_t *counters[HOTKEYS_SKETCH_DEPTH], v[HOTKEYS_SKETCH_DEPTH];
+    uint32_t min = UINT32_MAX;
+    int j, pos;
+
+    /* Conservative update: only the counters equal to the minimum are
+     * incremented, which reduces the overestimation caused by collisions.
+     * Written without branches: which counters are raised is random, and
+     * the mispredictions cost more than storing all four counters. */
+    for (j = 0; j < HOTKEYS_SKETCH_DEPTH; j++) {
+        counters[j] = hotkeysCounter(hk,hash,j);
+        v[j] = *counters[j];
+        min = v[j] < min ? v[j] : min;
+    }
+    if (min == UINT32_MAX) return;
+    min++;
+    for (j = 0; j < HOTKEYS_SKETCH_DEPTH; j++)
+        *counters[j] = v[j] < min ? min : v[j];
+
+    /* The estimate of a key in the top-K only grows, and is never smaller than
+     * the count stored in its entry, so once the heap is full a key that
+     * doesn't beat the least accessed one can't be in the top-K: most cold
+     * keys stop here without touching the index. */
+    if (hk->used == hk->k && min <= hk->heap[0].count) return;
+
+    /* Already in the top-K? */
+    if ((pos = hotkeysIndexFind(hk,hash,key,len)) != -1) {
+        hk->heap[pos].count = min;
+        hotkeysSiftDown(hk,pos);
+        return;
+    }
+
+    if (hk->used < hk->k) {
+        hotkeyEntry *he = hk->heap + hk->used;
+        he->hash = hash;
+        he->count = min;
+        he->key = sdsnewlen(key,len);
+        hotkeysIndexAdd(hk,hash,hk->used);
+        hk->used++;
+        hotkeysSiftUp(hk,hk->used-1);
+    } else {
+        /* The counts in the heap are only updated when their key is seen, so
+         * the least accessed key may just be stale: refresh it from the
+         * sketch first, otherwise every cold key would replace it in turn. */
+        hotkeyEntry *he = hk->heap;
+        uint32_t current = hotkeysEstimate(hk,he->hash);
+
+        if (current >= min) {
+            he->count = current;
+            hotkeysSiftDown(hk,0);
+            return;
+        }
+
+        /* Replace the least accessed key, reusing its buffer. */
+        hotkeysIndexDelete(hk,he->hash,0);
+        he->hash = hash;
+        he->count = min;
+        he->key = sdscpylen(he->key,key,len);
+        hotkeysIndexAdd(hk,hash,0);
+        hotkeysSiftDown(hk,0);
+    }
+}
+
+/* 由processCommand调用，按命令声明的key位置记录访问的key。
+ * firstkey为0时默认使用argv[1]，为负数时代表命令不包含key */
+void hotkeysFeedCommand(client *c) {
+    hotkeys *hk = server.hotkeys;
+    struct respCommand *cmd = c->cmd;
+    int j, last;
+
+    if (hk == NULL || cmd->firstkey < 0) return;
+    if (cmd->firstkey == 0) {
+        if (c->argc > 1 && sdsEncodedObject(c->argv[1]))
+            hotkeysAdd(hk,c->argv[1]->ptr,sdslen(c->argv[1]->ptr));
+        return;
+    }
+
+    last = cmd->lastkey ? cmd->lastkey : cmd->firstkey;
+    if (last < 0) last = c->argc+last;
+    if (last >= c->argc) last = c->argc-1;
+    for (j = cmd->firstkey; j <= last; j += cmd->keystep ? cmd->keystep : 1) {
+        if (sdsEncodedObject(c->argv[j]))
+            hotkeysAdd(hk,c->argv[j]->ptr,sdslen(c->argv[j]->ptr));
+    }
+}
+
+/* 所有计数减半，由serverCron按hotkeys_decay_period周期调用 */
+void hotkeysDecay(void) {
+    hotkeys *hk = server.hotkeys;
+    int i, j;
+
+    if (hk == NULL) return;
+    for (i = 0; i < HOTKEYS_SKETCH_DEPTH; i++) {
+        for (j = 0; j < HOTKEYS_SKETCH_WIDTH; j++)
+            hk->sketch[i][j] >>= 1;
+    }
+    /* Halving keeps the heap property, no need to rebuild it. */
+    for (j = 0; j < hk->used; j++) hk->heap[j].count >>= 1;
+}
+
+static int hotkeysCompareDesc(const void *a, const void *b) {
+    const hotkeyEntry *ea = a, *eb = b;
+    if (ea->count == eb->count) return 0;
+    return ea->count < eb->count ? 1 : -1;
+}
+
+/* HOTKEYS [count] | RESET */
+void hotkeysCommand(client *c) {
+    hotkeys *hk = server.hotkeys;
+    long long count;
+    int j;
+
+    if (c->argc == 2 && !strcasecmp(c->argv[1]->ptr,"reset")) {
+        if (hk) hotkeysClear(hk);
+        addReply(c,shared.ok);
+        return;
+    }
+    if (hk == NULL) {
+        addReplyError(c,"Hot keys tracking is disabled, enable it with CONFIG SET hotkeys-topk <k>");
+        return;
+    }
+    count = hk->used;
+    if (c->argc == 2 &&
+        (!string2ll(c->argv[1]->ptr,sdslen(c->argv[1]->ptr),&count) || count < 0))
+    {
+        addReplyError(c,"value is out of range, must be positive");
+        return;
+    } else if (c->argc > 2) {
+        addReplyError(c,"syntax error");
+        return;
+    }
+    if (count > hk->used) count = hk->used;
+
+    /* Sort a copy, the heap keeps being updated by the next commands. */
+    hotkeyEntry *sorted = zmalloc(sizeof(hotkeyEntry)*hk->used);
+    memcpy(sorted,hk->heap,sizeof(hotkeyEntry)*hk->used);
+    qsort(sorted,hk->used,sizeof(hotkeyEntry),hotkeysCompareDesc);
+
+    addReplyArrayLen(c,count*2);
+    for (j = 0; j < count; j++) {
+        addReplyBulkCBuffer(c,sorted[j].key,sdslen(sorted[j].key));
+        addReplyLongLong(c,(long long)sorted[j].count);
+    }
+    zfree(sorted);
+}
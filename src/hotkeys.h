@@ -0,0 +1,39 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_HOTKEYS_H
+#define RESP_SERVER_HOTKEYS_H
+
+#include "server.h"
+
+#define CONFIG_DEFAULT_HOTKEYS_TOPK 0           /* 0代表关闭 */
+#define CONFIG_DEFAULT_HOTKEYS_DECAY_PERIOD 60  /* 秒 */
+#define HOTKEYS_MAX_TOPK 1024
+
+/* Count-min sketch geometry: 4 rows of 2048 counters, 32KB in total. */
+#define HOTKEYS_SKETCH_DEPTH 4
+#define HOTKEYS_SKETCH_WIDTH 2048
+
+typedef struct hotkeyEntry {
+    uint64_t hash;          /* 键的哈希值，查找时先比较哈希 */
+    uint64_t count;         /* 估计的访问次数 */
+    sds key;
+} hotkeyEntry;
+
+typedef struct hotkeys {
+    uint32_t sketch[HOTKEYS_SKETCH_DEPTH][HOTKEYS_SKETCH_WIDTH];
+    hotkeyEntry *heap;      /* 以count为序的最小堆，堆顶为top-K中访问最少的键 */
+    int k;                  /* 堆容量 */
+    int used;               /* 堆中键的数量 */
+    int *index;             /* 哈希值到堆中位置的开放寻址表(线性探测)，-1为空 */
+    uint32_t indexmask;     /* 表大小为不小于2*k的2的幂，减1 */
+    uint64_t seed;
+} hotkeys;
+
+int hotkeysSetTopK(long long k);
+void hotkeysFeedCommand(client *c);
+void hotkeysDecay(void);
+void hotkeysCommand(client *c);
+
+#endif //RESP_SERVER_HOTKEYS_H
@@ -0,0 +1,774 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// HyperLogLog基数估计：PFADD、PFCOUNT、PFMERGE。
+//
+// HyperLogLog保存在字符串值中，16字节的头部之后为2^14个寄存器，标准误差约0.81%。元素的64位
+// hash低14位选择寄存器，其余50位中最低的1所在的位置(从1开始)为rank，寄存器记录见过的最大rank。
+// 寄存器有两种编码：
+// - 稀疏编码：按寄存器顺序排列的操作码，ZERO(00xxxxxx)为1~64个值为0的寄存器，
+//   XZERO(01xxxxxx yyyyyyyy)为1~16384个值为0的寄存器，VAL(1vvvvvxx)为1~4个值为1~32的寄存器。
+//   新建的HyperLogLog只有一个XZERO，元素较少时只占几十到几百字节；
+// - 稠密编码：每个寄存器6位，共12288字节。
+// 稀疏编码的长度超过hll-sparse-max-bytes，或有寄存器的值超过32时转换为稠密编码，之后不再转换回稀疏编码。
+//
+// PFADD先把所有元素的(寄存器, rank)排序，稀疏编码时一次遍历旧的操作码生成新的编码。
+// 多个key的PFCOUNT与PFMERGE把所有key按寄存器取最大值合并到一组预先分配的、每个寄存器1字节的
+// 寄存器中，不为每次命令分配内存。稠密编码的合并、以及由寄存器计算估计值的调和平均在x86上
+// 与bitops.c一样按CPU选择AVX2版本的内核。基数由Ertl的改进估计算法计算，小基数时不需要线性计数修正。
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "server.h"
+#include "db.h"
+#include "hyperloglog.h"
+#include "reply.h"
+#include "zmalloc.h"
+#include "log.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HLL_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+uint64_t wyhash(const uint8_t *in, const size_t inlen, const uint8_t *k);
+void wyhash_batch(const uint8_t *const *in, const size_t *inlen, int count,
+                  const uint8_t *k, uint64_t *out);
+
+#define HLL_P 14                            /* 寄存器数量为2^HLL_P */
+#define HLL_Q (64-HLL_P)                    /* 用于计算rank的hash位数 */
+#define HLL_REGISTERS (1<<HLL_P)
+#define HLL_P_MASK (HLL_REGISTERS-1)
+#define HLL_BITS 6                          /* 稠密编码每个寄存器的位数 */
+#define HLL_REGISTER_MAX ((1<<HLL_BITS)-1)
+#define HLL_HDR_SIZE 16
+#define HLL_DENSE_REGISTERS_SIZE ((HLL_REGISTERS*HLL_BITS+7)/8)
+#define HLL_DENSE_SIZE (HLL_HDR_SIZE+HLL_DENSE_REGISTERS_SIZE)
+#define HLL_DENSE 0
+#define HLL_SPARSE 1
+#define HLL_MAX_ENCODING 1
+#define HLL_ALPHA_INF 0.721347520444481703680
+
+/* 值的头部，cached_card为最近一次PFCOUNT计算的基数(小端序)，card[7]的最高位为1时无效 */
+struct hllhdr {
+    char magic[4];          /* "HYLL" */
+    uint8_t encoding;       /* HLL_DENSE或HLL_SPARSE */
+    uint8_t notused[3];
+    uint8_t card[8];
+    uint8_t registers[];
+};
+
+#define HLL_INVALIDATE_CACHE(hdr) ((hdr)->card[7] |= (1<<7))
+#define HLL_VALID_CACHE(hdr) (((hdr)->card[7] & (1<<7)) == 0)
+
+/* 稀疏编码的操作码 */
+#define HLL_SPARSE_XZERO_BIT 0x40
+#define HLL_SPARSE_VAL_BIT 0x80
+#define HLL_SPARSE_IS_ZERO(p) (((*(p)) & 0xc0) == 0)
+#define HLL_SPARSE_IS_XZERO(p) (((*(p)) & 0xc0) == HLL_SPARSE_XZERO_BIT)
+#define HLL_SPARSE_ZERO_LEN(p) (((*(p)) & 0x3f)+1)
+#define HLL_SPARSE_XZERO_LEN(p) (((((*(p)) & 0x3f) << 8) | (*((p)+1)))+1)
+#define HLL_SPARSE_VAL_VALUE(p) ((((*(p)) >> 2) & 0x1f)+1)
+#define HLL_SPARSE_VAL_LEN(p) (((*(p)) & 0x3)+1)
+#define HLL_SPARSE_VAL_MAX_VALUE 32
+#define HLL_SPARSE_VAL_MAX_LEN 4
+#define HLL_SPARSE_ZERO_MAX_LEN 64
+#define HLL_SPARSE_XZERO_MAX_LEN 16384
+
+/* PFADD的一次更新：寄存器编号在高位，rank在低8位，按整数排序即按寄存器排序 */
+#define HLL_UPDATE(index,rank) (((uint32_t)(index) << 8) | (uint32_t)(rank))
+#define HLL_UPDATE_INDEX(u) ((u) >> 8)
+#define HLL_UPDATE_RANK(u) ((int)((u) & 0xff))
+
+static const char *invalid_hll_err = "-INVALIDOBJ Corrupted HLL object detected";
+
+/* 元素hash的key固定不变，同样的元素在任何进程中都落在同一个寄存器，不同key之间可以合并 */
+static const uint8_t hll_hash_key[16] = "resp-server-hll";
+
+/* 多个key的PFCOUNT与PFMERGE合并寄存器用的缓冲区，每个寄存器1字节 */
+static uint8_t hll_scratch[HLL_REGISTERS];
+
+/* 估计基数需要的寄存器统计：值为0与值为HLL_Q+1的寄存器在估计算法中单独处理 */
+typedef struct hllSummary {
+    double sum;             /* 其余寄存器的2^-value之和 */
+    long zeros;             /* 值为0的寄存器数量 */
+    long saturated;         /* 值为HLL_Q+1的寄存器数量 */
+} hllSummary;
+
+typedef void (hllMergeDenseFunction)(uint8_t *max, const uint8_t *registers);
+typedef void (hllSummarizeFunction)(const uint8_t *max, hllSummary *s);
+
+/*-----------------------------------------------------------------------------
+ * Dense registers
+ *----------------------------------------------------------------------------*/
+
+/* 稠密编码每3个字节保存4个寄存器：24位小端整数中第k个寄存器为第6k~6k+5位 */
+static inline uint32_t hllDenseLoadGroup(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+static inline void hllDenseStoreGroup(uint8_t *p, uint32_t x) {
+    p[0] = x & 0xff;
+    p[1] = (x >> 8) & 0xff;
+    p[2] = (x >> 16) & 0xff;
+}
+
+static inline int hllDenseGet(const uint8_t *registers, long index) {
+    uint32_t x = hllDenseLoadGroup(registers+(index >> 2)*3);
+
+    return (x >> ((index & 3)*HLL_BITS)) & HLL_REGISTER_MAX;
+}
+
+static inline void hllDenseSet(uint8_t *registers, long index, int value) {
+    uint8_t *p = registers+(index >> 2)*3;
+    int shift = (index & 3)*HLL_BITS;
+    uint32_t x = hllDenseLoadGroup(p);
+
+    x = (x & ~((uint32_t)HLL_REGISTER_MAX << shift)) | ((uint32_t)value << shift);
+    hllDenseStoreGroup(p,x);
+}
+
+/* max[i] = max(max[i], 稠密编码的第i个寄存器) */
+static void hllMergeDenseScalar(uint8_t *max, const uint8_t *registers) {
+    long i;
+
+    for (i = 0; i < HLL_REGISTERS; i += 4) {
+        uint32_t x = hllDenseLoadGroup(registers+(i >> 2)*3);
+        uint8_t r0 = x & HLL_REGISTER_MAX, r1 = (x >> 6) & HLL_REGISTER_MAX,
+                r2 = (x >> 12) & HLL_REGISTER_MAX, r3 = (x >> 18) & HLL_REGISTER_MAX;
+
+        if (r0 > max[i]) max[i] = r0;
+        if (r1 > max[i+1]) max[i+1] = r1;
+        if (r2 > max[i+2]) max[i+2] = r2;
+        if (r3 > max[i+3]) max[i+3] = r3;
+    }
+}
+
+/* 按寄存器值的直方图计算统计 */
+static void hllSummarizeScalar(const uint8_t *max, hllSummary *s) {
+    long histo[HLL_REGISTER_MAX+1] = {0}, i;
+    int j;
+
+    for (i = 0; i < HLL_REGISTERS; i += 8) {
+        histo[max[i]]++;
+        histo[max[i+1]]++;
+        histo[max[i+2]]++;
+        histo[max[i+3]]++;
+        histo[max[i+4]]++;
+        histo[max[i+5]]++;
+        histo[max[i+6]]++;
+        histo[max[i+7]]++;
+    }
+    s->sum = 0;
+    for (j = 1; j <= HLL_REGISTER_MAX; j++) {
+        if (j != HLL_Q+1) s->sum += ldexp(histo[j],-j);
+    }
+    s->zeros = histo[0];
+    s->saturated = histo[HLL_Q+1];
+}
+
+#ifdef HLL_X86_DISPATCH
+/* 每次把24字节(8组)展开为32个寄存器：两个128位通道分别读取12字节，vpshufb把每组3字节放入
+ * 一个32位整数，再移位、掩码使4个寄存器各占一个字节，与max按字节取最大值。
+ * 最后一次读取会越过寄存器末尾，留给标量代码处理 */
+__attribute__((target("avx2")))
+static void hllMergeDenseAVX2(uint8_t *max, const uint8_t *registers) {
+    const __m256i shuffle = _mm256_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1,
+                                             0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+    const __m256i m0 = _mm256_set1_epi32(0x3f), m1 = _mm256_set1_epi32(0x3f00),
+                  m2 = _mm256_set1_epi32(0x3f0000), m3 = _mm256_set1_epi32(0x3f000000);
+    long i = 0, b = 0;
+
+    for (; b+28 <= HLL_DENSE_REGISTERS_SIZE; b += 24, i += 32) {
+        __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                        _mm_loadu_si128((const __m128i*)(registers+b))),
+                        _mm_loadu_si128((const __m128i*)(registers+b+12)),1);
+        __m256i r;
+
+        x = _mm256_shuffle_epi8(x,shuffle);
+        r = _mm256_or_si256(
+                _mm256_or_si256(_mm256_and_si256(x,m0),
+                                _mm256_and_si256(_mm256_slli_epi32(x,2),m1)),
+                _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(x,4),m2),
+                                _mm256_and_si256(_mm256_slli_epi32(x,6),m3)));
+        r = _mm256_max_epu8(r,_mm256_loadu_si256((const __m256i*)(max+i)));
+        _mm256_storeu_si256((__m256i*)(max+i),r);
+    }
+    for (; i < HLL_REGISTERS; i += 4) {
+        uint32_t x = hllDenseLoadGroup(registers+(i >> 2)*3);
+        int k;
+
+        for (k = 0; k < 4; k++) {
+            uint8_t r = (x >> (k*HLL_BITS)) & HLL_REGISTER_MAX;
+            if (r > max[i+k]) max[i+k] = r;
+        }
+    }
+}
+
+/* 4个寄存器一组扩展为64位整数，(1023-value)<<52即为双精度的2^-value，值为0的寄存器按掩码
+ * 去掉，4个累加器并行求和。值为0与HLL_Q+1的寄存器用vpcmpeqb+popcnt计数 */
+__attribute__((target("avx2,popcnt")))
+static void hllSummarizeAVX2(const uint8_t *max, hllSummary *s) {
+    const __m256i bias = _mm256_set1_epi64x(1023), zero = _mm256_setzero_si256(),
+                  sat = _mm256_set1_epi8(HLL_Q+1);
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd(),
+            acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+    double lanes[4];
+    long zeros = 0, saturated = 0, i;
+
+#define HLL_AVX2_POW2(acc,v) do { \
+    __m256i w = _mm256_cvtepu8_epi64(v); \
+    __m256i e = _mm256_slli_epi64(_mm256_sub_epi64(bias,w),52); \
+    e = _mm256_andnot_si256(_mm256_cmpeq_epi64(w,zero),e); \
+    acc = _mm256_add_pd(acc,_mm256_castsi256_pd(e)); \
+} while(0)
+
+    for (i = 0; i < HLL_REGISTERS; i += 32) {
+        __m256i r = _mm256_loadu_si256((const __m256i*)(max+i));
+        __m128i lo = _mm256_castsi256_si128(r), hi = _mm256_extracti128_si256(r,1);
+
+        zeros += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(r,zero)));
+        saturated += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(r,sat)));
+        HLL_AVX2_POW2(acc0,lo);
+        HLL_AVX2_POW2(acc1,_mm_srli_si128(lo,4));
+        HLL_AVX2_POW2(acc2,_mm_srli_si128(lo,8));
+        HLL_AVX2_POW2(acc3,_mm_srli_si128(lo,12));
+        HLL_AVX2_POW2(acc0,hi);
+        HLL_AVX2_POW2(acc1,_mm_srli_si128(hi,4));
+        HLL_AVX2_POW2(acc2,_mm_srli_si128(hi,8));
+        HLL_AVX2_POW2(acc3,_mm_srli_si128(hi,12));
+    }
+#undef HLL_AVX2_POW2
+
+    _mm256_storeu_pd(lanes,_mm256_add_pd(_mm256_add_pd(acc0,acc1),_mm256_add_pd(acc2,acc3)));
+    s->sum = lanes[0]+lanes[1]+lanes[2]+lanes[3]-ldexp(saturated,-(HLL_Q+1));
+    s->zeros = zeros;
+    s->saturated = saturated;
+}
+#endif
+
+static hllMergeDenseFunction *mergeDenseKernel = NULL;
+static hllSummarizeFunction *summarizeKernel = NULL;
+
+static void hllSelectKernels(void) {
+    mergeDenseKernel = hllMergeDenseScalar;
+    summarizeKernel = hllSummarizeScalar;
+#ifdef HLL_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        mergeDenseKernel = hllMergeDenseAVX2;
+        summarizeKernel = hllSummarizeAVX2;
+    }
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+ * Cardinality estimation
+ *----------------------------------------------------------------------------*/
+
+/* Ertl, "New cardinality estimation algorithms for HyperLogLog sketches"中修正
+ * 值为0与值为HLL_Q+1的寄存器的两个函数 */
+static double hllSigma(double x) {
+    double y = 1, z = x, zPrime;
+
+    if (x == 1.) return INFINITY;
+    do {
+        x *= x;
+        zPrime = z;
+        z += x*y;
+        y += y;
+    } while(zPrime != z);
+    return z;
+}
+
+static double hllTau(double x) {
+    double y = 1.0, z = 1-x, zPrime;
+
+    if (x == 0. || x == 1.) return 0.;
+    do {
+        x = sqrt(x);
+        zPrime = z;
+        y *= 0.5;
+        z -= pow(1-x,2)*y;
+    } while(zPrime != z);
+    return z/3;
+}
+
+/* alpha*m^2除以修正后的sum(2^-register)，即寄存器的调和平均 */
+static uint64_t hllEstimate(const hllSummary *s) {
+    double m = HLL_REGISTERS, z;
+
+    z = m*hllTau((m-s->saturated)/m);
+    z = ldexp(z,-HLL_Q)+s->sum+m*hllSigma(s->zeros/m);
+    return (uint64_t)llroundl(HLL_ALPHA_INF*m*m/z);
+}
+
+/*-----------------------------------------------------------------------------
+ * Sparse registers
+ *----------------------------------------------------------------------------*/
+
+/* 解码p处的操作码，*value、*runlen为这一段寄存器的值与数量，返回操作码的长度，
+ * 操作码超出end时返回0 */
+static inline int hllSparseDecode(const uint8_t *p, const uint8_t *end, int *value, long *runlen) {
+    if (HLL_SPARSE_IS_ZERO(p)) {
+        *value = 0;
+        *runlen = HLL_SPARSE_ZERO_LEN(p);
+        return 1;
+    } else if (HLL_SPARSE_IS_XZERO(p)) {
+        if (p+1 >= end) return 0;
+        *value = 0;
+        *runlen = HLL_SPARSE_XZERO_LEN(p);
+        return 2;
+    }
+    *value = HLL_SPARSE_VAL_VALUE(p);
+    *runlen = HLL_SPARSE_VAL_LEN(p);
+    return 1;
+}
+
+/* 按寄存器顺序生成稀疏编码，相邻的同值寄存器合并为一个操作码 */
+typedef struct hllSparseWriter {
+    uint8_t *p;             /* 写入位置 */
+    uint8_t *end;           /* 缓冲区末尾 */
+    int value;              /* 尚未写出的一段寄存器的值 */
+    long runlen;            /* 尚未写出的寄存器数量 */
+    int overflow;           /* 缓冲区不足 */
+} hllSparseWriter;
+
+static void hllSparseWriterInit(hllSparseWriter *w, uint8_t *buf, size_t len) {
+    w->p = buf;
+    w->end = buf+len;
+    w->value = 0;
+    w->runlen = 0;
+    w->overflow = 0;
+}
+
+static void hllSparseFlush(hllSparseWriter *w) {
+    while (w->runlen) {
+        long n;
+
+        if (w->value == 0 && w->runlen > HLL_SPARSE_ZERO_MAX_LEN) {
+            n = w->runlen < HLL_SPARSE_XZERO_MAX_LEN ? w->runlen : HLL_SPARSE_XZERO_MAX_LEN;
+            if (w->end-w->p < 2) goto overflow;
+            *w->p++ = HLL_SPARSE_XZERO_BIT | ((n-1) >> 8);
+            *w->p++ = (n-1) & 0xff;
+        } else {
+            if (w->p == w->end) goto overflow;
+            if (w->value == 0) {
+                n = w->runlen;
+                *w->p++ = n-1;
+            } else {
+                n = w->runlen < HLL_SPARSE_VAL_MAX_LEN ? w->runlen : HLL_SPARSE_VAL_MAX_LEN;
+                *w->p++ = HLL_SPARSE_VAL_BIT | ((w->value-1) << 2) | (n-1);
+            }
+        }
+        w->runlen -= n;
+    }
+    return;
+
+overflow:
+    w->overflow = 1;
+    w->runlen = 0;
+}
+
+/* 追加n个值为value的寄存器，value不能超过HLL_SPARSE_VAL_MAX_VALUE */
+static inline void hllSparsePush(hllSparseWriter *w, int value, long n) {
+    if (n == 0) return;
+    if (value != w->value) {
+        hllSparseFlush(w);
+        w->value = value;
+    }
+    w->runlen += n;
+}
+
+/* max[i] = max(max[i], 稀疏编码的第i个寄存器)，编码损坏时返回C_ERR */
+static int hllMergeSparse(uint8_t *max, const uint8_t *p, const uint8_t *end) {
+    long index = 0, runlen;
+    int value, oplen;
+
+    while (p < end) {
+        if ((oplen = hllSparseDecode(p,end,&value,&runlen)) == 0) return C_ERR;
+        if (index+runlen > HLL_REGISTERS) return C_ERR;
+        for (; value && runlen; runlen--, index++) {
+            if (value > max[index]) max[index] = value;
+        }
+        index += runlen;
+        p += oplen;
+    }
+    return index == HLL_REGISTERS ? C_OK : C_ERR;
+}
+
+/* 直接由稀疏编码计算统计，不展开寄存器 */
+static int hllSummarizeSparse(const uint8_t *p, const uint8_t *end, hllSummary *s) {
+    long histo[HLL_SPARSE_VAL_MAX_VALUE+1] = {0}, index = 0, runlen;
+    int value, oplen, j;
+
+    while (p < end) {
+        if ((oplen = hllSparseDecode(p,end,&value,&runlen)) == 0) return C_ERR;
+        index += runlen;
+        histo[value] += runlen;
+        p += oplen;
+    }
+    if (index != HLL_REGISTERS) return C_ERR;
+
+    s->sum = 0;
+    for (j = 1; j <= HLL_SPARSE_VAL_MAX_VALUE; j++) s->sum += ldexp(histo[j],-j);
+    s->zeros = histo[0];
+    s->saturated = 0;
+    return C_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * HyperLogLog objects
+ *----------------------------------------------------------------------------*/
+
+static void hllInitHeader(struct hllhdr *hdr, int encoding) {
+    memcpy(hdr->magic,"HYLL",4);
+    hdr->encoding = encoding;
+    memset(hdr->notused,0,sizeof(hdr->notused));
+    memset(hdr->card,0,sizeof(hdr->card));
+    HLL_INVALIDATE_CACHE(hdr);
+}
+
+/* 新建空的HyperLogLog：所有寄存器为一个XZERO */
+static robj *createHLLObject(void) {
+    sds s = sdsnewlen(NULL,HLL_HDR_SIZE+2);
+    struct hllhdr *hdr = (struct hllhdr*)s;
+
+    hllInitHeader(hdr,HLL_SPARSE);
+    hdr->registers[0] = HLL_SPARSE_XZERO_BIT | ((HLL_REGISTERS-1) >> 8);
+    hdr->registers[1] = (HLL_REGISTERS-1) & 0xff;
+    return createObject(OBJ_STRING,s);
+}
+
+/* 检查o是否为HyperLogLog，不是时回复错误 */
+static int isHLLObjectOrReply(client *c, robj *o) {
+    struct hllhdr *hdr;
+
+    if (checkType(c,o,OBJ_STRING)) return C_ERR;
+    if (!sdsEncodedObject(o) || stringObjectLen(o) < HLL_HDR_SIZE) goto invalid;
+
+    hdr = o->ptr;
+    if (memcmp(hdr->magic,"HYLL",4) != 0 || hdr->encoding > HLL_MAX_ENCODING) goto invalid;
+    if (hdr->encoding == HLL_DENSE && stringObjectLen(o) != HLL_DENSE_SIZE) goto invalid;
+    return C_OK;
+
+invalid:
+    addReplyError(c,"-WRONGTYPE Key is not a valid HyperLogLog string value.");
+    return C_ERR;
+}
+
+/* 把o中的HyperLogLog按寄存器取最大值合并到max中，编码损坏时返回C_ERR */
+static int hllMerge(uint8_t *max, robj *o) {
+    struct hllhdr *hdr = o->ptr;
+
+    if (hdr->encoding == HLL_DENSE) {
+        if (mergeDenseKernel == NULL) hllSelectKernels();
+        mergeDenseKernel(max,hdr->registers);
+        return C_OK;
+    }
+    return hllMergeSparse(max,hdr->registers,(uint8_t*)o->ptr+sdslen(o->ptr));
+}
+
+/* 计算o中HyperLogLog的基数，编码损坏时返回C_ERR */
+static int hllCount(robj *o, uint64_t *card) {
+    struct hllhdr *hdr = o->ptr;
+    hllSummary s;
+
+    if (hdr->encoding == HLL_DENSE) {
+        memset(hll_scratch,0,sizeof(hll_scratch));
+        hllMerge(hll_scratch,o);
+        summarizeKernel(hll_scratch,&s);
+    } else if (hllSummarizeSparse(hdr->registers,(uint8_t*)o->ptr+sdslen(o->ptr),&s) != C_OK) {
+        return C_ERR;
+    }
+    *card = hllEstimate(&s);
+    return C_OK;
+}
+
+/* 由每个寄存器1字节的max生成稠密编码 */
+static sds hllDenseFromRegisters(const uint8_t *max) {
+    sds s = sdsnewlen(SDS_NOINIT,HLL_DENSE_SIZE);
+    struct hllhdr *hdr = (struct hllhdr*)s;
+    long i;
+
+    hllInitHeader(hdr,HLL_DENSE);
+    for (i = 0; i < HLL_REGISTERS; i += 4) {
+        hllDenseStoreGroup(hdr->registers+(i >> 2)*3,
+            (uint32_t)max[i] | ((uint32_t)max[i+1] << 6) |
+            ((uint32_t)max[i+2] << 12) | ((uint32_t)max[i+3] << 18));
+    }
+    return s;
+}
+
+/* 由每个寄存器1字节的max生成稀疏编码，超过hll-sparse-max-bytes或有寄存器的值超过
+ * HLL_SPARSE_VAL_MAX_VALUE时返回NULL */
+static sds hllSparseFromRegisters(const uint8_t *max) {
+    size_t limit = server.hll_sparse_max_bytes < HLL_DENSE_SIZE ? server.hll_sparse_max_bytes : HLL_DENSE_SIZE;
+    sds s;
+    hllSparseWriter w;
+    long i;
+
+    if (limit <= HLL_HDR_SIZE) return NULL;
+    s = sdsnewlen(SDS_NOINIT,limit);
+    hllInitHeader((struct hllhdr*)s,HLL_SPARSE);
+    hllSparseWriterInit(&w,(uint8_t*)s+HLL_HDR_SIZE,limit-HLL_HDR_SIZE);
+    for (i = 0; i < HLL_REGISTERS && !w.overflow; i++) {
+        if (max[i] > HLL_SPARSE_VAL_MAX_VALUE) break;
+        hllSparsePush(&w,max[i],1);
+    }
+    hllSparseFlush(&w);
+    if (i != HLL_REGISTERS || w.overflow) {
+        sdsfree(s);
+        return NULL;
+    }
+    sdssetlen(s,(char*)w.p-s);
+    return sdsRemoveFreeSpace(s);
+}
+
+/* 把稀疏编码转换为稠密编码，编码损坏时返回C_ERR */
+static int hllSparseToDense(robj *o) {
+    struct hllhdr *hdr = o->ptr;
+    sds dense;
+
+    memset(hll_scratch,0,sizeof(hll_scratch));
+    if (hllMergeSparse(hll_scratch,hdr->registers,(uint8_t*)o->ptr+sdslen(o->ptr)) != C_OK)
+        return C_ERR;
+    dense = hllDenseFromRegisters(hll_scratch);
+    sdsfree(o->ptr);
+    o->ptr = dense;
+    return C_OK;
+}
+
+static int hllDenseAdd(uint8_t *registers, const uint32_t *updates, int n) {
+    int j, updated = 0;
+
+    for (j = 0; j < n; j++) {
+        long index = HLL_UPDATE_INDEX(updates[j]);
+        int rank = HLL_UPDATE_RANK(updates[j]);
+
+        if (rank > hllDenseGet(registers,index)) {
+            hllDenseSet(registers,index,rank);
+            updated = 1;
+        }
+    }
+    return updated;
+}
+
+/* 把按寄存器排好序的更新合并到稀疏编码中：遍历一次旧的操作码，生成新的编码。
+ * 新的编码超过hll-sparse-max-bytes或有寄存器的值超过HLL_SPARSE_VAL_MAX_VALUE时转换为
+ * 稠密编码再更新。返回是否有寄存器变化，编码损坏时返回-1 */
+static int hllSparseAdd(robj *o, const uint32_t *updates, int n) {
+    uint8_t *p = (uint8_t*)o->ptr+HLL_HDR_SIZE, *end = (uint8_t*)o->ptr+sdslen(o->ptr);
+    size_t limit = server.hll_sparse_max_bytes;
+    hllSparseWriter w;
+    long index = 0, start, runlen;
+    int value, oplen, updated = 0, j = 0;
+    sds s;
+
+    /* 每个更新最多把一个操作码拆成ZERO/XZERO、VAL、ZERO/XZERO三个，新增不超过5字节 */
+    if (limit > sdslen(o->ptr)+(size_t)n*5+2) limit = sdslen(o->ptr)+(size_t)n*5+2;
+    if (limit <= HLL_HDR_SIZE) goto promote;
+    s = sdsnewlen(SDS_NOINIT,limit);
+    memcpy(s,o->ptr,HLL_HDR_SIZE);
+    hllSparseWriterInit(&w,(uint8_t*)s+HLL_HDR_SIZE,limit-HLL_HDR_SIZE);
+
+    while (p < end) {
+        if ((oplen = hllSparseDecode(p,end,&value,&runlen)) == 0 ||
+            index+runlen > HLL_REGISTERS) goto invalid;
+        start = index;
+        index += runlen;
+        for (; j < n && HLL_UPDATE_INDEX(updates[j]) < (uint32_t)index; j++) {
+            long ui = HLL_UPDATE_INDEX(updates[j]);
+            int rank = HLL_UPDATE_RANK(updates[j]);
+
+            if (rank <= value) continue;
+            if (rank > HLL_SPARSE_VAL_MAX_VALUE) goto overflow;
+            hllSparsePush(&w,value,ui-start);
+            hllSparsePush(&w,rank,1);
+            start = ui+1;
+            updated = 1;
+        }
+        hllSparsePush(&w,value,index-start);
+        if (w.overflow) goto overflow;
+        p += oplen;
+    }
+    if (index != HLL_REGISTERS) goto invalid;
+    hllSparseFlush(&w);
+    if (w.overflow) goto overflow;
+
+    if (!updated) {
+        sdsfree(s);
+        return 0;
+    }
+    sdssetlen(s,(char*)w.p-s);
+    sdsfree(o->ptr);
+    o->ptr = sdsRemoveFreeSpace(s);
+    return 1;
+
+invalid:
+    sdsfree(s);
+    return -1;
+
+overflow:
+    sdsfree(s);
+promote:
+    if (hllSparseToDense(o) != C_OK) return -1;
+    return hllDenseAdd(((struct hllhdr*)o->ptr)->registers,updates,n);
+}
+
+static int qsortCompareUpdates(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* 计算argv[start..argc)中元素的(寄存器, rank)，排序后每个寄存器只保留最大的rank，返回更新的数量 */
+static int hllComputeUpdates(client *c, int start, uint32_t *updates) {
+    int count = c->argc-start, j, n = 0;
+    const uint8_t **keys = zmalloc(sizeof(*keys)*count);
+    size_t *lens = zmalloc(sizeof(*lens)*count);
+    uint64_t *hashes = zmalloc(sizeof(*hashes)*count);
+
+    for (j = 0; j < count; j++) {
+        keys[j] = c->argv[start+j]->ptr;
+        lens[j] = sdslen(c->argv[start+j]->ptr);
+    }
+    wyhash_batch(keys,lens,count,hll_hash_key,hashes);
+    for (j = 0; j < count; j++) {
+        uint64_t hash = hashes[j];
+        /* 最高位之上补一个1，rank最大为HLL_Q+1 */
+        uint64_t bits = (hash >> HLL_P) | ((uint64_t)1 << HLL_Q);
+
+        updates[j] = HLL_UPDATE(hash & HLL_P_MASK,__builtin_ctzll(bits)+1);
+    }
+    zfree(keys);
+    zfree(lens);
+    zfree(hashes);
+
+    qsort(updates,count,sizeof(uint32_t),qsortCompareUpdates);
+    for (j = 0; j < count; j++) {
+        if (j+1 < count && HLL_UPDATE_INDEX(updates[j]) == HLL_UPDATE_INDEX(updates[j+1])) continue;
+        updates[n++] = updates[j];
+    }
+    return n;
+}
+
+/*-----------------------------------------------------------------------------
+ * HyperLogLog Commands
+ *----------------------------------------------------------------------------*/
+
+/* PFADD key [element ...]
+ * 有寄存器变化(或新建了key)时回复1，否则回复0 */
+void pfaddCommand(client *c) {
+    robj *o = lookupKeyWrite(server.db,c->argv[1]);
+    struct hllhdr *hdr;
+    int updated = 0;
+
+    if (o == NULL) {
+        o = createHLLObject();
+        dbAdd(server.db,c->argv[1],o);
+        updated = 1;
+    } else {
+        if (isHLLObjectOrReply(c,o) != C_OK) return;
+        o = dbUnshareStringValue(server.db,c->argv[1],o);
+    }
+
+    if (c->argc > 2) {
+        uint32_t *updates = zmalloc(sizeof(uint32_t)*(c->argc-2));
+        int n = hllComputeUpdates(c,2,updates), ret;
+
+        hdr = o->ptr;
+        if (hdr->encoding == HLL_DENSE)
+            ret = hllDenseAdd(hdr->registers,updates,n);
+        else
+            ret = hllSparseAdd(o,updates,n);
+        zfree(updates);
+        if (ret == -1) {
+            addReplyError(c,invalid_hll_err);
+            return;
+        }
+        updated |= ret;
+    }
+
+    if (updated) HLL_INVALIDATE_CACHE((struct hllhdr*)o->ptr);
+    addReply(c,updated ? shared.cone : shared.czero);
+}
+
+/* PFCOUNT key [key ...]
+ * 单个key时缓存计算结果，直到下一次修改；多个key时合并到hll_scratch中计算并集的基数 */
+void pfcountCommand(client *c) {
+    struct hllhdr *hdr;
+    uint64_t card;
+    hllSummary s;
+    robj *o;
+    int j;
+
+    if (summarizeKernel == NULL) hllSelectKernels();
+
+    if (c->argc == 2) {
+        if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+            isHLLObjectOrReply(c,o) != C_OK) return;
+
+        hdr = o->ptr;
+        if (HLL_VALID_CACHE(hdr)) {
+            card = 0;
+            for (j = 7; j >= 0; j--) card = (card << 8) | hdr->card[j];
+        } else {
+            if (hllCount(o,&card) != C_OK) {
+                addReplyError(c,invalid_hll_err);
+                return;
+            }
+            o = dbUnshareStringValue(server.db,c->argv[1],o);
+            hdr = o->ptr;
+            for (j = 0; j < 8; j++) hdr->card[j] = (card >> (j*8)) & 0xff;
+        }
+        addReplyLongLong(c,(long long)card);
+        return;
+    }
+
+    memset(hll_scratch,0,sizeof(hll_scratch));
+    for (j = 1; j < c->argc; j++) {
+        if ((o = lookupKeyRead(server.db,c->argv[j])) == NULL) continue;
+        if (isHLLObjectOrReply(c,o) != C_OK) return;
+        if (hllMerge(hll_scratch,o) != C_OK) {
+            addReplyError(c,invalid_hll_err);
+            return;
+        }
+    }
+    summarizeKernel(hll_scratch,&s);
+    addReplyLongLong(c,(long long)hllEstimate(&s));
+}
+
+/* PFMERGE destkey [sourcekey ...]
+ * destkey与所有sourcekey的并集保存到destkey，保留destkey的过期时间。
+ * 所有key都是稀疏编码时结果尽量使用稀疏编码 */
+void pfmergeCommand(client *c) {
+    int j, dense = 0;
+    robj *o;
+    sds s = NULL;
+
+    memset(hll_scratch,0,sizeof(hll_scratch));
+    for (j = 1; j < c->argc; j++) {
+        if ((o = lookupKeyRead(server.db,c->argv[j])) == NULL) continue;
+        if (isHLLObjectOrReply(c,o) != C_OK) return;
+        if (((struct hllhdr*)o->ptr)->encoding == HLL_DENSE) dense = 1;
+        if (hllMerge(hll_scratch,o) != C_OK) {
+            addReplyError(c,invalid_hll_err);
+            return;
+        }
+    }
+
+    if (!dense) s = hllSparseFromRegisters(hll_scratch);
+    if (s == NULL) s = hllDenseFromRegisters(hll_scratch);
+
+    if ((o = lookupKeyWrite(server.db,c->argv[1])) == NULL) {
+        dbAdd(server.db,c->argv[1],createObject(OBJ_STRING,s));
+    } else {
+        o = dbUnshareStringValue(server.db,c->argv[1],o);
+        sdsfree(o->ptr);
+        o->ptr = s;
+    }
+    addReply(c,shared.ok);
+}
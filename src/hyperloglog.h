@@ -0,0 +1,17 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_HYPERLOGLOG_H
+#define RESP_SERVER_HYPERLOGLOG_H
+
+#include "server.h"
+
+/* 稀疏编码的HyperLogLog超过该字节数时转换为12KB的稠密编码 */
+#define CONFIG_DEFAULT_HLL_SPARSE_MAX_BYTES 3000
+
+void pfaddCommand(client *c);
+void pfcountCommand(client *c);
+void pfmergeCommand(client *c);
+
+#endif //RESP_SERVER_HYPERLOGLOG_H
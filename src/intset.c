@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2009-2012, Pieter Noordhuis <pcnoordhuis at gmail dot com>
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "intset.h"
+#include "zmalloc.h"
+#include "endianconv.h"
+
+/* Note that these encodings are ordered, so:
+ * INTSET_ENC_INT16 < INTSET_ENC_INT32 < INTSET_ENC_INT64. */
+#define INTSET_ENC_INT16 (sizeof(int16_t))
+#define INTSET_ENC_INT32 (sizeof(int32_t))
+#define INTSET_ENC_INT64 (sizeof(int64_t))
+
+/* Return the required encoding for the provided value. */
+static uint8_t _intsetValueEncoding(int64_t v) {
+    if (v < INT32_MIN || v > INT32_MAX)
+        return INTSET_ENC_INT64;
+    else if (v < INT16_MIN || v > INT16_MAX)
+        return INTSET_ENC_INT32;
+    else
+        return INTSET_ENC_INT16;
+}
+
+/* Return the value at pos, given an encoding. */
+static int64_t _intsetGetEncoded(intset *is, int pos, uint8_t enc) {
+    int64_t v64;
+    int32_t v32;
+    int16_t v16;
+
+    if (enc == INTSET_ENC_INT64) {
+        memcpy(&v64,((int64_t*)is->contents)+pos,sizeof(v64));
+        memrev64ifbe(&v64);
+        return v64;
+    } else if (enc == INTSET_ENC_INT32) {
+        memcpy(&v32,((int32_t*)is->contents)+pos,sizeof(v32));
+        memrev32ifbe(&v32);
+        return v32;
+    } else {
+        memcpy(&v16,((int16_t*)is->contents)+pos,sizeof(v16));
+        memrev16ifbe(&v16);
+        return v16;
+    }
+}
+
+/* Return the value at pos, using the configured encoding. */
+static int64_t _intsetGet(intset *is, int pos) {
+    return _intsetGetEncoded(is,pos,intrev32ifbe(is->encoding));
+}
+
+/* Set the value at pos, using the configured encoding. */
+static void _intsetSet(intset *is, int pos, int64_t value) {
+    uint32_t encoding = intrev32ifbe(is->encoding);
+
+    if (encoding == INTSET_ENC_INT64) {
+        ((int64_t*)is->contents)[pos] = value;
+        memrev64ifbe(((int64_t*)is->contents)+pos);
+    } else if (encoding == INTSET_ENC_INT32) {
+        ((int32_t*)is->contents)[pos] = value;
+        memrev32ifbe(((int32_t*)is->contents)+pos);
+    } else {
+        ((int16_t*)is->contents)[pos] = value;
+        memrev16ifbe(((int16_t*)is->contents)+pos);
+    }
+}
+
+/* Create an empty intset. */
+intset *intsetNew(void) {
+    intset *is = zmalloc(sizeof(intset));
+    is->encoding = intrev32ifbe(INTSET_ENC_INT16);
+    is->length = 0;
+    return is;
+}
+
+/* Resize the intset */
+static intset *intsetResize(intset *is, uint32_t len) {
+    size_t size = (size_t)len*intrev32ifbe(is->encoding);
+    is = zrealloc(is,sizeof(intset)+size);
+    return is;
+}
+
+/* Search for the position of "value". Return 1 when the value was found and
+ * sets "pos" to the position of the value within the intset. Return 0 when
+ * the value is not present in the intset and sets "pos" to the position
+ * where "value" can be inserted. */
+static uint8_t intsetSearch(intset *is, int64_t value, uint32_t *pos) {
+    int min = 0, max = intrev32ifbe(is->length)-1, mid = -1;
+    int64_t cur = -1;
+
+    /* The value can never be found when the set is empty */
+    if (intrev32ifbe(is->length) == 0) {
+        if (pos) *pos = 0;
+        return 0;
+    } else {
+        /* Check for the case where we know we cannot find the value,
+         * but do know the insert position. */
+        if (value > _intsetGet(is,max)) {
+            if (pos) *pos = intrev32ifbe(is->length);
+            return 0;
+        } else if (value < _intsetGet(is,0)) {
+            if (pos) *pos = 0;
+            return 0;
+        }
+    }
+
+    while(max >= min) {
+        mid = ((unsigned int)min + (unsigned int)max) >> 1;
+        cur = _intsetGet(is,mid);
+        if (value > cur) {
+            min = mid+1;
+        } else if (value < cur) {
+            max = mid-1;
+        } else {
+            break;
+        }
+    }
+
+    if (value == cur) {
+        if (pos) *pos = mid;
+        return 1;
+    } else {
+        if (pos) *pos = min;
+        return 0;
+    }
+}
+
+/* Upgrades the intset to a larger encoding and inserts the given integer. */
+static intset *intsetUpgradeAndAdd(intset *is, int64_t value) {
+    uint8_t curenc = intrev32ifbe(is->encoding);
+    uint8_t newenc = _intsetValueEncoding(value);
+    int length = intrev32ifbe(is->length);
+    int prepend = value < 0 ? 1 : 0;
+
+    /* First set new encoding and resize */
+    is->encoding = intrev32ifbe(newenc);
+    is = intsetResize(is,intrev32ifbe(is->length)+1);
+
+    /* Upgrade back-to-front so we don't overwrite values.
+     * Note that the "prepend" variable is used to make sure we have an empty
+     * space at either the beginning or the end of the intset. */
+    while(length--)
+        _intsetSet(is,length+prepend,_intsetGetEncoded(is,length,curenc));
+
+    /* Set the value at the beginning or the end. */
+    if (prepend)
+        _intsetSet(is,0,value);
+    else
+        _intsetSet(is,intrev32ifbe(is->length),value);
+    is->length = intrev32ifbe(intrev32ifbe(is->length)+1);
+    return is;
+}
+
+static void intsetMoveTail(intset *is, uint32_t from, uint32_t to) {
+    void *src, *dst;
+    uint32_t bytes = intrev32ifbe(is->length)-from;
+    uint32_t encoding = intrev32ifbe(is->encoding);
+
+    if (encoding == INTSET_ENC_INT64) {
+        src = (int64_t*)is->contents+from;
+        dst = (int64_t*)is->contents+to;
+        bytes *= sizeof(int64_t);
+    } else if (encoding == INTSET_ENC_INT32) {
+        src = (int32_t*)is->contents+from;
+        dst = (int32_t*)is->contents+to;
+        bytes *= sizeof(int32_t);
+    } else {
+        src = (int16_t*)is->contents+from;
+        dst = (int16_t*)is->contents+to;
+        bytes *= sizeof(int16_t);
+    }
+    memmove(dst,src,bytes);
+}
+
+/* Insert an integer in the intset */
+intset *intsetAdd(intset *is, int64_t value, uint8_t *success) {
+    uint8_t valenc = _intsetValueEncoding(value);
+    uint32_t pos;
+    if (success) *success = 1;
+
+    /* Upgrade encoding if necessary. If we need to upgrade, we know that
+     * this value should be either appended (if > 0) or prepended (if < 0),
+     * because it lies outside the range of existing values. */
+    if (valenc > intrev32ifbe(is->encoding)) {
+        /* This always succeeds, so we don't need to curry *success. */
+        return intsetUpgradeAndAdd(is,value);
+    } else {
+        /* Abort if the value is already present in the set.
+         * This call will populate "pos" with the right position to insert
+         * the value when it cannot be found. */
+        if (intsetSearch(is,value,&pos)) {
+            if (success) *success = 0;
+            return is;
+        }
+
+        is = intsetResize(is,intrev32ifbe(is->length)+1);
+        if (pos < intrev32ifbe(is->length)) intsetMoveTail(is,pos,pos+1);
+    }
+
+    _intsetSet(is,pos,value);
+    is->length = intrev32ifbe(intrev32ifbe(is->length)+1);
+    return is;
+}
+
+/* Delete integer from intset */
+intset *intsetRemove(intset *is, int64_t value, int *success) {
+    uint8_t valenc = _intsetValueEncoding(value);
+    uint32_t pos;
+    if (success) *success = 0;
+
+    if (valenc <= intrev32ifbe(is->encoding) && intsetSearch(is,value,&pos)) {
+        uint32_t len = intrev32ifbe(is->length);
+
+        /* We know we can delete */
+        if (success) *success = 1;
+
+        /* Overwrite value with tail and update length */
+        if (pos < (len-1)) intsetMoveTail(is,pos+1,pos);
+        is = intsetResize(is,len-1);
+        is->length = intrev32ifbe(len-1);
+    }
+    return is;
+}
+
+/* Determine whether a value belongs to this set */
+uint8_t intsetFind(intset *is, int64_t value) {
+    uint8_t valenc = _intsetValueEncoding(value);
+    return valenc <= intrev32ifbe(is->encoding) && intsetSearch(is,value,NULL);
+}
+
+/* Get the value at the given position. When this position is
+ * out of range the function returns 0, when in range it returns 1. */
+uint8_t intsetGet(intset *is, uint32_t pos, int64_t *value) {
+    if (pos < intrev32ifbe(is->length)) {
+        *value = _intsetGet(is,pos);
+        return 1;
+    }
+    return 0;
+}
+
+/* Return intset length */
+uint32_t intsetLen(const intset *is) {
+    return intrev32ifbe(is->length);
+}
+
+/* Return intset blob size in bytes. */
+size_t intsetBlobLen(intset *is) {
+    return sizeof(intset)+(size_t)intrev32ifbe(is->length)*intrev32ifbe(is->encoding);
+}
+
+/* ----------------------------- 交集 ----------------------------------------
+ * 两个intset的交集。两者长度接近时按块归并：SSE2下每次取两边各一个16字节的块，
+ * 将一边的块循环移位后与另一边逐次比较，一次得到块内所有相等的元素，然后前进块中
+ * 最大值较小的一边(相等时两边都前进)；长度相差超过INTSET_GALLOP_RATIO倍时，
+ * 对较小集合的每个元素在较大集合中从上次的位置起倍增步长再二分查找，
+ * 复杂度为O(m*log(n/m))。交集的元素在两边的编码下都能表示，结果使用较小的编码 */
+
+#define INTSET_GALLOP_RATIO 32
+
+/* 标量归并，处理SIMD块之后剩余的元素，以及两边编码不同的情况 */
+static uint32_t intsetIntersectMerge(intset *a, uint32_t i, intset *b, uint32_t j, intset *r, uint32_t k) {
+    uint32_t na = intrev32ifbe(a->length), nb = intrev32ifbe(b->length);
+    uint8_t enca = intrev32ifbe(a->encoding), encb = intrev32ifbe(b->encoding);
+
+    while (i < na && j < nb) {
+        int64_t va = _intsetGetEncoded(a,i,enca), vb = _intsetGetEncoded(b,j,encb);
+        if (va < vb) {
+            i++;
+        } else if (va > vb) {
+            j++;
+        } else {
+            _intsetSet(r,k++,va);
+            i++;
+            j++;
+        }
+    }
+    return k;
+}
+
+/* 倍增查找：small中的每个元素在large中从上次停下的位置起查找 */
+static uint32_t intsetIntersectGallop(intset *small, intset *large, intset *r) {
+    uint32_t ns = intrev32ifbe(small->length), nl = intrev32ifbe(large->length);
+    uint8_t encs = intrev32ifbe(small->encoding), encl = intrev32ifbe(large->encoding);
+    uint32_t i, lo = 0, k = 0;
+
+    for (i = 0; i < ns && lo < nl; i++) {
+        int64_t v = _intsetGetEncoded(small,i,encs);
+        uint32_t step = 1, hi;
+
+        /* 找到第一个不小于v的位置所在的区间(lo, hi] */
+        if (_intsetGetEncoded(large,lo,encl) < v) {
+            while (lo+step < nl && _intsetGetEncoded(large,lo+step,encl) < v) {
+                lo += step;
+                step <<= 1;
+            }
+            hi = lo+step < nl ? lo+step : nl;
+            lo++;
+            while (lo < hi) {
+                uint32_t mid = lo+(hi-lo)/2;
+                if (_intsetGetEncoded(large,mid,encl) < v)
+                    lo = mid+1;
+                else
+                    hi = mid;
+            }
+            if (lo == nl) break;
+        }
+        if (_intsetGetEncoded(large,lo,encl) == v) {
+            _intsetSet(r,k++,v);
+            lo++;
+        }
+    }
+    return k;
+}
+
+#if defined(__SSE2__)
+/* int32块归并：每块4个元素，vb依次循环移位1~3个元素后与va比较，
+ * 一次比较完两块的全部16对元素 */
+static uint32_t intsetIntersect32(const int32_t *a, uint32_t na, const int32_t *b, uint32_t nb,
+                                  int32_t *out, uint32_t *pi, uint32_t *pj) {
+    uint32_t i = 0, j = 0, k = 0;
+    uint32_t na4 = na & ~3U, nb4 = nb & ~3U;
+
+    while (i < na4 && j < nb4) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a+i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b+j));
+        __m128i eq = _mm_cmpeq_epi32(va,vb);
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(0,3,2,1))));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(1,0,3,2))));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(2,1,0,3))));
+        unsigned int mask = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(eq));
+        int32_t amax = a[i+3], bmax = b[j+3];
+
+        while (mask) {
+            out[k++] = a[i+__builtin_ctz(mask)];
+            mask &= mask-1;
+        }
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+    *pi = i;
+    *pj = j;
+    return k;
+}
+
+/* int16块归并：每块8个元素，vb循环移位1~7个元素。movemask_epi8每个元素
+ * 得到2位，只保留偶数位 */
+static uint32_t intsetIntersect16(const int16_t *a, uint32_t na, const int16_t *b, uint32_t nb,
+                                  int16_t *out, uint32_t *pi, uint32_t *pj) {
+    uint32_t i = 0, j = 0, k = 0;
+    uint32_t na8 = na & ~7U, nb8 = nb & ~7U;
+
+#define INTSET_ROT16(v,n) _mm_or_si128(_mm_srli_si128(v,2*(n)),_mm_slli_si128(v,16-2*(n)))
+    while (i < na8 && j < nb8) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a+i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b+j));
+        __m128i eq = _mm_cmpeq_epi16(va,vb);
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,INTSET_ROT16(vb,1)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,INTSET_ROT16(vb,2)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,INTSET_ROT16(vb,3)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,INTSET_ROT16(vb,4)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,INTSET_ROT16(vb,5)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,INTSET_ROT16(vb,6)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,INTSET_ROT16(vb,7)));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq) & 0x5555;
+        int16_t amax = a[i+7], bmax = b[j+7];
+
+        while (mask) {
+            out[k++] = a[i+__builtin_ctz(mask)/2];
+            mask &= mask-1;
+        }
+        if (amax <= bmax) i += 8;
+        if (bmax <= amax) j += 8;
+    }
+#undef INTSET_ROT16
+    *pi = i;
+    *pj = j;
+    return k;
+}
+#endif
+
+/* 返回a与b的交集，为新分配的intset */
+intset *intsetIntersect(intset *a, intset *b) {
+    uint32_t na = intrev32ifbe(a->length), nb = intrev32ifbe(b->length);
+    uint8_t enca = intrev32ifbe(a->encoding), encb = intrev32ifbe(b->encoding);
+    intset *r = intsetNew();
+    uint32_t k = 0;
+
+    r->encoding = intrev32ifbe(enca < encb ? enca : encb);
+    if (na == 0 || nb == 0) return r;
+    r = intsetResize(r,na < nb ? na : nb);
+
+    if (na > nb*(uint64_t)INTSET_GALLOP_RATIO) {
+        k = intsetIntersectGallop(b,a,r);
+    } else if (nb > na*(uint64_t)INTSET_GALLOP_RATIO) {
+        k = intsetIntersectGallop(a,b,r);
+    } else {
+        uint32_t i = 0, j = 0;
+#if defined(__SSE2__)
+        if (enca == encb && enca == INTSET_ENC_INT32)
+            k = intsetIntersect32((int32_t*)a->contents,na,(int32_t*)b->contents,nb,
+                                  (int32_t*)r->contents,&i,&j);
+        else if (enca == encb && enca == INTSET_ENC_INT16)
+            k = intsetIntersect16((int16_t*)a->contents,na,(int16_t*)b->contents,nb,
+                                  (int16_t*)r->contents,&i,&j);
+#endif
+        k = intsetIntersectMerge(a,i,b,j,r,k);
+    }
+
+    r = intsetResize(r,k);
+    r->length = intrev32ifbe(k);
+    return r;
+}
@@ -9,8 +9,11 @@
 #include <locale.h>
 #include <unistd.h>
 #include <sys/syslog.h>
+#include <fcntl.h>
+#include <string.h>
 #include "log.h"
 #include "server.h"
+#include "util.h"
 
 /* This is a safe version of localtime() which contains no locks and is
  * fork() friendly. Even the _r version of localtime() cannot be used safely
@@ -87,7 +90,6 @@ void nolocks_localtime(struct tm *tmp, time_t t, time_t tz, int dst) {
 }
 
 void serverLogRaw(int level, const char *msg) {
-    const int syslogLevelMap[] = { LOG_DEBUG, LOG_INFO, LOG_NOTICE, LOG_WARNING };
     const char *c = ".-*#";
     FILE *fp;
     char buf[64];
@@ -132,6 +134,39 @@ void serverLog(int level, const char *fmt, ...) {
     serverLogRaw(level,msg);
 }
 
+/* Log a fixed message without printf-alike capabilities, in a way that is
+ * safe to call from a signal handler.
+ *
+ * We actually use this only for signals that are not fatal from the point
+ * of view of Redis. Signals that are going to kill the server anyway and
+ * where we need printf-alike features are served by serverLog(). */
+void serverLogFromHandler(int level, const char *msg) {
+    int fd;
+    int log_to_stdout = server.logfile[0] == '\0';
+    char buf[64];
+
+    if ((level&0xff) < server.verbosity) return;
+    fd = serverLogOpenFromHandler();
+    if (fd == -1) return;
+    ll2string(buf,sizeof(buf),getpid());
+    if (write(fd,buf,strlen(buf)) == -1) goto err;
+    if (write(fd,":signal-handler (",17) == -1) goto err;
+    ll2string(buf,sizeof(buf),time(NULL));
+    if (write(fd,buf,strlen(buf)) == -1) goto err;
+    if (write(fd,") ",2) == -1) goto err;
+    if (write(fd,msg,strlen(msg)) == -1) goto err;
+    if (write(fd,"\n",1) == -1) goto err;
+err:
+    if (!log_to_stdout) close(fd);
+}
+
+/* Return a file descriptor for the log usable from a signal handler, the
+ * caller should close it unless it is STDOUT_FILENO. Returns -1 on error. */
+int serverLogOpenFromHandler(void) {
+    if (server.logfile[0] == '\0') return STDOUT_FILENO;
+    return open(server.logfile, O_APPEND|O_CREAT|O_WRONLY, 0644);
+}
+
 /* _serverAssert is needed by dict */
 void _serverAssert(const char *estr, const char *file, int line) {
     fprintf(stderr, "=== ASSERTION FAILED ===");
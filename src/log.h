@@ -27,5 +27,7 @@ void _serverAssert(const char *estr, const char *file, int line);
 #define serverAssert(_e) ((_e)?(void)0 : (_serverAssert(#_e,__FILE__,__LINE__),_exit(1)))
 
 void serverLog(int level, const char *fmt, ...);
+void serverLogFromHandler(int level, const char *msg);
+int serverLogOpenFromHandler(void);
 
 #endif //RESP_SERVER_LOG_H
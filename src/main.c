@@ -5,7 +5,6 @@
 #include <string.h>
 #include "server.h"
 #include "reply.h"
-#include "log.h"
 
 void commandCommand(client *c){
     addReply(c, shared.ok);
@@ -20,42 +19,6 @@ void pingCommand(client *c) {
     addReply(c, shared.pong);
 }
 
-/* 获取客户端参数信息
-效果:
-127.0.0.1:2234> set k1 v1 v2 v3 v4
-"set command"
-日志信息:
-yukino@yukino:~/project/resp-server$ ./resp-server
-376658:09 May 2023 15:20:37.621 # argv[0]: set
-376658:09 May 2023 15:20:37.622 # argv[1]: k1
-376658:09 May 2023 15:20:37.622 # argv[2]: v1
-376658:09 May 2023 15:20:37.622 # argv[3]: v2
-376658:09 May 2023 15:20:37.622 # argv[4]: v3
-376658:09 May 2023 15:20:37.622 # argv[5]: v4
- * */
-void setCommand(client *c) {
-    int j;
-
-    /* 打印命令行参数 */
-    for (j = 0; j < c->argc; j++) {
-        serverLog(LL_WARNING, "argv[%d]: %s", j, c->argv[j]->ptr);
-    }
-
-    /* 向客户端回复字符串 */
-    addReplyBulk(c, createObject(OBJ_STRING,sdsnew(
-            "set command")));
-}
-
-/* 回复简单字符串
-效果:
-127.0.0.1:2234> get
-"get command"
- * */
-void getCommand(client *c) {
-    addReplyBulk(c, createObject(OBJ_STRING,sdsnew(
-            "get command")));
-}
-
 /* 回复数字数组
 效果:
 127.0.0.1:2234> test
@@ -97,12 +60,11 @@ void testCommand1(client *c) {
 如果这个值为0，那么不做检查
 如果这个值大于0，需要相等
 注意：命令的名字本身也是一个参数
+GET/SET/DEL/MGET/MSET等键空间命令由服务端内置，这里的同名命令会覆盖内置实现
  * */
 respCommand commandTable[] = {
         {"command", commandCommand, -1},
         {"ping", pingCommand, 0},
-        {"set",setCommand,0},
-        {"get", getCommand, 0},
         {"test", testCommand, 0},
         {"test1", testCommand1, 0},
 };
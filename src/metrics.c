@@ -0,0 +1,328 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 可选的Prometheus指标端口。在server.el上注册一个极简的HTTP/1.1侦听器，
+// 以Prometheus文本格式输出客户端数量、命令统计、命令耗时直方图、流量、内存及事件循环耗时。
+// 指标按阶段增量渲染: 每次可写事件只渲染一小段并写入套接字，避免一次抓取长时间阻塞事件循环。
+
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include "server.h"
+#include "metrics.h"
+#include "connection.h"
+#include "zmalloc.h"
+#include "error.h"
+#include "log.h"
+#include "db.h"
+
+/* 渲染阶段 */
+#define METRICS_STAGE_SERVER 0      /* HTTP响应头与全局指标 */
+#define METRICS_STAGE_CMD_CALLS 1   /* 每个命令的调用次数 */
+#define METRICS_STAGE_CMD_LATENCY 2 /* 每个命令的耗时直方图 */
+#define METRICS_STAGE_DONE 3
+
+/* 每一步渲染的命令数量，直方图每个命令约30行 */
+#define METRICS_CALLS_PER_STEP 16
+#define METRICS_HISTOGRAMS_PER_STEP 2
+
+typedef struct metricsClient {
+    connection *conn;
+    sds querybuf;       /* HTTP请求 */
+    sds buf;            /* 待发送的响应 */
+    size_t sentlen;     /* buf中已发送的字节数 */
+    int stage;          /* 当前渲染阶段 */
+    dictIterator *di;   /* 命令表迭代器，跨事件保存渲染进度 */
+    time_t ctime;       /* 连接建立时间 */
+    listNode *node;     /* 在server.metrics_clients中的节点 */
+} metricsClient;
+
+static void freeMetricsClient(metricsClient *mc) {
+    listDelNode(server.metrics_clients,mc->node);
+    if (mc->di) dictReleaseIterator(mc->di);
+    sdsfree(mc->querybuf);
+    sdsfree(mc->buf);
+    connClose(mc->conn);
+    zfree(mc);
+}
+
+/* 输出一个直方图的所有样本，bucket上界由微秒转换为秒 */
+static sds metricsCatHistogram(sds s, const char *name, const char *labels,
+                               latencyHistogram *h)
+{
+    long long cumulative = 0;
+    int j;
+
+    for (j = 0; j < LATENCY_HISTOGRAM_BUCKETS-1; j++) {
+        cumulative += h->buckets[j];
+        s = sdscatprintf(s,"%s_bucket{%s%sle=\"%g\"} %lld\n",
+                         name,labels,labels[0] ? "," : "",
+                         (double)(1LL<<j)/1000000,cumulative);
+    }
+    s = sdscatprintf(s,"%s_bucket{%s%sle=\"+Inf\"} %lld\n",
+                     name,labels,labels[0] ? "," : "",h->count);
+    if (labels[0]) {
+        s = sdscatprintf(s,"%s_sum{%s} %.6f\n",name,labels,(double)h->sum/1000000);
+        s = sdscatprintf(s,"%s_count{%s} %lld\n",name,labels,h->count);
+    } else {
+        s = sdscatprintf(s,"%s_sum %.6f\n",name,(double)h->sum/1000000);
+        s = sdscatprintf(s,"%s_count %lld\n",name,h->count);
+    }
+    return s;
+}
+
+static sds metricsCatServer(sds s) {
+    s = sdscat(s,"HTTP/1.1 200 OK\r\n"
+                 "Content-Type: text/plain; version=0.0.4\r\n"
+                 "Connection: close\r\n\r\n");
+    s = sdscatprintf(s,
+        "# TYPE resp_uptime_seconds gauge\n"
+        "resp_uptime_seconds %lld\n"
+        "# TYPE resp_connected_clients gauge\n"
+        "resp_connected_clients %lu\n"
+        "# TYPE resp_blocked_clients gauge\n"
+        "resp_blocked_clients %lu\n"
+        "# TYPE resp_connections_received_total counter\n"
+        "resp_connections_received_total %lld\n"
+        "# TYPE resp_commands_processed_total counter\n"
+        "resp_commands_processed_total %lld\n"
+        "# TYPE resp_instantaneous_ops_per_sec gauge\n"
+        "resp_instantaneous_ops_per_sec %lld\n"
+        "# TYPE resp_net_input_bytes_total counter\n"
+        "resp_net_input_bytes_total %lld\n"
+        "# TYPE resp_net_output_bytes_total counter\n"
+        "resp_net_output_bytes_total %lld\n"
+        "# TYPE resp_memory_used_bytes gauge\n"
+        "resp_memory_used_bytes %zu\n"
+        "# TYPE resp_memory_rss_bytes gauge\n"
+        "resp_memory_rss_bytes %zu\n"
+        "# TYPE resp_keys gauge\n"
+        "resp_keys %lu\n"
+        "# TYPE resp_expires gauge\n"
+        "resp_expires %lu\n"
+        "# TYPE resp_expired_keys_total counter\n"
+        "resp_expired_keys_total %lld\n"
+        "# TYPE resp_expired_stale_percent gauge\n"
+        "resp_expired_stale_percent %.2f\n"
+        "# TYPE resp_expire_cycle_time_cap_reached_total counter\n"
+        "resp_expire_cycle_time_cap_reached_total %lld\n"
+        "# TYPE resp_expire_cycle_cpu_seconds_total counter\n"
+        "resp_expire_cycle_cpu_seconds_total %.6f\n"
+        "# TYPE resp_memory_max_bytes gauge\n"
+        "resp_memory_max_bytes %lld\n"
+        "# TYPE resp_evicted_keys_total counter\n"
+        "resp_evicted_keys_total %lld\n"
+        "# TYPE resp_keyspace_hits_total counter\n"
+        "resp_keyspace_hits_total %lld\n"
+        "# TYPE resp_keyspace_misses_total counter\n"
+        "resp_keyspace_misses_total %lld\n"
+        "# TYPE resp_admission_rejected_total counter\n"
+        "resp_admission_rejected_total %lld\n",
+        (long long)(server.unixtime - server.stat_starttime),
+        listLength(server.clients),
+        listLength(server.blocked_clients),
+        server.stat_numconnections,
+        server.stat_numcommands,
+        getInstantaneousMetric(STATS_METRIC_COMMAND),
+        server.stat_net_input_bytes,
+        server.stat_net_output_bytes,
+        zmalloc_used_memory(),
+        server.stat_rss,
+        dictSize(server.db->dict),
+        dictSize(server.db->expires),
+        server.stat_expiredkeys,
+        server.stat_expired_stale_perc,
+        server.stat_expired_time_cap_reached_count,
+        (double)server.stat_expire_cycle_time_used/1000000,
+        server.maxmemory,
+        server.stat_evictedkeys,
+        server.stat_keyspace_hits,
+        server.stat_keyspace_misses,
+        server.stat_admission_rejected);
+    s = sdscat(s,"# TYPE resp_event_loop_duration_seconds histogram\n");
+    return metricsCatHistogram(s,"resp_event_loop_duration_seconds","",
+                               &server.el_latency);
+}
+
+/* 渲染下一段指标到mc->buf */
+static void metricsRenderStep(metricsClient *mc) {
+    dictEntry *de;
+    int n;
+
+    switch (mc->stage) {
+    case METRICS_STAGE_SERVER:
+        mc->buf = metricsCatServer(mc->buf);
+        mc->buf = sdscat(mc->buf,"# TYPE resp_command_calls_total counter\n");
+        mc->di = dictGetSafeIterator(server.commands);
+        mc->stage = METRICS_STAGE_CMD_CALLS;
+        break;
+    case METRICS_STAGE_CMD_CALLS:
+        for (n = 0; n < METRICS_CALLS_PER_STEP; n++) {
+            if ((de = dictNext(mc->di)) == NULL) break;
+            respCommand *cmd = dictGetVal(de);
+            mc->buf = sdscatprintf(mc->buf,"resp_command_calls_total{cmd=\"%s\"} %lld\n",
+                                   cmd->name,cmd->latency.count);
+        }
+        if (de == NULL) {
+            dictReleaseIterator(mc->di);
+            mc->di = dictGetSafeIterator(server.commands);
+            mc->buf = sdscat(mc->buf,"# TYPE resp_command_duration_seconds histogram\n");
+            mc->stage = METRICS_STAGE_CMD_LATENCY;
+        }
+        break;
+    case METRICS_STAGE_CMD_LATENCY:
+        for (n = 0; n < METRICS_HISTOGRAMS_PER_STEP; ) {
+            if ((de = dictNext(mc->di)) == NULL) break;
+            respCommand *cmd = dictGetVal(de);
+            char labels[128];
+
+            if (cmd->latency.count == 0) continue;
+            snprintf(labels,sizeof(labels),"cmd=\"%s\"",cmd->name);
+            mc->buf = metricsCatHistogram(mc->buf,"resp_command_duration_seconds",
+                                          labels,&cmd->latency);
+            n++;
+        }
+        if (de == NULL) {
+            dictReleaseIterator(mc->di);
+            mc->di = NULL;
+            mc->stage = METRICS_STAGE_DONE;
+        }
+        break;
+    }
+}
+
+/* 可写事件: 发送已渲染的数据，发送完毕后渲染下一段，全部发送完毕后关闭连接 */
+static void metricsWriteHandler(eventLoop *el, int fd, void *clientData, int mask) {
+    metricsClient *mc = clientData;
+    int nwritten;
+    UNUSED(el);
+    UNUSED(fd);
+    UNUSED(mask);
+
+    if (mc->sentlen == sdslen(mc->buf)) {
+        if (mc->stage == METRICS_STAGE_DONE) {
+            freeMetricsClient(mc);
+            return;
+        }
+        sdsclear(mc->buf);
+        mc->sentlen = 0;
+        metricsRenderStep(mc);
+    }
+
+    nwritten = connWrite(mc->conn,mc->buf+mc->sentlen,sdslen(mc->buf)-mc->sentlen);
+    if (nwritten == -1) {
+        if (connGetState(mc->conn) == CONN_STATE_CONNECTED) return;
+        freeMetricsClient(mc);
+        return;
+    }
+    mc->sentlen += nwritten;
+    server.stat_net_output_bytes += nwritten;
+}
+
+/* 读取HTTP请求，只处理"GET /metrics"，其余返回404 */
+static void metricsReadHandler(eventLoop *el, int fd, void *clientData, int mask) {
+    metricsClient *mc = clientData;
+    size_t qblen = sdslen(mc->querybuf);
+    int nread;
+    UNUSED(el);
+    UNUSED(mask);
+
+    mc->querybuf = sdsMakeRoomFor(mc->querybuf,PROTO_IOBUF_LEN);
+    nread = connRead(mc->conn,mc->querybuf+qblen,PROTO_IOBUF_LEN);
+    if (nread == -1 && connGetState(mc->conn) == CONN_STATE_CONNECTED) return;
+    if (nread <= 0) {
+        freeMetricsClient(mc);
+        return;
+    }
+    sdsIncrLen(mc->querybuf,nread);
+    server.stat_net_input_bytes += nread;
+
+    if (strstr(mc->querybuf,"\r\n\r\n") == NULL) {
+        if (sdslen(mc->querybuf) > METRICS_MAX_REQUEST_LEN) freeMetricsClient(mc);
+        return;
+    }
+
+    if (strncmp(mc->querybuf,"GET /metrics ",13) != 0 &&
+        strncmp(mc->querybuf,"GET / ",6) != 0)
+    {
+        mc->buf = sdscat(mc->buf,"HTTP/1.1 404 Not Found\r\n"
+                                 "Content-Length: 0\r\n"
+                                 "Connection: close\r\n\r\n");
+        mc->stage = METRICS_STAGE_DONE;
+    }
+    deleteFileEvent(server.el,fd,EVENT_READABLE);
+    if (createFileEvent(server.el,fd,EVENT_WRITABLE,metricsWriteHandler,mc) != ERROR_SUCCESS)
+        freeMetricsClient(mc);
+}
+
+static void metricsAcceptHandler(eventLoop *el, int fd, void *clientData, int mask) {
+    int cfd, max = MAX_ACCEPTS_PER_CALL;
+    metricsClient *mc;
+    UNUSED(clientData);
+    UNUSED(mask);
+
+    while(max--) {
+        cfd = genericAccept(fd,NULL,NULL);
+        if (cfd == -1) return;
+
+        mc = zmalloc(sizeof(*mc));
+        mc->conn = connCreateAcceptedSocket(cfd);
+        mc->querybuf = sdsempty();
+        mc->buf = sdsempty();
+        mc->sentlen = 0;
+        mc->stage = METRICS_STAGE_SERVER;
+        mc->di = NULL;
+        mc->ctime = server.unixtime;
+        listAddNodeTail(server.metrics_clients,mc);
+        mc->node = listLast(server.metrics_clients);
+        mc->conn->state = CONN_STATE_CONNECTED;
+        connNonBlock(mc->conn);
+        if (createFileEvent(el,cfd,EVENT_READABLE,metricsReadHandler,mc) != ERROR_SUCCESS) {
+            serverLog(LL_WARNING,"Error registering fd event for the new metrics client.");
+            freeMetricsClient(mc);
+            return;
+        }
+    }
+}
+
+/* 由serverCron调用，关闭建立超过METRICS_CLIENT_TIMEOUT秒的连接，避免不发送请求或
+ * 不读取响应的对端一直占用文件描述符。连接按建立时间排序，遇到未超时的连接即可停止 */
+void metricsCron(void) {
+    listNode *ln;
+
+    while ((ln = listFirst(server.metrics_clients)) != NULL) {
+        metricsClient *mc = listNodeValue(ln);
+
+        if (server.unixtime - mc->ctime <= METRICS_CLIENT_TIMEOUT) break;
+        serverLog(LL_VERBOSE,"Closing idle metrics client.");
+        freeMetricsClient(mc);
+    }
+}
+
+/* 修改指标端口，0代表关闭。已建立的抓取连接不受影响 */
+int metricsSetPort(int port) {
+    if (server.metrics_fd != -1) {
+        deleteFileEvent(server.el,server.metrics_fd,EVENT_READABLE);
+        close(server.metrics_fd);
+        server.metrics_fd = -1;
+    }
+    server.metrics_port = port;
+    if (port == 0) return C_OK;
+
+    server.metrics_fd = tcpServer(port,server.tcpBacklog);
+    if (server.metrics_fd == -1) {
+        serverLog(LL_WARNING,"Could not create metrics server TCP listening socket on port %d.",port);
+        server.metrics_port = 0;
+        return C_ERR;
+    }
+    if (createFileEvent(server.el,server.metrics_fd,EVENT_READABLE,
+                        metricsAcceptHandler,NULL) != ERROR_SUCCESS)
+    {
+        close(server.metrics_fd);
+        server.metrics_fd = -1;
+        server.metrics_port = 0;
+        return C_ERR;
+    }
+    serverLog(LL_NOTICE,"Metrics server listening on port %d.",port);
+    return C_OK;
+}
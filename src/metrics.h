@@ -0,0 +1,35 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_METRICS_H
+#define RESP_SERVER_METRICS_H
+
+#define CONFIG_DEFAULT_METRICS_PORT 0
+
+/* Latency histograms use power of two buckets: bucket 'i' counts the samples
+ * <= 2^i microseconds, the last bucket is +Inf. 24 buckets cover up to ~4s. */
+#define LATENCY_HISTOGRAM_BUCKETS 24
+
+#define METRICS_MAX_REQUEST_LEN (1024*8)
+#define METRICS_CLIENT_TIMEOUT 10   /* 秒，连接建立后超过该时间仍未完成抓取则关闭 */
+
+typedef struct latencyHistogram {
+    long long buckets[LATENCY_HISTOGRAM_BUCKETS]; /* Not cumulative. */
+    long long count;
+    long long sum;                                /* Microseconds. */
+} latencyHistogram;
+
+static inline void latencyHistogramAdd(latencyHistogram *h, long long us) {
+    int idx = us <= 1 ? 0 : 64 - __builtin_clzll((unsigned long long)us-1);
+
+    if (idx > LATENCY_HISTOGRAM_BUCKETS-1) idx = LATENCY_HISTOGRAM_BUCKETS-1;
+    h->buckets[idx]++;
+    h->count++;
+    h->sum += us;
+}
+
+int metricsSetPort(int port);
+void metricsCron(void);
+
+#endif //RESP_SERVER_METRICS_H
@@ -33,6 +33,15 @@
 #include "object.h"
 #include "util.h"
 #include "log.h"
+#include "reply.h"
+#include "evict.h"
+#include "listpack.h"
+#include "quicklist.h"
+#include "intset.h"
+#include "roaring.h"
+#include "stream.h"
+#include "timeseries.h"
+#include "t_vector.h"
 #include <math.h>
 #include <ctype.h>
 #include <unistd.h>
@@ -49,6 +58,7 @@ robj *createObject(int type, void *ptr) {
     o->encoding = OBJ_ENCODING_RAW;
     o->ptr = ptr;
     o->refcount = 1;
+    initObjectAccessTime(o);
     return o;
 }
 
@@ -70,6 +80,7 @@ robj *createEmbeddedStringObject(const char *ptr, size_t len) {
     o->encoding = OBJ_ENCODING_EMBSTR;
     o->ptr = sh+1;
     o->refcount = 1;
+    initObjectAccessTime(o);
 
     sh->len = len;
     sh->alloc = len;
@@ -99,7 +110,192 @@ robj *createStringObject(const char *ptr, size_t len) {
         return createRawStringObject(ptr,len);
 }
 
+/* 使用LRU/LFU淘汰策略时，键空间中的每个值都需要独立的访问信息，不能使用共享整数与标记指针 */
+static int valueObjectsCanBeShared(void) {
+    return server.maxmemory == 0 ||
+           !(server.maxmemory_policy & MAXMEMORY_FLAG_NO_SHARED_INTEGERS);
+}
+
+static robj *createTaggedIntObject(long long value) {
+    return (robj*)(((uintptr_t)value << 2) | OBJ_TAG_INT);
+}
+
+/* 将不超过OBJ_TAG_STR_MAX字节的字符串编码为标记指针 */
+robj *createTaggedStringObject(const char *ptr, size_t len) {
+    uintptr_t word = (len << 2) | OBJ_TAG_STR;
+    size_t j;
+
+    serverAssert(len <= OBJ_TAG_STR_MAX);
+    for (j = 0; j < len; j++)
+        word |= (uintptr_t)(unsigned char)ptr[j] << (8*(j+1));
+    return (robj*)word;
+}
+
+/* 将标记的值写入buf，返回长度。整数需要LONG_STR_SIZE字节的buf */
+size_t taggedObjectToString(robj *o, char *buf, size_t len) {
+    size_t j, n;
+
+    if (objIsTaggedInt(o)) return ll2string(buf,len,objTaggedInt(o));
+    n = objTaggedStrLen(o);
+    serverAssert(n <= len);
+    for (j = 0; j < n; j++)
+        buf[j] = (char)((uintptr_t)o >> (8*(j+1)));
+    return n;
+}
+
+/* Create a string object from a long long value. When possible returns a
+ * shared integer object, or at least an integer encoded one.
+ *
+ * If valueobj is non zero, the function avoids returning a a shared
+ * integer, because the object is going to be used as value in the key
+ * space, where the LRU field of the object must be private. */
+robj *createStringObjectFromLongLongWithOptions(long long value, int valueobj) {
+    robj *o;
+
+    if (!valueobj && value >= 0 && value < OBJ_SHARED_INTEGERS) {
+        o = shared.integers[value];
+    } else {
+        if (value >= LONG_MIN && value <= LONG_MAX) {
+            o = createObject(OBJ_STRING, NULL);
+            o->encoding = OBJ_ENCODING_INT;
+            o->ptr = (void*)((long)value);
+        } else {
+            o = createObject(OBJ_STRING,sdsfromlonglong(value));
+        }
+    }
+    return o;
+}
+
+robj *createStringObjectFromLongLong(long long value) {
+    return createStringObjectFromLongLongWithOptions(value,0);
+}
+
+/* Create a string object from a long long value according to the specified
+ * flag. When an LRU/LFU maxmemory policy is used shared integers are
+ * avoided: the object is going to be stored as a value in the keyspace,
+ * where it needs a private LRU field. Otherwise the value is encoded in
+ * a tagged pointer if it fits in 62 bits, without allocation. */
+robj *createStringObjectFromLongLongForValue(long long value) {
+    if (!valueObjectsCanBeShared())
+        return createStringObjectFromLongLongWithOptions(value,1);
+    if (value >= OBJ_TAG_INT_MIN && value <= OBJ_TAG_INT_MAX)
+        return createTaggedIntObject(value);
+    return createStringObjectFromLongLongWithOptions(value,0);
+}
 
+/* Duplicate a string object, with the guarantee that the returned object
+ * has the same encoding as the original one.
+ *
+ * This function also guarantees that duplicating a small integer object
+ * (or a string object that contains a representation of a small integer)
+ * will always result in a fresh object that is unshared (refcount == 1).
+ *
+ * The resulting object always has refcount set to 1. */
+robj *dupStringObject(const robj *o) {
+    robj *d;
+
+    if (objIsTaggedInt(o))
+        return createStringObjectFromLongLongWithOptions(objTaggedInt(o),1);
+    if (objIsTagged(o)) {
+        char buf[OBJ_TAG_STR_MAX];
+
+        return createEmbeddedStringObject(buf,taggedObjectToString((robj*)o,buf,sizeof(buf)));
+    }
+    serverAssert(o->type == OBJ_STRING);
+
+    switch(o->encoding) {
+    case OBJ_ENCODING_RAW:
+        return createRawStringObject(o->ptr,sdslen(o->ptr));
+    case OBJ_ENCODING_EMBSTR:
+        return createEmbeddedStringObject(o->ptr,sdslen(o->ptr));
+    case OBJ_ENCODING_INT:
+        d = createObject(OBJ_STRING, NULL);
+        d->encoding = OBJ_ENCODING_INT;
+        d->ptr = o->ptr;
+        return d;
+    default:
+        serverPanic("Wrong encoding.");
+        break;
+    }
+}
+
+robj *createQuicklistObject(void) {
+    quicklist *l = quicklistCreate();
+    robj *o = createObject(OBJ_LIST,l);
+    o->encoding = OBJ_ENCODING_QUICKLIST;
+    return o;
+}
+
+robj *createHashObject(void) {
+    unsigned char *lp = lpNew();
+    robj *o = createObject(OBJ_HASH, lp);
+    o->encoding = OBJ_ENCODING_LISTPACK;
+    return o;
+}
+
+robj *createSetObject(void) {
+    dict *d = dictCreate(&setDictType,NULL);
+    robj *o = createObject(OBJ_SET,d);
+    o->encoding = OBJ_ENCODING_HT;
+    return o;
+}
+
+robj *createIntsetObject(void) {
+    intset *is = intsetNew();
+    robj *o = createObject(OBJ_SET,is);
+    o->encoding = OBJ_ENCODING_INTSET;
+    return o;
+}
+
+robj *createZsetObject(void) {
+    zset *zs = zmalloc(sizeof(*zs));
+    robj *o;
+
+    zs->dict = dictCreate(&zsetDictType,NULL);
+    zs->zbt = zbtCreate();
+    o = createObject(OBJ_ZSET,zs);
+    o->encoding = OBJ_ENCODING_BTREE;
+    return o;
+}
+
+robj *createZsetListpackObject(void) {
+    unsigned char *lp = lpNew();
+    robj *o = createObject(OBJ_ZSET,lp);
+    o->encoding = OBJ_ENCODING_LISTPACK;
+    return o;
+}
+
+robj *createRoaringObject(void) {
+    robj *o = createObject(OBJ_ROARING,roaringNew());
+    o->encoding = OBJ_ENCODING_ROARING;
+    return o;
+}
+
+robj *createStreamObject(void) {
+    robj *o = createObject(OBJ_STREAM,streamNew());
+    o->encoding = OBJ_ENCODING_STREAM;
+    return o;
+}
+
+robj *createTimeseriesObject(size_t chunk_size) {
+    robj *o = createObject(OBJ_TIMESERIES,tsNew(chunk_size));
+    o->encoding = OBJ_ENCODING_GORILLA;
+    return o;
+}
+
+robj *createVectorObject(uint32_t dim, int type, int metric, uint32_t M, uint32_t ef_construction) {
+    robj *o = createObject(OBJ_VECTOR,vectorSetNew(dim,type,metric,M,ef_construction));
+    o->encoding = OBJ_ENCODING_HNSW;
+    return o;
+}
+
+void freeListObject(robj *o) {
+    if (o->encoding == OBJ_ENCODING_QUICKLIST) {
+        quicklistRelease(o->ptr);
+    } else {
+        serverPanic("Unknown list encoding type");
+    }
+}
 
 void freeSetObject(robj *o) {
     switch (o->encoding) {
@@ -114,23 +310,316 @@ void freeSetObject(robj *o) {
     }
 }
 
+void freeZsetObject(robj *o) {
+    zset *zs;
+    switch (o->encoding) {
+    case OBJ_ENCODING_BTREE:
+        zs = o->ptr;
+        dictRelease(zs->dict);
+        zbtFree(zs->zbt);
+        zfree(zs);
+        break;
+    case OBJ_ENCODING_LISTPACK:
+        lpFree(o->ptr);
+        break;
+    default:
+        serverPanic("Unknown sorted set encoding");
+    }
+}
+
+void freeHashObject(robj *o) {
+    switch (o->encoding) {
+    case OBJ_ENCODING_HT:
+        dictRelease((dict*) o->ptr);
+        break;
+    case OBJ_ENCODING_LISTPACK:
+        lpFree(o->ptr);
+        break;
+    default:
+        serverPanic("Unknown hash encoding type");
+        break;
+    }
+}
+
+void freeRoaringObject(robj *o) {
+    if (o->encoding == OBJ_ENCODING_ROARING) {
+        roaringFree(o->ptr);
+    } else {
+        serverPanic("Unknown roaring bitmap encoding");
+    }
+}
+
+void freeStreamObject(robj *o) {
+    if (o->encoding == OBJ_ENCODING_STREAM) {
+        freeStream(o->ptr);
+    } else {
+        serverPanic("Unknown stream encoding");
+    }
+}
+
+void freeTimeseriesObject(robj *o) {
+    if (o->encoding == OBJ_ENCODING_GORILLA) {
+        tsFree(o->ptr);
+    } else {
+        serverPanic("Unknown time series encoding");
+    }
+}
+
+void freeVectorObject(robj *o) {
+    if (o->encoding == OBJ_ENCODING_HNSW) {
+        vectorSetFree(o->ptr);
+    } else {
+        serverPanic("Unknown vector encoding");
+    }
+}
+
 void freeStringObject(robj *o) {
     if (o->encoding == OBJ_ENCODING_RAW) {
         sdsfree(o->ptr);
     }
 }
 
+void incrRefCount(robj *o) {
+    if (objIsTagged(o)) return;
+    if (o->refcount < OBJ_FIRST_SPECIAL_REFCOUNT) {
+        o->refcount++;
+    } else {
+        if (o->refcount == OBJ_SHARED_REFCOUNT) {
+            /* Nothing to do: this refcount is immutable. */
+        } else if (o->refcount == OBJ_STATIC_REFCOUNT) {
+            serverPanic("You tried to retain an object allocated in the stack");
+        }
+    }
+}
+
 void decrRefCount(robj *o) {
+    if (objIsTagged(o)) return;
     if (o->refcount == 1) {
         switch(o->type) {
             case OBJ_STRING: freeStringObject(o); break;
+            case OBJ_LIST: freeListObject(o); break;
+            case OBJ_SET: freeSetObject(o); break;
+            case OBJ_ZSET: freeZsetObject(o); break;
+            case OBJ_HASH: freeHashObject(o); break;
+            case OBJ_ROARING: freeRoaringObject(o); break;
+            case OBJ_STREAM: freeStreamObject(o); break;
+            case OBJ_TIMESERIES: freeTimeseriesObject(o); break;
+            case OBJ_VECTOR: freeVectorObject(o); break;
             default: break;
         }
         zfree(o);
+    } else {
+        if (o->refcount <= 0) serverPanic("decrRefCount against refcount <= 0");
+        if (o->refcount != OBJ_SHARED_REFCOUNT) o->refcount--;
+    }
+}
+
+/* This variant of decrRefCount() gets its argument as void, and is useful
+ * as free method in data structures that expect a 'void free_object(void*)'
+ * prototype for the free method. */
+void decrRefCountVoid(void *o) {
+    decrRefCount(o);
+}
+
+/* Optimize the SDS string inside the string object to require little space,
+ * in case there is more than 10% of free space at the end of the SDS
+ * string. This happens because SDS strings tend to overallocate to avoid
+ * wasting too much time in allocations when appending to the string. */
+void trimStringObjectIfNeeded(robj *o) {
+    if (o->encoding == OBJ_ENCODING_RAW &&
+        sdsavail(o->ptr) > sdslen(o->ptr)/10)
+    {
+        o->ptr = sdsRemoveFreeSpace(o->ptr);
+    }
+}
+
+/* Try to encode a string object in order to save space */
+robj *tryObjectEncoding(robj *o) {
+    long value;
+    sds s;
+    size_t len;
+
+    if (objIsTagged(o)) return o;
+    serverAssert(o->type == OBJ_STRING);
+    s = o->ptr;
+
+    /* We try some specialized encoding only for objects that are
+     * RAW or EMBSTR encoded, in other words objects that are still
+     * in represented by an actually array of chars. */
+    if (!sdsEncodedObject(o)) return o;
+
+    /* It's not safe to encode shared objects: shared objects can be shared
+     * everywhere in the "object space" of Redis and may end in places where
+     * they are not handled. We handle them only as values in the keyspace. */
+     if (o->refcount > 1) return o;
+
+    /* Check if we can represent this string as a long integer.
+     * Note that we are sure that a string larger than 20 chars is not
+     * representable as a 32 nor 64 bit integer. */
+    len = sdslen(s);
+    if (len <= 20 && string2l(s,len,&value)) {
+        /* This object is encodable as a long. Try to encode it in a tagged
+         * pointer, that needs no allocation at all. Note that we avoid it
+         * when maxmemory is used with an LRU/LFU policy, because every
+         * object needs to have a private LRU field for the LRU algorithm
+         * to work well. */
+        if (valueObjectsCanBeShared() &&
+            value >= OBJ_TAG_INT_MIN &&
+            value <= OBJ_TAG_INT_MAX)
+        {
+            decrRefCount(o);
+            return createTaggedIntObject(value);
+        } else {
+            if (o->encoding == OBJ_ENCODING_RAW) {
+                sdsfree(o->ptr);
+                o->encoding = OBJ_ENCODING_INT;
+                o->ptr = (void*) value;
+                return o;
+            } else if (o->encoding == OBJ_ENCODING_EMBSTR) {
+                decrRefCount(o);
+                return createStringObjectFromLongLongWithOptions(value,1);
+            }
+        }
+    }
+
+    /* Strings of up to 7 bytes fit in a tagged pointer as well. */
+    if (len <= OBJ_TAG_STR_MAX && valueObjectsCanBeShared()) {
+        robj *tagged = createTaggedStringObject(s,len);
+
+        decrRefCount(o);
+        return tagged;
+    }
+
+    /* If the string is small and is still RAW encoded,
+     * try the EMBSTR encoding which is more efficient.
+     * In this representation the object and the SDS string are allocated
+     * in the same chunk of memory to save space and cache misses. */
+    if (len <= OBJ_ENCODING_EMBSTR_SIZE_LIMIT) {
+        robj *emb;
+
+        if (o->encoding == OBJ_ENCODING_EMBSTR) return o;
+        emb = createEmbeddedStringObject(s,sdslen(s));
+        decrRefCount(o);
+        return emb;
+    }
+
+    /* We can't encode the object...
+     *
+     * Do the last try, and at least optimize the SDS string inside
+     * the string object to require little space, in case there
+     * is more than 10% of free space at the end of the SDS string. */
+    trimStringObjectIfNeeded(o);
+
+    /* Return the original object. */
+    return o;
+}
+
+/* Get a decoded version of an encoded object (returned as a new object).
+ * If the object is already raw-encoded just increment the ref count. */
+robj *getDecodedObject(robj *o) {
+    robj *dec;
+
+    if (sdsEncodedObject(o)) {
+        incrRefCount(o);
+        return o;
+    }
+    if (objIsTagged(o)) {
+        char buf[32];
+
+        return createStringObject(buf,taggedObjectToString(o,buf,sizeof(buf)));
+    }
+    if (o->type == OBJ_STRING && o->encoding == OBJ_ENCODING_INT) {
+        char buf[32];
+
+        ll2string(buf,32,(long)o->ptr);
+        dec = createStringObject(buf,strlen(buf));
+        return dec;
+    } else {
+        serverPanic("Unknown encoding type");
+    }
+}
+
+int getLongLongFromObject(robj *o, long long *target) {
+    long long value;
+
+    if (o == NULL) {
+        value = 0;
+    } else if (objIsTaggedInt(o)) {
+        value = objTaggedInt(o);
+    } else if (objIsTagged(o)) {
+        char buf[OBJ_TAG_STR_MAX];
+
+        if (string2ll(buf,taggedObjectToString(o,buf,sizeof(buf)),&value) == 0) return C_ERR;
+    } else {
+        serverAssert(o->type == OBJ_STRING);
+        if (sdsEncodedObject(o)) {
+            if (string2ll(o->ptr,sdslen(o->ptr),&value) == 0) return C_ERR;
+        } else if (o->encoding == OBJ_ENCODING_INT) {
+            value = (long)o->ptr;
+        } else {
+            serverPanic("Unknown string encoding");
+        }
+    }
+    if (target) *target = value;
+    return C_OK;
+}
+
+int getLongLongFromObjectOrReply(client *c, robj *o, long long *target, const char *msg) {
+    long long value;
+    if (getLongLongFromObject(o, &value) != C_OK) {
+        if (msg != NULL) {
+            addReplyError(c,(char*)msg);
+        } else {
+            addReplyError(c,"value is not an integer or out of range");
+        }
+        return C_ERR;
+    }
+    *target = value;
+    return C_OK;
+}
+
+int getDoubleFromObject(robj *o, double *target) {
+    double value;
+
+    if (o == NULL) {
+        value = 0;
+    } else if (objIsTaggedInt(o)) {
+        value = objTaggedInt(o);
+    } else if (objIsTagged(o)) {
+        char buf[OBJ_TAG_STR_MAX];
+
+        if (string2d(buf,taggedObjectToString(o,buf,sizeof(buf)),&value) == 0) return C_ERR;
+    } else {
+        serverAssert(o->type == OBJ_STRING);
+        if (sdsEncodedObject(o)) {
+            if (string2d(o->ptr,sdslen(o->ptr),&value) == 0) return C_ERR;
+        } else if (o->encoding == OBJ_ENCODING_INT) {
+            value = (long)o->ptr;
+        } else {
+            serverPanic("Unknown string encoding");
+        }
+    }
+    *target = value;
+    return C_OK;
+}
+
+int getDoubleFromObjectOrReply(client *c, robj *o, double *target, const char *msg) {
+    double value;
+    if (getDoubleFromObject(o, &value) != C_OK) {
+        if (msg != NULL) {
+            addReplyError(c,(char*)msg);
+        } else {
+            addReplyError(c,"value is not a valid float");
+        }
+        return C_ERR;
     }
+    *target = value;
+    return C_OK;
 }
 
 size_t stringObjectLen(robj *o) {
+    if (objIsTaggedInt(o)) return sdigits10(objTaggedInt(o));
+    if (objIsTagged(o)) return objTaggedStrLen(o);
     serverAssert(o->type == OBJ_STRING);
     if (sdsEncodedObject(o)) {
         return sdslen(o->ptr);
@@ -140,7 +629,7 @@ size_t stringObjectLen(robj *o) {
 }
 
 robj *makeObjectShared(robj *o) {
-    serverAssert(o->refcount == 1);
+    serverAssert(!objIsTagged(o) && o->refcount == 1);
     o->refcount = OBJ_SHARED_REFCOUNT;
     return o;
 }
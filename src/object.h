@@ -6,6 +6,7 @@
 #define RESP_SERVER_OBJECT_H
 
 #include <limits.h>
+#include <stdint.h>
 
 /* Objects encoding. Some kind of objects like Strings and Hashes can be
  * internally represented in multiple ways. The 'encoding' field of the object
@@ -21,6 +22,11 @@
 #define OBJ_ENCODING_EMBSTR 8  /* Embedded sds string encoding */
 #define OBJ_ENCODING_QUICKLIST 9 /* Encoded as linked list of ziplists */
 #define OBJ_ENCODING_STREAM 10 /* Encoded as a radix tree of listpacks */
+#define OBJ_ENCODING_LISTPACK 11 /* Encoded as a listpack */
+#define OBJ_ENCODING_BTREE 12 /* Encoded as order-statistic B+tree + dict */
+#define OBJ_ENCODING_ROARING 13 /* Encoded as roaring bitmap */
+#define OBJ_ENCODING_GORILLA 14 /* Encoded as Gorilla-compressed chunks */
+#define OBJ_ENCODING_HNSW 15 /* Encoded as vector array + HNSW graph */
 
 #define LRU_BITS 24
 #define LRU_CLOCK_MAX ((1<<LRU_BITS)-1) /* Max value of obj->lru */
@@ -36,6 +42,10 @@
 #define OBJ_SET 2       /* Set object. */
 #define OBJ_ZSET 3      /* Sorted set object. */
 #define OBJ_HASH 4      /* Hash object. */
+#define OBJ_ROARING 5   /* Roaring bitmap object. */
+#define OBJ_STREAM 6    /* Stream object. */
+#define OBJ_TIMESERIES 7    /* Time series object. */
+#define OBJ_VECTOR 8        /* Vector index object. */
 
 #define LRU_BITS 24
 #define LRU_CLOCK_MAX ((1<<LRU_BITS)-1) /* Max value of obj->lru */
@@ -50,7 +60,33 @@
 #define OBJ_STATIC_REFCOUNT (INT_MAX-1) /* Object allocated in the stack. */
 #define OBJ_FIRST_SPECIAL_REFCOUNT OBJ_STATIC_REFCOUNT
 
-#define sdsEncodedObject(objptr) (objptr->encoding == OBJ_ENCODING_RAW || objptr->encoding == OBJ_ENCODING_EMBSTR)
+#define initStaticStringObject(_var,_ptr) do { \
+    _var.refcount = OBJ_STATIC_REFCOUNT; \
+    _var.type = OBJ_STRING; \
+    _var.encoding = OBJ_ENCODING_RAW; \
+    _var.ptr = _ptr; \
+} while(0)
+
+/* 标记指针(tagged pointer)：键空间中的短字符串值直接编码在robj*中，不分配对象。
+ * 对象按8字节对齐，最低2位为OBJ_TAG_INT时其余62位为有符号整数；为OBJ_TAG_STR时
+ * 第2~4位为长度，高7个字节依次为不超过7字节的内容。标记的值type为OBJ_STRING，
+ * 没有引用计数与访问信息，需通过objType、stringObjectLen、getLongLongFromObject、
+ * getDecodedObject、addReplyBulk等接口访问，不能直接解引用 */
+#define OBJ_TAG_MASK 3
+#define OBJ_TAG_INT 1
+#define OBJ_TAG_STR 2
+#define OBJ_TAG_INT_MAX (((long long)1<<61)-1)
+#define OBJ_TAG_INT_MIN (-((long long)1<<61))
+#define OBJ_TAG_STR_MAX 7
+
+#define objIsTagged(o) ((uintptr_t)(o) & OBJ_TAG_MASK)
+#define objIsTaggedInt(o) (((uintptr_t)(o) & OBJ_TAG_MASK) == OBJ_TAG_INT)
+#define objTaggedInt(o) ((long long)((intptr_t)(o) >> 2))
+#define objTaggedStrLen(o) ((size_t)(((uintptr_t)(o) >> 2) & 7))
+#define objType(o) (objIsTagged(o) ? OBJ_STRING : (o)->type)
+
+#define sdsEncodedObject(objptr) (!objIsTagged(objptr) && \
+    ((objptr)->encoding == OBJ_ENCODING_RAW || (objptr)->encoding == OBJ_ENCODING_EMBSTR))
 
 typedef struct respObject {
     unsigned type:4;
@@ -63,15 +99,45 @@ typedef struct respObject {
 } robj;
 
 typedef struct sharedObjectsStruct{
-    robj *crlf, *ok, *err, *pong,
+    robj *crlf, *ok, *err, *pong, *czero, *cone, *nullbulk, *nullarray, *emptyarray,
+    *wrongtypeerr, *syntaxerr, *oomerr,
     *integers[OBJ_SHARED_INTEGERS],
     *mbulkhdr[OBJ_SHARED_BULKHDR_LEN], /* "*<value>\r\n" */
     *bulkhdr[OBJ_SHARED_BULKHDR_LEN];  /* "$<value>\r\n" */
 } sharedObjectsStruct;
 
+struct client;
+
 robj *createObject(int type, void *ptr);
 robj *createStringObject(const char *ptr, size_t len);
+robj *createRawStringObject(const char *ptr, size_t len);
+robj *createEmbeddedStringObject(const char *ptr, size_t len);
+robj *createStringObjectFromLongLong(long long value);
+robj *createStringObjectFromLongLongWithOptions(long long value, int valueobj);
+robj *createStringObjectFromLongLongForValue(long long value);
+robj *createTaggedStringObject(const char *ptr, size_t len);
+size_t taggedObjectToString(robj *o, char *buf, size_t len);
+robj *dupStringObject(const robj *o);
+robj *createQuicklistObject(void);
+robj *createHashObject(void);
+robj *createSetObject(void);
+robj *createIntsetObject(void);
+robj *createZsetObject(void);
+robj *createZsetListpackObject(void);
+robj *createRoaringObject(void);
+robj *createStreamObject(void);
+robj *createTimeseriesObject(size_t chunk_size);
+robj *createVectorObject(uint32_t dim, int type, int metric, uint32_t M, uint32_t ef_construction);
+robj *tryObjectEncoding(robj *o);
+robj *getDecodedObject(robj *o);
+int getLongLongFromObject(robj *o, long long *target);
+int getLongLongFromObjectOrReply(struct client *c, robj *o, long long *target, const char *msg);
+int getDoubleFromObject(robj *o, double *target);
+int getDoubleFromObjectOrReply(struct client *c, robj *o, double *target, const char *msg);
+void trimStringObjectIfNeeded(robj *o);
+void incrRefCount(robj *o);
 void decrRefCount(robj *o);
+void decrRefCountVoid(void *o);
 size_t stringObjectLen(robj *o);
 robj *makeObjectShared(robj *o);
 
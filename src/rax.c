@@ -0,0 +1,482 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 基数树，用于stream：listpack节点按主ID索引，消费组的PEL按ID索引，消费组与消费者按名称索引。
+//
+// 每个节点为一次分配：头部之后依次为压缩的路径、子节点路径的首字节与子节点指针，查找子节点时
+// 只扫描首字节数组。stream的ID按大端序保存，同一毫秒内的ID共享前面的字节，单调递增插入时
+// 只在最右侧的路径上分裂节点。增删子节点时重新分配节点，并更新父节点中的指针。
+//
+// 迭代器保存从根节点到当前节点的路径，向后遍历时先访问节点自身再访问子节点，向前遍历相反；
+// raxSeek()先按">="定位，其余的比较方式由此前后移动一步得到。
+
+#include <unistd.h>
+#include <string.h>
+#include "rax.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/*-----------------------------------------------------------------------------
+ * Nodes
+ *----------------------------------------------------------------------------*/
+
+#define raxPadding(n) ((sizeof(void*)-((n) % sizeof(void*))) % sizeof(void*))
+#define raxNodePath(n) ((n)->buf)
+#define raxNodeEdges(n) ((n)->buf+(n)->size)
+#define raxNodeChildren(n) \
+    ((raxNode**)((n)->buf+(n)->size+(n)->numchildren+raxPadding((n)->size+(n)->numchildren)))
+
+static size_t raxNodeAllocSize(size_t size, size_t numchildren) {
+    return sizeof(raxNode)+size+numchildren+raxPadding(size+numchildren)+numchildren*sizeof(raxNode*);
+}
+
+/* 新建路径为path的节点，子节点首字节与指针由调用者填写 */
+static raxNode *raxNewNode(rax *rax, const unsigned char *path, size_t size, int numchildren) {
+    raxNode *n = zmalloc(raxNodeAllocSize(size,numchildren));
+
+    n->iskey = 0;
+    n->size = size;
+    n->numchildren = numchildren;
+    n->data = NULL;
+    if (size) memcpy(raxNodePath(n),path,size);
+    rax->numnodes++;
+    return n;
+}
+
+static void raxFreeNode(rax *rax, raxNode *n) {
+    zfree(n);
+    rax->numnodes--;
+}
+
+/* 以新的路径复制n(包括key、值与子节点)，释放n */
+static raxNode *raxReplacePath(rax *rax, raxNode *n, const unsigned char *path, size_t size) {
+    raxNode *nn = raxNewNode(rax,path,size,n->numchildren);
+
+    nn->iskey = n->iskey;
+    nn->data = n->data;
+    memcpy(raxNodeEdges(nn),raxNodeEdges(n),n->numchildren);
+    memcpy(raxNodeChildren(nn),raxNodeChildren(n),sizeof(raxNode*)*n->numchildren);
+    raxFreeNode(rax,n);
+    return nn;
+}
+
+/* 在下标idx处加入子节点child，返回重新分配后的n */
+static raxNode *raxAddChild(rax *rax, raxNode *n, int idx, raxNode *child) {
+    raxNode *nn = raxNewNode(rax,raxNodePath(n),n->size,n->numchildren+1);
+    unsigned char *edges = raxNodeEdges(n), *nedges = raxNodeEdges(nn);
+    raxNode **children = raxNodeChildren(n), **nchildren = raxNodeChildren(nn);
+
+    nn->iskey = n->iskey;
+    nn->data = n->data;
+    memcpy(nedges,edges,idx);
+    memcpy(nedges+idx+1,edges+idx,n->numchildren-idx);
+    nedges[idx] = raxNodePath(child)[0];
+    memcpy(nchildren,children,sizeof(raxNode*)*idx);
+    memcpy(nchildren+idx+1,children+idx,sizeof(raxNode*)*(n->numchildren-idx));
+    nchildren[idx] = child;
+    raxFreeNode(rax,n);
+    return nn;
+}
+
+/* 删除下标idx处的子节点指针(不释放子节点)，返回重新分配后的n */
+static raxNode *raxRemoveChild(rax *rax, raxNode *n, int idx) {
+    raxNode *nn = raxNewNode(rax,raxNodePath(n),n->size,n->numchildren-1);
+    unsigned char *edges = raxNodeEdges(n), *nedges = raxNodeEdges(nn);
+    raxNode **children = raxNodeChildren(n), **nchildren = raxNodeChildren(nn);
+
+    nn->iskey = n->iskey;
+    nn->data = n->data;
+    memcpy(nedges,edges,idx);
+    memcpy(nedges+idx,edges+idx+1,n->numchildren-idx-1);
+    memcpy(nchildren,children,sizeof(raxNode*)*idx);
+    memcpy(nchildren+idx,children+idx+1,sizeof(raxNode*)*(n->numchildren-idx-1));
+    raxFreeNode(rax,n);
+    return nn;
+}
+
+/* 第一个首字节不小于c的子节点下标，*found为首字节是否等于c */
+static inline int raxFindEdge(raxNode *n, unsigned char c, int *found) {
+    unsigned char *edges = raxNodeEdges(n);
+    int j;
+
+    for (j = 0; j < n->numchildren && edges[j] < c; j++);
+    *found = j < n->numchildren && edges[j] == c;
+    return j;
+}
+
+/*-----------------------------------------------------------------------------
+ * Rax API
+ *----------------------------------------------------------------------------*/
+
+rax *raxNew(void) {
+    rax *rax = zmalloc(sizeof(*rax));
+
+    rax->numele = 0;
+    rax->numnodes = 0;
+    rax->head = raxNewNode(rax,NULL,0,0);
+    return rax;
+}
+
+static void raxFreeNodeRecursive(rax *rax, raxNode *n, void (*free_callback)(void*)) {
+    raxNode **children = raxNodeChildren(n);
+    int j;
+
+    for (j = 0; j < n->numchildren; j++) raxFreeNodeRecursive(rax,children[j],free_callback);
+    if (n->iskey && free_callback) free_callback(n->data);
+    raxFreeNode(rax,n);
+}
+
+void raxFreeWithCallback(rax *rax, void (*free_callback)(void*)) {
+    raxFreeNodeRecursive(rax,rax->head,free_callback);
+    zfree(rax);
+}
+
+void raxFree(rax *rax) {
+    raxFreeWithCallback(rax,NULL);
+}
+
+uint64_t raxSize(rax *rax) {
+    return rax->numele;
+}
+
+/* 插入key s，已存在时替换值并通过old返回旧的值。返回1代表新增了key，0代表替换 */
+int raxInsert(rax *rax, const unsigned char *s, size_t len, void *data, void **old) {
+    raxNode **link = &rax->head, *n = rax->head;
+    size_t pos = 0;
+
+    while (1) {
+        raxNode **clink, *child, *tail, *mid;
+        size_t j;
+        int idx, found;
+
+        /* n的路径已经匹配，pos为其后的位置 */
+        if (pos == len) {
+            if (n->iskey) {
+                if (old) *old = n->data;
+                n->data = data;
+                return 0;
+            }
+            n->iskey = 1;
+            n->data = data;
+            rax->numele++;
+            return 1;
+        }
+
+        idx = raxFindEdge(n,s[pos],&found);
+        if (!found) {
+            raxNode *leaf = raxNewNode(rax,s+pos,len-pos,0);
+
+            leaf->iskey = 1;
+            leaf->data = data;
+            *link = raxAddChild(rax,n,idx,leaf);
+            rax->numele++;
+            return 1;
+        }
+
+        clink = &raxNodeChildren(n)[idx];
+        child = *clink;
+        for (j = 1; j < child->size && pos+j < len && raxNodePath(child)[j] == s[pos+j]; j++);
+        if (j < child->size) {
+            /* 在第j个字节处分裂子节点：前j个字节成为新的中间节点，剩余部分为它唯一的子节点 */
+            mid = raxNewNode(rax,raxNodePath(child),j,1);
+            tail = raxReplacePath(rax,child,raxNodePath(child)+j,child->size-j);
+            raxNodeEdges(mid)[0] = raxNodePath(tail)[0];
+            raxNodeChildren(mid)[0] = tail;
+            *clink = mid;
+            child = mid;
+        }
+        link = clink;
+        n = child;
+        pos += j;
+    }
+}
+
+/* 节点变化后整理：不是key的节点没有子节点时删除，只有一个子节点时与子节点合并。根节点不整理 */
+static void raxCompactNode(rax *rax, raxNode **link, int isroot) {
+    raxNode *n = *link, *child, *merged;
+    unsigned char *path;
+
+    if (isroot || n->iskey || n->numchildren > 1) return;
+    if (n->numchildren == 0) {
+        raxFreeNode(rax,n);
+        *link = NULL;
+        return;
+    }
+
+    child = raxNodeChildren(n)[0];
+    path = zmalloc(n->size+child->size);
+    memcpy(path,raxNodePath(n),n->size);
+    memcpy(path+n->size,raxNodePath(child),child->size);
+    merged = raxReplacePath(rax,child,path,n->size+child->size);
+    zfree(path);
+    raxFreeNode(rax,n);
+    *link = merged;
+}
+
+static int raxRemoveNode(rax *rax, raxNode **link, const unsigned char *s, size_t len,
+                         size_t pos, void **old, int isroot)
+{
+    raxNode *n = *link, *child;
+    int idx, found;
+
+    if (pos == len) {
+        if (!n->iskey) return 0;
+        if (old) *old = n->data;
+        n->iskey = 0;
+        n->data = NULL;
+        rax->numele--;
+    } else {
+        idx = raxFindEdge(n,s[pos],&found);
+        if (!found) return 0;
+        child = raxNodeChildren(n)[idx];
+        if (child->size > len-pos || memcmp(raxNodePath(child),s+pos,child->size) != 0) return 0;
+        if (!raxRemoveNode(rax,&raxNodeChildren(n)[idx],s,len,pos+child->size,old,0)) return 0;
+        if (raxNodeChildren(n)[idx] == NULL) *link = n = raxRemoveChild(rax,n,idx);
+    }
+    raxCompactNode(rax,link,isroot);
+    return 1;
+}
+
+/* 删除key s，通过old返回它的值。返回1代表删除了key，0代表key不存在 */
+int raxRemove(rax *rax, const unsigned char *s, size_t len, void **old) {
+    return raxRemoveNode(rax,&rax->head,s,len,0,old,1);
+}
+
+/* 查找key s，存在时返回1并通过value返回它的值 */
+int raxFind(rax *rax, const unsigned char *s, size_t len, void **value) {
+    raxNode *n = rax->head;
+    size_t pos = 0;
+    int idx, found;
+
+    while (pos < len) {
+        idx = raxFindEdge(n,s[pos],&found);
+        if (!found) return 0;
+        n = raxNodeChildren(n)[idx];
+        if (n->size > len-pos || memcmp(raxNodePath(n),s+pos,n->size) != 0) return 0;
+        pos += n->size;
+    }
+    if (!n->iskey) return 0;
+    if (value) *value = n->data;
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------
+ * Iterator
+ *----------------------------------------------------------------------------*/
+
+void raxStart(raxIterator *it, rax *rt) {
+    it->rt = rt;
+    it->flags = RAX_ITER_EOF;
+    it->key = it->key_static;
+    it->key_len = 0;
+    it->key_max = RAX_ITER_STATIC_LEN;
+    it->data = NULL;
+    it->stack = it->stack_static;
+    it->depth = 0;
+    it->stack_max = RAX_ITER_STATIC_STACK;
+}
+
+void raxStop(raxIterator *it) {
+    if (it->key != it->key_static) zfree(it->key);
+    if (it->stack != it->stack_static) zfree(it->stack);
+}
+
+int raxEOF(raxIterator *it) {
+    return it->flags & RAX_ITER_EOF;
+}
+
+#define raxIterTop(it) ((it)->stack[(it)->depth-1].node)
+
+static void raxIterReset(raxIterator *it) {
+    it->stack[0].node = it->rt->head;
+    it->stack[0].idx = 0;
+    it->depth = 1;
+    it->key_len = 0;
+}
+
+/* 进入当前节点的第idx个子节点 */
+static void raxIterPush(raxIterator *it, int idx) {
+    raxNode *child = raxNodeChildren(raxIterTop(it))[idx];
+
+    if (it->key_len+child->size > it->key_max) {
+        size_t max = (it->key_len+child->size)*2;
+
+        if (it->key == it->key_static) {
+            it->key = zmalloc(max);
+            memcpy(it->key,it->key_static,it->key_len);
+        } else {
+            it->key = zrealloc(it->key,max);
+        }
+        it->key_max = max;
+    }
+    if (it->depth == it->stack_max) {
+        size_t max = it->stack_max*2;
+
+        if (it->stack == it->stack_static) {
+            it->stack = zmalloc(sizeof(raxStackItem)*max);
+            memcpy(it->stack,it->stack_static,sizeof(raxStackItem)*it->depth);
+        } else {
+            it->stack = zrealloc(it->stack,sizeof(raxStackItem)*max);
+        }
+        it->stack_max = max;
+    }
+    memcpy(it->key+it->key_len,raxNodePath(child),child->size);
+    it->key_len += child->size;
+    it->stack[it->depth].node = child;
+    it->stack[it->depth].idx = idx;
+    it->depth++;
+}
+
+/* 回到父节点，返回离开的节点在父节点中的下标 */
+static int raxIterPop(raxIterator *it) {
+    raxStackItem *item = &it->stack[--it->depth];
+
+    it->key_len -= item->node->size;
+    return item->idx;
+}
+
+/* 移动到下一个key。descend为1时从当前节点的子树开始找，为0时跳过整个子树 */
+static int raxIterForward(raxIterator *it, int descend) {
+    if (descend && raxIterTop(it)->numchildren) {
+        raxIterPush(it,0);
+    } else {
+        while (1) {
+            int idx;
+
+            if (it->depth == 1) return 0;
+            idx = raxIterPop(it);
+            if (idx+1 < raxIterTop(it)->numchildren) {
+                raxIterPush(it,idx+1);
+                break;
+            }
+        }
+    }
+    while (!raxIterTop(it)->iskey) raxIterPush(it,0);
+    return 1;
+}
+
+/* 移动到上一个key：左侧兄弟子树中最大的key，没有时为父节点 */
+static int raxIterBackward(raxIterator *it) {
+    while (1) {
+        int idx;
+
+        if (it->depth == 1) return 0;
+        idx = raxIterPop(it);
+        if (idx > 0) {
+            raxIterPush(it,idx-1);
+            while (raxIterTop(it)->numchildren)
+                raxIterPush(it,raxIterTop(it)->numchildren-1);
+            return 1;
+        }
+        if (raxIterTop(it)->iskey) return 1;
+    }
+}
+
+/* 当前节点子树中最小的key */
+static int raxIterMin(raxIterator *it) {
+    if (raxIterTop(it)->iskey) return 1;
+    return raxIterForward(it,1);
+}
+
+static int raxIterLast(raxIterator *it) {
+    raxIterReset(it);
+    while (raxIterTop(it)->numchildren) raxIterPush(it,raxIterTop(it)->numchildren-1);
+    return raxIterTop(it)->iskey;
+}
+
+/* 定位到第一个不小于s的key，*exact为是否等于s */
+static int raxIterSeekGreaterEqual(raxIterator *it, const unsigned char *s, size_t len, int *exact) {
+    size_t pos = 0;
+
+    *exact = 0;
+    raxIterReset(it);
+    while (1) {
+        raxNode *n = raxIterTop(it), *child;
+        size_t j;
+        int idx, found;
+
+        if (pos == len) {
+            if (n->iskey) {
+                *exact = 1;
+                return 1;
+            }
+            return raxIterForward(it,1);
+        }
+
+        idx = raxFindEdge(n,s[pos],&found);
+        if (idx == n->numchildren) return raxIterForward(it,0);
+        raxIterPush(it,idx);
+        if (!found) return raxIterMin(it);
+
+        child = raxIterTop(it);
+        for (j = 1; j < child->size && pos+j < len && raxNodePath(child)[j] == s[pos+j]; j++);
+        if (j < child->size) {
+            /* s在这个节点的路径中结束或比路径大/小，整个子树都在s的同一侧 */
+            if (pos+j == len || raxNodePath(child)[j] > s[pos+j]) return raxIterMin(it);
+            return raxIterForward(it,0);
+        }
+        pos += j;
+    }
+}
+
+/* 按op定位："^"为第一个key，"$"为最后一个key，">="、">"、"<="、"<"为与ele比较。
+ * 之后第一次调用raxNext()或raxPrev()返回定位到的key。没有满足条件的key时返回0 */
+int raxSeek(raxIterator *it, const char *op, const unsigned char *ele, size_t len) {
+    int found, exact;
+
+    if (op[0] == '^') {
+        raxIterReset(it);
+        found = raxIterMin(it);
+    } else if (op[0] == '$') {
+        found = raxIterLast(it);
+    } else if (op[0] == '>' || op[0] == '<') {
+        found = raxIterSeekGreaterEqual(it,ele,len,&exact);
+        if (op[0] == '>') {
+            if (found && exact && op[1] != '=') found = raxIterForward(it,1);
+        } else if (!found) {
+            found = raxIterLast(it);
+        } else if (!exact || op[1] != '=') {
+            found = raxIterBackward(it);
+        }
+    } else {
+        serverPanic("Invalid seek operator");
+    }
+
+    if (!found) {
+        it->flags = RAX_ITER_EOF;
+        return 0;
+    }
+    it->flags = RAX_ITER_JUST_SEEKED;
+    it->data = raxIterTop(it)->data;
+    return 1;
+}
+
+/* 移动到下一个key，返回0代表遍历结束 */
+int raxNext(raxIterator *it) {
+    if (it->flags & RAX_ITER_EOF) return 0;
+    if (it->flags & RAX_ITER_JUST_SEEKED) {
+        it->flags &= ~RAX_ITER_JUST_SEEKED;
+        return 1;
+    }
+    if (!raxIterForward(it,1)) {
+        it->flags |= RAX_ITER_EOF;
+        return 0;
+    }
+    it->data = raxIterTop(it)->data;
+    return 1;
+}
+
+/* 移动到上一个key，返回0代表遍历结束 */
+int raxPrev(raxIterator *it) {
+    if (it->flags & RAX_ITER_EOF) return 0;
+    if (it->flags & RAX_ITER_JUST_SEEKED) {
+        it->flags &= ~RAX_ITER_JUST_SEEKED;
+        return 1;
+    }
+    if (!raxIterBackward(it)) {
+        it->flags |= RAX_ITER_EOF;
+        return 0;
+    }
+    it->data = raxIterTop(it)->data;
+    return 1;
+}
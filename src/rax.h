@@ -0,0 +1,69 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_RAX_H
+#define RESP_SERVER_RAX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* 基数树(radix tree)：key为任意字节串，按字节序有序。只有一个子节点的路径压缩在一个节点中，
+ * 节点的key为从根节点到该节点经过的所有路径的拼接。子节点按路径的第一个字节有序，
+ * 除根节点外，不是key的节点至少有两个子节点 */
+typedef struct raxNode {
+    uint32_t iskey:1;           /* 节点的key在树中 */
+    uint32_t size:31;           /* 压缩路径的长度，根节点为0 */
+    uint16_t numchildren;
+    void *data;                 /* key对应的值 */
+    /* size字节的路径，numchildren字节的子节点路径首字节(升序)，
+     * 按指针对齐后为numchildren个子节点指针 */
+    unsigned char buf[];
+} raxNode;
+
+typedef struct rax {
+    raxNode *head;
+    uint64_t numele;            /* key的数量 */
+    uint64_t numnodes;          /* 节点数量 */
+} rax;
+
+typedef struct raxStackItem {
+    raxNode *node;
+    int idx;                    /* 节点在父节点子节点中的下标 */
+} raxStackItem;
+
+#define RAX_ITER_STATIC_LEN 128
+#define RAX_ITER_STATIC_STACK 32
+#define RAX_ITER_JUST_SEEKED (1<<0) /* 下一次raxNext()/raxPrev()返回定位到的key */
+#define RAX_ITER_EOF (1<<1)
+
+/* 有序遍历的迭代器。树被修改后迭代器失效，需要重新raxSeek() */
+typedef struct raxIterator {
+    rax *rt;
+    int flags;
+    unsigned char *key;         /* 当前key */
+    size_t key_len;
+    size_t key_max;
+    void *data;                 /* 当前key的值 */
+    raxStackItem *stack;        /* 从根节点到当前节点的路径 */
+    size_t depth;
+    size_t stack_max;
+    unsigned char key_static[RAX_ITER_STATIC_LEN];
+    raxStackItem stack_static[RAX_ITER_STATIC_STACK];
+} raxIterator;
+
+rax *raxNew(void);
+void raxFree(rax *rax);
+void raxFreeWithCallback(rax *rax, void (*free_callback)(void*));
+int raxInsert(rax *rax, const unsigned char *s, size_t len, void *data, void **old);
+int raxRemove(rax *rax, const unsigned char *s, size_t len, void **old);
+int raxFind(rax *rax, const unsigned char *s, size_t len, void **value);
+uint64_t raxSize(rax *rax);
+void raxStart(raxIterator *it, rax *rt);
+int raxSeek(raxIterator *it, const char *op, const unsigned char *ele, size_t len);
+int raxNext(raxIterator *it);
+int raxPrev(raxIterator *it);
+int raxEOF(raxIterator *it);
+void raxStop(raxIterator *it);
+
+#endif //RESP_SERVER_RAX_H
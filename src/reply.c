@@ -14,7 +14,8 @@ int clientHasPendingReplies(client *c) {
 }
 
 void prepareClientToWrite(client *c) {
-    if (!clientHasPendingReplies(c)) {
+    if (!(c->flags & CLIENT_PENDING_WRITE) && !clientHasPendingReplies(c)) {
+        c->flags |= CLIENT_PENDING_WRITE;
         listAddNodeHead(server.clients_pending_write,c);
     }
 }
@@ -125,6 +126,11 @@ void addReply(client *c, robj *obj) {
     if (sdsEncodedObject(obj)) {
         if (addReplyToBuffer(c,obj->ptr,sdslen(obj->ptr)) != C_OK)
             addReplyProtoToList(c,obj->ptr,sdslen(obj->ptr));
+    } else if (objIsTagged(obj)) {
+        char buf[32];
+        size_t len = taggedObjectToString(obj,buf,sizeof(buf));
+        if (addReplyToBuffer(c,buf,len) != C_OK)
+            addReplyProtoToList(c,buf,len);
     } else if (obj->encoding == OBJ_ENCODING_INT) {
         /* For integer encoded strings we just convert it into a string
          * using our optimized function, and attach the resulting string
@@ -210,6 +216,34 @@ void addReplyBulkLongLong(client *c, long long ll) {
     addReplyBulkCBuffer(c,buf,len);
 }
 
+/* Add a double as a bulk reply, formatted with d2string() so that
+ * integral scores are replied without a fractional part. */
+void addReplyDouble(client *c, double d) {
+    char dbuf[128];
+    int dlen;
+
+    dlen = d2string(dbuf,sizeof(dbuf),d);
+    addReplyBulkCBuffer(c,dbuf,dlen);
+}
+
+/* Add a C null term string as bulk reply */
+void addReplyBulkCString(client *c, const char *s) {
+    if (s == NULL) {
+        addReply(c,shared.nullbulk);
+    } else {
+        addReplyBulkCBuffer(c,s,strlen(s));
+    }
+}
+
+void addReplyLongLong(client *c, long long ll) {
+    if (ll == 0)
+        addReply(c,shared.czero);
+    else if (ll == 1)
+        addReply(c,shared.cone);
+    else
+        addReplyLongLongWithPrefix(c,ll,':');
+}
+
 void addReplyAggregateLen(client *c, long length, int prefix) {
     if (prefix == '*' && length < OBJ_SHARED_BULKHDR_LEN)
         addReply(c,shared.mbulkhdr[length]);
@@ -219,4 +253,30 @@ void addReplyAggregateLen(client *c, long length, int prefix) {
 
 void addReplyArrayLen(client *c, long length) {
     addReplyAggregateLen(c,length,'*');
+}
+
+/* 回复元素数量事先未知的数组：先在回复链表中放一个空节点占位，
+ * 写完所有元素后由setDeferredArrayLen()填写数组长度 */
+void *addReplyDeferredLen(client *c) {
+    prepareClientToWrite(c);
+    listAddNodeTail(c->reply,NULL);
+    return listLast(c->reply);
+}
+
+void setDeferredArrayLen(client *c, void *node, long length) {
+    listNode *ln = node;
+    clientReplyBlock *buf;
+    char lenstr[32];
+    size_t len;
+
+    lenstr[0] = '*';
+    len = ll2string(lenstr+1,sizeof(lenstr)-3,length)+1;
+    lenstr[len++] = '\r';
+    lenstr[len++] = '\n';
+    buf = zmalloc(len+sizeof(clientReplyBlock));
+    buf->size = zmalloc_usable(buf)-sizeof(clientReplyBlock);
+    buf->used = len;
+    memcpy(buf->buf,lenstr,len);
+    listNodeValue(ln) = buf;
+    c->reply_bytes += buf->size;
 }
\ No newline at end of file
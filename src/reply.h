@@ -14,5 +14,11 @@ void addReplyErrorFormat(client *c, const char *fmt, ...);
 void addReplyBulk(client *c, robj *obj);
 void addReplyBulkCBuffer(client *c, const void *p, size_t len);
 void addReplyBulkLongLong(client *c, long long ll);
+void addReplyDouble(client *c, double d);
 void addReplyArrayLen(client *c, long length);
+void *addReplyDeferredLen(client *c);
+void setDeferredArrayLen(client *c, void *node, long length);
+void addReplyBulkCString(client *c, const char *s);
+void addReplyLongLong(client *c, long long ll);
+void addReplyStatus(client *c, const char *status);
 #endif //RESP_SERVER_REPLY_H
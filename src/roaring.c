@@ -0,0 +1,886 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// roaring bitmap。数组容器按值有序，查找为二分查找；位图容器每个值1位；游程容器保存有序的
+// 不相交区间。增删只在数组与位图之间按ROARING_ARRAY_MAX自动转换，游程容器由roaringOptimize()
+// 在三种表示中选出最小的一种时生成，命令在修改完一个容器后调用它。
+//
+// 容器之间的集合运算：位图与位图逐个128位按位运算，同时用SSE2统计结果的基数；数组与数组的交集
+// 按块归并，每次比较两边各8个元素的所有元素对；其余组合按元素归并或查位图。游程容器参与运算时
+// 先展开为位图。
+
+#include <string.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "roaring.h"
+#include "zmalloc.h"
+#include "log.h"
+
+#define ROARING_BITMAP_BYTES (ROARING_BITMAP_WORDS*sizeof(uint64_t))
+
+/*-----------------------------------------------------------------------------
+ * Popcount
+ *----------------------------------------------------------------------------*/
+
+#if defined(__SSE2__)
+/* 每个字节中置位的数量 */
+static inline __m128i _roaringPopcountBytes(__m128i v) {
+    const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+
+    v = _mm_sub_epi8(v,_mm_and_si128(_mm_srli_epi64(v,1),m1));
+    v = _mm_add_epi8(_mm_and_si128(v,m2),_mm_and_si128(_mm_srli_epi64(v,2),m2));
+    return _mm_and_si128(_mm_add_epi8(v,_mm_srli_epi64(v,4)),m4);
+}
+
+/* 把v中置位的数量累加到acc的两个64位通道 */
+#define _roaringPopcountAdd(acc, v) \
+    ((acc) = _mm_add_epi64((acc),_mm_sad_epu8(_roaringPopcountBytes(v),_mm_setzero_si128())))
+
+static inline uint64_t _roaringPopcountSum(__m128i acc) {
+    return (uint64_t)_mm_cvtsi128_si32(acc)+(uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(acc,8));
+}
+#endif
+
+/* words[0..n)中置位的数量 */
+static uint32_t roaringPopcount(const uint64_t *words, uint32_t n) {
+    uint32_t i = 0, count = 0;
+
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+
+    for (; i+2 <= n; i += 2)
+        _roaringPopcountAdd(acc,_mm_loadu_si128((const __m128i*)(words+i)));
+    count = (uint32_t)_roaringPopcountSum(acc);
+#endif
+    for (; i < n; i++) count += __builtin_popcountll(words[i]);
+    return count;
+}
+
+/* 位图中游程的数量，即前一位为0的置位的数量 */
+static uint32_t roaringBitmapRuns(const uint64_t *words) {
+    uint32_t i = 0, runs = 0;
+
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128(), prev = _mm_setzero_si128();
+
+    for (; i < ROARING_BITMAP_WORDS; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(words+i));
+        /* 每个通道左移1位，最低位补上前一个64位字的最高位 */
+        __m128i carry = _mm_srli_epi64(_mm_or_si128(_mm_slli_si128(v,8),_mm_srli_si128(prev,8)),63);
+        __m128i starts = _mm_andnot_si128(_mm_or_si128(_mm_slli_epi64(v,1),carry),v);
+
+        _roaringPopcountAdd(acc,starts);
+        prev = v;
+    }
+    runs = (uint32_t)_roaringPopcountSum(acc);
+#else
+    uint64_t prev = 0;
+
+    for (; i < ROARING_BITMAP_WORDS; i++) {
+        runs += __builtin_popcountll(words[i] & ~((words[i] << 1) | (prev >> 63)));
+        prev = words[i];
+    }
+#endif
+    return runs;
+}
+
+/*-----------------------------------------------------------------------------
+ * Containers
+ *----------------------------------------------------------------------------*/
+
+/* 返回数组中第一个不小于v的位置 */
+static uint32_t arrayLowerBound(const uint16_t *a, uint32_t n, uint16_t v) {
+    uint32_t lo = 0, hi = n;
+
+    while (lo < hi) {
+        uint32_t mid = (lo+hi)/2;
+        if (a[mid] < v)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* 返回最后一个start不大于v的游程，没有时返回-1 */
+static int32_t runFind(const roaringRun *runs, uint32_t n, uint16_t v) {
+    int32_t lo = 0, hi = (int32_t)n-1;
+
+    while (lo <= hi) {
+        int32_t mid = (lo+hi)/2;
+        if (runs[mid].start <= v)
+            lo = mid+1;
+        else
+            hi = mid-1;
+    }
+    return lo-1;
+}
+
+/* 保证数组或游程数组至少能再容纳一个元素 */
+static void containerReserve(roaringContainer *c, size_t elesize, uint32_t max) {
+    if (c->n < c->cap) return;
+    c->cap = c->cap < 4 ? 4 : c->cap*2;
+    if (c->cap > max) c->cap = max;
+    c->data = zrealloc(c->data,(size_t)c->cap*elesize);
+}
+
+static void containerToBitmap(roaringContainer *c) {
+    uint64_t *words;
+    uint32_t i;
+
+    if (c->type == ROARING_BITMAP) return;
+    words = zcalloc(ROARING_BITMAP_BYTES);
+    if (c->type == ROARING_ARRAY) {
+        uint16_t *a = c->data;
+        for (i = 0; i < c->n; i++) words[a[i] >> 6] |= (uint64_t)1 << (a[i] & 63);
+    } else {
+        roaringRun *runs = c->data;
+        for (i = 0; i < c->n; i++) {
+            uint32_t start = runs[i].start, end = start+runs[i].len;   /* [start, end] */
+            uint32_t fw = start >> 6, lw = end >> 6;
+            uint64_t fmask = ~(uint64_t)0 << (start & 63);
+            uint64_t lmask = ~(uint64_t)0 >> (63-(end & 63));
+
+            if (fw == lw) {
+                words[fw] |= fmask & lmask;
+            } else {
+                words[fw] |= fmask;
+                memset(words+fw+1,0xff,(lw-fw-1)*sizeof(uint64_t));
+                words[lw] |= lmask;
+            }
+        }
+    }
+    zfree(c->data);
+    c->data = words;
+    c->type = ROARING_BITMAP;
+    c->n = c->cap = 0;
+}
+
+static void containerToArray(roaringContainer *c) {
+    uint16_t *a;
+    uint32_t i, k = 0;
+
+    if (c->type == ROARING_ARRAY) return;
+    serverAssert(c->card <= ROARING_ARRAY_MAX);
+    a = zmalloc(c->card*sizeof(uint16_t));
+    if (c->type == ROARING_BITMAP) {
+        uint64_t *words = c->data;
+        for (i = 0; i < ROARING_BITMAP_WORDS; i++) {
+            uint64_t w = words[i];
+            while (w) {
+                a[k++] = (uint16_t)(i*64+__builtin_ctzll(w));
+                w &= w-1;
+            }
+        }
+    } else {
+        roaringRun *runs = c->data;
+        for (i = 0; i < c->n; i++) {
+            uint32_t v, end = (uint32_t)runs[i].start+runs[i].len;
+            for (v = runs[i].start; v <= end; v++) a[k++] = (uint16_t)v;
+        }
+    }
+    zfree(c->data);
+    c->data = a;
+    c->type = ROARING_ARRAY;
+    c->n = c->cap = c->card;
+}
+
+static void containerToRun(roaringContainer *c, uint32_t nruns) {
+    roaringRun *runs;
+    uint32_t i, k = 0;
+
+    if (c->type == ROARING_RUN) return;
+    runs = zmalloc(nruns*sizeof(roaringRun));
+    if (c->type == ROARING_ARRAY) {
+        uint16_t *a = c->data;
+        for (i = 0; i < c->n; i++) {
+            if (k && (uint32_t)runs[k-1].start+runs[k-1].len+1 == a[i]) {
+                runs[k-1].len++;
+            } else {
+                runs[k].start = a[i];
+                runs[k].len = 0;
+                k++;
+            }
+        }
+    } else {
+        uint64_t *words = c->data;
+        uint32_t v = 0;
+
+        /* 交替找下一个置位与下一个0位 */
+        while (v < 65536) {
+            uint32_t w = v >> 6, end;
+            uint64_t bits = words[w] & (~(uint64_t)0 << (v & 63));
+
+            while (bits == 0 && ++w < ROARING_BITMAP_WORDS) bits = words[w];
+            if (bits == 0) break;
+            v = w*64+__builtin_ctzll(bits);
+            bits = ~words[w] & (~(uint64_t)0 << (v & 63));
+            while (bits == 0 && ++w < ROARING_BITMAP_WORDS) bits = ~words[w];
+            end = bits ? w*64+__builtin_ctzll(bits) : 65536;
+            runs[k].start = (uint16_t)v;
+            runs[k].len = (uint16_t)(end-v-1);
+            k++;
+            v = end;
+        }
+    }
+    serverAssert(k == nruns);
+    zfree(c->data);
+    c->data = runs;
+    c->type = ROARING_RUN;
+    c->n = c->cap = nruns;
+}
+
+static int containerContains(const roaringContainer *c, uint16_t v) {
+    if (c->type == ROARING_ARRAY) {
+        const uint16_t *a = c->data;
+        uint32_t pos = arrayLowerBound(a,c->n,v);
+        return pos < c->n && a[pos] == v;
+    } else if (c->type == ROARING_BITMAP) {
+        const uint64_t *words = c->data;
+        return (words[v >> 6] >> (v & 63)) & 1;
+    } else {
+        const roaringRun *runs = c->data;
+        int32_t i = runFind(runs,c->n,v);
+        return i >= 0 && v <= (uint32_t)runs[i].start+runs[i].len;
+    }
+}
+
+static int containerAdd(roaringContainer *c, uint16_t v) {
+    if (c->type == ROARING_ARRAY) {
+        uint16_t *a = c->data;
+        uint32_t pos = arrayLowerBound(a,c->n,v);
+
+        if (pos < c->n && a[pos] == v) return 0;
+        if (c->n == ROARING_ARRAY_MAX) {
+            containerToBitmap(c);
+            return containerAdd(c,v);
+        }
+        containerReserve(c,sizeof(uint16_t),ROARING_ARRAY_MAX);
+        a = c->data;
+        memmove(a+pos+1,a+pos,(c->n-pos)*sizeof(uint16_t));
+        a[pos] = v;
+        c->n++;
+    } else if (c->type == ROARING_BITMAP) {
+        uint64_t *words = c->data, bit = (uint64_t)1 << (v & 63);
+
+        if (words[v >> 6] & bit) return 0;
+        words[v >> 6] |= bit;
+    } else {
+        roaringRun *runs = c->data;
+        int32_t i = runFind(runs,c->n,v);
+        int prev, next;
+
+        if (i >= 0 && v <= (uint32_t)runs[i].start+runs[i].len) return 0;
+        prev = i >= 0 && (uint32_t)runs[i].start+runs[i].len+1 == v;
+        next = (uint32_t)(i+1) < c->n && runs[i+1].start == (uint32_t)v+1;
+        if (prev && next) {
+            /* 合并前后两个游程 */
+            runs[i].len += runs[i+1].len+2;
+            memmove(runs+i+1,runs+i+2,(c->n-i-2)*sizeof(roaringRun));
+            c->n--;
+        } else if (prev) {
+            runs[i].len++;
+        } else if (next) {
+            runs[i+1].start--;
+            runs[i+1].len++;
+        } else {
+            containerReserve(c,sizeof(roaringRun),65536/2);
+            runs = c->data;
+            memmove(runs+i+2,runs+i+1,(c->n-i-1)*sizeof(roaringRun));
+            runs[i+1].start = v;
+            runs[i+1].len = 0;
+            c->n++;
+        }
+    }
+    c->card++;
+    return 1;
+}
+
+static int containerRemove(roaringContainer *c, uint16_t v) {
+    if (c->type == ROARING_ARRAY) {
+        uint16_t *a = c->data;
+        uint32_t pos = arrayLowerBound(a,c->n,v);
+
+        if (pos == c->n || a[pos] != v) return 0;
+        memmove(a+pos,a+pos+1,(c->n-pos-1)*sizeof(uint16_t));
+        c->n--;
+        c->card--;
+    } else if (c->type == ROARING_BITMAP) {
+        uint64_t *words = c->data, bit = (uint64_t)1 << (v & 63);
+
+        if (!(words[v >> 6] & bit)) return 0;
+        words[v >> 6] &= ~bit;
+        if (--c->card <= ROARING_ARRAY_MAX) containerToArray(c);
+    } else {
+        roaringRun *runs = c->data;
+        int32_t i = runFind(runs,c->n,v);
+        uint32_t end;
+
+        if (i < 0 || v > (uint32_t)runs[i].start+runs[i].len) return 0;
+        end = (uint32_t)runs[i].start+runs[i].len;
+        if (runs[i].len == 0) {
+            memmove(runs+i,runs+i+1,(c->n-i-1)*sizeof(roaringRun));
+            c->n--;
+        } else if (v == runs[i].start) {
+            runs[i].start++;
+            runs[i].len--;
+        } else if (v == end) {
+            runs[i].len--;
+        } else {
+            /* 从中间拆成两个游程 */
+            containerReserve(c,sizeof(roaringRun),65536/2);
+            runs = c->data;
+            memmove(runs+i+2,runs+i+1,(c->n-i-1)*sizeof(roaringRun));
+            runs[i+1].start = v+1;
+            runs[i+1].len = (uint16_t)(end-v-1);
+            runs[i].len = (uint16_t)(v-runs[i].start-1);
+            c->n++;
+        }
+        c->card--;
+    }
+    return 1;
+}
+
+/* 小于等于v的元素数量 */
+static uint32_t containerRank(const roaringContainer *c, uint16_t v) {
+    if (c->type == ROARING_ARRAY) {
+        const uint16_t *a = c->data;
+        uint32_t pos = arrayLowerBound(a,c->n,v);
+        return pos < c->n && a[pos] == v ? pos+1 : pos;
+    } else if (c->type == ROARING_BITMAP) {
+        const uint64_t *words = c->data;
+        uint64_t mask = (v & 63) == 63 ? ~(uint64_t)0 : ((uint64_t)1 << ((v & 63)+1))-1;
+        return roaringPopcount(words,v >> 6)+__builtin_popcountll(words[v >> 6] & mask);
+    } else {
+        const roaringRun *runs = c->data;
+        uint32_t i, rank = 0;
+
+        for (i = 0; i < c->n && runs[i].start <= v; i++) {
+            uint32_t span = v-runs[i].start;
+            rank += (span < runs[i].len ? span : runs[i].len)+1;
+        }
+        return rank;
+    }
+}
+
+/* 第rank个元素(从0开始)，rank小于card */
+static uint16_t containerSelect(const roaringContainer *c, uint32_t rank) {
+    uint32_t i;
+
+    if (c->type == ROARING_ARRAY) {
+        return ((const uint16_t*)c->data)[rank];
+    } else if (c->type == ROARING_BITMAP) {
+        const uint64_t *words = c->data;
+        for (i = 0; i < ROARING_BITMAP_WORDS; i++) {
+            uint64_t w = words[i];
+            uint32_t count = __builtin_popcountll(w);
+
+            if (rank < count) {
+                while (rank--) w &= w-1;
+                return (uint16_t)(i*64+__builtin_ctzll(w));
+            }
+            rank -= count;
+        }
+    } else {
+        const roaringRun *runs = c->data;
+        for (i = 0; i < c->n; i++) {
+            if (rank <= runs[i].len) return (uint16_t)(runs[i].start+rank);
+            rank -= runs[i].len+1;
+        }
+    }
+    serverPanic("roaring select out of range");
+    return 0;
+}
+
+/* 遍历[lo, hi]中的元素，回调返回0时返回0 */
+static int containerIterate(const roaringContainer *c, uint32_t base, uint16_t lo, uint16_t hi,
+                            roaringIterFunction *fn, void *privdata) {
+    uint32_t i;
+
+    if (c->type == ROARING_ARRAY) {
+        const uint16_t *a = c->data;
+        for (i = arrayLowerBound(a,c->n,lo); i < c->n && a[i] <= hi; i++)
+            if (!fn(privdata,base|a[i])) return 0;
+    } else if (c->type == ROARING_BITMAP) {
+        const uint64_t *words = c->data;
+        for (i = lo >> 6; i <= (uint32_t)(hi >> 6); i++) {
+            uint64_t w = words[i];
+
+            if (i == (uint32_t)(lo >> 6)) w &= ~(uint64_t)0 << (lo & 63);
+            if (i == (uint32_t)(hi >> 6)) w &= ~(uint64_t)0 >> (63-(hi & 63));
+            while (w) {
+                if (!fn(privdata,base|(i*64+__builtin_ctzll(w)))) return 0;
+                w &= w-1;
+            }
+        }
+    } else {
+        const roaringRun *runs = c->data;
+        int32_t first = runFind(runs,c->n,lo);
+
+        for (i = first < 0 ? 0 : (uint32_t)first; i < c->n && runs[i].start <= hi; i++) {
+            uint32_t v = runs[i].start > lo ? runs[i].start : lo;
+            uint32_t end = (uint32_t)runs[i].start+runs[i].len;
+
+            if (end > hi) end = hi;
+            for (; v <= end; v++)
+                if (!fn(privdata,base|v)) return 0;
+        }
+    }
+    return 1;
+}
+
+static void containerCopy(roaringContainer *dst, const roaringContainer *src) {
+    size_t size;
+
+    *dst = *src;
+    if (src->type == ROARING_BITMAP)
+        size = ROARING_BITMAP_BYTES;
+    else if (src->type == ROARING_ARRAY)
+        size = src->n*sizeof(uint16_t);
+    else
+        size = src->n*sizeof(roaringRun);
+    dst->data = zmalloc(size);
+    memcpy(dst->data,src->data,size);
+    if (src->type != ROARING_BITMAP) dst->cap = dst->n;
+}
+
+/*-----------------------------------------------------------------------------
+ * Container operations
+ *----------------------------------------------------------------------------*/
+
+#if defined(__SSE2__)
+/* 两个数组的交集，按块归并：每块8个元素，vb依次循环移位1~7个元素后与va比较，
+ * 一次比较完两块的全部64对元素。返回写入out的元素数量 */
+static uint32_t arrayIntersectSSE2(const uint16_t *a, uint32_t na, const uint16_t *b, uint32_t nb,
+                                   uint16_t *out, uint32_t *pi, uint32_t *pj) {
+    uint32_t i = 0, j = 0, k = 0;
+    uint32_t na8 = na & ~7U, nb8 = nb & ~7U;
+
+#define ROARING_ROT16(v,n) _mm_or_si128(_mm_srli_si128(v,2*(n)),_mm_slli_si128(v,16-2*(n)))
+    while (i < na8 && j < nb8) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a+i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b+j));
+        __m128i eq = _mm_cmpeq_epi16(va,vb);
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,ROARING_ROT16(vb,1)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,ROARING_ROT16(vb,2)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,ROARING_ROT16(vb,3)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,ROARING_ROT16(vb,4)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,ROARING_ROT16(vb,5)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,ROARING_ROT16(vb,6)));
+        eq = _mm_or_si128(eq,_mm_cmpeq_epi16(va,ROARING_ROT16(vb,7)));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq) & 0x5555;
+        uint16_t amax = a[i+7], bmax = b[j+7];
+
+        while (mask) {
+            out[k++] = a[i+__builtin_ctz(mask)/2];
+            mask &= mask-1;
+        }
+        if (amax <= bmax) i += 8;
+        if (bmax <= amax) j += 8;
+    }
+#undef ROARING_ROT16
+    *pi = i;
+    *pj = j;
+    return k;
+}
+#endif
+
+/* 两个数组的运算，结果写入out(容量na+nb)，返回元素数量 */
+static uint32_t arrayArrayOp(const uint16_t *a, uint32_t na, const uint16_t *b, uint32_t nb,
+                             uint16_t *out, int op) {
+    uint32_t i = 0, j = 0, k = 0;
+
+#if defined(__SSE2__)
+    if (op == ROARING_OP_AND) k = arrayIntersectSSE2(a,na,b,nb,out,&i,&j);
+#endif
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            if (op != ROARING_OP_AND) out[k++] = a[i];
+            i++;
+        } else if (a[i] > b[j]) {
+            if (op == ROARING_OP_OR || op == ROARING_OP_XOR) out[k++] = b[j];
+            j++;
+        } else {
+            if (op == ROARING_OP_AND || op == ROARING_OP_OR) out[k++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    if (op != ROARING_OP_AND)
+        while (i < na) out[k++] = a[i++];
+    if (op == ROARING_OP_OR || op == ROARING_OP_XOR)
+        while (j < nb) out[k++] = b[j++];
+    return k;
+}
+
+/* 两个位图的运算，返回结果的基数 */
+static uint32_t bitmapBitmapOp(const uint64_t *a, const uint64_t *b, uint64_t *out, int op) {
+    uint32_t i = 0;
+
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+
+#define ROARING_BITMAP_LOOP(expr) \
+    for (i = 0; i < ROARING_BITMAP_WORDS; i += 2) { \
+        __m128i va = _mm_loadu_si128((const __m128i*)(a+i)); \
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b+i)); \
+        __m128i vr = expr; \
+        _mm_storeu_si128((__m128i*)(out+i),vr); \
+        _roaringPopcountAdd(acc,vr); \
+    }
+    switch (op) {
+    case ROARING_OP_AND: ROARING_BITMAP_LOOP(_mm_and_si128(va,vb)); break;
+    case ROARING_OP_OR: ROARING_BITMAP_LOOP(_mm_or_si128(va,vb)); break;
+    case ROARING_OP_XOR: ROARING_BITMAP_LOOP(_mm_xor_si128(va,vb)); break;
+    default: ROARING_BITMAP_LOOP(_mm_andnot_si128(vb,va)); break;
+    }
+#undef ROARING_BITMAP_LOOP
+    return (uint32_t)_roaringPopcountSum(acc);
+#else
+    uint32_t card = 0;
+
+    for (i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        switch (op) {
+        case ROARING_OP_AND: out[i] = a[i] & b[i]; break;
+        case ROARING_OP_OR: out[i] = a[i] | b[i]; break;
+        case ROARING_OP_XOR: out[i] = a[i] ^ b[i]; break;
+        default: out[i] = a[i] & ~b[i]; break;
+        }
+        card += __builtin_popcountll(out[i]);
+    }
+    return card;
+#endif
+}
+
+/* 结果容器按基数选择数组或位图 */
+static void containerNormalize(roaringContainer *c) {
+    if (c->type == ROARING_BITMAP && c->card <= ROARING_ARRAY_MAX)
+        containerToArray(c);
+    else if (c->type == ROARING_ARRAY && c->card > ROARING_ARRAY_MAX)
+        containerToBitmap(c);
+}
+
+/* 容器a与b的运算，结果写入dst，返回0代表结果为空 */
+static int containerOp(roaringContainer *dst, const roaringContainer *a, const roaringContainer *b, int op) {
+    roaringContainer ta, tb;
+    int swapped = 0;
+
+    /* 游程容器先展开为位图 */
+    if (a->type == ROARING_RUN) {
+        containerCopy(&ta,a);
+        containerToBitmap(&ta);
+        a = &ta;
+    }
+    if (b->type == ROARING_RUN) {
+        containerCopy(&tb,b);
+        containerToBitmap(&tb);
+        b = &tb;
+    }
+
+    memset(dst,0,sizeof(*dst));
+    if (a->type == ROARING_ARRAY && b->type == ROARING_ARRAY) {
+        uint16_t *out = zmalloc((a->n+b->n)*sizeof(uint16_t));
+
+        dst->type = ROARING_ARRAY;
+        dst->data = out;
+        dst->card = dst->n = dst->cap = arrayArrayOp(a->data,a->n,b->data,b->n,out,op);
+    } else if (a->type == ROARING_BITMAP && b->type == ROARING_BITMAP) {
+        dst->type = ROARING_BITMAP;
+        dst->data = zmalloc(ROARING_BITMAP_BYTES);
+        dst->card = bitmapBitmapOp(a->data,b->data,dst->data,op);
+    } else {
+        /* 一边数组一边位图，arr为数组一边 */
+        const roaringContainer *arr = a, *bm = b;
+        const uint16_t *v;
+        const uint64_t *words;
+        uint32_t i;
+
+        if (a->type == ROARING_BITMAP) {
+            arr = b;
+            bm = a;
+            swapped = 1;
+        }
+        v = arr->data;
+        words = bm->data;
+        if (op == ROARING_OP_AND || (op == ROARING_OP_ANDNOT && !swapped)) {
+            /* 数组中在(不在)位图里的元素 */
+            uint16_t *out = zmalloc(arr->n*sizeof(uint16_t));
+            uint32_t k = 0, want = op == ROARING_OP_AND;
+
+            for (i = 0; i < arr->n; i++) {
+                out[k] = v[i];
+                k += ((words[v[i] >> 6] >> (v[i] & 63)) & 1) == want;
+            }
+            dst->type = ROARING_ARRAY;
+            dst->data = out;
+            dst->card = dst->n = dst->cap = k;
+        } else {
+            /* 复制位图后按数组置位、翻转或清零 */
+            uint64_t *out = zmalloc(ROARING_BITMAP_BYTES);
+            uint32_t card = bm->card;
+
+            memcpy(out,words,ROARING_BITMAP_BYTES);
+            for (i = 0; i < arr->n; i++) {
+                uint64_t bit = (uint64_t)1 << (v[i] & 63), *w = out+(v[i] >> 6);
+                int set = (*w & bit) != 0;
+
+                if (op == ROARING_OP_OR) {
+                    *w |= bit;
+                    card += !set;
+                } else if (op == ROARING_OP_XOR) {
+                    *w ^= bit;
+                    card += set ? -1 : 1;
+                } else {
+                    *w &= ~bit;
+                    card -= set;
+                }
+            }
+            dst->type = ROARING_BITMAP;
+            dst->data = out;
+            dst->card = card;
+        }
+    }
+
+    if (a == &ta) zfree(ta.data);
+    if (b == &tb) zfree(tb.data);
+    if (dst->card == 0) {
+        zfree(dst->data);
+        return 0;
+    }
+    containerNormalize(dst);
+    return 1;
+}
+
+/* 把容器转换为数组、位图、游程三种表示中最小的一种 */
+static void containerOptimize(roaringContainer *c) {
+    uint32_t nruns;
+    size_t runsize, othersize;
+
+    if (c->type == ROARING_ARRAY) {
+        const uint16_t *a = c->data;
+        uint32_t i;
+
+        nruns = c->n ? 1 : 0;
+        for (i = 1; i < c->n; i++) nruns += a[i] != a[i-1]+1;
+    } else if (c->type == ROARING_BITMAP) {
+        nruns = roaringBitmapRuns(c->data);
+    } else {
+        nruns = c->n;
+    }
+
+    runsize = nruns*sizeof(roaringRun);
+    othersize = c->card <= ROARING_ARRAY_MAX ? c->card*sizeof(uint16_t) : ROARING_BITMAP_BYTES;
+    if (runsize < othersize) {
+        containerToRun(c,nruns);
+    } else if (c->card <= ROARING_ARRAY_MAX) {
+        containerToArray(c);
+    } else {
+        containerToBitmap(c);
+    }
+
+    /* 释放数组与游程数组多余的容量 */
+    if (c->type != ROARING_BITMAP && c->cap > c->n) {
+        size_t elesize = c->type == ROARING_ARRAY ? sizeof(uint16_t) : sizeof(roaringRun);
+        c->data = zrealloc(c->data,c->n*elesize);
+        c->cap = c->n;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * Roaring bitmap API
+ *----------------------------------------------------------------------------*/
+
+roaring *roaringNew(void) {
+    roaring *r = zmalloc(sizeof(*r));
+
+    r->n = r->cap = 0;
+    r->keys = NULL;
+    r->containers = NULL;
+    r->card = 0;
+    return r;
+}
+
+void roaringFree(roaring *r) {
+    uint32_t i;
+
+    for (i = 0; i < r->n; i++) zfree(r->containers[i].data);
+    zfree(r->keys);
+    zfree(r->containers);
+    zfree(r);
+}
+
+roaring *roaringDup(const roaring *r) {
+    roaring *dup = roaringNew();
+    uint32_t i;
+
+    if (r->n == 0) return dup;
+    dup->n = dup->cap = r->n;
+    dup->keys = zmalloc(r->n*sizeof(uint16_t));
+    dup->containers = zmalloc(r->n*sizeof(roaringContainer));
+    memcpy(dup->keys,r->keys,r->n*sizeof(uint16_t));
+    for (i = 0; i < r->n; i++) containerCopy(dup->containers+i,r->containers+i);
+    dup->card = r->card;
+    return dup;
+}
+
+/* 查找key对应的容器，不存在时pos为插入位置。连续写入时通常是最后一个容器 */
+static int roaringFindKey(const roaring *r, uint16_t key, uint32_t *pos) {
+    uint32_t lo = 0, hi = r->n;
+
+    if (r->n && r->keys[r->n-1] <= key) {
+        *pos = r->keys[r->n-1] == key ? r->n-1 : r->n;
+        return r->keys[r->n-1] == key;
+    }
+    while (lo < hi) {
+        uint32_t mid = (lo+hi)/2;
+        if (r->keys[mid] < key)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    *pos = lo;
+    return lo < r->n && r->keys[lo] == key;
+}
+
+/* 在pos插入容器c */
+static void roaringInsertContainer(roaring *r, uint32_t pos, uint16_t key, const roaringContainer *c) {
+    if (r->n == r->cap) {
+        r->cap = r->cap < 4 ? 4 : r->cap*2;
+        r->keys = zrealloc(r->keys,r->cap*sizeof(uint16_t));
+        r->containers = zrealloc(r->containers,r->cap*sizeof(roaringContainer));
+    }
+    memmove(r->keys+pos+1,r->keys+pos,(r->n-pos)*sizeof(uint16_t));
+    memmove(r->containers+pos+1,r->containers+pos,(r->n-pos)*sizeof(roaringContainer));
+    r->keys[pos] = key;
+    r->containers[pos] = *c;
+    r->n++;
+}
+
+static void roaringRemoveContainer(roaring *r, uint32_t pos) {
+    zfree(r->containers[pos].data);
+    memmove(r->keys+pos,r->keys+pos+1,(r->n-pos-1)*sizeof(uint16_t));
+    memmove(r->containers+pos,r->containers+pos+1,(r->n-pos-1)*sizeof(roaringContainer));
+    r->n--;
+}
+
+/* 加入x，返回1代表x原先不存在 */
+int roaringAdd(roaring *r, uint32_t x) {
+    uint32_t pos;
+
+    if (!roaringFindKey(r,x >> 16,&pos)) {
+        roaringContainer c = {ROARING_ARRAY,0,0,0,NULL};
+        roaringInsertContainer(r,pos,x >> 16,&c);
+    }
+    if (!containerAdd(r->containers+pos,x & 0xffff)) return 0;
+    r->card++;
+    return 1;
+}
+
+/* 删除x，返回1代表x原先存在 */
+int roaringRemove(roaring *r, uint32_t x) {
+    uint32_t pos;
+
+    if (!roaringFindKey(r,x >> 16,&pos) || !containerRemove(r->containers+pos,x & 0xffff))
+        return 0;
+    if (r->containers[pos].card == 0) roaringRemoveContainer(r,pos);
+    r->card--;
+    return 1;
+}
+
+int roaringContains(const roaring *r, uint32_t x) {
+    uint32_t pos;
+
+    return roaringFindKey(r,x >> 16,&pos) && containerContains(r->containers+pos,x & 0xffff);
+}
+
+uint64_t roaringCard(const roaring *r) {
+    return r->card;
+}
+
+/* 小于等于x的元素数量 */
+uint64_t roaringRank(const roaring *r, uint32_t x) {
+    uint64_t rank = 0;
+    uint32_t i;
+
+    for (i = 0; i < r->n && r->keys[i] < (x >> 16); i++) rank += r->containers[i].card;
+    if (i < r->n && r->keys[i] == (x >> 16)) rank += containerRank(r->containers+i,x & 0xffff);
+    return rank;
+}
+
+/* 第rank个元素(从0开始)写入x，rank超出范围时返回0 */
+int roaringSelect(const roaring *r, uint64_t rank, uint32_t *x) {
+    uint32_t i;
+
+    if (rank >= r->card) return 0;
+    for (i = 0; i < r->n; i++) {
+        const roaringContainer *c = r->containers+i;
+
+        if (rank < c->card) {
+            *x = ((uint32_t)r->keys[i] << 16) | containerSelect(c,(uint32_t)rank);
+            return 1;
+        }
+        rank -= c->card;
+    }
+    return 0;
+}
+
+/* 返回a与b运算的结果，为新分配的roaring bitmap */
+roaring *roaringOp(const roaring *a, const roaring *b, int op) {
+    roaring *r = roaringNew();
+    uint32_t i = 0, j = 0;
+    roaringContainer c;
+
+    while (i < a->n || j < b->n) {
+        if (j == b->n || (i < a->n && a->keys[i] < b->keys[j])) {
+            /* 只在a中 */
+            if (op != ROARING_OP_AND) {
+                containerCopy(&c,a->containers+i);
+                roaringInsertContainer(r,r->n,a->keys[i],&c);
+                r->card += c.card;
+            }
+            i++;
+        } else if (i == a->n || b->keys[j] < a->keys[i]) {
+            /* 只在b中 */
+            if (op == ROARING_OP_OR || op == ROARING_OP_XOR) {
+                containerCopy(&c,b->containers+j);
+                roaringInsertContainer(r,r->n,b->keys[j],&c);
+                r->card += c.card;
+            }
+            j++;
+        } else {
+            if (containerOp(&c,a->containers+i,b->containers+j,op)) {
+                containerOptimize(&c);
+                roaringInsertContainer(r,r->n,a->keys[i],&c);
+                r->card += c.card;
+            }
+            i++;
+            j++;
+        }
+    }
+    return r;
+}
+
+/* 把key对应的容器转换为最小的表示，修改完一个容器后调用 */
+void roaringOptimize(roaring *r, uint16_t key) {
+    uint32_t pos;
+
+    if (roaringFindKey(r,key,&pos)) containerOptimize(r->containers+pos);
+}
+
+/* 按升序遍历[min, max]中的元素，回调返回0时停止并返回0 */
+int roaringIterate(const roaring *r, uint32_t min, uint32_t max, roaringIterFunction *fn, void *privdata) {
+    uint32_t i;
+
+    if (min > max) return 1;
+    roaringFindKey(r,min >> 16,&i);
+    for (; i < r->n && r->keys[i] <= (max >> 16); i++) {
+        uint16_t key = r->keys[i];
+        uint16_t lo = key == (min >> 16) ? min & 0xffff : 0;
+        uint16_t hi = key == (max >> 16) ? max & 0xffff : 0xffff;
+
+        if (!containerIterate(r->containers+i,(uint32_t)key << 16,lo,hi,fn,privdata)) return 0;
+    }
+    return 1;
+}
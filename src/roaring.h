@@ -0,0 +1,63 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_ROARING_H
+#define RESP_SERVER_ROARING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* roaring bitmap：32位整数按高16位分组，每组的低16位保存在一个容器中，容器按高16位有序。
+ * 容器有三种：有序的uint16数组(元素不超过ROARING_ARRAY_MAX)、65536位的位图、
+ * 有序的[起点, 长度-1]游程数组，roaringOptimize()把容器转换为三者中最小的一种 */
+#define ROARING_ARRAY 1
+#define ROARING_BITMAP 2
+#define ROARING_RUN 3
+
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_BITMAP_WORDS 1024   /* 65536位 */
+
+typedef struct roaringRun {
+    uint16_t start;
+    uint16_t len;       /* 游程包含len+1个值 */
+} roaringRun;
+
+typedef struct roaringContainer {
+    uint8_t type;
+    uint32_t card;      /* 元素数量，1~65536 */
+    uint32_t n;         /* 数组的元素数量或游程数量，位图不使用 */
+    uint32_t cap;       /* 数组或游程数组的容量 */
+    void *data;         /* uint16_t[cap]、uint64_t[ROARING_BITMAP_WORDS]或roaringRun[cap] */
+} roaringContainer;
+
+typedef struct roaring {
+    uint32_t n, cap;            /* 容器数量与容量 */
+    uint16_t *keys;             /* 容器对应的高16位，升序 */
+    roaringContainer *containers;
+    uint64_t card;              /* 元素总数 */
+} roaring;
+
+/* roaringOp()支持的运算 */
+#define ROARING_OP_AND 0
+#define ROARING_OP_OR 1
+#define ROARING_OP_XOR 2
+#define ROARING_OP_ANDNOT 3
+
+/* roaringIterate()的回调，返回0时停止遍历 */
+typedef int (roaringIterFunction)(void *privdata, uint32_t x);
+
+roaring *roaringNew(void);
+void roaringFree(roaring *r);
+roaring *roaringDup(const roaring *r);
+int roaringAdd(roaring *r, uint32_t x);
+int roaringRemove(roaring *r, uint32_t x);
+int roaringContains(const roaring *r, uint32_t x);
+uint64_t roaringCard(const roaring *r);
+uint64_t roaringRank(const roaring *r, uint32_t x);
+int roaringSelect(const roaring *r, uint64_t rank, uint32_t *x);
+roaring *roaringOp(const roaring *a, const roaring *b, int op);
+void roaringOptimize(roaring *r, uint16_t key);
+int roaringIterate(const roaring *r, uint32_t min, uint32_t max, roaringIterFunction *fn, void *privdata);
+
+#endif //RESP_SERVER_ROARING_H
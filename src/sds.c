@@ -73,37 +73,11 @@ static inline char sdsReqType(size_t string_size) {
 #endif
 }
 
-/* Create a new sds string with the content specified by the 'init' pointer
- * and 'initlen'.
- * If NULL is used for 'init' the string is initialized with zero bytes.
- * If SDS_NOINIT is used, the buffer is left uninitialized;
- *
- * The string is always null-termined (all the sds strings are, always) so
- * even if you create an sds string with:
- *
- * mystring = sdsnewlen("abc",3);
- *
- * You can print the string with printf() as there is an implicit \0 at the
- * end of the string. However the string is binary safe and can contain
- * \0 characters in the middle, as the length is stored in the sds header. */
-sds sdsnewlen(const void *init, size_t initlen) {
-    void *sh;
-    sds s;
-    char type = sdsReqType(initlen);
-    /* Empty strings are usually created in order to append. Use type 8
-     * since type 5 is not good at this. */
-    if (type == SDS_TYPE_5 && initlen == 0) type = SDS_TYPE_8;
-    int hdrlen = sdsHdrSize(type);
-    unsigned char *fp; /* flags pointer. */
+/* Write the header of a string of type 'type' whose buffer is exactly
+ * 'initlen' bytes, before 's'. */
+static void sdsSetHdr(sds s, char type, size_t initlen) {
+    unsigned char *fp = ((unsigned char*)s)-1; /* flags pointer. */
 
-    sh = s_malloc(hdrlen+initlen+1);
-    if (sh == NULL) return NULL;
-    if (init==SDS_NOINIT)
-        init = NULL;
-    else if (!init)
-        memset(sh, 0, hdrlen+initlen+1);
-    s = (char*)sh+hdrlen;
-    fp = ((unsigned char*)s)-1;
     switch(type) {
         case SDS_TYPE_5: {
             *fp = type | (initlen << SDS_TYPE_BITS);
@@ -138,6 +112,38 @@ sds sdsnewlen(const void *init, size_t initlen) {
             break;
         }
     }
+}
+
+/* Create a new sds string with the content specified by the 'init' pointer
+ * and 'initlen'.
+ * If NULL is used for 'init' the string is initialized with zero bytes.
+ * If SDS_NOINIT is used, the buffer is left uninitialized;
+ *
+ * The string is always null-termined (all the sds strings are, always) so
+ * even if you create an sds string with:
+ *
+ * mystring = sdsnewlen("abc",3);
+ *
+ * You can print the string with printf() as there is an implicit \0 at the
+ * end of the string. However the string is binary safe and can contain
+ * \0 characters in the middle, as the length is stored in the sds header. */
+sds sdsnewlen(const void *init, size_t initlen) {
+    void *sh;
+    sds s;
+    char type = sdsReqType(initlen);
+    /* Empty strings are usually created in order to append. Use type 8
+     * since type 5 is not good at this. */
+    if (type == SDS_TYPE_5 && initlen == 0) type = SDS_TYPE_8;
+    int hdrlen = sdsHdrSize(type);
+
+    sh = s_malloc(hdrlen+initlen+1);
+    if (sh == NULL) return NULL;
+    if (init==SDS_NOINIT)
+        init = NULL;
+    else if (!init)
+        memset(sh, 0, hdrlen+initlen+1);
+    s = (char*)sh+hdrlen;
+    sdsSetHdr(s,type,initlen);
     if (initlen && init)
         memcpy(s, init, initlen);
     s[initlen] = '\0';
@@ -161,6 +167,28 @@ sds sdsdup(const sds s) {
     return sdsnewlen(s, sdslen(s));
 }
 
+/* Return the number of bytes needed by sdswrite() to store a string of
+ * 'len' bytes, header and null term included. */
+size_t sdswritelen(size_t len) {
+    return sdsHdrSize(sdsReqType(len))+len+1;
+}
+
+/* Write a copy of the 'len' bytes at 'init' as an sds string in 'buf', that
+ * is at least sdswritelen(len) bytes, and return it. The string has no free
+ * space and is not allocated by itself: it must not be passed to sdsfree()
+ * or to the functions that may reallocate it, like sdscat(). This is how
+ * the string is embedded in another allocation, e.g. a dict entry. */
+sds sdswrite(void *buf, size_t buflen, const void *init, size_t len) {
+    char type = sdsReqType(len);
+    sds s = (char*)buf+sdsHdrSize(type);
+
+    assert(buflen >= sdswritelen(len));
+    sdsSetHdr(s,type,len);
+    memcpy(s,init,len);
+    s[len] = '\0';
+    return s;
+}
+
 /* Free an sds string. No operation is performed if 's' is NULL. */
 void sdsfree(sds s) {
     if (s == NULL) return;
@@ -258,6 +258,8 @@ void sdsIncrLen(sds s, ssize_t incr);
 sds sdsRemoveFreeSpace(sds s);
 size_t sdsAllocSize(sds s);
 void *sdsAllocPtr(sds s);
+size_t sdswritelen(size_t len);
+sds sdswrite(void *buf, size_t buflen, const void *init, size_t len);
 
 /* Export the allocator used by SDS to the program using SDS.
  * Sometimes the program SDS is linked to, may use a different set of
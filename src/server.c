@@ -20,10 +20,128 @@
 #include "reply.h"
 #include "log.h"
 #include "object.h"
+#include "slowlog.h"
+#include "config.h"
+#include "debug.h"
+#include "hotkeys.h"
+#include "db.h"
+#include "t_string.h"
+#include "t_bitops.h"
+#include "t_list.h"
+#include "t_hash.h"
+#include "t_set.h"
+#include "t_zset.h"
+#include "t_roaring.h"
+#include "hyperloglog.h"
+#include "t_stream.h"
+#include "t_timeseries.h"
+#include "t_vector.h"
+#include "blocked.h"
+#include "expire.h"
+#include "evict.h"
+#include "tinylfu.h"
 
 respServer server;
 sharedObjectsStruct shared;
 
+/* 服务端内置命令，用户命令列表中的同名命令优先 */
+respCommand serverCommandTable[] = {
+        {"slowlog", slowlogCommand, -2, -1},
+        {"config", configCommand, -2, -1},
+        {"debug", debugCommand, -2, -1},
+        {"hotkeys", hotkeysCommand, -1, -1},
+        {"get", getCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"set", setCommand, -3, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"mget", mgetCommand, -2, 1, -1, 1, CMD_READONLY},
+        {"mset", msetCommand, -3, 1, -1, 2, CMD_WRITE|CMD_DENYOOM},
+        {"incr", incrCommand, 2, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"decr", decrCommand, 2, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"incrby", incrbyCommand, 3, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"decrby", decrbyCommand, 3, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"strlen", strlenCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"setbit", setbitCommand, 4, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"getbit", getbitCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"bitcount", bitcountCommand, -2, 1, 1, 1, CMD_READONLY},
+        {"bitpos", bitposCommand, -3, 1, 1, 1, CMD_READONLY},
+        {"bitop", bitopCommand, -4, 2, -1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"bitfield", bitfieldCommand, -2, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"lpush", lpushCommand, -3, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"rpush", rpushCommand, -3, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"lpop", lpopCommand, 2, 1, 1, 1, CMD_WRITE},
+        {"rpop", rpopCommand, 2, 1, 1, 1, CMD_WRITE},
+        {"llen", llenCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"lindex", lindexCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"lrange", lrangeCommand, 4, 1, 1, 1, CMD_READONLY},
+        {"ltrim", ltrimCommand, 4, 1, 1, 1, CMD_WRITE},
+        {"hset", hsetCommand, -4, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"hget", hgetCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"hmget", hmgetCommand, -3, 1, 1, 1, CMD_READONLY},
+        {"hgetall", hgetallCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"hdel", hdelCommand, -3, 1, 1, 1, CMD_WRITE},
+        {"hlen", hlenCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"hexists", hexistsCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"hincrby", hincrbyCommand, 4, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"sadd", saddCommand, -3, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"srem", sremCommand, -3, 1, 1, 1, CMD_WRITE},
+        {"sismember", sismemberCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"scard", scardCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"smembers", smembersCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"sinter", sinterCommand, -2, 1, -1, 1, CMD_READONLY},
+        {"sintercard", sintercardCommand, -3, 2, 2, 1, CMD_READONLY},
+        {"sunion", sunionCommand, -2, 1, -1, 1, CMD_READONLY},
+        {"sdiff", sdiffCommand, -2, 1, -1, 1, CMD_READONLY},
+        {"zadd", zaddCommand, -4, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"zincrby", zincrbyCommand, 4, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"zrem", zremCommand, -3, 1, 1, 1, CMD_WRITE},
+        {"zcard", zcardCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"zscore", zscoreCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"zrank", zrankCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"zrange", zrangeCommand, -4, 1, 1, 1, CMD_READONLY},
+        {"zrangebyscore", zrangebyscoreCommand, -4, 1, 1, 1, CMD_READONLY},
+        {"radd", raddCommand, -3, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"rrem", rremCommand, -3, 1, 1, 1, CMD_WRITE},
+        {"rcontains", rcontainsCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"rcard", rcardCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"rrank", rrankCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"rselect", rselectCommand, 3, 1, 1, 1, CMD_READONLY},
+        {"rrange", rrangeCommand, -4, 1, 1, 1, CMD_READONLY},
+        {"rbitop", rbitopCommand, -4, 2, -1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"pfadd", pfaddCommand, -2, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"pfcount", pfcountCommand, -2, 1, -1, 1, CMD_READONLY},
+        {"pfmerge", pfmergeCommand, -2, 1, -1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"xadd", xaddCommand, -5, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"xrange", xrangeCommand, -4, 1, 1, 1, CMD_READONLY},
+        {"xlen", xlenCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"xtrim", xtrimCommand, -4, 1, 1, 1, CMD_WRITE},
+        {"xread", xreadCommand, -4, -1, 0, 0, CMD_READONLY},
+        {"xgroup", xgroupCommand, -2, 2, 2, 1, CMD_WRITE|CMD_DENYOOM},
+        {"xreadgroup", xreadgroupCommand, -7, -1, 0, 0, CMD_WRITE},
+        {"xack", xackCommand, -4, 1, 1, 1, CMD_WRITE},
+        {"xpending", xpendingCommand, -3, 1, 1, 1, CMD_READONLY},
+        {"tscreate", tscreateCommand, -2, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"tsadd", tsaddCommand, -4, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"tsget", tsgetCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"tsrange", tsrangeCommand, -4, 1, 1, 1, CMD_READONLY},
+        {"tsinfo", tsinfoCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"vcreate", vcreateCommand, -4, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"vadd", vaddCommand, -4, 1, 1, 1, CMD_WRITE|CMD_DENYOOM},
+        {"vdel", vdelCommand, -3, 1, 1, 1, CMD_WRITE},
+        {"vknn", vknnCommand, -5, 1, 1, 1, CMD_READONLY},
+        {"vcard", vcardCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"vinfo", vinfoCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"del", delCommand, -2, 1, -1, 1, CMD_WRITE},
+        {"exists", existsCommand, -2, 1, -1, 1, CMD_READONLY},
+        {"expire", expireCommand, 3, 1, 1, 1, CMD_WRITE},
+        {"pexpire", pexpireCommand, 3, 1, 1, 1, CMD_WRITE},
+        {"expireat", expireatCommand, 3, 1, 1, 1, CMD_WRITE},
+        {"pexpireat", pexpireatCommand, 3, 1, 1, 1, CMD_WRITE},
+        {"ttl", ttlCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"pttl", pttlCommand, 2, 1, 1, 1, CMD_READONLY},
+        {"persist", persistCommand, 2, 1, 1, 1, CMD_WRITE},
+        {"dbsize", dbsizeCommand, 1, -1, 0, 0, CMD_READONLY},
+        {"flushdb", flushdbCommand, 1, -1, 0, 0, CMD_WRITE},
+};
+
 void populateCommandTable(respCommand *commandTab, int numCommands) {
     int j;
 
@@ -34,12 +152,34 @@ void populateCommandTable(respCommand *commandTab, int numCommands) {
     }
 }
 
+void populateServerCommandTable(void) {
+    int numCommands = sizeof(serverCommandTable)/sizeof(struct respCommand);
+    int j;
+
+    for (j = 0; j < numCommands; j++) {
+        struct respCommand *c = serverCommandTable + j;
+        sds name = sdsnew(c->name);
+
+        if (dictAdd(server.commands, name, c) != DICT_OK) sdsfree(name);
+    }
+}
+
 void createSharedObjects(void) {
     int j;
     shared.crlf = createObject(OBJ_STRING, sdsnew("\r\n"));
     shared.ok = createObject(OBJ_STRING, sdsnew("+OK\r\n"));
     shared.err = createObject(OBJ_STRING, sdsnew("-ERR\r\n"));
     shared.pong = createObject(OBJ_STRING,sdsnew("+PONG\r\n"));
+    shared.czero = createObject(OBJ_STRING,sdsnew(":0\r\n"));
+    shared.cone = createObject(OBJ_STRING,sdsnew(":1\r\n"));
+    shared.nullbulk = createObject(OBJ_STRING,sdsnew("$-1\r\n"));
+    shared.nullarray = createObject(OBJ_STRING,sdsnew("*-1\r\n"));
+    shared.emptyarray = createObject(OBJ_STRING,sdsnew("*0\r\n"));
+    shared.wrongtypeerr = createObject(OBJ_STRING,sdsnew(
+        "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n"));
+    shared.syntaxerr = createObject(OBJ_STRING,sdsnew("-ERR syntax error\r\n"));
+    shared.oomerr = createObject(OBJ_STRING,sdsnew(
+        "-OOM command not allowed when used memory > 'maxmemory'.\r\n"));
     for (j = 0; j < OBJ_SHARED_INTEGERS; j++) {
         shared.integers[j] =
                 makeObjectShared(createObject(OBJ_STRING,(void*)(long)j));
@@ -251,6 +391,11 @@ long long ustime(void) {
     return ust;
 }
 
+/* Return the UNIX time in milliseconds */
+mstime_t mstime(void) {
+    return ustime()/1000;
+}
+
 void updateCachedTime(int update_daylight_info) {
     server.ustime = ustime();
     server.mstime = server.ustime / 1000;
@@ -270,6 +415,7 @@ void updateCachedTime(int update_daylight_info) {
  */
 void processCommand(client *c) {
     int isProc = 1;
+    long long start, *phase = c->slowlog_phase;
 
     /* c->argv[0]->ptr表示command name */
     c->cmd = lookupCommand(c->argv[0]->ptr);
@@ -286,13 +432,40 @@ void processCommand(client *c) {
     } else if ((c->cmd->arity > 0 && c->cmd->arity != c->argc) ||
                (c->argc < -c->cmd->arity)) {
         serverLog(LL_WARNING, "wrong number of arguments for '%s' command.", c->cmd->name);
+        addReplyErrorFormat(c,"wrong number of arguments for '%s' command",
+                            c->cmd->name);
+        isProc = 0;
+    } else if (server.maxmemory && (c->cmd->flags & CMD_WRITE) &&
+               freeMemoryIfNeeded() == C_ERR && (c->cmd->flags & CMD_DENYOOM)) {
+        /* 写命令执行前按maxmemory淘汰key，仍无法回到限制以下时拒绝会占用更多内存的命令 */
+        addReply(c, shared.oomerr);
         isProc = 0;
     }
 
     if (isProc) {
+        hotkeysFeedCommand(c);
+
+        /* 记录各阶段耗时: 排队耗时为从读取到命令首字节至开始执行，扣除解析耗时 */
+        start = ustime();
+        phase[SLOWLOG_PHASE_PARSE] = c->parse_us;
+        phase[SLOWLOG_PHASE_QUEUE] = start - c->cmd_start_us - c->parse_us;
+        if (phase[SLOWLOG_PHASE_QUEUE] < 0) phase[SLOWLOG_PHASE_QUEUE] = 0;
+
         c->cmd->proc(c);
+
+        updateCachedTime(0);
+        phase[SLOWLOG_PHASE_EXEC] = server.ustime - start;
+        phase[SLOWLOG_PHASE_FLUSH] = 0;
+        latencyHistogramAdd(&c->cmd->latency,phase[SLOWLOG_PHASE_EXEC]);
+        server.stat_numcommands++;
+        c->slowlog_id = slowlogPushEntryIfNeeded(c,c->argv,c->argc,phase);
+        c->slowlog_cmd = c->cmd;
+        c->slowlog_argc = c->argc;
+        c->slowlog_cmd_end_us = server.ustime;
+        c->slowlog_flush_pending = 1;
+    } else {
+        updateCachedTime(0);
     }
-    updateCachedTime(0);
     resetClient(c);
 }
 
@@ -311,9 +484,27 @@ void unlinkClient(client *c) {
         connClose(c->conn);
         c->conn = NULL;
     }
+
+    /* Remove from the list of pending writes if needed. */
+    if (c->flags & CLIENT_PENDING_WRITE) {
+        listNode *ln = listSearchKey(server.clients_pending_write,c);
+        serverAssert(ln != NULL);
+        listDelNode(server.clients_pending_write,ln);
+        c->flags &= ~CLIENT_PENDING_WRITE;
+    }
 }
 
 void freeClient(client *c) {
+    /* 已在异步释放队列中的客户端被直接释放时，需要从队列中移除 */
+    if (c->flags & CLIENT_CLOSE_ASAP) {
+        listNode *ln = listSearchKey(server.clients_to_close,c);
+        serverAssert(ln != NULL);
+        listDelNode(server.clients_to_close,ln);
+    }
+
+    /* 丢弃未完成的增量任务 */
+    unblockClient(c);
+
     sdsfree(c->querybuf);
     c->querybuf = NULL;
     listRelease(c->reply);
@@ -365,6 +556,38 @@ int tcpServer(int port , int backlog) {
     return serverSocket;
 }
 
+uint64_t dictSdsHash(const void *key) {
+    return dictGenHashFunction((unsigned char*)key, sdslen((char*)key));
+}
+
+/* wyhash比SipHash快数倍，但无法防御刻意构造的碰撞key，只用于key不受客户端控制的dict */
+uint64_t dictSdsWyHash(const void *key) {
+    return dictGenWyHashFunction((unsigned char*)key, sdslen((char*)key));
+}
+
+void dictSdsWyHashBatch(const void *const *keys, int count, uint64_t *hashes) {
+    size_t lens[64];
+    int j, n;
+
+    for (; count > 0; keys += n, hashes += n, count -= n) {
+        n = count < 64 ? count : 64;
+        for (j = 0; j < n; j++) lens[j] = sdslen((sds)keys[j]);
+        dictGenWyHashFunctionBatch(keys,lens,n,hashes);
+    }
+}
+
+int dictSdsKeyCompare(void *privdata, const void *key1,
+                      const void *key2)
+{
+    int l1,l2;
+    DICT_NOTUSED(privdata);
+
+    l1 = sdslen((sds)key1);
+    l2 = sdslen((sds)key2);
+    if (l1 != l2) return 0;
+    return memcmp(key1, key2, l1) == 0;
+}
+
 uint64_t dictSdsCaseHash(const void *key) {
     return dictGenCaseHashFunction((unsigned char*)key, sdslen((char*)key));
 }
@@ -384,6 +607,25 @@ void dictSdsDestructor(void *privdata, void *val)
     sdsfree(val);
 }
 
+/* 把sds key复制到dict entry中，见dictType.embedKey */
+size_t dictSdsEmbedKey(void *buf, size_t buflen, const void *key, unsigned char *keyoff) {
+    size_t len = sdslen((sds)key);
+    sds s;
+
+    if (buf == NULL) return sdswritelen(len);
+    s = sdswrite(buf,buflen,key,len);
+    *keyoff = (unsigned char)(s-(char*)buf);
+    return buflen;
+}
+
+void dictObjectDestructor(void *privdata, void *val)
+{
+    DICT_NOTUSED(privdata);
+
+    if (val == NULL) return; /* Lazy freeing will set value to NULL. */
+    decrRefCount(val);
+}
+
 /* Command table. sds string -> command struct pointer. */
 dictType commandTableDictType = {
         dictSdsCaseHash,            /* hash function */
@@ -394,6 +636,73 @@ dictType commandTableDictType = {
         NULL                        /* val destructor */
 };
 
+/* Db->expires dictionary type. The keys are shared with the keyspace
+ * and the values are the expire times stored as signed integers. */
+dictType keyptrDictType = {
+        dictSdsHash,                /* hash function */
+        NULL,                       /* key dup */
+        NULL,                       /* val dup */
+        dictSdsKeyCompare,          /* key compare */
+        NULL,                       /* key destructor */
+        NULL,                       /* val destructor */
+        1                           /* open addressing */
+};
+
+/* Keyspace dictionary type. sds string -> robj. The keys are copied in
+ * the entries, that the expires dictionary shares. */
+dictType dbDictType = {
+        dictSdsHash,                /* hash function */
+        NULL,                       /* key dup */
+        NULL,                       /* val dup */
+        dictSdsKeyCompare,          /* key compare */
+        NULL,                       /* key destructor */
+        dictObjectDestructor,       /* val destructor */
+        1,                          /* open addressing */
+        NULL,                       /* hash batch function */
+        dictSdsEmbedKey             /* embed key */
+};
+
+/* Sets hash table (note that small sets of integers are represented with
+ * intsets). The members are copied in the entries, there are no values. */
+dictType setDictType = {
+        dictSdsHash,                /* hash function */
+        NULL,                       /* key dup */
+        NULL,                       /* val dup */
+        dictSdsKeyCompare,          /* key compare */
+        NULL,                       /* key destructor */
+        NULL,                       /* val destructor */
+        1,                          /* open addressing */
+        NULL,                       /* hash batch function */
+        dictSdsEmbedKey             /* embed key */
+};
+
+/* Sorted sets hash (note: a B+tree is used in addition to the hash table).
+ * The members are shared with the B+tree, which releases them, and the
+ * values are the scores stored as doubles. */
+dictType zsetDictType = {
+        dictSdsHash,                /* hash function */
+        NULL,                       /* key dup */
+        NULL,                       /* val dup */
+        dictSdsKeyCompare,          /* key compare */
+        NULL,                       /* key destructor */
+        NULL,                       /* val destructor */
+        1                           /* open addressing */
+};
+
+/* Hash type hash table (note that small hashes are represented with listpacks).
+ * The fields are copied in the entries, the values are sds strings. */
+dictType hashDictType = {
+        dictSdsHash,                /* hash function */
+        NULL,                       /* key dup */
+        NULL,                       /* val dup */
+        dictSdsKeyCompare,          /* key compare */
+        NULL,                       /* key destructor */
+        dictSdsDestructor,          /* val destructor */
+        1,                          /* open addressing */
+        NULL,                       /* hash batch function */
+        dictSdsEmbedKey             /* embed key */
+};
+
 void initDefaultOptions() {
     server.port = DEFAULT_PORT;
     server.logfile = "\0";
@@ -403,9 +712,44 @@ void initDefaultOptions() {
     server.proto_max_bulk_len = PROTO_MAX_BULK_LEN;
     server.tcpkeepalive = DEFAULT_TCP_KEEPALIVE;
     server.verbosity = LL_NOTICE;
+    server.slowlog_log_slower_than = CONFIG_DEFAULT_SLOWLOG_LOG_SLOWER_THAN;
+    server.slowlog_max_len = CONFIG_DEFAULT_SLOWLOG_MAX_LEN;
+    server.watchdog_period = CONFIG_DEFAULT_WATCHDOG_PERIOD;
+    server.metrics_port = CONFIG_DEFAULT_METRICS_PORT;
+    server.hz = CONFIG_DEFAULT_HZ;
+    server.hotkeys_topk = CONFIG_DEFAULT_HOTKEYS_TOPK;
+    server.hotkeys_decay_period = CONFIG_DEFAULT_HOTKEYS_DECAY_PERIOD;
+    server.active_expire_effort = CONFIG_DEFAULT_ACTIVE_EXPIRE_EFFORT;
+    server.maxmemory = CONFIG_DEFAULT_MAXMEMORY;
+    server.maxmemory_policy = CONFIG_DEFAULT_MAXMEMORY_POLICY;
+    server.maxmemory_samples = CONFIG_DEFAULT_MAXMEMORY_SAMPLES;
+    server.lfu_log_factor = CONFIG_DEFAULT_LFU_LOG_FACTOR;
+    server.lfu_decay_time = CONFIG_DEFAULT_LFU_DECAY_TIME;
+    server.maxmemory_admission = CONFIG_DEFAULT_MAXMEMORY_ADMISSION;
+    server.tinylfu_capacity = CONFIG_DEFAULT_TINYLFU_CAPACITY;
+    server.active_rehashing_budget = CONFIG_DEFAULT_ACTIVE_REHASHING_BUDGET;
+    server.job_slice_us = CONFIG_DEFAULT_JOB_SLICE_US;
+    server.keyspace_hash = CONFIG_DEFAULT_KEYSPACE_HASH;
+    server.list_max_listpack_size = CONFIG_DEFAULT_LIST_MAX_LISTPACK_SIZE;
+    server.list_compress_depth = CONFIG_DEFAULT_LIST_COMPRESS_DEPTH;
+    server.hash_max_listpack_entries = CONFIG_DEFAULT_HASH_MAX_LISTPACK_ENTRIES;
+    server.hash_max_listpack_value = CONFIG_DEFAULT_HASH_MAX_LISTPACK_VALUE;
+    server.set_max_intset_entries = CONFIG_DEFAULT_SET_MAX_INTSET_ENTRIES;
+    server.zset_max_listpack_entries = CONFIG_DEFAULT_ZSET_MAX_LISTPACK_ENTRIES;
+    server.zset_max_listpack_value = CONFIG_DEFAULT_ZSET_MAX_LISTPACK_VALUE;
+    server.hll_sparse_max_bytes = CONFIG_DEFAULT_HLL_SPARSE_MAX_BYTES;
+    server.stream_node_max_bytes = CONFIG_DEFAULT_STREAM_NODE_MAX_BYTES;
+    server.stream_node_max_entries = CONFIG_DEFAULT_STREAM_NODE_MAX_ENTRIES;
+    server.ts_chunk_size = CONFIG_DEFAULT_TS_CHUNK_SIZE;
 }
 
 void initServerAttr() {
+    uint8_t hashseed[16];
+
+    /* 随机化哈希种子，避免针对键空间的哈希碰撞攻击 */
+    getRandomBytes(hashseed,sizeof(hashseed));
+    dictSetHashFunctionSeed(hashseed);
+
     updateCachedTime(1);
     server.el = NULL;
     server.ipFd = -1;
@@ -415,18 +759,59 @@ void initServerAttr() {
     server.commands = dictCreate(&commandTableDictType,NULL);
     server.clients_pending_write = listCreate();
     server.clients_to_close = listCreate();
+    server.blocked_clients = listCreate();
     server.timezone = getTimeZone();
+    server.lruclock = getLRUClock();
+    server.loop_busy_since = 0;
+    server.stat_starttime = server.unixtime;
+    server.stat_numcommands = 0;
+    server.stat_numconnections = 0;
+    server.stat_net_input_bytes = 0;
+    server.stat_net_output_bytes = 0;
+    server.stat_rss = zmalloc_get_rss();
+    server.stat_expiredkeys = 0;
+    server.stat_expired_stale_perc = 0;
+    server.stat_expired_time_cap_reached_count = 0;
+    server.stat_expire_cycle_time_used = 0;
+    server.stat_evictedkeys = 0;
+    server.stat_eviction_time_cap_reached_count = 0;
+    server.stat_keyspace_hits = 0;
+    server.stat_keyspace_misses = 0;
+    server.stat_admission_rejected = 0;
+    memset(server.inst_metric,0,sizeof(server.inst_metric));
+    server.el_busy_start = 0;
+    memset(&server.el_latency,0,sizeof(server.el_latency));
+    server.metrics_fd = -1;
+    server.metrics_clients = listCreate();
+    server.cronloops = 0;
+    server.hotkeys = NULL;
+    server.db = NULL;
+    server.tinylfu = NULL;
+    server.cron_dicts = listCreate();
+    server.watchdog_reported = 0;
 }
 
 /* 处理客户端请求缓冲区数据 */
 void processInputBuffer(client *c) {
+    long long start;
+    unsigned long ret;
+
     while(c->qb_pos < sdslen(c->querybuf)) {
+        /* 客户端即将被释放，不再处理其请求 */
+        if (c->flags & CLIENT_CLOSE_ASAP) break;
+
+        /* 客户端挂起在增量任务上，任务完成后再处理后续请求 */
+        if (c->flags & CLIENT_BLOCKED) break;
+
         /*
          * 1. !c->reqtype即客户端数据类型未确认，当前解析的是一个新的请求命令
          * 2. '*'开头，表明是PROTO_REQ_MULTIBULK类型，符合RESP协议
          * 3. 非'*'开头，表明是PROTO_REQ_INLINE类型，并非RESP协议，为管道命令，用于支持telnet，暂不支持
          */
         if (!c->reqtype) {
+            /* 新命令，计时从读取到首字节的时刻开始 */
+            c->cmd_start_us = c->lastread_us;
+            c->parse_us = 0;
             if (c->querybuf[c->qb_pos] == '*') {
                 c->reqtype = PROTO_REQ_MULTIBULK;
             } else {
@@ -435,14 +820,24 @@ void processInputBuffer(client *c) {
         }
 
         if (c->reqtype == PROTO_REQ_MULTIBULK) {
-            if (processMultibulkBuffer(c) != ERROR_SUCCESS) break;
+            start = ustime();
+            ret = processMultibulkBuffer(c);
+            c->parse_us += ustime() - start;
+            if (ret != ERROR_SUCCESS) break;
         } else {
             serverLog(LL_WARNING, "Unknown request type.");
         }
 
+        /* 空命令"*0\r\n"或"*-1\r\n"，直接重置 */
+        if (c->argc == 0) {
+            resetClient(c);
+            continue;
+        }
+
         /* 执行命令 */
         server.current_client = c;
         processCommand(c);
+        server.current_client = NULL;
     }
 
     /* Trim to pos */
@@ -500,21 +895,26 @@ void readQueryFromClient(eventLoop *el, int fd, void *clientData, int mask) {
             return;
         } else {
             serverLog(LL_WARNING, "Reading from client: %s.", connGetLastError(c->conn));
-            connClose(c->conn);
+            freeClient(c);
             return;
         }
     } else if (nread == 0) {
         serverLog(LL_NOTICE, "Client closed connection.");
-        connClose(c->conn);
+        freeClient(c);
         return;
     }
 
     /* 因querybuf为sds结构，更新sds结构的len属性 */
     sdsIncrLen(c->querybuf,nread);
+    server.stat_net_input_bytes += nread;
+
+    /* 更新缓存时间，作为本次读取到的命令的起始时间 */
+    updateCachedTime(0);
+    c->lastread_us = server.ustime;
 
     if (sdslen(c->querybuf) > server.client_max_querybuf_len) {
         serverLog(LL_WARNING, "Closing client that reached max query buffer length.");
-        connClose(c->conn);
+        freeClient(c);
         return;
     }
 
@@ -545,6 +945,7 @@ client *createClient(connection *conn) {
     }
     uint64_t client_id = ++server.next_client_id;
     c->id = client_id;
+    c->flags = 0;
     c->conn = conn;
     c->bufpos = 0;
     c->qb_pos = 0;
@@ -554,12 +955,22 @@ client *createClient(connection *conn) {
     c->argv = NULL;
     c->argv_len_sum = 0;
     c->cmd = NULL;
+    c->job = NULL;
     c->multibulklen = 0;
     c->bulklen = -1;
     c->sentlen = 0;
     c->reply = listCreate();
     c->reply_bytes = 0;
     c->client_list_node = NULL;
+    c->lastread_us = 0;
+    c->cmd_start_us = 0;
+    c->parse_us = 0;
+    c->slowlog_id = -1;
+    memset(c->slowlog_phase,0,sizeof(c->slowlog_phase));
+    c->slowlog_cmd_end_us = 0;
+    c->slowlog_cmd = NULL;
+    c->slowlog_argc = 0;
+    c->slowlog_flush_pending = 0;
     listSetFreeMethod(c->reply,freeClientReplyValue);
     listSetDupMethod(c->reply,dupClientReplyValue);
     if (conn) linkClient(c);
@@ -607,6 +1018,7 @@ void acceptTcpHandler(eventLoop *el, int fd, void *clientData, int mask) {
         }
 
         conn = connCreateAcceptedSocket(clientFd);
+        conn->state = CONN_STATE_CONNECTED;
 
         if (listLength(server.clients) >= server.maxClient) {
             char *err= "-ERR max number of clients reached.\r\n";
@@ -617,6 +1029,7 @@ void acceptTcpHandler(eventLoop *el, int fd, void *clientData, int mask) {
             return;
         }
 
+        server.stat_numconnections++;
         c = createClient(conn);
         if (NULL == c) {
             serverLog(LL_WARNING, "Error registering fd event for the new client: %s.", connGetLastError(conn));
@@ -629,6 +1042,84 @@ void acceptTcpHandler(eventLoop *el, int fd, void *clientData, int mask) {
 
 }
 
+/* Add a sample to the operations per second array of samples. */
+void trackInstantaneousMetric(int metric, long long current_reading) {
+    long long t = mstime() - server.inst_metric[metric].last_sample_time;
+    long long ops = current_reading -
+                    server.inst_metric[metric].last_sample_count;
+    long long ops_sec;
+
+    ops_sec = t > 0 ? (ops*1000/t) : 0;
+
+    server.inst_metric[metric].samples[server.inst_metric[metric].idx] =
+        ops_sec;
+    server.inst_metric[metric].idx++;
+    server.inst_metric[metric].idx %= STATS_METRIC_SAMPLES;
+    server.inst_metric[metric].last_sample_time = mstime();
+    server.inst_metric[metric].last_sample_count = current_reading;
+}
+
+/* Return the mean of all the samples. */
+long long getInstantaneousMetric(int metric) {
+    int j;
+    long long sum = 0;
+
+    for (j = 0; j < STATS_METRIC_SAMPLES; j++)
+        sum += server.inst_metric[metric].samples[j];
+    return sum / STATS_METRIC_SAMPLES;
+}
+
+/* 将dict加入serverCron的后台维护列表：在时间预算内完成渐进式rehash，
+ * 并在删除大量元素后收缩hash表。释放dict前需先调用unregisterCronDict */
+void registerCronDict(dict *d) {
+    listAddNodeTail(server.cron_dicts,d);
+}
+
+void unregisterCronDict(dict *d) {
+    listNode *ln = listSearchKey(server.cron_dicts,d);
+
+    if (ln) listDelNode(server.cron_dicts,ln);
+}
+
+/* Hash tables are shrunk when the fill drops below HASHTABLE_MIN_FILL, or
+ * HASHTABLE_OA_MIN_FILL for open addressing tables: these pay a whole
+ * slot for every empty position, instead of a pointer. */
+static int htNeedsResize(dict *dict) {
+    long long size, used;
+
+    size = dictSlots(dict);
+    used = dictSize(dict);
+    if (size <= DICT_HT_INITIAL_SIZE) return 0;
+    if (dictIsOpenAddressing(dict))
+        return used*100/size < HASHTABLE_OA_MIN_FILL;
+    return used*100/size < HASHTABLE_MIN_FILL;
+}
+
+/* 后台维护注册的dict，所有dict共用active_rehashing_budget微秒的预算：
+ * 完成进行中的rehash，装载率过低时调用dictResize收缩。开放寻址表每次只
+ * 收缩一个段，因此收缩完成后会继续检查。dictDisableResize期间(如fork子
+ * 进程存在时，避免写时复制)不做任何操作。预算用完时，下次从之后的dict开始 */
+static void dictsCron(void) {
+    long long start, elapsed = 0, budget = server.active_rehashing_budget;
+    unsigned long j, len = listLength(server.cron_dicts);
+
+    if (budget == 0 || !dictResizeEnabled()) return;
+    start = ustime();
+    for (j = 0; j < len && elapsed < budget; j++) {
+        dict *d = listNodeValue(listFirst(server.cron_dicts));
+
+        while (elapsed < budget) {
+            if (!dictIsRehashing(d) &&
+                (!htNeedsResize(d) || dictResize(d) == DICT_ERR)) break;
+            /* 存在安全迭代器时无法rehash */
+            if (dictRehashMicroseconds(d,budget-elapsed) == 0 &&
+                dictIsRehashing(d)) break;
+            elapsed = ustime()-start;
+        }
+        if (elapsed < budget) listRotateHeadToTail(server.cron_dicts);
+    }
+}
+
 int serverCron(struct eventLoop *el, long long id, void *clientData) {
     UNUSED(el);
     UNUSED(id);
@@ -636,10 +1127,46 @@ int serverCron(struct eventLoop *el, long long id, void *clientData) {
 
     /* Update the time cache. */
     updateCachedTime(1);
-    return EVENT_NOMORE;
+    server.lruclock = getLRUClock();
+
+    /* 每100毫秒采样一次瞬时指标 */
+    run_with_period(100) {
+        trackInstantaneousMetric(STATS_METRIC_COMMAND,server.stat_numcommands);
+        trackInstantaneousMetric(STATS_METRIC_NET_INPUT,
+                                 server.stat_net_input_bytes);
+        trackInstantaneousMetric(STATS_METRIC_NET_OUTPUT,
+                                 server.stat_net_output_bytes);
+    }
+
+    /* 读取/proc开销较大，每秒采样一次常驻内存 */
+    run_with_period(1000) {
+        server.stat_rss = zmalloc_get_rss();
+    }
+
+    /* 主动删除过期key */
+    activeExpireCycle(ACTIVE_EXPIRE_CYCLE_SLOW);
+
+    /* 上一次淘汰因超时中止时，继续淘汰直到回到maxmemory以下 */
+    if (server.maxmemory) freeMemoryIfNeeded();
+
+    /* 后台rehash与收缩hash表 */
+    dictsCron();
+
+    /* 关闭超时的指标端口连接 */
+    metricsCron();
+
+    /* 热点key计数定期减半 */
+    run_with_period(server.hotkeys_decay_period*1000) {
+        hotkeysDecay();
+    }
+
+    server.cronloops++;
+    return 1000/server.hz;
 }
 
 void freeClientAsync(client *c) {
+    if (c->flags & CLIENT_CLOSE_ASAP) return;
+    c->flags |= CLIENT_CLOSE_ASAP;
     listAddNodeTail(server.clients_to_close,c);
 }
 
@@ -654,6 +1181,7 @@ int writeToClient(client *c, int handler_installed) {
         if (c->bufpos > 0) {
             nwritten = connWrite(c->conn,c->buf+c->sentlen,c->bufpos-c->sentlen);
             if (nwritten <= 0) break;
+            server.stat_net_output_bytes += nwritten;
             c->sentlen += nwritten;
             totwritten += nwritten;
 
@@ -675,6 +1203,7 @@ int writeToClient(client *c, int handler_installed) {
 
             nwritten = connWrite(c->conn, o->buf + c->sentlen, objlen - c->sentlen);
             if (nwritten <= 0) break;
+            server.stat_net_output_bytes += nwritten;
             c->sentlen += nwritten;
             totwritten += nwritten;
 
@@ -706,17 +1235,25 @@ int writeToClient(client *c, int handler_installed) {
     }
     if (!clientHasPendingReplies(c)) {
         c->sentlen = 0;
+
+        /* 最后一个命令的回复已全部发送，补充慢查询日志的发送阶段耗时 */
+        if (c->slowlog_flush_pending)
+            slowlogUpdateFlushPhase(c, ustime() - c->slowlog_cmd_end_us);
         if (handler_installed) {
-            deleteFileEvent(server.el, c->conn->fd, EVENT_READABLE);
+            deleteFileEvent(server.el, c->conn->fd, EVENT_WRITABLE);
         }
 
     }
     return C_OK;
 }
 
-void sendReplyToClient(connection *conn) {
-    client *c = connGetPrivateData(conn);
-    writeToClient(c,1);
+void sendReplyToClient(eventLoop *el, int fd, void *clientData, int mask) {
+    connection *conn = (connection *)clientData;
+    UNUSED(el);
+    UNUSED(fd);
+    UNUSED(mask);
+
+    writeToClient(connGetPrivateData(conn),1);
 }
 
 void handleClientsWithPendingWrites(void) {
@@ -732,8 +1269,12 @@ void handleClientsWithPendingWrites(void) {
     listRewind(server.clients_pending_write,&li);
     while((ln = listNext(&li))) {
         client *c = listNodeValue(ln);
+        c->flags &= ~CLIENT_PENDING_WRITE;
         listDelNode(server.clients_pending_write,ln);
 
+        /* 即将被释放的客户端无需回复 */
+        if (c->flags & CLIENT_CLOSE_ASAP) continue;
+
         /* 将client回复缓冲区内容写入TCP发送缓冲区 */
         if (writeToClient(c,0) == C_ERR) continue;
 
@@ -747,7 +1288,7 @@ void handleClientsWithPendingWrites(void) {
                                         c->conn->fd,
                                         EVENT_WRITABLE,
                                         sendReplyToClient,
-                                        NULL);
+                                        c->conn);
             if (errorCode != ERROR_SUCCESS) {
                 freeClientAsync(c);
             }
@@ -763,6 +1304,7 @@ int freeClientsInAsyncFreeQueue(void) {
     listRewind(server.clients_to_close,&li);
     while ((ln = listNext(&li)) != NULL) {
         client *c = listNodeValue(ln);
+        c->flags &= ~CLIENT_CLOSE_ASAP;
         freeClient(c);
         listDelNode(server.clients_to_close,ln);
         freed++;
@@ -773,11 +1315,30 @@ int freeClientsInAsyncFreeQueue(void) {
 void beforeSleep(struct eventLoop *el) {
     UNUSED(el);
 
+    /* 过期key较多时执行一次快速过期周期 */
+    activeExpireCycle(ACTIVE_EXPIRE_CYCLE_FAST);
+
+    /* 执行一段增量任务，完成的任务在下面与其他回复一起发送 */
+    processBlockedJobs();
+
     /* 回复缓冲数据写入数据套接字 */
     handleClientsWithPendingWrites();
 
     /* 异步释放client */
     freeClientsInAsyncFreeQueue();
+
+    /* 即将进入休眠，记录本轮事件循环耗时，看门狗不再计时 */
+    if (server.el_busy_start)
+        latencyHistogramAdd(&server.el_latency,ustime()-server.el_busy_start);
+    watchdogLoopIdle();
+}
+
+void afterSleep(struct eventLoop *el) {
+    UNUSED(el);
+
+    /* 从休眠中唤醒，开始计时 */
+    server.el_busy_start = ustime();
+    watchdogLoopBusy(server.el_busy_start);
 }
 
 void initServer(respCommand *commandTab, int numCommands) {
@@ -788,6 +1349,14 @@ void initServer(respCommand *commandTab, int numCommands) {
 
     /* 加载可用命令 */
     populateCommandTable(commandTab, numCommands);
+    populateServerCommandTable();
+
+    /* 初始化慢查询日志 */
+    slowlogInit();
+
+    /* 创建键空间 */
+    initDb();
+    evictionPoolAlloc();
 
     /* 创建事件循环器 */
     server.el = createEventLoop(server.maxClient + CONFIG_FDSET_INCR);
@@ -814,13 +1383,24 @@ void initServer(respCommand *commandTab, int numCommands) {
 
     /* 注册事件循环器的钩子函数 */
     setBeforeSleepProc(server.el, beforeSleep);
+    setAfterSleepProc(server.el, afterSleep);
+
+    /* 开启热点key统计 */
+    if (server.hotkeys_topk) hotkeysSetTopK(server.hotkeys_topk);
+
+    /* 开启指标端口 */
+    if (server.metrics_port) metricsSetPort(server.metrics_port);
+
+    /* 开启看门狗 */
+    if (server.watchdog_period) watchdogEnable(server.watchdog_period);
 
 }
 
 void eventMain() {
     eventLoop *el = server.el;
     while(1) {
-        (void)processEvents(el, EVENT_ALL_EVENTS | EVENT_CALL_BEFORE_SLEEP);
+        (void)processEvents(el, EVENT_ALL_EVENTS | EVENT_CALL_BEFORE_SLEEP |
+                                EVENT_CALL_AFTER_SLEEP);
     }
 }
 
@@ -5,12 +5,15 @@
 #ifndef RESP_SERVER_SERVER_H
 #define RESP_SERVER_SERVER_H
 
+#include <sys/socket.h>
 #include "event.h"
 #include "adlist.h"
 #include "connection.h"
 #include "sds.h"
 #include "object.h"
 #include "dict.h"
+#include "zbtree.h"
+#include "metrics.h"
 
 #define DEFAULT_PORT 2233;
 #define DEFAULT_BACKLOG 511;
@@ -33,6 +36,31 @@
 
 #define DEFAULT_TCP_KEEPALIVE 300
 
+#define CONFIG_DEFAULT_HZ        10      /* Time interrupt calls/sec. */
+#define CONFIG_MIN_HZ            1
+#define CONFIG_MAX_HZ            500
+
+/* Instantaneous metrics tracking. */
+#define STATS_METRIC_SAMPLES 16     /* Number of samples per metric. */
+#define STATS_METRIC_COMMAND 0      /* Number of commands executed. */
+#define STATS_METRIC_NET_INPUT 1    /* Bytes read to network .*/
+#define STATS_METRIC_NET_OUTPUT 2   /* Bytes written to network. */
+#define STATS_METRIC_COUNT 3
+
+/* Using the following macro you can run code inside serverCron() with the
+ * specified period, specified in milliseconds.
+ * The actual resolution depends on server.hz. */
+#define run_with_period(_ms_) if ((_ms_ <= 1000/server.hz) || !(server.cronloops%((_ms_)/(1000/server.hz))))
+
+/* 后台rehash与收缩 */
+#define CONFIG_DEFAULT_ACTIVE_REHASHING_BUDGET 1000 /* 每次serverCron的时间预算(微秒) */
+#define HASHTABLE_MIN_FILL        10      /* 链式hash表装载率低于10%时收缩 */
+#define HASHTABLE_OA_MIN_FILL     25      /* 开放寻址表装载率低于25%时收缩 */
+
+/* Slow log */
+#define CONFIG_DEFAULT_SLOWLOG_LOG_SLOWER_THAN 10000
+#define CONFIG_DEFAULT_SLOWLOG_MAX_LEN 128
+
 #define MAX_ACCEPTS_PER_CALL 1000
 
 #define LONG_STR_SIZE      21          /* Bytes needed for long -> str + '\0' */
@@ -46,6 +74,16 @@
 
 #define NET_MAX_WRITES_PER_EVENT (1024*64)
 
+/* Command flags */
+#define CMD_WRITE (1<<0)            /* 会修改键空间的命令 */
+#define CMD_READONLY (1<<1)         /* 只读命令 */
+#define CMD_DENYOOM (1<<2)          /* 超出maxmemory且无法淘汰时拒绝执行 */
+
+/* Client flags */
+#define CLIENT_PENDING_WRITE (1<<0) /* 客户端位于clients_pending_write链表中 */
+#define CLIENT_CLOSE_ASAP (1<<1)    /* 客户端位于clients_to_close链表中，等待释放 */
+#define CLIENT_BLOCKED (1<<2)       /* 客户端挂起在增量任务上，见blocked.c */
+
 #define C_OK                    0
 #define C_ERR                   -1
 
@@ -56,6 +94,12 @@ typedef void commandProc(client *c);
 typedef long long mstime_t; /* millisecond time type. */
 typedef long long ustime_t; /* microsecond time type. */
 
+/* 有序集合。dict保存member到score的映射，zbt按(score, member)排序，两者共享member */
+typedef struct zset {
+    dict *dict;
+    zbtree *zbt;
+} zset;
+
 typedef struct respCommand {
     // 命令名称，如SET、GET
     char *name;
@@ -65,6 +109,18 @@ typedef struct respCommand {
 
     // 命令参数数量
     int arity;
+
+    // key的位置: 第一个key、最后一个key(负数代表倒数)、步长，用于热点key统计。
+    // firstkey为0时默认argv[1]为key，为负数时代表命令不包含key
+    int firstkey;
+    int lastkey;
+    int keystep;
+
+    // 命令标志，见CMD_*。标记CMD_WRITE的命令执行前会按maxmemory淘汰key
+    int flags;
+
+    // 以下字段由服务端维护，命令列表中无需填写
+    latencyHistogram latency;   /* 执行次数及耗时直方图 */
 }respCommand;
 
 typedef struct respServer {
@@ -77,6 +133,35 @@ typedef struct respServer {
     long long proto_max_bulk_len;           /* 最大RESP协议<length>限度 */
     int tcpkeepalive;                       /* TCP保活时间 */
     int verbosity;                          /* 日志等级 */
+    long long slowlog_log_slower_than;      /* 慢查询阈值(微秒)，负数代表关闭 */
+    unsigned long slowlog_max_len;          /* 慢查询日志最大条数 */
+    int watchdog_period;                    /* 看门狗周期(毫秒)，0代表关闭 */
+    int metrics_port;                       /* Prometheus指标端口，0代表关闭 */
+    int hz;                                 /* serverCron每秒执行次数 */
+    int hotkeys_topk;                       /* 热点key统计数量，0代表关闭 */
+    int hotkeys_decay_period;               /* 热点key计数减半周期(秒) */
+    int active_expire_effort;               /* 主动过期的力度，1~10 */
+    long long maxmemory;                    /* 内存上限(字节)，0代表不限制 */
+    int maxmemory_policy;                   /* 淘汰策略，见MAXMEMORY_* */
+    int maxmemory_samples;                  /* 每次淘汰采样的key数量 */
+    int lfu_log_factor;                     /* LFU计数器对数增长因子 */
+    int lfu_decay_time;                     /* LFU计数器衰减周期(分钟) */
+    int maxmemory_admission;                /* 准入策略，见MAXMEMORY_ADMISSION_* */
+    int tinylfu_capacity;                   /* TinyLFU sketch按多少个key分配空间 */
+    int active_rehashing_budget;            /* serverCron中后台rehash的时间预算(微秒)，0代表关闭 */
+    int job_slice_us;                       /* 每轮事件循环执行增量任务的时间(微秒) */
+    int keyspace_hash;                      /* 键空间的hash函数，见KEYSPACE_HASH_* */
+    int list_max_listpack_size;             /* list每个节点的元素数量(正数)或大小(-1~-5)上限 */
+    int list_compress_depth;                /* list两端不压缩的节点数量，0代表不压缩 */
+    unsigned long hash_max_listpack_entries;/* listpack编码的hash最多保存的field数量 */
+    unsigned long hash_max_listpack_value;  /* listpack编码的hash中field、value的最大长度 */
+    unsigned long set_max_intset_entries;   /* intset编码的set最多保存的元素数量 */
+    unsigned long zset_max_listpack_entries;/* listpack编码的zset最多保存的元素数量 */
+    unsigned long zset_max_listpack_value;  /* listpack编码的zset中member的最大长度 */
+    unsigned long hll_sparse_max_bytes;     /* 稀疏编码的HyperLogLog的最大长度 */
+    unsigned long stream_node_max_bytes;    /* stream的listpack节点的最大字节数 */
+    unsigned long stream_node_max_entries;  /* stream的listpack节点的最大元素数量 */
+    unsigned long ts_chunk_size;            /* 新建时间序列每个块的最大字节数 */
 
     // 其他类
     eventLoop *el;                          /* 事件循环定时器 */
@@ -87,11 +172,58 @@ typedef struct respServer {
     dict *commands;                         /* 已支持的命令表 */
     list *clients_pending_write;            /* 待回复客户端链表 */
     list *clients_to_close;                 /* 待异步释放客户端 */
+    list *blocked_clients;                  /* 挂起在增量任务上的客户端 */
     time_t timezone;                        /* 时区 */
     int daylight_active;
     mstime_t mstime;                        /* 以毫秒为单位的'unixtime' */
     ustime_t ustime;                        /* 以微秒为单位的'unixtime' */
     _Atomic time_t unixtime;
+    _Atomic unsigned int lruclock;          /* LRU时钟，见LRU_CLOCK_RESOLUTION */
+
+    // 慢查询日志
+    struct slowlogEntry *slowlog;           /* 慢查询环形缓冲区 */
+    unsigned long slowlog_used;             /* 环形缓冲区中有效条目数量 */
+    long long slowlog_entry_id;             /* 下一条慢查询日志ID */
+
+    // 统计
+    time_t stat_starttime;                  /* 服务启动时间 */
+    long long stat_numcommands;             /* 已执行命令数量 */
+    long long stat_numconnections;          /* 已接收连接数量 */
+    long long stat_net_input_bytes;         /* 网络读取字节数 */
+    long long stat_net_output_bytes;        /* 网络写入字节数 */
+    size_t stat_rss;                        /* 最近一次采样的常驻内存 */
+    long long stat_expiredkeys;             /* 已删除的过期key数量 */
+    double stat_expired_stale_perc;         /* 主动过期采样中已过期key比例的滑动平均 */
+    long long stat_expired_time_cap_reached_count; /* 主动过期因超时而中止的次数 */
+    long long stat_expire_cycle_time_used;  /* 主动过期累计耗时(微秒) */
+    long long stat_evictedkeys;             /* 因maxmemory被淘汰的key数量 */
+    long long stat_eviction_time_cap_reached_count; /* 淘汰因超时而中止的次数 */
+    long long stat_keyspace_hits;           /* 读取key命中次数 */
+    long long stat_keyspace_misses;         /* 读取key未命中次数 */
+    long long stat_admission_rejected;      /* 未通过准入而被淘汰的新增key数量 */
+    struct {
+        long long last_sample_time;         /* 上次采样时间(毫秒) */
+        long long last_sample_count;        /* 上次采样时的计数 */
+        long long samples[STATS_METRIC_SAMPLES];
+        int idx;
+    } inst_metric[STATS_METRIC_COUNT];      /* 瞬时指标采样 */
+    long long el_busy_start;                /* 本轮事件循环被唤醒的时间 */
+    latencyHistogram el_latency;            /* 每轮事件循环处理耗时 */
+    int metrics_fd;                         /* 指标端口侦听套接字 */
+    list *metrics_clients;                  /* 指标端口的连接，按建立时间排序 */
+    int cronloops;                          /* serverCron执行次数 */
+
+    // 键空间
+    struct respDb *db;                      /* 内置键空间 */
+    struct tinylfu *tinylfu;                /* TinyLFU准入sketch，未开启时为NULL */
+    list *cron_dicts;                       /* 由serverCron执行后台rehash与收缩的dict */
+
+    // 热点key
+    struct hotkeys *hotkeys;                /* 热点key统计，未开启时为NULL */
+
+    // 看门狗
+    _Atomic long long loop_busy_since;      /* 本轮事件循环开始处理事件的时间，0代表休眠中 */
+    long long watchdog_reported;            /* 已报告过的事件循环轮次 */
 }respServer;
 
 typedef struct clientReplyBlock {
@@ -101,6 +233,7 @@ typedef struct clientReplyBlock {
 
 struct client {
     uint64_t id;                    /* 客户端ID */
+    int flags;                      /* 客户端标志，见CLIENT_* */
     connection *conn;               /* 客户端关联的连接 */
     sds querybuf;                   /* 查询缓冲区，用于存放客户端请求数据 */
     size_t qb_pos;                  /* 查询缓冲区最新读取位置 */
@@ -108,6 +241,7 @@ struct client {
     robj **argv;                    /* 当前命令参数 */
     size_t argv_len_sum;            /* 命令所有参数的长度,即所有参数的<length>之和 */
     struct respCommand *cmd;        /* 当前执行命令 */
+    struct blockedJob *job;         /* 挂起的增量任务，见CLIENT_BLOCKED */
     int reqtype;                    /* R请求协议类型 */
     int multibulklen;               /* 当前命令尚未解析的参数个数 */
     long bulklen;                   /* resp协议个数'$<length>\r\n<data>\r\n'中的<length> */
@@ -116,15 +250,47 @@ struct client {
     size_t sentlen;                 /* Amount of bytes already sent in the current
                                         buffer or object being sent. */
     listNode *client_list_node;
+    long long lastread_us;          /* 最近一次读取到数据的时间 */
+    long long cmd_start_us;         /* 当前命令第一个字节被读取的时间 */
+    long long parse_us;             /* 当前命令累计解析耗时 */
+    long long slowlog_id;           /* 最后一个命令的慢查询日志ID，-1代表未记录 */
+    long long slowlog_phase[4];     /* 最后一个命令各阶段耗时，见SLOWLOG_PHASE_* */
+    long long slowlog_cmd_end_us;   /* 最后一个命令执行完毕的时间 */
+    struct respCommand *slowlog_cmd;/* 最后一个执行的命令 */
+    int slowlog_argc;               /* 最后一个命令的参数数量 */
+    int slowlog_flush_pending;      /* 最后一个命令的回复尚未发送完毕 */
     int bufpos;                     /* 固定回复缓冲区的最新操作位置 */
     char buf[PROTO_REPLY_CHUNK_BYTES];  /* 固定回复缓冲区 */
 };
 
 extern respServer server;
 extern sharedObjectsStruct shared;
+extern dictType dbDictType;
+extern dictType keyptrDictType;
+extern dictType hashDictType;
+extern dictType setDictType;
+extern dictType zsetDictType;
 
 void addReplyError(client *c, const char *err);
 
+long long ustime(void);
+long long mstime(void);
+int tcpServer(int port, int backlog);
+int genericAccept(int s, struct sockaddr *sa, socklen_t *len);
+long long getInstantaneousMetric(int metric);
+uint64_t dictSdsHash(const void *key);
+uint64_t dictSdsWyHash(const void *key);
+void dictSdsWyHashBatch(const void *const *keys, int count, uint64_t *hashes);
+int dictSdsKeyCompare(void *privdata, const void *key1, const void *key2);
+void dictSdsDestructor(void *privdata, void *val);
+size_t dictSdsEmbedKey(void *buf, size_t buflen, const void *key, unsigned char *keyoff);
+void dictObjectDestructor(void *privdata, void *val);
+void freeClient(client *c);
+void freeClientAsync(client *c);
+void processInputBuffer(client *c);
+void registerCronDict(dict *d);
+void unregisterCronDict(dict *d);
+
 void respInitOptions(int port, char *logfile, respCommand *commandTab, int numCommand);
 
 void respListenEvent();
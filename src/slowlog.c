@@ -0,0 +1,281 @@
+/* Slowlog implements a system that is able to remember the latest N
+ * queries that took more than M microseconds to execute.
+ *
+ * The execution time to reach to be logged in the slow log is set
+ * using the 'slowlog_log_slower_than' server field, that is the number
+ * of microseconds.
+ *
+ * The number of entries remembered is 'slowlog_max_len'. Entries live in a
+ * preallocated ring buffer indexed by their unique id, so the fast path
+ * (query below the threshold) is just a comparison and never allocates,
+ * and an entry can be found again in O(1) to add the reply flush time once
+ * the reply has been drained.
+ *
+ * Every entry records the time spent by the query in each phase of its
+ * life: parsing, waiting behind other queries of the same client,
+ * execution of the command proc and flushing of the reply.
+ *
+ * Copyright (c) 2009-2012, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <strings.h>
+#include "slowlog.h"
+#include "zmalloc.h"
+#include "reply.h"
+#include "util.h"
+#include "log.h"
+
+static const char *slowlogPhaseName[SLOWLOG_PHASE_NUM] = {
+    "parse", "queue", "exec", "flush"
+};
+
+/* Release the arguments of the entry and mark the slot as empty. */
+static void slowlogClearEntry(slowlogEntry *se) {
+    int j;
+
+    for (j = 0; j < se->argc; j++)
+        decrRefCount(se->argv[j]);
+    zfree(se->argv);
+    se->argv = NULL;
+    se->argc = 0;
+    se->id = -1;
+}
+
+/* Fill the ring buffer slot for the next entry id. 'argc' is the number of
+ * arguments we got, 'real_argc' the number of arguments the query had: when
+ * the latter is bigger the entry reports how many arguments were omitted. */
+static long long slowlogPushEntry(uint64_t client_id, robj **argv, int argc,
+                                  int real_argc, long long *phase)
+{
+    long long id = server.slowlog_entry_id++;
+    slowlogEntry *se = server.slowlog + (id % server.slowlog_max_len);
+    int slargc, j;
+
+    if (se->id != -1) {
+        slowlogClearEntry(se);
+        server.slowlog_used--;
+    }
+
+    slargc = real_argc;
+    if (slargc > SLOWLOG_ENTRY_MAX_ARGC) slargc = SLOWLOG_ENTRY_MAX_ARGC;
+    if (slargc > argc+1) slargc = argc+1;
+    se->argc = slargc;
+    se->argv = zmalloc(sizeof(robj*)*slargc);
+    for (j = 0; j < slargc; j++) {
+        /* Logging too many arguments is a useless memory waste, so we stop
+         * at SLOWLOG_ENTRY_MAX_ARGC, but use the last argument to specify
+         * how many remaining arguments there were in the original command. */
+        if (j >= argc || (slargc != real_argc && j == slargc-1)) {
+            se->argv[j] = createObject(OBJ_STRING,
+                                       sdscatprintf(sdsempty(),"... (%d more arguments)",
+                                                    real_argc-slargc+1));
+        } else if (objIsTagged(argv[j])) {
+            se->argv[j] = getDecodedObject(argv[j]);
+        } else if (!sdsEncodedObject(argv[j])) {
+            se->argv[j] = createObject(OBJ_STRING,sdsfromlonglong((long)argv[j]->ptr));
+        } else if (sdslen(argv[j]->ptr) > SLOWLOG_ENTRY_MAX_STRING) {
+            /* Trim too long strings as well... */
+            sds s = sdsnewlen(argv[j]->ptr, SLOWLOG_ENTRY_MAX_STRING);
+
+            s = sdscatprintf(s,"... (%lu more bytes)",
+                             (unsigned long)
+                                     sdslen(argv[j]->ptr) - SLOWLOG_ENTRY_MAX_STRING);
+            se->argv[j] = createObject(OBJ_STRING,s);
+        } else {
+            se->argv[j] = createStringObject(argv[j]->ptr,sdslen(argv[j]->ptr));
+        }
+    }
+    se->id = id;
+    se->time = time(NULL);
+    se->client_id = client_id;
+    se->duration = 0;
+    for (j = 0; j < SLOWLOG_PHASE_NUM; j++) {
+        se->phase[j] = phase[j];
+        se->duration += phase[j];
+    }
+    server.slowlog_used++;
+    return id;
+}
+
+/* Initialize the slow log. This function should be called a single time
+ * at server startup. */
+void slowlogInit(void) {
+    server.slowlog = NULL;
+    server.slowlog_used = 0;
+    server.slowlog_entry_id = 0;
+    slowlogResize(server.slowlog_max_len);
+}
+
+/* Change the capacity of the ring buffer, retaining the most recent entries
+ * that still fit. */
+void slowlogResize(unsigned long len) {
+    slowlogEntry *old = server.slowlog;
+    unsigned long oldlen = server.slowlog_max_len, j;
+    long long first = server.slowlog_entry_id - (long long)len;
+
+    server.slowlog = len ? zmalloc(sizeof(slowlogEntry)*len) : NULL;
+    for (j = 0; j < len; j++) {
+        server.slowlog[j].id = -1;
+        server.slowlog[j].argc = 0;
+        server.slowlog[j].argv = NULL;
+    }
+    server.slowlog_used = 0;
+
+    for (j = 0; old && j < oldlen; j++) {
+        slowlogEntry *se = old+j;
+
+        if (se->id == -1) continue;
+        if (se->id < first) {
+            slowlogClearEntry(se);
+            continue;
+        }
+        server.slowlog[se->id % len] = *se;
+        server.slowlog_used++;
+    }
+    zfree(old);
+    server.slowlog_max_len = len;
+}
+
+/* Push a new entry into the slow log if the sum of the phases reached the
+ * configured threshold. Returns the id of the new entry, or -1 if the query
+ * was not logged. This function is called for every command, so below the
+ * threshold it must not do any work besides the comparison. */
+long long slowlogPushEntryIfNeeded(client *c, robj **argv, int argc, long long *phase) {
+    long long duration = phase[SLOWLOG_PHASE_PARSE] + phase[SLOWLOG_PHASE_QUEUE] +
+                         phase[SLOWLOG_PHASE_EXEC] + phase[SLOWLOG_PHASE_FLUSH];
+
+    if (server.slowlog_log_slower_than < 0 || server.slowlog_max_len == 0)
+        return -1; /* Slowlog disabled */
+    if (duration < server.slowlog_log_slower_than) return -1;
+    return slowlogPushEntry(c->id,argv,argc,argc,phase);
+}
+
+/* Called once the reply of the last command of the client was completely
+ * written to the socket. If the command was already logged, the flush time
+ * is added to its entry. Otherwise the command may reach the threshold only
+ * because of a slow reader: since its arguments are already gone we log the
+ * command name alone, with the number of omitted arguments. */
+void slowlogUpdateFlushPhase(client *c, long long flush) {
+    long long *phase = c->slowlog_phase;
+    long long duration;
+
+    c->slowlog_flush_pending = 0;
+    if (server.slowlog_log_slower_than < 0 || server.slowlog_max_len == 0)
+        return;
+
+    phase[SLOWLOG_PHASE_FLUSH] = flush;
+    if (c->slowlog_id != -1) {
+        slowlogEntry *se = server.slowlog + (c->slowlog_id % server.slowlog_max_len);
+
+        /* The entry may have been rotated out or reset in the meantime. */
+        if (se->id == c->slowlog_id) {
+            se->phase[SLOWLOG_PHASE_FLUSH] = flush;
+            se->duration += flush;
+        }
+        return;
+    }
+
+    duration = phase[SLOWLOG_PHASE_PARSE] + phase[SLOWLOG_PHASE_QUEUE] +
+               phase[SLOWLOG_PHASE_EXEC] + flush;
+    if (duration < server.slowlog_log_slower_than || c->slowlog_cmd == NULL) return;
+
+    robj *name = createStringObject(c->slowlog_cmd->name,strlen(c->slowlog_cmd->name));
+    slowlogPushEntry(c->id,&name,1,c->slowlog_argc,phase);
+    decrRefCount(name);
+}
+
+/* Remove all the entries from the current slow log. */
+void slowlogReset(void) {
+    unsigned long j;
+
+    for (j = 0; j < server.slowlog_max_len; j++) {
+        if (server.slowlog[j].id != -1) slowlogClearEntry(server.slowlog+j);
+    }
+    server.slowlog_used = 0;
+}
+
+/* The SLOWLOG command. Implements all the subcommands needed to handle the
+ * slow log. */
+void slowlogCommand(client *c) {
+    if (c->argc == 2 && !strcasecmp(c->argv[1]->ptr,"help")) {
+        const char *help[] = {
+"GET [count] -- Return top entries from the slowlog (default: 10)."
+"    Entries are made up of unique slowlog id, unix timestamp,"
+"    total execution time in microseconds, command arguments, client id"
+"    and the per phase time: parse, queue, exec and flush.",
+"LEN -- Return the length of the slowlog.",
+"RESET -- Reset the slowlog.",
+        };
+        int j, n = sizeof(help)/sizeof(help[0]);
+
+        addReplyArrayLen(c,n);
+        for (j = 0; j < n; j++) addReplyStatus(c,help[j]);
+    } else if (c->argc == 2 && !strcasecmp(c->argv[1]->ptr,"reset")) {
+        slowlogReset();
+        addReply(c,shared.ok);
+    } else if (c->argc == 2 && !strcasecmp(c->argv[1]->ptr,"len")) {
+        addReplyLongLong(c,server.slowlog_used);
+    } else if ((c->argc == 2 || c->argc == 3) &&
+               !strcasecmp(c->argv[1]->ptr,"get"))
+    {
+        long long count = 10, id;
+        int sent = 0, j;
+
+        if (c->argc == 3 &&
+            (!string2ll(c->argv[2]->ptr,sdslen(c->argv[2]->ptr),&count) || count < 0))
+        {
+            addReplyError(c,"value is out of range, must be positive");
+            return;
+        }
+        if (count > (long long)server.slowlog_used) count = server.slowlog_used;
+
+        addReplyArrayLen(c,count);
+        for (id = server.slowlog_entry_id-1; sent < count && id >= 0; id--) {
+            slowlogEntry *se = server.slowlog + (id % server.slowlog_max_len);
+
+            if (se->id != id) continue;
+            addReplyArrayLen(c,6);
+            addReplyLongLong(c,se->id);
+            addReplyLongLong(c,se->time);
+            addReplyLongLong(c,se->duration);
+            addReplyArrayLen(c,se->argc);
+            for (j = 0; j < se->argc; j++)
+                addReplyBulk(c,se->argv[j]);
+            addReplyLongLong(c,se->client_id);
+            addReplyArrayLen(c,SLOWLOG_PHASE_NUM*2);
+            for (j = 0; j < SLOWLOG_PHASE_NUM; j++) {
+                addReplyBulkCString(c,slowlogPhaseName[j]);
+                addReplyLongLong(c,se->phase[j]);
+            }
+            sent++;
+        }
+    } else {
+        addReplyErrorFormat(c,"Unknown subcommand or wrong number of arguments for '%s'. Try SLOWLOG HELP.",
+                            (char*)c->argv[1]->ptr);
+    }
+}
@@ -0,0 +1,40 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_SLOWLOG_H
+#define RESP_SERVER_SLOWLOG_H
+
+#include "server.h"
+
+#define SLOWLOG_ENTRY_MAX_ARGC 32
+#define SLOWLOG_ENTRY_MAX_STRING 128
+
+/* Phases of a single request, see the slowlogEntry 'phase' array. */
+#define SLOWLOG_PHASE_PARSE 0   /* Time spent in processMultibulkBuffer(). */
+#define SLOWLOG_PHASE_QUEUE 1   /* From the first byte read to the proc call. */
+#define SLOWLOG_PHASE_EXEC 2    /* Time spent in c->cmd->proc(). */
+#define SLOWLOG_PHASE_FLUSH 3   /* From the proc return to the reply drained. */
+#define SLOWLOG_PHASE_NUM 4
+
+/* This structure defines an entry inside the slow log ring buffer. */
+typedef struct slowlogEntry {
+    robj **argv;
+    int argc;
+    long long id;       /* Unique entry identifier, -1 if the slot is empty. */
+    long long duration; /* Sum of all the phases, in microseconds. */
+    long long phase[SLOWLOG_PHASE_NUM]; /* Per phase time, in microseconds. */
+    time_t time;        /* Unix time at which the query was executed. */
+    uint64_t client_id; /* Client that issued the query. */
+} slowlogEntry;
+
+/* Exported API */
+void slowlogInit(void);
+void slowlogResize(unsigned long len);
+long long slowlogPushEntryIfNeeded(client *c, robj **argv, int argc, long long *phase);
+void slowlogUpdateFlushPhase(client *c, long long flush);
+
+/* Exported commands */
+void slowlogCommand(client *c);
+
+#endif //RESP_SERVER_SLOWLOG_H
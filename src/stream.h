@@ -0,0 +1,83 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_STREAM_H
+#define RESP_SERVER_STREAM_H
+
+#include "server.h"
+#include "rax.h"
+#include "listpack.h"
+
+/* 元素ID：毫秒时间戳与同一毫秒内的序号 */
+typedef struct streamID {
+    uint64_t ms;
+    uint64_t seq;
+} streamID;
+
+/* stream由若干listpack节点组成，rax中以节点第一个元素的ID(主ID，16字节大端序)为key。
+ * 每个节点的格式：
+ *   主元素：count deleted num-fields field_1 ... field_N 0
+ *   元素：flags ms-diff seq-diff [num-fields field_1 value_1 ...|value_1 ...] lp-count
+ * count、deleted为节点中有效与已删除的元素数量，ms-diff、seq-diff为与主ID的差。
+ * 字段与主元素相同的元素设置STREAM_ITEM_FLAG_SAMEFIELDS，只保存值。lp-count为元素除自身
+ * 以外的listpack项数，用于从节点末尾找到最后一个元素 */
+typedef struct stream {
+    rax *rax;               /* 主ID -> listpack节点 */
+    uint64_t length;        /* 有效的元素数量 */
+    streamID last_id;       /* 最大的ID，新元素的ID必须比它大 */
+    rax *cgroups;           /* 消费组名称 -> streamCG */
+} stream;
+
+#define STREAM_ITEM_FLAG_NONE 0
+#define STREAM_ITEM_FLAG_DELETED (1<<0)     /* 元素已被XTRIM删除 */
+#define STREAM_ITEM_FLAG_SAMEFIELDS (1<<1)  /* 元素的字段与主元素相同 */
+
+/* 按ID升序遍历[start, end]中的元素 */
+typedef struct streamIterator {
+    stream *stream;
+    streamID master_id;                 /* 当前节点的主ID */
+    uint64_t master_fields_count;
+    unsigned char *master_fields_start; /* 主元素的第一个字段 */
+    unsigned char *master_fields_ptr;   /* SAMEFIELDS元素下一个字段在主元素中的位置 */
+    int entry_flags;                    /* 当前元素的flags */
+    int64_t fields_left;                /* 当前元素尚未读取的字段数量 */
+    streamID start_id;
+    streamID end_id;
+    raxIterator ri;
+    unsigned char *lp;                  /* 当前节点，NULL代表需要进入下一个节点 */
+    unsigned char *lp_ele;              /* 当前节点中最后读取的项 */
+    unsigned char field_buf[LP_INTBUF_SIZE];
+    unsigned char value_buf[LP_INTBUF_SIZE];
+} streamIterator;
+
+/* 消费组 */
+typedef struct streamCG {
+    streamID last_id;       /* 最后一次交付给消费者的ID */
+    rax *pel;               /* 已交付未确认的元素，ID -> streamNACK */
+    rax *consumers;         /* 消费者名称 -> streamConsumer */
+} streamCG;
+
+typedef struct streamConsumer {
+    mstime_t seen_time;     /* 最近一次读取的时间 */
+    sds name;
+    rax *pel;               /* 交付给该消费者未确认的元素，ID -> streamNACK，与消费组共享 */
+} streamConsumer;
+
+/* 已交付未确认的元素 */
+typedef struct streamNACK {
+    mstime_t delivery_time; /* 最近一次交付的时间 */
+    uint64_t delivery_count;
+    streamConsumer *consumer;
+} streamNACK;
+
+stream *streamNew(void);
+void freeStream(stream *s);
+int streamCompareID(const streamID *a, const streamID *b);
+void streamIteratorStart(streamIterator *si, stream *s, const streamID *start, const streamID *end);
+int streamIteratorGetID(streamIterator *si, streamID *id, int64_t *numfields);
+void streamIteratorGetField(streamIterator *si, unsigned char **field, int64_t *field_len,
+                            unsigned char **value, int64_t *value_len);
+void streamIteratorStop(streamIterator *si);
+
+#endif //RESP_SERVER_STREAM_H
@@ -0,0 +1,653 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 字符串上的位操作命令：SETBIT、GETBIT、BITCOUNT、BITPOS、BITOP、BITFIELD，语义与Redis一致。
+//
+// 修改位的命令先通过dbUnshareStringValue()把值换成私有的RAW对象再原地修改；只读的命令直接读取
+// 值的内容，标记指针与INT编码的值先转换为字符串。BITCOUNT、BITOP的计算在bitops.c中。
+
+#include <unistd.h>
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+#include "server.h"
+#include "db.h"
+#include "t_bitops.h"
+#include "bitops.h"
+#include "reply.h"
+#include "util.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/*-----------------------------------------------------------------------------
+ * Helpers
+ *----------------------------------------------------------------------------*/
+
+/* 解析位偏移。hash为1时是BITFIELD的偏移，"#n"表示第n个bits位宽的整数。
+ * 偏移不能超过proto-max-bulk-len字节，避免SETBIT创建超出协议上限的字符串 */
+static int getBitOffsetFromArgument(client *c, robj *o, uint64_t *offset, int hash, int bits) {
+    long long loffset;
+    char *err = "bit offset is not an integer or out of range";
+    char *p = o->ptr;
+    size_t plen = sdslen(p);
+    int usehash = 0;
+
+    if (hash && plen > 1 && p[0] == '#') usehash = 1;
+    if (string2ll(p+usehash,plen-usehash,&loffset) == 0 || loffset < 0 ||
+        (usehash && loffset > LLONG_MAX/bits))
+    {
+        addReplyError(c,err);
+        return C_ERR;
+    }
+    if (usehash) loffset *= bits;
+    if ((unsigned long long)loffset >= (unsigned long long)server.proto_max_bulk_len*8) {
+        addReplyError(c,err);
+        return C_ERR;
+    }
+    *offset = (uint64_t)loffset;
+    return C_OK;
+}
+
+/* 解析BITFIELD的类型：i1~i64为有符号整数，u1~u63为无符号整数 */
+static int getBitfieldTypeFromArgument(client *c, robj *o, int *sign, int *bits) {
+    char *p = o->ptr;
+    char *err = "Invalid bitfield type. Use something like i16 u8. "
+                "Note that u64 is not supported but i64 is.";
+    long long llbits;
+
+    if (p[0] == 'i' || p[0] == 'I') {
+        *sign = 1;
+    } else if (p[0] == 'u' || p[0] == 'U') {
+        *sign = 0;
+    } else {
+        addReplyError(c,err);
+        return C_ERR;
+    }
+
+    if (string2ll(p+1,sdslen(p)-1,&llbits) == 0 || llbits < 1 ||
+        (*sign == 1 && llbits > 64) || (*sign == 0 && llbits > 63))
+    {
+        addReplyError(c,err);
+        return C_ERR;
+    }
+    *bits = (int)llbits;
+    return C_OK;
+}
+
+/* 为修改位的命令查找key：不存在时创建足够容纳maxbit的全0字符串，存在时换成私有的RAW对象
+ * 并补0到足够的长度。类型不对时回复错误并返回NULL */
+static robj *lookupStringForBitCommand(client *c, uint64_t maxbit) {
+    size_t byte = maxbit >> 3;
+    robj *o = lookupKeyWrite(server.db,c->argv[1]);
+
+    if (o == NULL) {
+        o = createObject(OBJ_STRING,sdsnewlen(NULL,byte+1));
+        dbAdd(server.db,c->argv[1],o);
+    } else {
+        if (checkType(c,o,OBJ_STRING)) return NULL;
+        o = dbUnshareStringValue(server.db,c->argv[1],o);
+        o->ptr = sdsgrowzero(o->ptr,byte+1);
+    }
+    return o;
+}
+
+/* 只读访问字符串值的内容：标记指针与INT编码的值写入llbuf(LONG_STR_SIZE字节)，
+ * o为NULL时返回NULL，长度为0 */
+static const unsigned char *getObjectReadOnlyString(robj *o, size_t *len, char *llbuf) {
+    if (o == NULL) {
+        *len = 0;
+        return NULL;
+    }
+    if (sdsEncodedObject(o)) {
+        *len = sdslen(o->ptr);
+        return o->ptr;
+    }
+    if (objIsTagged(o))
+        *len = taggedObjectToString(o,llbuf,LONG_STR_SIZE);
+    else
+        *len = ll2string(llbuf,LONG_STR_SIZE,(long)o->ptr);
+    return (unsigned char*)llbuf;
+}
+
+/* 把BITCOUNT、BITPOS的[start, end]换算为字节范围。isbit为1时start、end是位偏移，
+ * 首尾字节中不在范围内的位记录在first_mask、last_mask中 */
+static void bitRangeToBytes(long long *start, long long *end, long long totlen, int isbit,
+                            unsigned char *first_mask, unsigned char *last_mask)
+{
+    if (isbit) totlen <<= 3;
+    if (*start < 0) *start = totlen+*start;
+    if (*end < 0) *end = totlen+*end;
+    if (*start < 0) *start = 0;
+    if (*end < 0) *end = 0;
+    if (*end >= totlen) *end = totlen-1;
+    if (isbit && *start <= *end) {
+        *first_mask = ~((1 << (8-(*start & 7)))-1) & 0xff;
+        *last_mask = (1 << (7-(*end & 7)))-1;
+        *start >>= 3;
+        *end >>= 3;
+    }
+}
+
+static int getBitRangeUnitFromArgument(client *c, robj *o, int *isbit) {
+    if (!strcasecmp(o->ptr,"bit")) {
+        *isbit = 1;
+    } else if (!strcasecmp(o->ptr,"byte")) {
+        *isbit = 0;
+    } else {
+        addReply(c,shared.syntaxerr);
+        return C_ERR;
+    }
+    return C_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * Bit Commands
+ *----------------------------------------------------------------------------*/
+
+/* SETBIT key offset bitvalue */
+void setbitCommand(client *c) {
+    robj *o;
+    char *err = "bit is not an integer or out of range";
+    uint64_t bitoffset;
+    size_t byte;
+    int bit, byteval, bitval;
+    long long on;
+
+    if (getBitOffsetFromArgument(c,c->argv[2],&bitoffset,0,0) != C_OK) return;
+    if (getLongLongFromObjectOrReply(c,c->argv[3],&on,err) != C_OK) return;
+    if (on & ~1) {
+        addReplyError(c,err);
+        return;
+    }
+    if ((o = lookupStringForBitCommand(c,bitoffset)) == NULL) return;
+
+    byte = bitoffset >> 3;
+    byteval = ((unsigned char*)o->ptr)[byte];
+    bit = 7-(bitoffset & 0x7);
+    bitval = byteval & (1 << bit);
+    byteval &= ~(1 << bit);
+    byteval |= ((on & 0x1) << bit);
+    ((unsigned char*)o->ptr)[byte] = byteval;
+    addReply(c,bitval ? shared.cone : shared.czero);
+}
+
+/* GETBIT key offset */
+void getbitCommand(client *c) {
+    robj *o;
+    char llbuf[LONG_STR_SIZE];
+    const unsigned char *p;
+    uint64_t bitoffset;
+    size_t byte, len;
+    int bitval = 0;
+
+    if (getBitOffsetFromArgument(c,c->argv[2],&bitoffset,0,0) != C_OK) return;
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_STRING)) return;
+
+    p = getObjectReadOnlyString(o,&len,llbuf);
+    byte = bitoffset >> 3;
+    if (byte < len) bitval = p[byte] & (1 << (7-(bitoffset & 0x7)));
+    addReply(c,bitval ? shared.cone : shared.czero);
+}
+
+/* BITCOUNT key [start end [BYTE|BIT]] */
+void bitcountCommand(client *c) {
+    robj *o;
+    char llbuf[LONG_STR_SIZE];
+    const unsigned char *p;
+    long long start, end, count;
+    unsigned char first_mask = 0, last_mask = 0;
+    size_t len;
+    int isbit = 0;
+
+    if (c->argc == 4 || c->argc == 5) {
+        if (getLongLongFromObjectOrReply(c,c->argv[2],&start,NULL) != C_OK ||
+            getLongLongFromObjectOrReply(c,c->argv[3],&end,NULL) != C_OK) return;
+        if (c->argc == 5 && getBitRangeUnitFromArgument(c,c->argv[4],&isbit) != C_OK) return;
+    } else if (c->argc != 2) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_STRING)) return;
+
+    p = getObjectReadOnlyString(o,&len,llbuf);
+    if (c->argc == 2) {
+        start = 0;
+        end = (long long)len-1;
+    } else {
+        bitRangeToBytes(&start,&end,(long long)len,isbit,&first_mask,&last_mask);
+    }
+    if (start > end) {
+        addReply(c,shared.czero);
+        return;
+    }
+
+    count = (long long)bitopsPopcount(p+start,end-start+1);
+    /* 减去首尾字节中不在范围内的位 */
+    if (first_mask) count -= __builtin_popcount(p[start] & first_mask);
+    if (last_mask) count -= __builtin_popcount(p[end] & last_mask);
+    addReplyLongLong(c,count);
+}
+
+/* BITPOS key bit [start [end [BYTE|BIT]]]
+ * 查找0时如果没有指定end，字符串右侧视为无限多个0；指定了end时只在范围内查找，找不到回复-1 */
+void bitposCommand(client *c) {
+    robj *o;
+    char llbuf[LONG_STR_SIZE];
+    const unsigned char *p;
+    long long bit, start, end, bytes, curbytes, pos;
+    unsigned char first_mask = 0, last_mask = 0, tmpchar;
+    size_t len;
+    int isbit = 0, end_given = 0;
+
+    if (getLongLongFromObjectOrReply(c,c->argv[2],&bit,NULL) != C_OK) return;
+    if (bit != 0 && bit != 1) {
+        addReplyError(c,"The bit argument must be 1 or 0.");
+        return;
+    }
+    if (c->argc > 6) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+    if (c->argc >= 4 && getLongLongFromObjectOrReply(c,c->argv[3],&start,NULL) != C_OK) return;
+    if (c->argc >= 5) {
+        if (getLongLongFromObjectOrReply(c,c->argv[4],&end,NULL) != C_OK) return;
+        end_given = 1;
+    }
+    if (c->argc == 6 && getBitRangeUnitFromArgument(c,c->argv[5],&isbit) != C_OK) return;
+
+    if ((o = lookupKeyRead(server.db,c->argv[1])) == NULL) {
+        addReplyLongLong(c,bit ? -1 : 0);
+        return;
+    }
+    if (checkType(c,o,OBJ_STRING)) return;
+
+    p = getObjectReadOnlyString(o,&len,llbuf);
+    if (c->argc >= 4) {
+        if (!end_given) end = isbit ? ((long long)len << 3)+7 : (long long)len-1;
+        bitRangeToBytes(&start,&end,(long long)len,isbit,&first_mask,&last_mask);
+    } else {
+        start = 0;
+        end = (long long)len-1;
+    }
+    if (start > end) {
+        addReplyLongLong(c,-1);
+        return;
+    }
+
+    bytes = end-start+1;
+    if (first_mask) {
+        /* 首字节中不在范围内的位设为与bit相反的值 */
+        tmpchar = bit ? p[start] & ~first_mask : p[start] | first_mask;
+        if (last_mask && bytes == 1)
+            tmpchar = bit ? tmpchar & ~last_mask : tmpchar | last_mask;
+        pos = bitopsFirstBit(&tmpchar,1,bit);
+        if (bytes == 1 || (pos != -1 && pos != 8)) goto result;
+        start++;
+        bytes--;
+    }
+    /* 尾字节有不在范围内的位时单独处理 */
+    curbytes = bytes-(last_mask ? 1 : 0);
+    if (curbytes > 0) {
+        pos = bitopsFirstBit(p+start,curbytes,bit);
+        if (bytes == curbytes || (pos != -1 && pos != curbytes << 3)) goto result;
+        start += curbytes;
+        bytes -= curbytes;
+    }
+    tmpchar = bit ? p[end] & ~last_mask : p[end] | last_mask;
+    pos = bitopsFirstBit(&tmpchar,1,bit);
+
+result:
+    /* 查找0且指定了end时，范围内全为1回复-1 */
+    if (end_given && bit == 0 && pos == bytes << 3) {
+        addReplyLongLong(c,-1);
+        return;
+    }
+    if (pos != -1) pos += start << 3;
+    addReplyLongLong(c,pos);
+}
+
+/* BITOP AND|OR|XOR|NOT destkey key [key ...]
+ * 结果的长度为最长的源key的长度，较短的源key不足的部分视为0，结果为空时删除destkey。
+ * 回复结果的长度 */
+void bitopCommand(client *c) {
+    char *opname = c->argv[1]->ptr;
+    robj **objects, *o;
+    const unsigned char **src;
+    size_t *len, maxlen = 0;
+    int op, j, numkeys = c->argc-3;
+
+    if (!strcasecmp(opname,"and"))
+        op = BITOP_AND;
+    else if (!strcasecmp(opname,"or"))
+        op = BITOP_OR;
+    else if (!strcasecmp(opname,"xor"))
+        op = BITOP_XOR;
+    else if (!strcasecmp(opname,"not"))
+        op = BITOP_NOT;
+    else {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+    if (op == BITOP_NOT && numkeys != 1) {
+        addReplyError(c,"BITOP NOT must be called with a single source key.");
+        return;
+    }
+
+    /* 先检查所有key的类型 */
+    for (j = 0; j < numkeys; j++) {
+        o = lookupKeyRead(server.db,c->argv[j+3]);
+        if (o && checkType(c,o,OBJ_STRING)) return;
+    }
+
+    /* RAW、EMBSTR编码的源key只增加引用计数，不复制内容 */
+    objects = zmalloc(sizeof(robj*)*numkeys);
+    src = zmalloc(sizeof(unsigned char*)*numkeys);
+    len = zmalloc(sizeof(size_t)*numkeys);
+    for (j = 0; j < numkeys; j++) {
+        o = lookupKeyRead(server.db,c->argv[j+3]);
+        if (o == NULL) {
+            objects[j] = NULL;
+            src[j] = (const unsigned char*)"";
+            len[j] = 0;
+            continue;
+        }
+        objects[j] = getDecodedObject(o);
+        src[j] = objects[j]->ptr;
+        len[j] = sdslen(objects[j]->ptr);
+        if (len[j] > maxlen) maxlen = len[j];
+    }
+
+    if (maxlen) {
+        sds res = sdsnewlen(SDS_NOINIT,maxlen);
+
+        bitopsCombine((unsigned char*)res,maxlen,src,len,numkeys,op);
+        o = createObject(OBJ_STRING,res);
+        setKey(server.db,c->argv[2],o);
+        decrRefCount(o);
+    } else {
+        dbDelete(server.db,c->argv[2]);
+    }
+
+    for (j = 0; j < numkeys; j++)
+        if (objects[j]) decrRefCount(objects[j]);
+    zfree(objects);
+    zfree(src);
+    zfree(len);
+    addReplyLongLong(c,maxlen);
+}
+
+/*-----------------------------------------------------------------------------
+ * BITFIELD
+ *----------------------------------------------------------------------------*/
+
+/* The following set.*Bitfield and get.*Bitfield functions implement setting
+ * and getting arbitrary size (up to 64 bits) signed and unsigned integers
+ * at arbitrary positions into a bitmap.
+ *
+ * The representation considers the bitmap as an array of bits, from left to
+ * right, and the integer is stored in big endian form, starting from the most
+ * significant bit, like SETBIT and GETBIT do. */
+
+static uint64_t getUnsignedBitfield(const unsigned char *p, uint64_t offset, uint64_t bits) {
+    uint64_t value = 0, j;
+
+    for (j = 0; j < bits; j++) {
+        uint64_t byte = offset >> 3;
+        uint64_t bit = 7-(offset & 0x7);
+
+        value = (value << 1) | ((p[byte] >> bit) & 1);
+        offset++;
+    }
+    return value;
+}
+
+static void setUnsignedBitfield(unsigned char *p, uint64_t offset, uint64_t bits, uint64_t value) {
+    uint64_t j;
+
+    for (j = 0; j < bits; j++) {
+        uint64_t bitval = (value & ((uint64_t)1 << (bits-1-j))) != 0;
+        uint64_t byte = offset >> 3;
+        uint64_t bit = 7-(offset & 0x7);
+        uint64_t byteval = p[byte];
+
+        byteval &= ~((uint64_t)1 << bit);
+        byteval |= bitval << bit;
+        p[byte] = byteval & 0xff;
+        offset++;
+    }
+}
+
+static int64_t getSignedBitfield(const unsigned char *p, uint64_t offset, uint64_t bits) {
+    uint64_t value = getUnsignedBitfield(p,offset,bits);
+
+    /* If the top significant bit is 1, propagate it to all the
+     * higher bits for two's complement representation of signed
+     * integers. */
+    if (bits < 64 && (value & ((uint64_t)1 << (bits-1))))
+        value |= ((uint64_t)-1) << bits;
+    return (int64_t)value;
+}
+
+static void setSignedBitfield(unsigned char *p, uint64_t offset, uint64_t bits, int64_t value) {
+    setUnsignedBitfield(p,offset,bits,(uint64_t)value);
+}
+
+#define BFOVERFLOW_WRAP 0
+#define BFOVERFLOW_SAT 1
+#define BFOVERFLOW_FAIL 2
+
+/* value加上incr后是否超出bits位无符号整数的范围：上溢返回1，下溢返回-1，否则返回0。
+ * 溢出时按owtype把回绕(WRAP)或饱和(SAT)后的值写入limit */
+static int checkUnsignedBitfieldOverflow(uint64_t value, int64_t incr, uint64_t bits, int owtype,
+                                         uint64_t *limit)
+{
+    uint64_t max = (bits == 64) ? UINT64_MAX : (((uint64_t)1 << bits)-1);
+    int overflow = 0;
+
+    if (value > max || (incr > 0 && (uint64_t)incr > max-value)) {
+        overflow = 1;
+        if (owtype == BFOVERFLOW_SAT) *limit = max;
+    } else if (incr < 0 && (uint64_t)0-(uint64_t)incr > value) {
+        overflow = -1;
+        if (owtype == BFOVERFLOW_SAT) *limit = 0;
+    }
+    if (overflow && owtype == BFOVERFLOW_WRAP)
+        *limit = (value+(uint64_t)incr) & max;
+    return overflow;
+}
+
+/* 同上，bits位有符号整数。value在范围内时max-value、min-value不会溢出 */
+static int checkSignedBitfieldOverflow(int64_t value, int64_t incr, uint64_t bits, int owtype,
+                                       int64_t *limit)
+{
+    int64_t max = (bits == 64) ? INT64_MAX : (((int64_t)1 << (bits-1))-1);
+    int64_t min = (-max)-1;
+    int overflow = 0;
+
+    if (value > max || (incr > 0 && (bits < 64 || value >= 0) && incr > max-value)) {
+        overflow = 1;
+        if (owtype == BFOVERFLOW_SAT) *limit = max;
+    } else if (value < min || (incr < 0 && (bits < 64 || value < 0) && incr < min-value)) {
+        overflow = -1;
+        if (owtype == BFOVERFLOW_SAT) *limit = min;
+    }
+    if (overflow && owtype == BFOVERFLOW_WRAP) {
+        uint64_t c = (uint64_t)value+(uint64_t)incr;
+
+        /* 截断到bits位并按最高位做符号扩展 */
+        if (bits < 64) {
+            uint64_t mask = ((uint64_t)-1) << bits;
+
+            if (c & ((uint64_t)1 << (bits-1)))
+                c |= mask;
+            else
+                c &= ~mask;
+        }
+        *limit = (int64_t)c;
+    }
+    return overflow;
+}
+
+#define BITFIELDOP_GET 0
+#define BITFIELDOP_SET 1
+#define BITFIELDOP_INCRBY 2
+
+typedef struct bitfieldOp {
+    uint64_t offset;    /* 位偏移 */
+    int64_t i64;        /* SET的值或INCRBY的增量 */
+    int opcode;         /* BITFIELDOP_* */
+    int owtype;         /* BFOVERFLOW_* */
+    int bits;           /* 位宽 */
+    int sign;           /* 是否为有符号整数 */
+} bitfieldOp;
+
+/* 执行一个SET或INCRBY，回复旧值(SET)或新值(INCRBY)，FAIL策略下溢出时不修改并回复nil */
+static void bitfieldWrite(client *c, unsigned char *p, bitfieldOp *op) {
+    int overflow;
+
+    if (op->sign) {
+        int64_t oldval, newval, wrapped = 0;
+
+        oldval = getSignedBitfield(p,op->offset,op->bits);
+        if (op->opcode == BITFIELDOP_INCRBY) {
+            overflow = checkSignedBitfieldOverflow(oldval,op->i64,op->bits,op->owtype,&wrapped);
+            newval = overflow ? wrapped : oldval+op->i64;
+        } else {
+            overflow = checkSignedBitfieldOverflow(op->i64,0,op->bits,op->owtype,&wrapped);
+            newval = overflow ? wrapped : op->i64;
+        }
+        if (overflow && op->owtype == BFOVERFLOW_FAIL) {
+            addReply(c,shared.nullbulk);
+            return;
+        }
+        setSignedBitfield(p,op->offset,op->bits,newval);
+        addReplyLongLong(c,op->opcode == BITFIELDOP_INCRBY ? newval : oldval);
+    } else {
+        uint64_t oldval, newval, wrapped = 0;
+
+        oldval = getUnsignedBitfield(p,op->offset,op->bits);
+        if (op->opcode == BITFIELDOP_INCRBY) {
+            overflow = checkUnsignedBitfieldOverflow(oldval,op->i64,op->bits,op->owtype,&wrapped);
+            newval = overflow ? wrapped : oldval+(uint64_t)op->i64;
+        } else {
+            overflow = checkUnsignedBitfieldOverflow((uint64_t)op->i64,0,op->bits,op->owtype,&wrapped);
+            newval = overflow ? wrapped : (uint64_t)op->i64;
+        }
+        if (overflow && op->owtype == BFOVERFLOW_FAIL) {
+            addReply(c,shared.nullbulk);
+            return;
+        }
+        setUnsignedBitfield(p,op->offset,op->bits,newval);
+        addReplyLongLong(c,(long long)(op->opcode == BITFIELDOP_INCRBY ? newval : oldval));
+    }
+}
+
+/* 执行一个GET，超出字符串长度的部分视为0 */
+static void bitfieldRead(client *c, robj *o, bitfieldOp *op) {
+    unsigned char buf[9] = {0};
+    char llbuf[LONG_STR_SIZE];
+    const unsigned char *p;
+    uint64_t byte = op->offset >> 3;
+    size_t len, i;
+
+    /* 最多跨越9个字节，复制到buf中再读取，不必检查每一位是否越界 */
+    p = getObjectReadOnlyString(o,&len,llbuf);
+    for (i = 0; i < sizeof(buf) && byte+i < len; i++) buf[i] = p[byte+i];
+
+    if (op->sign)
+        addReplyLongLong(c,getSignedBitfield(buf,op->offset-byte*8,op->bits));
+    else
+        addReplyLongLong(c,(long long)getUnsignedBitfield(buf,op->offset-byte*8,op->bits));
+}
+
+/* BITFIELD key [GET type offset] [SET type offset value] [INCRBY type offset increment]
+ *              [OVERFLOW WRAP|SAT|FAIL] ...
+ * 先解析全部子命令，有写操作时一次把字符串扩展到最大的写入位置 */
+void bitfieldCommand(client *c) {
+    robj *o;
+    bitfieldOp *ops = NULL;
+    uint64_t bitoffset, highest_write_offset = 0;
+    int j, numops = 0, owtype = BFOVERFLOW_WRAP, readonly = 1;
+
+    for (j = 2; j < c->argc; j++) {
+        int remargs = c->argc-j-1;
+        char *subcmd = c->argv[j]->ptr;
+        int opcode, sign, bits;
+        long long i64 = 0;
+
+        if (!strcasecmp(subcmd,"get") && remargs >= 2) {
+            opcode = BITFIELDOP_GET;
+        } else if (!strcasecmp(subcmd,"set") && remargs >= 3) {
+            opcode = BITFIELDOP_SET;
+        } else if (!strcasecmp(subcmd,"incrby") && remargs >= 3) {
+            opcode = BITFIELDOP_INCRBY;
+        } else if (!strcasecmp(subcmd,"overflow") && remargs >= 1) {
+            char *owtypename = c->argv[++j]->ptr;
+
+            if (!strcasecmp(owtypename,"wrap")) {
+                owtype = BFOVERFLOW_WRAP;
+            } else if (!strcasecmp(owtypename,"sat")) {
+                owtype = BFOVERFLOW_SAT;
+            } else if (!strcasecmp(owtypename,"fail")) {
+                owtype = BFOVERFLOW_FAIL;
+            } else {
+                addReplyError(c,"Invalid OVERFLOW type specified");
+                zfree(ops);
+                return;
+            }
+            continue;
+        } else {
+            addReply(c,shared.syntaxerr);
+            zfree(ops);
+            return;
+        }
+
+        if (getBitfieldTypeFromArgument(c,c->argv[j+1],&sign,&bits) != C_OK ||
+            getBitOffsetFromArgument(c,c->argv[j+2],&bitoffset,1,bits) != C_OK)
+        {
+            zfree(ops);
+            return;
+        }
+        if (opcode != BITFIELDOP_GET) {
+            readonly = 0;
+            if (highest_write_offset < bitoffset+bits-1)
+                highest_write_offset = bitoffset+bits-1;
+            if (getLongLongFromObjectOrReply(c,c->argv[j+3],&i64,NULL) != C_OK) {
+                zfree(ops);
+                return;
+            }
+        }
+
+        ops = zrealloc(ops,sizeof(bitfieldOp)*(numops+1));
+        ops[numops].offset = bitoffset;
+        ops[numops].i64 = i64;
+        ops[numops].opcode = opcode;
+        ops[numops].owtype = owtype;
+        ops[numops].bits = bits;
+        ops[numops].sign = sign;
+        numops++;
+        j += (opcode == BITFIELDOP_GET) ? 2 : 3;
+    }
+
+    if (readonly) {
+        o = lookupKeyRead(server.db,c->argv[1]);
+        if (o != NULL && checkType(c,o,OBJ_STRING)) {
+            zfree(ops);
+            return;
+        }
+    } else if ((o = lookupStringForBitCommand(c,highest_write_offset)) == NULL) {
+        zfree(ops);
+        return;
+    }
+
+    addReplyArrayLen(c,numops);
+    for (j = 0; j < numops; j++) {
+        if (ops[j].opcode == BITFIELDOP_GET)
+            bitfieldRead(c,o,ops+j);
+        else
+            bitfieldWrite(c,o->ptr,ops+j);
+    }
+    zfree(ops);
+}
@@ -0,0 +1,17 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_BITOPS_H
+#define RESP_SERVER_T_BITOPS_H
+
+#include "server.h"
+
+void setbitCommand(client *c);
+void getbitCommand(client *c);
+void bitcountCommand(client *c);
+void bitposCommand(client *c);
+void bitopCommand(client *c);
+void bitfieldCommand(client *c);
+
+#endif //RESP_SERVER_T_BITOPS_H
@@ -0,0 +1,400 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// hash类型命令。新建的hash使用listpack编码，field与value依次保存在一块连续内存中，
+// field数量超过hash-max-listpack-entries或field、value长度超过hash-max-listpack-value时
+// 转换为dict（OBJ_ENCODING_HT），dict中field嵌入entry，value为sds。转换是单向的。
+
+#include <unistd.h>
+#include "server.h"
+#include "db.h"
+#include "t_hash.h"
+#include "reply.h"
+#include "util.h"
+#include "listpack.h"
+#include "log.h"
+
+#define HASH_SET_COPY 0
+#define HASH_SET_TAKE_VALUE (1<<0)  /* hashTypeSet()接管value */
+
+static void hashTypeConvert(robj *o, int enc);
+
+/*-----------------------------------------------------------------------------
+ * Hash type API
+ *----------------------------------------------------------------------------*/
+
+/* Check the length of a number of objects to see if we need to convert a
+ * listpack to a real hash. Note that we only check string encoded objects
+ * as their string length can be queried in constant time. */
+static void hashTypeTryConversion(robj *o, robj **argv, int start, int end) {
+    size_t sum = 0;
+    int i;
+
+    if (o->encoding != OBJ_ENCODING_LISTPACK) return;
+
+    for (i = start; i <= end; i++) {
+        if (!sdsEncodedObject(argv[i])) continue;
+        size_t len = sdslen(argv[i]->ptr);
+        if (len > server.hash_max_listpack_value) {
+            hashTypeConvert(o,OBJ_ENCODING_HT);
+            return;
+        }
+        sum += len;
+    }
+    if (!lpSafeToAdd(o->ptr,sum)) hashTypeConvert(o,OBJ_ENCODING_HT);
+}
+
+/* Return the number of fields of the hash. */
+static unsigned long hashTypeLength(const robj *o) {
+    if (o->encoding == OBJ_ENCODING_LISTPACK) return lpLength(o->ptr)/2;
+    if (o->encoding == OBJ_ENCODING_HT) return dictSize((const dict*)o->ptr);
+    serverPanic("Unknown hash encoding");
+    return 0;
+}
+
+/* Return the listpack entry of the value associated with 'field', or NULL
+ * if the field does not exist. */
+static unsigned char *hashTypeListpackFind(unsigned char *lp, sds field) {
+    unsigned char *fptr = lpFirst(lp);
+
+    if (fptr == NULL) return NULL;
+    fptr = lpFind(lp,fptr,(unsigned char*)field,sdslen(field),1);
+    if (fptr == NULL) return NULL;
+    return lpNext(lp,fptr);
+}
+
+/* Get the value associated with 'field'. Strings are returned in '*vstr'
+ * and '*vlen', pointing inside the hash, integers stored in the listpack
+ * are returned in '*vll' with '*vstr' set to NULL. Returns C_ERR if the
+ * field does not exist. */
+static int hashTypeGetValue(robj *o, sds field, unsigned char **vstr, unsigned int *vlen, long long *vll) {
+    if (o->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *vptr = hashTypeListpackFind(o->ptr,field);
+        int64_t v;
+
+        if (vptr == NULL) return C_ERR;
+        *vstr = lpGet(vptr,&v,NULL);
+        if (*vstr)
+            *vlen = v;
+        else
+            *vll = v;
+        return C_OK;
+    } else if (o->encoding == OBJ_ENCODING_HT) {
+        dictEntry *de = dictFind(o->ptr,field);
+
+        if (de == NULL) return C_ERR;
+        *vstr = (unsigned char*)dictGetVal(de);
+        *vlen = sdslen(dictGetVal(de));
+        return C_OK;
+    }
+    serverPanic("Unknown hash encoding");
+    return C_ERR;
+}
+
+/* Test if the specified field exists in the given hash. Returns 1 if the field
+ * exists, and 0 when it doesn't. */
+static int hashTypeExists(robj *o, sds field) {
+    unsigned char *vstr = NULL;
+    unsigned int vlen = UINT_MAX;
+    long long vll = LLONG_MAX;
+
+    return hashTypeGetValue(o,field,&vstr,&vlen,&vll) == C_OK;
+}
+
+/* Add a new field, overwrite the old with the new value if it already exists.
+ * Return 0 on insert and 1 on update.
+ *
+ * The field is always copied: in the listpack it is serialized, in the dict
+ * it is embedded in the entry. The value is copied as well, unless the
+ * HASH_SET_TAKE_VALUE flag is passed, in which case the function takes the
+ * ownership of the sds string. */
+static int hashTypeSet(robj *o, sds field, sds value, int flags) {
+    int update = 0;
+
+    if (o->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *lp = o->ptr, *vptr;
+
+        if ((vptr = hashTypeListpackFind(lp,field)) != NULL) {
+            lp = lpInsert(lp,(unsigned char*)value,sdslen(value),vptr,LP_REPLACE,NULL);
+            update = 1;
+        } else {
+            lp = lpAppend(lp,(unsigned char*)field,sdslen(field));
+            lp = lpAppend(lp,(unsigned char*)value,sdslen(value));
+        }
+        o->ptr = lp;
+        if (flags & HASH_SET_TAKE_VALUE) sdsfree(value);
+
+        /* Check if the listpack needs to be converted to a hash table */
+        if (hashTypeLength(o) > server.hash_max_listpack_entries)
+            hashTypeConvert(o,OBJ_ENCODING_HT);
+    } else if (o->encoding == OBJ_ENCODING_HT) {
+        dictEntry *de = dictFind(o->ptr,field);
+        sds v = (flags & HASH_SET_TAKE_VALUE) ? value : sdsdup(value);
+
+        if (de) {
+            sdsfree(dictGetVal(de));
+            dictSetVal((dict*)o->ptr,de,v);
+            update = 1;
+        } else {
+            dictAdd(o->ptr,field,v);
+        }
+    } else {
+        serverPanic("Unknown hash encoding");
+    }
+    return update;
+}
+
+/* Delete an element from a hash.
+ * Return 1 on deleted and 0 on not found. */
+static int hashTypeDelete(robj *o, sds field) {
+    int deleted = 0;
+
+    if (o->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *lp = o->ptr, *fptr;
+
+        fptr = lpFirst(lp);
+        if (fptr != NULL) {
+            fptr = lpFind(lp,fptr,(unsigned char*)field,sdslen(field),1);
+            if (fptr != NULL) {
+                /* Delete both the field and the value. */
+                o->ptr = lpDeleteRangeWithEntry(lp,&fptr,2);
+                deleted = 1;
+            }
+        }
+    } else if (o->encoding == OBJ_ENCODING_HT) {
+        deleted = dictDelete((dict*)o->ptr,field) == DICT_OK;
+    } else {
+        serverPanic("Unknown hash encoding");
+    }
+    return deleted;
+}
+
+static void hashTypeConvertListpack(robj *o, int enc) {
+    serverAssert(o->encoding == OBJ_ENCODING_LISTPACK);
+
+    if (enc == OBJ_ENCODING_LISTPACK) {
+        /* Nothing to do... */
+    } else if (enc == OBJ_ENCODING_HT) {
+        unsigned char *lp = o->ptr, *p;
+        unsigned char buf[LP_INTBUF_SIZE];
+        dict *d = dictCreate(&hashDictType,NULL);
+        sds field = sdsempty();
+
+        dictExpand(d,lpLength(lp)/2);
+        p = lpFirst(lp);
+        while (p) {
+            unsigned char *s;
+            int64_t len;
+
+            /* The field is copied in the dict entry, so one buffer is
+             * enough for all of them. */
+            s = lpGet(p,&len,buf);
+            field = sdscpylen(field,(char*)s,len);
+            p = lpNext(lp,p);
+            s = lpGet(p,&len,buf);
+            if (dictAdd(d,field,sdsnewlen(s,len)) != DICT_OK)
+                serverPanic("Listpack corruption detected");
+            p = lpNext(lp,p);
+        }
+        sdsfree(field);
+        lpFree(lp);
+        o->encoding = OBJ_ENCODING_HT;
+        o->ptr = d;
+    } else {
+        serverPanic("Unknown hash encoding");
+    }
+}
+
+static void hashTypeConvert(robj *o, int enc) {
+    if (o->encoding == OBJ_ENCODING_LISTPACK) {
+        hashTypeConvertListpack(o,enc);
+    } else if (o->encoding == OBJ_ENCODING_HT) {
+        serverPanic("Not implemented");
+    } else {
+        serverPanic("Unknown hash encoding");
+    }
+}
+
+static robj *hashTypeLookupWriteOrCreate(client *c, robj *key) {
+    robj *o = lookupKeyWrite(server.db,key);
+
+    if (o == NULL) {
+        o = createHashObject();
+        dbAdd(server.db,key,o);
+    } else if (checkType(c,o,OBJ_HASH)) {
+        return NULL;
+    }
+    return o;
+}
+
+static void addHashFieldToReply(client *c, robj *o, sds field) {
+    unsigned char *vstr = NULL;
+    unsigned int vlen = UINT_MAX;
+    long long vll = LLONG_MAX;
+
+    if (o == NULL || hashTypeGetValue(o,field,&vstr,&vlen,&vll) == C_ERR) {
+        addReply(c,shared.nullbulk);
+    } else if (vstr) {
+        addReplyBulkCBuffer(c,vstr,vlen);
+    } else {
+        addReplyBulkLongLong(c,vll);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * Hash type commands
+ *----------------------------------------------------------------------------*/
+
+/* HSET key field value [field value ...] */
+void hsetCommand(client *c) {
+    int i, created = 0;
+    robj *o;
+
+    if ((c->argc % 2) == 1) {
+        addReplyError(c,"wrong number of arguments for HSET");
+        return;
+    }
+
+    if ((o = hashTypeLookupWriteOrCreate(c,c->argv[1])) == NULL) return;
+    hashTypeTryConversion(o,c->argv,2,c->argc-1);
+
+    for (i = 2; i < c->argc; i += 2)
+        created += !hashTypeSet(o,c->argv[i]->ptr,c->argv[i+1]->ptr,HASH_SET_COPY);
+
+    addReplyLongLong(c,created);
+}
+
+/* HGET key field */
+void hgetCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.nullbulk)) == NULL ||
+        checkType(c,o,OBJ_HASH)) return;
+
+    addHashFieldToReply(c,o,c->argv[2]->ptr);
+}
+
+/* HMGET key field [field ...] */
+void hmgetCommand(client *c) {
+    robj *o;
+    int i;
+
+    /* Don't abort when the key cannot be found. Non-existing keys are empty
+     * hashes, where HMGET should respond with a series of null bulks. */
+    o = lookupKeyRead(server.db,c->argv[1]);
+    if (o != NULL && checkType(c,o,OBJ_HASH)) return;
+
+    addReplyArrayLen(c,c->argc-2);
+    for (i = 2; i < c->argc; i++)
+        addHashFieldToReply(c,o,c->argv[i]->ptr);
+}
+
+/* HGETALL key */
+void hgetallCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,o,OBJ_HASH)) return;
+
+    addReplyArrayLen(c,hashTypeLength(o)*2);
+    if (o->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *lp = o->ptr, *p = lpFirst(lp);
+
+        while (p) {
+            unsigned char *s;
+            int64_t v;
+
+            s = lpGet(p,&v,NULL);
+            if (s)
+                addReplyBulkCBuffer(c,s,v);
+            else
+                addReplyBulkLongLong(c,v);
+            p = lpNext(lp,p);
+        }
+    } else if (o->encoding == OBJ_ENCODING_HT) {
+        dictIterator *di = dictGetIterator(o->ptr);
+        dictEntry *de;
+
+        while ((de = dictNext(di)) != NULL) {
+            sds field = dictGetKey(de), value = dictGetVal(de);
+
+            addReplyBulkCBuffer(c,field,sdslen(field));
+            addReplyBulkCBuffer(c,value,sdslen(value));
+        }
+        dictReleaseIterator(di);
+    } else {
+        serverPanic("Unknown hash encoding");
+    }
+}
+
+/* HDEL key field [field ...] */
+void hdelCommand(client *c) {
+    robj *o;
+    int j, deleted = 0;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_HASH)) return;
+
+    for (j = 2; j < c->argc; j++) {
+        if (hashTypeDelete(o,c->argv[j]->ptr)) {
+            deleted++;
+            if (hashTypeLength(o) == 0) {
+                dbDelete(server.db,c->argv[1]);
+                break;
+            }
+        }
+    }
+    addReplyLongLong(c,deleted);
+}
+
+/* HLEN key */
+void hlenCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_HASH)) return;
+
+    addReplyLongLong(c,hashTypeLength(o));
+}
+
+/* HEXISTS key field */
+void hexistsCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_HASH)) return;
+
+    addReply(c,hashTypeExists(o,c->argv[2]->ptr) ? shared.cone : shared.czero);
+}
+
+/* HINCRBY key field increment */
+void hincrbyCommand(client *c) {
+    long long value, incr, oldvalue;
+    robj *o;
+    unsigned char *vstr;
+    unsigned int vlen;
+
+    if (getLongLongFromObjectOrReply(c,c->argv[3],&incr,NULL) != C_OK) return;
+    if ((o = hashTypeLookupWriteOrCreate(c,c->argv[1])) == NULL) return;
+    if (hashTypeGetValue(o,c->argv[2]->ptr,&vstr,&vlen,&value) == C_OK) {
+        if (vstr) {
+            if (string2ll((char*)vstr,vlen,&value) == 0) {
+                addReplyError(c,"hash value is not an integer");
+                return;
+            }
+        } /* Else hashTypeGetValue() already stored it into &value */
+    } else {
+        value = 0;
+    }
+
+    oldvalue = value;
+    if ((incr < 0 && oldvalue < 0 && incr < (LLONG_MIN-oldvalue)) ||
+        (incr > 0 && oldvalue > 0 && incr > (LLONG_MAX-oldvalue))) {
+        addReplyError(c,"increment or decrement would overflow");
+        return;
+    }
+    value += incr;
+    hashTypeTryConversion(o,c->argv,2,2);
+    hashTypeSet(o,c->argv[2]->ptr,sdsfromlonglong(value),HASH_SET_TAKE_VALUE);
+    addReplyLongLong(c,value);
+}
@@ -0,0 +1,24 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_HASH_H
+#define RESP_SERVER_T_HASH_H
+
+#include "server.h"
+
+/* 小hash使用listpack编码，field数量超过hash-max-listpack-entries或
+ * 任一field、value长度超过hash-max-listpack-value时转换为dict */
+#define CONFIG_DEFAULT_HASH_MAX_LISTPACK_ENTRIES 128
+#define CONFIG_DEFAULT_HASH_MAX_LISTPACK_VALUE 64
+
+void hsetCommand(client *c);
+void hgetCommand(client *c);
+void hmgetCommand(client *c);
+void hgetallCommand(client *c);
+void hdelCommand(client *c);
+void hlenCommand(client *c);
+void hexistsCommand(client *c);
+void hincrbyCommand(client *c);
+
+#endif //RESP_SERVER_T_HASH_H
@@ -0,0 +1,259 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// list类型命令。元素依次保存在quicklist各节点的listpack中，两端的push、pop只修改头尾节点，
+// 不为每个元素分配内存；开启list-compress-depth后，两端以外的节点使用LZF压缩。
+
+#include <unistd.h>
+#include "server.h"
+#include "db.h"
+#include "t_list.h"
+#include "reply.h"
+#include "quicklist.h"
+#include "log.h"
+
+#define LIST_HEAD 0
+#define LIST_TAIL 1
+
+/*-----------------------------------------------------------------------------
+ * List API
+ *----------------------------------------------------------------------------*/
+
+static unsigned long listTypeLength(const robj *subject) {
+    if (subject->encoding == OBJ_ENCODING_QUICKLIST) {
+        return quicklistCount(subject->ptr);
+    } else {
+        serverPanic("Unknown list encoding");
+    }
+}
+
+/* The function pushes an element to the specified list object 'subject',
+ * at head or tail position as specified by 'where'. */
+static void listTypePush(robj *subject, robj *value, int where) {
+    if (subject->encoding == OBJ_ENCODING_QUICKLIST) {
+        int pos = (where == LIST_HEAD) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
+        value = getDecodedObject(value);
+        size_t len = sdslen(value->ptr);
+        quicklistPush(subject->ptr, value->ptr, len, pos);
+        decrRefCount(value);
+    } else {
+        serverPanic("Unknown list encoding");
+    }
+}
+
+static void *listPopSaver(unsigned char *data, unsigned int sz) {
+    return createStringObject((char*)data,sz);
+}
+
+static robj *listTypePop(robj *subject, int where) {
+    long long vlong;
+    robj *value = NULL;
+
+    int ql_where = where == LIST_HEAD ? QUICKLIST_HEAD : QUICKLIST_TAIL;
+    if (subject->encoding == OBJ_ENCODING_QUICKLIST) {
+        if (quicklistPopCustom(subject->ptr, ql_where, (unsigned char **)&value,
+                               NULL, &vlong, listPopSaver)) {
+            if (!value)
+                value = createStringObjectFromLongLong(vlong);
+        }
+    } else {
+        serverPanic("Unknown list encoding");
+    }
+    return value;
+}
+
+/* Parse the start/end arguments of LRANGE and LTRIM. */
+static int getRangeFromObjectsOrReply(client *c, robj *startobj, robj *endobj,
+                                      long long *start, long long *end) {
+    if (getLongLongFromObjectOrReply(c,startobj,start,NULL) != C_OK ||
+        getLongLongFromObjectOrReply(c,endobj,end,NULL) != C_OK)
+        return C_ERR;
+    return C_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * List Commands
+ *----------------------------------------------------------------------------*/
+
+static void pushGenericCommand(client *c, int where) {
+    int j;
+    robj *lobj = lookupKeyWrite(server.db,c->argv[1]);
+
+    if (lobj && checkType(c,lobj,OBJ_LIST)) return;
+
+    if (!lobj) {
+        lobj = createQuicklistObject();
+        quicklistSetOptions(lobj->ptr, server.list_max_listpack_size,
+                            server.list_compress_depth);
+        dbAdd(server.db,c->argv[1],lobj);
+    }
+
+    for (j = 2; j < c->argc; j++)
+        listTypePush(lobj,c->argv[j],where);
+
+    addReplyLongLong(c,listTypeLength(lobj));
+}
+
+/* LPUSH key element [element ...] */
+void lpushCommand(client *c) {
+    pushGenericCommand(c,LIST_HEAD);
+}
+
+/* RPUSH key element [element ...] */
+void rpushCommand(client *c) {
+    pushGenericCommand(c,LIST_TAIL);
+}
+
+static void popGenericCommand(client *c, int where) {
+    robj *o = lookupKeyWrite(server.db,c->argv[1]);
+    robj *value;
+
+    if (o == NULL) {
+        addReply(c,shared.nullbulk);
+        return;
+    }
+    if (checkType(c,o,OBJ_LIST)) return;
+
+    value = listTypePop(o,where);
+    if (value == NULL) {
+        addReply(c,shared.nullbulk);
+    } else {
+        addReplyBulk(c,value);
+        decrRefCount(value);
+        if (listTypeLength(o) == 0) dbDelete(server.db,c->argv[1]);
+    }
+}
+
+/* LPOP key */
+void lpopCommand(client *c) {
+    popGenericCommand(c,LIST_HEAD);
+}
+
+/* RPOP key */
+void rpopCommand(client *c) {
+    popGenericCommand(c,LIST_TAIL);
+}
+
+/* LLEN key */
+void llenCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_LIST)) return;
+    addReplyLongLong(c,listTypeLength(o));
+}
+
+/* LINDEX key index */
+void lindexCommand(client *c) {
+    robj *o;
+    long long index;
+    quicklistIter *iter;
+    quicklistEntry entry;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.nullbulk)) == NULL ||
+        checkType(c,o,OBJ_LIST)) return;
+    if (getLongLongFromObjectOrReply(c,c->argv[2],&index,NULL) != C_OK)
+        return;
+
+    /* The iterator leaves a compressed node the way it found it, while
+     * quicklistIndex() alone would keep it decompressed. */
+    iter = quicklistGetIteratorAtIdx(o->ptr,AL_START_HEAD,index);
+    if (iter && quicklistNext(iter,&entry)) {
+        if (entry.value)
+            addReplyBulkCBuffer(c,entry.value,entry.sz);
+        else
+            addReplyBulkLongLong(c,entry.longval);
+    } else {
+        addReply(c,shared.nullbulk);
+    }
+    if (iter) quicklistReleaseIterator(iter);
+}
+
+/* LRANGE key start stop */
+void lrangeCommand(client *c) {
+    robj *o;
+    long long start, end, llen, rangelen;
+
+    if (getRangeFromObjectsOrReply(c,c->argv[2],c->argv[3],&start,&end) != C_OK)
+        return;
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,o,OBJ_LIST)) return;
+    llen = listTypeLength(o);
+
+    /* convert negative indexes */
+    if (start < 0) start = llen+start;
+    if (end < 0) end = llen+end;
+    if (start < 0) start = 0;
+
+    /* Invariant: start >= 0, so this test will be true when end < 0.
+     * The range is empty when start > end or start >= length. */
+    if (start > end || start >= llen) {
+        addReply(c,shared.emptyarray);
+        return;
+    }
+    if (end >= llen) end = llen-1;
+    rangelen = (end-start)+1;
+
+    /* Return the result in form of a multi-bulk reply. The elements are
+     * read in place, one listpack node after the other. */
+    addReplyArrayLen(c,rangelen);
+    if (o->encoding == OBJ_ENCODING_QUICKLIST) {
+        quicklistIter *iter = quicklistGetIteratorAtIdx(o->ptr,AL_START_HEAD,start);
+
+        while (rangelen--) {
+            quicklistEntry entry;
+
+            quicklistNext(iter,&entry);
+            if (entry.value)
+                addReplyBulkCBuffer(c,entry.value,entry.sz);
+            else
+                addReplyBulkLongLong(c,entry.longval);
+        }
+        quicklistReleaseIterator(iter);
+    } else {
+        serverPanic("Unknown list encoding");
+    }
+}
+
+/* LTRIM key start stop */
+void ltrimCommand(client *c) {
+    robj *o;
+    long long start, end, llen, ltrim, rtrim;
+
+    if (getRangeFromObjectsOrReply(c,c->argv[2],c->argv[3],&start,&end) != C_OK)
+        return;
+    if ((o = lookupKeyWrite(server.db,c->argv[1])) == NULL) {
+        addReply(c,shared.ok);
+        return;
+    }
+    if (checkType(c,o,OBJ_LIST)) return;
+    llen = listTypeLength(o);
+
+    /* convert negative indexes */
+    if (start < 0) start = llen+start;
+    if (end < 0) end = llen+end;
+    if (start < 0) start = 0;
+
+    /* Invariant: start >= 0, so this test will be true when end < 0.
+     * The range is empty when start > end or start >= length. */
+    if (start > end || start >= llen) {
+        /* Out of range start or start > end result in empty list */
+        ltrim = llen;
+        rtrim = 0;
+    } else {
+        if (end >= llen) end = llen-1;
+        ltrim = start;
+        rtrim = llen-end-1;
+    }
+
+    /* Remove list elements to perform the trim */
+    if (o->encoding == OBJ_ENCODING_QUICKLIST) {
+        quicklistDelRange(o->ptr,0,ltrim);
+        quicklistDelRange(o->ptr,-rtrim,rtrim);
+    } else {
+        serverPanic("Unknown list encoding");
+    }
+
+    if (listTypeLength(o) == 0) dbDelete(server.db,c->argv[1]);
+    addReply(c,shared.ok);
+}
@@ -0,0 +1,25 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_LIST_H
+#define RESP_SERVER_T_LIST_H
+
+#include "server.h"
+
+/* list由quicklist实现，即listpack节点组成的双向链表。list-max-listpack-size为正数时
+ * 限制每个节点的元素数量，为-1~-5时限制节点大小为4KB~64KB；list-compress-depth为
+ * 两端不压缩的节点数量，0代表不压缩 */
+#define CONFIG_DEFAULT_LIST_MAX_LISTPACK_SIZE -2
+#define CONFIG_DEFAULT_LIST_COMPRESS_DEPTH 0
+
+void lpushCommand(client *c);
+void rpushCommand(client *c);
+void lpopCommand(client *c);
+void rpopCommand(client *c);
+void llenCommand(client *c);
+void lindexCommand(client *c);
+void lrangeCommand(client *c);
+void ltrimCommand(client *c);
+
+#endif //RESP_SERVER_T_LIST_H
@@ -0,0 +1,251 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// roaring bitmap类型命令，元素为32位无符号整数(见roaring.c)。
+//
+// RADD/RREM先把参数中的id排序，每个容器修改完后调用一次roaringOptimize()选择最小的表示；
+// RBITOP与Redis的BITOP一样把运算结果保存到destkey，结果为空时删除destkey。
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "server.h"
+#include "db.h"
+#include "t_roaring.h"
+#include "reply.h"
+#include "roaring.h"
+#include "zmalloc.h"
+#include "log.h"
+
+static int getRoaringIdFromObjectOrReply(client *c, robj *o, uint32_t *id) {
+    long long value;
+
+    if (getLongLongFromObject(o,&value) != C_OK || value < 0 || value > UINT32_MAX) {
+        addReplyError(c,"id is not an integer or out of range");
+        return C_ERR;
+    }
+    *id = (uint32_t)value;
+    return C_OK;
+}
+
+static int qsortCompareIds(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* 解析argv[start..argc)中的id并排序，出错时回复错误并返回NULL */
+static uint32_t *parseSortedIdsOrReply(client *c, int start) {
+    uint32_t *ids = zmalloc(sizeof(uint32_t)*(c->argc-start));
+    int j;
+
+    for (j = start; j < c->argc; j++) {
+        if (getRoaringIdFromObjectOrReply(c,c->argv[j],ids+j-start) != C_OK) {
+            zfree(ids);
+            return NULL;
+        }
+    }
+    qsort(ids,c->argc-start,sizeof(uint32_t),qsortCompareIds);
+    return ids;
+}
+
+/* RADD key id [id ...] */
+void raddCommand(client *c) {
+    robj *o;
+    uint32_t *ids;
+    int j, n = c->argc-2, added = 0;
+
+    if ((ids = parseSortedIdsOrReply(c,2)) == NULL) return;
+    o = lookupKeyWrite(server.db,c->argv[1]);
+    if (o == NULL) {
+        o = createRoaringObject();
+        dbAdd(server.db,c->argv[1],o);
+    } else if (checkType(c,o,OBJ_ROARING)) {
+        zfree(ids);
+        return;
+    }
+
+    for (j = 0; j < n; j++) {
+        added += roaringAdd(o->ptr,ids[j]);
+        if (j == n-1 || (ids[j] >> 16) != (ids[j+1] >> 16))
+            roaringOptimize(o->ptr,ids[j] >> 16);
+    }
+    zfree(ids);
+    addReplyLongLong(c,added);
+}
+
+/* RREM key id [id ...] */
+void rremCommand(client *c) {
+    robj *o;
+    uint32_t *ids;
+    int j, n = c->argc-2, removed = 0;
+
+    if ((ids = parseSortedIdsOrReply(c,2)) == NULL) return;
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_ROARING)) {
+        zfree(ids);
+        return;
+    }
+
+    for (j = 0; j < n; j++) {
+        removed += roaringRemove(o->ptr,ids[j]);
+        if (j == n-1 || (ids[j] >> 16) != (ids[j+1] >> 16))
+            roaringOptimize(o->ptr,ids[j] >> 16);
+    }
+    zfree(ids);
+    if (roaringCard(o->ptr) == 0) dbDelete(server.db,c->argv[1]);
+    addReplyLongLong(c,removed);
+}
+
+/* RCONTAINS key id */
+void rcontainsCommand(client *c) {
+    robj *o;
+    uint32_t id;
+
+    if (getRoaringIdFromObjectOrReply(c,c->argv[2],&id) != C_OK) return;
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_ROARING)) return;
+
+    addReply(c,roaringContains(o->ptr,id) ? shared.cone : shared.czero);
+}
+
+/* RCARD key */
+void rcardCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_ROARING)) return;
+
+    addReplyLongLong(c,roaringCard(o->ptr));
+}
+
+/* RRANK key id：小于等于id的元素数量 */
+void rrankCommand(client *c) {
+    robj *o;
+    uint32_t id;
+
+    if (getRoaringIdFromObjectOrReply(c,c->argv[2],&id) != C_OK) return;
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_ROARING)) return;
+
+    addReplyLongLong(c,roaringRank(o->ptr,id));
+}
+
+/* RSELECT key index：升序第index个元素(从0开始)，超出范围时回复nil */
+void rselectCommand(client *c) {
+    robj *o;
+    long long index;
+    uint32_t id;
+
+    if (getLongLongFromObjectOrReply(c,c->argv[2],&index,NULL) != C_OK) return;
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.nullbulk)) == NULL ||
+        checkType(c,o,OBJ_ROARING)) return;
+
+    if (index < 0 || !roaringSelect(o->ptr,(uint64_t)index,&id))
+        addReply(c,shared.nullbulk);
+    else
+        addReplyLongLong(c,id);
+}
+
+typedef struct {
+    client *c;
+    uint64_t remaining;
+} rrangeReplyState;
+
+static int rrangeReplyId(void *privdata, uint32_t x) {
+    rrangeReplyState *st = privdata;
+
+    addReplyLongLong(st->c,x);
+    return --st->remaining != 0;
+}
+
+/* RRANGE key min max [LIMIT count]：升序返回[min, max]中的元素，
+ * 数量由两端的排名相减得到，不需要先收集结果 */
+void rrangeCommand(client *c) {
+    robj *o;
+    uint32_t min, max;
+    long long limit = -1;
+    uint64_t count;
+    rrangeReplyState st;
+
+    if (getRoaringIdFromObjectOrReply(c,c->argv[2],&min) != C_OK ||
+        getRoaringIdFromObjectOrReply(c,c->argv[3],&max) != C_OK) return;
+    if (c->argc == 6 && !strcasecmp(c->argv[4]->ptr,"limit")) {
+        if (getLongLongFromObjectOrReply(c,c->argv[5],&limit,NULL) != C_OK) return;
+    } else if (c->argc != 4) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,o,OBJ_ROARING)) return;
+
+    count = min > max ? 0 : roaringRank(o->ptr,max)-(min ? roaringRank(o->ptr,min-1) : 0);
+    if (limit >= 0 && (uint64_t)limit < count) count = limit;
+    addReplyArrayLen(c,count);
+    if (count == 0) return;
+
+    st.c = c;
+    st.remaining = count;
+    roaringIterate(o->ptr,min,max,rrangeReplyId,&st);
+}
+
+/* RBITOP AND|OR|XOR|ANDNOT destkey key [key ...]
+ * ANDNOT为第一个key减去其余所有key，不存在的key视为空集。回复结果的元素数量 */
+void rbitopCommand(client *c) {
+    char *opname = c->argv[1]->ptr;
+    roaring *res = NULL;
+    uint64_t card;
+    int op, j;
+
+    if (!strcasecmp(opname,"and"))
+        op = ROARING_OP_AND;
+    else if (!strcasecmp(opname,"or"))
+        op = ROARING_OP_OR;
+    else if (!strcasecmp(opname,"xor"))
+        op = ROARING_OP_XOR;
+    else if (!strcasecmp(opname,"andnot"))
+        op = ROARING_OP_ANDNOT;
+    else {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+
+    /* 先检查所有key的类型 */
+    for (j = 3; j < c->argc; j++) {
+        robj *o = lookupKeyRead(server.db,c->argv[j]);
+        if (o && checkType(c,o,OBJ_ROARING)) return;
+    }
+
+    for (j = 3; j < c->argc; j++) {
+        robj *o = lookupKeyRead(server.db,c->argv[j]);
+        roaring *src = o ? o->ptr : NULL, *tmp;
+
+        if (j == 3) {
+            res = src ? roaringDup(src) : roaringNew();
+            continue;
+        }
+        if (src == NULL) {
+            /* 空集：AND的结果为空，其余运算不变 */
+            if (op != ROARING_OP_AND) continue;
+            tmp = roaringNew();
+        } else {
+            tmp = roaringOp(res,src,op);
+        }
+        roaringFree(res);
+        res = tmp;
+        if (op != ROARING_OP_OR && op != ROARING_OP_XOR && roaringCard(res) == 0) break;
+    }
+
+    card = roaringCard(res);
+    if (card) {
+        robj *o = createObject(OBJ_ROARING,res);
+
+        o->encoding = OBJ_ENCODING_ROARING;
+        setKey(server.db,c->argv[2],o);
+        decrRefCount(o);
+    } else {
+        roaringFree(res);
+        dbDelete(server.db,c->argv[2]);
+    }
+    addReplyLongLong(c,card);
+}
@@ -0,0 +1,19 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_ROARING_H
+#define RESP_SERVER_T_ROARING_H
+
+#include "server.h"
+
+void raddCommand(client *c);
+void rremCommand(client *c);
+void rcontainsCommand(client *c);
+void rcardCommand(client *c);
+void rrankCommand(client *c);
+void rselectCommand(client *c);
+void rrangeCommand(client *c);
+void rbitopCommand(client *c);
+
+#endif //RESP_SERVER_T_ROARING_H
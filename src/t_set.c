@@ -0,0 +1,492 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// set类型命令。只包含整数的set使用intset编码：按值有序的整数数组，元素宽度按需取16/32/64位；
+// 元素数量超过set-max-intset-entries或加入非整数元素时转换为dict（OBJ_ENCODING_HT），
+// 元素嵌入entry，没有value。转换是单向的。
+//
+// SINTER/SINTERCARD先把各个集合按大小排序，intset之间用intsetIntersect()按块归并或倍增查找
+// 求交集，然后以最小的候选集合驱动，逐个元素到其余集合中查找，代价与最小集合的大小成正比。
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "server.h"
+#include "db.h"
+#include "t_set.h"
+#include "reply.h"
+#include "util.h"
+#include "intset.h"
+#include "zmalloc.h"
+#include "log.h"
+
+#define SET_OP_UNION 0
+#define SET_OP_DIFF 1
+
+static void setTypeConvert(robj *setobj, int enc);
+
+/*-----------------------------------------------------------------------------
+ * Set type API
+ *----------------------------------------------------------------------------*/
+
+/* Factory method to return a set that *can* hold "value". When the object has
+ * an integer-encodable value, an intset will be returned. Otherwise a regular
+ * hash table. */
+static robj *setTypeCreate(sds value) {
+    long long llval;
+
+    if (server.set_max_intset_entries && string2ll(value,sdslen(value),&llval))
+        return createIntsetObject();
+    return createSetObject();
+}
+
+/* Add the specified value into a set. Returns 1 if the element was added,
+ * 0 if it was already a member. */
+static int setTypeAdd(robj *subject, sds value) {
+    long long llval;
+
+    if (subject->encoding == OBJ_ENCODING_HT) {
+        return dictAdd(subject->ptr,value,NULL) == DICT_OK;
+    } else if (subject->encoding == OBJ_ENCODING_INTSET) {
+        if (string2ll(value,sdslen(value),&llval)) {
+            uint8_t success = 0;
+
+            subject->ptr = intsetAdd(subject->ptr,llval,&success);
+            /* Convert to regular set when the intset contains
+             * too many entries. */
+            if (success && intsetLen(subject->ptr) > server.set_max_intset_entries)
+                setTypeConvert(subject,OBJ_ENCODING_HT);
+            return success;
+        }
+        /* Failed to get integer from object, convert to regular set. */
+        setTypeConvert(subject,OBJ_ENCODING_HT);
+        serverAssert(dictAdd(subject->ptr,value,NULL) == DICT_OK);
+        return 1;
+    }
+    serverPanic("Unknown set encoding");
+    return 0;
+}
+
+static int setTypeRemove(robj *setobj, sds value) {
+    long long llval;
+
+    if (setobj->encoding == OBJ_ENCODING_HT) {
+        return dictDelete(setobj->ptr,value) == DICT_OK;
+    } else if (setobj->encoding == OBJ_ENCODING_INTSET) {
+        if (string2ll(value,sdslen(value),&llval)) {
+            int success;
+
+            setobj->ptr = intsetRemove(setobj->ptr,llval,&success);
+            return success;
+        }
+        return 0;
+    }
+    serverPanic("Unknown set encoding");
+    return 0;
+}
+
+static int setTypeIsMember(robj *set, sds value) {
+    long long llval;
+
+    if (set->encoding == OBJ_ENCODING_HT) {
+        return dictFind((dict*)set->ptr,value) != NULL;
+    } else if (set->encoding == OBJ_ENCODING_INTSET) {
+        if (string2ll(value,sdslen(value),&llval))
+            return intsetFind((intset*)set->ptr,llval);
+        return 0;
+    }
+    serverPanic("Unknown set encoding");
+    return 0;
+}
+
+static unsigned long setTypeSize(const robj *set) {
+    if (set->encoding == OBJ_ENCODING_HT) return dictSize((const dict*)set->ptr);
+    if (set->encoding == OBJ_ENCODING_INTSET) return intsetLen((const intset*)set->ptr);
+    serverPanic("Unknown set encoding");
+    return 0;
+}
+
+/* 把整数写入可复用的sds，用于到dict编码的集合中查找intset中的元素 */
+static sds setTypeIntToSds(sds buf, long long llval) {
+    char tmp[32];
+
+    return sdscpylen(buf,tmp,ll2string(tmp,sizeof(tmp),llval));
+}
+
+/* Convert the set to specified encoding. The resulting dict (when converting
+ * to a hash table) is presized to hold the number of elements in the original
+ * set. */
+static void setTypeConvert(robj *setobj, int enc) {
+    serverAssert(setobj->type == OBJ_SET && setobj->encoding == OBJ_ENCODING_INTSET);
+
+    if (enc == OBJ_ENCODING_HT) {
+        intset *is = setobj->ptr;
+        dict *d = dictCreate(&setDictType,NULL);
+        sds ele = sdsempty();
+        int64_t llval;
+        uint32_t j;
+
+        /* Presize the dict to avoid rehashing */
+        dictExpand(d,intsetLen(is));
+        for (j = 0; intsetGet(is,j,&llval); j++) {
+            ele = setTypeIntToSds(ele,llval);
+            serverAssert(dictAdd(d,ele,NULL) == DICT_OK);
+        }
+        sdsfree(ele);
+        zfree(is);
+        setobj->ptr = d;
+        setobj->encoding = OBJ_ENCODING_HT;
+    } else {
+        serverPanic("Unsupported set conversion");
+    }
+}
+
+/* 遍历集合。dict编码时返回entry中的元素，intset编码时返回写入buf的字符串，
+ * 在下一次调用setTypeNext()前有效 */
+typedef struct {
+    robj *subject;
+    uint32_t ii;        /* intset iterator */
+    dictIterator *di;
+    sds buf;
+} setTypeIterator;
+
+static void setTypeInitIterator(setTypeIterator *si, robj *subject) {
+    si->subject = subject;
+    si->ii = 0;
+    si->di = NULL;
+    si->buf = NULL;
+    if (subject->encoding == OBJ_ENCODING_HT) {
+        si->di = dictGetIterator(subject->ptr);
+    } else if (subject->encoding == OBJ_ENCODING_INTSET) {
+        si->buf = sdsempty();
+    } else {
+        serverPanic("Unknown set encoding");
+    }
+}
+
+static sds setTypeNext(setTypeIterator *si) {
+    if (si->di) {
+        dictEntry *de = dictNext(si->di);
+        return de ? dictGetKey(de) : NULL;
+    } else {
+        int64_t llval;
+
+        if (!intsetGet(si->subject->ptr,si->ii++,&llval)) return NULL;
+        si->buf = setTypeIntToSds(si->buf,llval);
+        return si->buf;
+    }
+}
+
+static void setTypeReleaseIterator(setTypeIterator *si) {
+    if (si->di) dictReleaseIterator(si->di);
+    sdsfree(si->buf);
+}
+
+static void addSetMembersToReply(client *c, robj *set) {
+    addReplyArrayLen(c,setTypeSize(set));
+    if (set->encoding == OBJ_ENCODING_INTSET) {
+        int64_t llval;
+        uint32_t j;
+
+        for (j = 0; intsetGet(set->ptr,j,&llval); j++)
+            addReplyBulkLongLong(c,llval);
+    } else {
+        dictIterator *di = dictGetIterator(set->ptr);
+        dictEntry *de;
+
+        while ((de = dictNext(di)) != NULL) {
+            sds ele = dictGetKey(de);
+            addReplyBulkCBuffer(c,ele,sdslen(ele));
+        }
+        dictReleaseIterator(di);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * Set commands API
+ *----------------------------------------------------------------------------*/
+
+/* SADD key member [member ...] */
+void saddCommand(client *c) {
+    robj *set;
+    int j, added = 0;
+
+    set = lookupKeyWrite(server.db,c->argv[1]);
+    if (set == NULL) {
+        set = setTypeCreate(c->argv[2]->ptr);
+        dbAdd(server.db,c->argv[1],set);
+    } else if (checkType(c,set,OBJ_SET)) {
+        return;
+    }
+
+    for (j = 2; j < c->argc; j++)
+        added += setTypeAdd(set,c->argv[j]->ptr);
+    addReplyLongLong(c,added);
+}
+
+/* SREM key member [member ...] */
+void sremCommand(client *c) {
+    robj *set;
+    int j, deleted = 0;
+
+    if ((set = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,set,OBJ_SET)) return;
+
+    for (j = 2; j < c->argc; j++) {
+        if (setTypeRemove(set,c->argv[j]->ptr)) {
+            deleted++;
+            if (setTypeSize(set) == 0) {
+                dbDelete(server.db,c->argv[1]);
+                break;
+            }
+        }
+    }
+    addReplyLongLong(c,deleted);
+}
+
+/* SISMEMBER key member */
+void sismemberCommand(client *c) {
+    robj *set;
+
+    if ((set = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,set,OBJ_SET)) return;
+
+    addReply(c,setTypeIsMember(set,c->argv[2]->ptr) ? shared.cone : shared.czero);
+}
+
+/* SCARD key */
+void scardCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_SET)) return;
+
+    addReplyLongLong(c,setTypeSize(o));
+}
+
+/* SMEMBERS key */
+void smembersCommand(client *c) {
+    robj *set;
+
+    if ((set = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,set,OBJ_SET)) return;
+
+    addSetMembersToReply(c,set);
+}
+
+static int qsortCompareSetsByCardinality(const void *s1, const void *s2) {
+    unsigned long first = setTypeSize(*(robj**)s1), second = setTypeSize(*(robj**)s2);
+
+    return (first > second) - (first < second);
+}
+
+/* 求setkeys对应集合的交集，任一key不存在时交集为空。
+ *
+ * 按大小排序后先用intsetIntersect()求出所有intset的交集acc，然后在acc与dict编码的
+ * 集合中选最小的一个驱动：逐个元素到其余集合中查找，全部命中的元素属于交集。
+ * acc中的整数先写入可复用的sds再到dict中查找，dict中的元素转换为整数后到acc中查找。
+ * 结果先收集起来再回复，因为回复需要先写出元素数量。
+ *
+ * cardinality_only为1时只回复交集的大小，limit不为0时数到limit个元素即停止 */
+static void sinterGenericCommand(client *c, robj **setkeys, unsigned long setnum,
+                                 unsigned long limit, int cardinality_only) {
+    robj **sets = zmalloc(sizeof(robj*)*setnum);
+    robj **hts;
+    intset *acc = NULL;
+    int acc_owned = 0;
+    unsigned long j, k, nints = 0, nhts = 0, card = 0;
+    int64_t *intres = NULL;
+    sds *strres = NULL, buf = NULL;
+
+    for (j = 0; j < setnum; j++) {
+        robj *setobj = lookupKeyRead(server.db,setkeys[j]);
+
+        if (setobj == NULL) {
+            zfree(sets);
+            if (cardinality_only)
+                addReply(c,shared.czero);
+            else
+                addReply(c,shared.emptyarray);
+            return;
+        }
+        if (checkType(c,setobj,OBJ_SET)) {
+            zfree(sets);
+            return;
+        }
+        sets[j] = setobj;
+    }
+
+    /* intset排在前面，各自保持从小到大的顺序 */
+    qsort(sets,setnum,sizeof(robj*),qsortCompareSetsByCardinality);
+    hts = zmalloc(sizeof(robj*)*setnum);
+    for (j = 0; j < setnum; j++) {
+        if (sets[j]->encoding == OBJ_ENCODING_INTSET)
+            sets[nints++] = sets[j];
+        else
+            hts[nhts++] = sets[j];
+    }
+
+    if (nints) {
+        acc = sets[0]->ptr;
+        for (j = 1; j < nints && intsetLen(acc); j++) {
+            intset *tmp = intsetIntersect(acc,sets[j]->ptr);
+
+            if (acc_owned) zfree(acc);
+            acc = tmp;
+            acc_owned = 1;
+        }
+    }
+
+    if (acc && (nhts == 0 || intsetLen(acc) <= dictSize((dict*)hts[0]->ptr))) {
+        /* 由acc驱动，到所有dict中查找 */
+        int64_t llval;
+
+        if (!cardinality_only) intres = zmalloc(sizeof(int64_t)*intsetLen(acc));
+        if (nhts) buf = sdsempty();
+        for (j = 0; intsetGet(acc,j,&llval); j++) {
+            if (nhts) buf = setTypeIntToSds(buf,llval);
+            for (k = 0; k < nhts; k++)
+                if (dictFind(hts[k]->ptr,buf) == NULL) break;
+            if (k != nhts) continue;
+
+            if (intres) intres[card] = llval;
+            if (++card == limit) break;
+        }
+    } else {
+        /* 由最小的dict驱动，到acc与其余dict中查找 */
+        dictIterator *di = dictGetIterator(hts[0]->ptr);
+        dictEntry *de;
+
+        if (!cardinality_only) strres = zmalloc(sizeof(sds)*dictSize((dict*)hts[0]->ptr));
+        while ((de = dictNext(di)) != NULL) {
+            sds ele = dictGetKey(de);
+            long long llval;
+
+            if (acc && (!string2ll(ele,sdslen(ele),&llval) || !intsetFind(acc,llval)))
+                continue;
+            for (k = 1; k < nhts; k++) {
+                /* 同一个key可以出现多次，不在正在遍历的dict中查找：
+                 * dictFind()会执行渐进式rehash */
+                if (hts[k] == hts[0]) continue;
+                if (dictFind(hts[k]->ptr,ele) == NULL) break;
+            }
+            if (k != nhts) continue;
+
+            if (strres) strres[card] = ele;
+            if (++card == limit) break;
+        }
+        dictReleaseIterator(di);
+    }
+
+    if (cardinality_only) {
+        addReplyLongLong(c,card);
+    } else {
+        addReplyArrayLen(c,card);
+        for (j = 0; j < card; j++) {
+            if (intres)
+                addReplyBulkLongLong(c,intres[j]);
+            else
+                addReplyBulkCBuffer(c,strres[j],sdslen(strres[j]));
+        }
+    }
+
+    if (acc_owned) zfree(acc);
+    sdsfree(buf);
+    zfree(intres);
+    zfree(strres);
+    zfree(hts);
+    zfree(sets);
+}
+
+/* SINTER key [key ...] */
+void sinterCommand(client *c) {
+    sinterGenericCommand(c,c->argv+1,c->argc-1,0,0);
+}
+
+/* SINTERCARD numkeys key [key ...] [LIMIT limit] */
+void sintercardCommand(client *c) {
+    long long numkeys, limit = 0;
+    int j;
+
+    if (getLongLongFromObjectOrReply(c,c->argv[1],&numkeys,NULL) != C_OK) return;
+    if (numkeys <= 0) {
+        addReplyError(c,"numkeys should be greater than 0");
+        return;
+    }
+    if (numkeys > c->argc-2) {
+        addReplyError(c,"Number of keys can't be greater than number of args");
+        return;
+    }
+
+    for (j = 2+numkeys; j < c->argc; j += 2) {
+        if (c->argc-j >= 2 && !strcasecmp(c->argv[j]->ptr,"limit")) {
+            if (getLongLongFromObjectOrReply(c,c->argv[j+1],&limit,NULL) != C_OK) return;
+            if (limit < 0) {
+                addReplyError(c,"LIMIT can't be negative");
+                return;
+            }
+        } else {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+    }
+
+    sinterGenericCommand(c,c->argv+2,numkeys,limit,1);
+}
+
+/* 并集把所有集合的元素加入临时集合；差集遍历第一个集合，保留不属于其余任何集合的元素 */
+static void sunionDiffGenericCommand(client *c, robj **setkeys, int setnum, int op) {
+    robj **sets = zmalloc(sizeof(robj*)*setnum);
+    robj *dstset = createIntsetObject();
+    setTypeIterator si;
+    sds ele;
+    int j;
+
+    for (j = 0; j < setnum; j++) {
+        robj *setobj = lookupKeyRead(server.db,setkeys[j]);
+
+        if (setobj && checkType(c,setobj,OBJ_SET)) {
+            zfree(sets);
+            decrRefCount(dstset);
+            return;
+        }
+        sets[j] = setobj;
+    }
+
+    if (op == SET_OP_UNION) {
+        for (j = 0; j < setnum; j++) {
+            if (!sets[j]) continue; /* non existing keys are like empty sets */
+
+            setTypeInitIterator(&si,sets[j]);
+            while ((ele = setTypeNext(&si)) != NULL)
+                setTypeAdd(dstset,ele);
+            setTypeReleaseIterator(&si);
+        }
+    } else if (op == SET_OP_DIFF && sets[0]) {
+        setTypeInitIterator(&si,sets[0]);
+        while ((ele = setTypeNext(&si)) != NULL) {
+            for (j = 1; j < setnum; j++) {
+                if (!sets[j]) continue; /* no key is an empty set. */
+                if (sets[j] == sets[0]) break; /* same set! */
+                if (setTypeIsMember(sets[j],ele)) break;
+            }
+            if (j == setnum) setTypeAdd(dstset,ele);
+        }
+        setTypeReleaseIterator(&si);
+    }
+
+    addSetMembersToReply(c,dstset);
+    decrRefCount(dstset);
+    zfree(sets);
+}
+
+/* SUNION key [key ...] */
+void sunionCommand(client *c) {
+    sunionDiffGenericCommand(c,c->argv+1,c->argc-1,SET_OP_UNION);
+}
+
+/* SDIFF key [key ...] */
+void sdiffCommand(client *c) {
+    sunionDiffGenericCommand(c,c->argv+1,c->argc-1,SET_OP_DIFF);
+}
@@ -0,0 +1,24 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_SET_H
+#define RESP_SERVER_T_SET_H
+
+#include "server.h"
+
+/* 只包含整数的小set使用有序的intset编码，元素数量超过set-max-intset-entries
+ * 或加入非整数元素时转换为dict */
+#define CONFIG_DEFAULT_SET_MAX_INTSET_ENTRIES 512
+
+void saddCommand(client *c);
+void sremCommand(client *c);
+void sismemberCommand(client *c);
+void scardCommand(client *c);
+void smembersCommand(client *c);
+void sinterCommand(client *c);
+void sintercardCommand(client *c);
+void sunionCommand(client *c);
+void sdiffCommand(client *c);
+
+#endif //RESP_SERVER_T_SET_H
@@ -0,0 +1,1289 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// stream类型命令。stream是只追加的日志，元素由ID(毫秒时间戳-序号)与若干field/value组成，ID严格递增。
+// 元素按ID顺序写入listpack节点，节点以第一个元素的ID(主ID)为key存放在基数树中。节点内的元素只保存
+// 与主ID的差值，字段与主元素相同时只保存值，整数形式的ID差值、字段数量等在listpack中按整数编码，
+// 通常只占1字节。范围查询用raxSeek()定位到起始节点后顺序遍历。
+//
+// XTRIM只删除最旧的元素：整个节点都要删除时直接从基数树中移除，否则在节点中把元素标记为删除。
+//
+// 消费组记录最后一次交付的ID与已交付未确认的元素(PEL)，PEL以ID为key，消费组与消费者各有一份，
+// 共享同一个streamNACK。XREADGROUP使用">"读取新元素并加入PEL，使用其它ID时从消费者的PEL中
+// 重新读取已交付的元素，XACK把元素从PEL中移除。
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "server.h"
+#include "db.h"
+#include "stream.h"
+#include "t_stream.h"
+#include "reply.h"
+#include "util.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/* XADD/XTRIM的裁剪方式 */
+#define TRIM_STRATEGY_NONE 0
+#define TRIM_STRATEGY_MAXLEN 1
+#define TRIM_STRATEGY_MINID 2
+
+typedef struct streamTrimArgs {
+    int strategy;
+    int approx;             /* "~"：只删除整个节点，可能保留多于要求的元素 */
+    long long maxlen;
+    streamID minid;
+} streamTrimArgs;
+
+/*-----------------------------------------------------------------------------
+ * Low level stream encoding
+ *----------------------------------------------------------------------------*/
+
+/* ID按大端序编码为16字节，使基数树的字节序与ID的大小顺序一致 */
+static void streamEncodeID(unsigned char *buf, const streamID *id) {
+    int j;
+
+    for (j = 0; j < 8; j++) {
+        buf[j] = (unsigned char)(id->ms >> (56-j*8));
+        buf[8+j] = (unsigned char)(id->seq >> (56-j*8));
+    }
+}
+
+static void streamDecodeID(const unsigned char *buf, streamID *id) {
+    int j;
+
+    id->ms = id->seq = 0;
+    for (j = 0; j < 8; j++) {
+        id->ms = (id->ms << 8) | buf[j];
+        id->seq = (id->seq << 8) | buf[8+j];
+    }
+}
+
+int streamCompareID(const streamID *a, const streamID *b) {
+    if (a->ms != b->ms) return a->ms > b->ms ? 1 : -1;
+    if (a->seq != b->seq) return a->seq > b->seq ? 1 : -1;
+    return 0;
+}
+
+/* 把id加1，已经是最大的ID时返回C_ERR */
+static int streamIncrID(streamID *id) {
+    if (id->seq == UINT64_MAX) {
+        if (id->ms == UINT64_MAX) return C_ERR;
+        id->ms++;
+        id->seq = 0;
+    } else {
+        id->seq++;
+    }
+    return C_OK;
+}
+
+/* 把id减1，已经是0-0时返回C_ERR */
+static int streamDecrID(streamID *id) {
+    if (id->seq == 0) {
+        if (id->ms == 0) return C_ERR;
+        id->ms--;
+        id->seq = UINT64_MAX;
+    } else {
+        id->seq--;
+    }
+    return C_OK;
+}
+
+static void addReplyStreamID(client *c, const streamID *id) {
+    char buf[64];
+    int len = snprintf(buf,sizeof(buf),"%llu-%llu",
+                       (unsigned long long)id->ms,(unsigned long long)id->seq);
+    addReplyBulkCBuffer(c,buf,len);
+}
+
+static unsigned char *lpAppendInteger(unsigned char *lp, int64_t value) {
+    char buf[LP_INTBUF_SIZE];
+    int len = ll2string(buf,sizeof(buf),value);
+    return lpAppend(lp,(unsigned char*)buf,len);
+}
+
+/* 替换*pos处的整数，*pos更新为替换后的位置 */
+static unsigned char *lpReplaceInteger(unsigned char *lp, unsigned char **pos, int64_t value) {
+    char buf[LP_INTBUF_SIZE];
+    int len = ll2string(buf,sizeof(buf),value);
+    return lpInsert(lp,(unsigned char*)buf,len,*pos,LP_REPLACE,pos);
+}
+
+/* 节点中的计数、flags、ID差值等都是以整数编码写入的 */
+static int64_t lpGetInteger(unsigned char *ele) {
+    int64_t v;
+    long long ll;
+    unsigned char *e = lpGet(ele,&v,NULL);
+
+    if (e == NULL) return v;
+    serverAssert(string2ll((char*)e,v,&ll));
+    return ll;
+}
+
+static void streamFreeListpack(void *lp) {
+    lpFree(lp);
+}
+
+static void streamFreeNACK(void *nack) {
+    zfree(nack);
+}
+
+static void streamFreeConsumer(void *ptr) {
+    streamConsumer *consumer = ptr;
+
+    /* streamNACK由消费组的PEL负责释放 */
+    raxFree(consumer->pel);
+    sdsfree(consumer->name);
+    zfree(consumer);
+}
+
+static void streamFreeCG(void *ptr) {
+    streamCG *cg = ptr;
+
+    raxFreeWithCallback(cg->pel,streamFreeNACK);
+    raxFreeWithCallback(cg->consumers,streamFreeConsumer);
+    zfree(cg);
+}
+
+stream *streamNew(void) {
+    stream *s = zmalloc(sizeof(*s));
+
+    s->rax = raxNew();
+    s->length = 0;
+    s->last_id.ms = 0;
+    s->last_id.seq = 0;
+    s->cgroups = NULL;
+    return s;
+}
+
+void freeStream(stream *s) {
+    raxFreeWithCallback(s->rax,streamFreeListpack);
+    if (s->cgroups) raxFreeWithCallback(s->cgroups,streamFreeCG);
+    zfree(s);
+}
+
+/* 追加一个元素，id必须大于s->last_id。argv为numfields对field/value。
+ *
+ * 最后一个节点超过stream-node-max-bytes或stream-node-max-entries时创建新节点，新元素
+ * 成为新节点的主元素，其字段作为节点的主字段 */
+static void streamAppendItem(stream *s, robj **argv, int64_t numfields, const streamID *id) {
+    raxIterator ri;
+    unsigned char *lp = NULL, *p;
+    unsigned char rax_key[16];
+    streamID master_id;
+    size_t totelelen = 0;
+    int64_t j;
+    int flags = STREAM_ITEM_FLAG_NONE;
+
+    raxStart(&ri,s->rax);
+    if (raxSeek(&ri,"$",NULL,0) && raxNext(&ri)) {
+        lp = ri.data;
+        memcpy(rax_key,ri.key,sizeof(rax_key));
+    }
+    raxStop(&ri);
+
+    for (j = 0; j < numfields*2; j++) totelelen += sdslen(argv[j]->ptr);
+
+    if (lp != NULL) {
+        p = lpFirst(lp);
+        int64_t count = lpGetInteger(p);
+        int64_t deleted = lpGetInteger(lpNext(lp,p));
+
+        if ((server.stream_node_max_bytes &&
+             lpBytes(lp) + totelelen >= server.stream_node_max_bytes) ||
+            (server.stream_node_max_entries &&
+             (unsigned long)(count+deleted) >= server.stream_node_max_entries) ||
+            !lpSafeToAdd(lp,totelelen))
+        {
+            lp = NULL;
+        }
+    }
+
+    if (lp == NULL) {
+        master_id = *id;
+        streamEncodeID(rax_key,id);
+        lp = lpNew();
+        lp = lpAppendInteger(lp,1);
+        lp = lpAppendInteger(lp,0);
+        lp = lpAppendInteger(lp,numfields);
+        for (j = 0; j < numfields; j++) {
+            sds field = argv[j*2]->ptr;
+            lp = lpAppend(lp,(unsigned char*)field,sdslen(field));
+        }
+        lp = lpAppendInteger(lp,0);
+        flags |= STREAM_ITEM_FLAG_SAMEFIELDS;
+    } else {
+        unsigned char buf[LP_INTBUF_SIZE];
+
+        streamDecodeID(rax_key,&master_id);
+        p = lpFirst(lp);
+        lp = lpReplaceInteger(lp,&p,lpGetInteger(p)+1);
+
+        /* 字段与主元素完全相同时只保存值 */
+        p = lpNext(lp,lpNext(lp,p));
+        if (lpGetInteger(p) == numfields) {
+            for (j = 0; j < numfields; j++) {
+                int64_t len;
+                unsigned char *field;
+                sds f = argv[j*2]->ptr;
+
+                p = lpNext(lp,p);
+                field = lpGet(p,&len,buf);
+                if ((size_t)len != sdslen(f) || memcmp(field,f,len) != 0) break;
+            }
+            if (j == numfields) flags |= STREAM_ITEM_FLAG_SAMEFIELDS;
+        }
+    }
+
+    /* ID差值按无符号数回绕，读取时加回主ID即可还原 */
+    lp = lpAppendInteger(lp,flags);
+    lp = lpAppendInteger(lp,(int64_t)(id->ms - master_id.ms));
+    lp = lpAppendInteger(lp,(int64_t)(id->seq - master_id.seq));
+    if (flags & STREAM_ITEM_FLAG_SAMEFIELDS) {
+        for (j = 0; j < numfields; j++) {
+            sds value = argv[j*2+1]->ptr;
+            lp = lpAppend(lp,(unsigned char*)value,sdslen(value));
+        }
+        lp = lpAppendInteger(lp,numfields+3);
+    } else {
+        lp = lpAppendInteger(lp,numfields);
+        for (j = 0; j < numfields*2; j++) {
+            sds ele = argv[j]->ptr;
+            lp = lpAppend(lp,(unsigned char*)ele,sdslen(ele));
+        }
+        lp = lpAppendInteger(lp,numfields*2+4);
+    }
+    raxInsert(s->rax,rax_key,sizeof(rax_key),lp,NULL);
+
+    s->length++;
+    s->last_id = *id;
+}
+
+/* 读取节点中最后一个元素的ID */
+static void streamLastIDInNode(unsigned char *lp, const streamID *master_id, streamID *id) {
+    unsigned char *p = lpLast(lp);
+    int64_t lp_count = lpGetInteger(p);
+
+    while (lp_count--) p = lpPrev(lp,p);
+    p = lpNext(lp,p);
+    id->ms = master_id->ms + (uint64_t)lpGetInteger(p);
+    p = lpNext(lp,p);
+    id->seq = master_id->seq + (uint64_t)lpGetInteger(p);
+}
+
+/* 从最旧的元素开始删除，返回删除的元素数量。
+ *
+ * 需要删除节点中的全部元素时直接释放整个节点。之后的第一个节点只有部分元素需要删除，
+ * approx为1时保留这个节点，否则把这些元素标记为删除 */
+static int64_t streamTrim(stream *s, const streamTrimArgs *args) {
+    raxIterator ri;
+    int64_t deleted = 0;
+    int maxlen = args->strategy == TRIM_STRATEGY_MAXLEN;
+
+    if (maxlen && s->length <= (uint64_t)args->maxlen) return 0;
+
+    raxStart(&ri,s->rax);
+    raxSeek(&ri,"^",NULL,0);
+    while (raxNext(&ri)) {
+        unsigned char *lp = ri.data, *p;
+        unsigned char key[16];
+        streamID master_id, id;
+        int64_t entries, marked, master_fields, j;
+
+        if (maxlen && s->length <= (uint64_t)args->maxlen) break;
+
+        streamDecodeID(ri.key,&master_id);
+        p = lpFirst(lp);
+        entries = lpGetInteger(p);
+
+        int remove_node;
+        if (maxlen) {
+            remove_node = s->length - entries >= (uint64_t)args->maxlen;
+        } else {
+            streamLastIDInNode(lp,&master_id,&id);
+            remove_node = streamCompareID(&id,&args->minid) < 0;
+        }
+
+        if (remove_node) {
+            memcpy(key,ri.key,sizeof(key));
+            lpFree(lp);
+            raxRemove(s->rax,key,sizeof(key),NULL);
+            raxSeek(&ri,">",key,sizeof(key));
+            s->length -= entries;
+            deleted += entries;
+            continue;
+        }
+
+        if (args->approx) break;
+
+        p = lpNext(lp,p);
+        marked = lpGetInteger(p);
+        p = lpNext(lp,p);
+        master_fields = lpGetInteger(p);
+        for (j = 0; j <= master_fields; j++) p = lpNext(lp,p);
+
+        /* p指向上一个元素的最后一项，逐个标记删除 */
+        while ((p = lpNext(lp,p)) != NULL) {
+            unsigned char *fp = p;
+            int flags = (int)lpGetInteger(p);
+            int64_t to_skip;
+
+            if (maxlen && s->length <= (uint64_t)args->maxlen) break;
+
+            p = lpNext(lp,p);
+            id.ms = master_id.ms + (uint64_t)lpGetInteger(p);
+            p = lpNext(lp,p);
+            id.seq = master_id.seq + (uint64_t)lpGetInteger(p);
+            if (!maxlen && streamCompareID(&id,&args->minid) >= 0) break;
+
+            if (flags & STREAM_ITEM_FLAG_SAMEFIELDS) {
+                to_skip = master_fields;
+            } else {
+                p = lpNext(lp,p);
+                to_skip = lpGetInteger(p)*2;
+            }
+            while (to_skip--) p = lpNext(lp,p);
+            p = lpNext(lp,p);
+
+            if (!(flags & STREAM_ITEM_FLAG_DELETED)) {
+                /* flags的编码长度不变，替换后p在listpack中的偏移不变 */
+                size_t offset = p - lp;
+                lp = lpReplaceInteger(lp,&fp,flags|STREAM_ITEM_FLAG_DELETED);
+                p = lp + offset;
+                entries--;
+                marked++;
+                s->length--;
+                deleted++;
+            }
+        }
+
+        p = lpFirst(lp);
+        lp = lpReplaceInteger(lp,&p,entries);
+        p = lpNext(lp,p);
+        lp = lpReplaceInteger(lp,&p,marked);
+        memcpy(key,ri.key,sizeof(key));
+        raxInsert(s->rax,key,sizeof(key),lp,NULL);
+        break;
+    }
+    raxStop(&ri);
+    return deleted;
+}
+
+/*-----------------------------------------------------------------------------
+ * Stream iterator
+ *----------------------------------------------------------------------------*/
+
+/* 遍历ID在[start, end]中的元素，start/end为NULL代表不限制 */
+void streamIteratorStart(streamIterator *si, stream *s, const streamID *start, const streamID *end) {
+    unsigned char start_key[16];
+
+    si->stream = s;
+    if (start) {
+        si->start_id = *start;
+    } else {
+        si->start_id.ms = 0;
+        si->start_id.seq = 0;
+    }
+    if (end) {
+        si->end_id = *end;
+    } else {
+        si->end_id.ms = UINT64_MAX;
+        si->end_id.seq = UINT64_MAX;
+    }
+
+    /* start所在的节点是主ID不大于start的最后一个节点 */
+    streamEncodeID(start_key,&si->start_id);
+    raxStart(&si->ri,s->rax);
+    if (!raxSeek(&si->ri,"<=",start_key,sizeof(start_key)))
+        raxSeek(&si->ri,"^",NULL,0);
+    si->lp = NULL;
+    si->lp_ele = NULL;
+    si->fields_left = 0;
+    si->entry_flags = STREAM_ITEM_FLAG_NONE;
+}
+
+/* 移动到下一个元素，返回0代表遍历结束。之后调用numfields次streamIteratorGetField()读取字段，
+ * 不需要读完 */
+int streamIteratorGetID(streamIterator *si, streamID *id, int64_t *numfields) {
+    while (1) {
+        if (si->lp == NULL) {
+            int64_t j;
+
+            if (!raxNext(&si->ri)) return 0;
+            streamDecodeID(si->ri.key,&si->master_id);
+            if (streamCompareID(&si->master_id,&si->end_id) > 0) return 0;
+
+            si->lp = si->ri.data;
+            si->lp_ele = lpNext(si->lp,lpNext(si->lp,lpFirst(si->lp)));
+            si->master_fields_count = lpGetInteger(si->lp_ele);
+            si->master_fields_start = lpNext(si->lp,si->lp_ele);
+            si->lp_ele = si->master_fields_start;
+            for (j = 0; j < (int64_t)si->master_fields_count; j++)
+                si->lp_ele = lpNext(si->lp,si->lp_ele);
+        } else {
+            /* 跳过上一个元素未读取的字段，停在它的lp-count */
+            int64_t to_skip = si->fields_left;
+
+            if (!(si->entry_flags & STREAM_ITEM_FLAG_SAMEFIELDS)) to_skip *= 2;
+            while (to_skip--) si->lp_ele = lpNext(si->lp,si->lp_ele);
+            si->lp_ele = lpNext(si->lp,si->lp_ele);
+        }
+
+        si->lp_ele = lpNext(si->lp,si->lp_ele);
+        if (si->lp_ele == NULL) {
+            si->lp = NULL;
+            continue;
+        }
+
+        si->entry_flags = (int)lpGetInteger(si->lp_ele);
+        si->lp_ele = lpNext(si->lp,si->lp_ele);
+        id->ms = si->master_id.ms + (uint64_t)lpGetInteger(si->lp_ele);
+        si->lp_ele = lpNext(si->lp,si->lp_ele);
+        id->seq = si->master_id.seq + (uint64_t)lpGetInteger(si->lp_ele);
+
+        if (si->entry_flags & STREAM_ITEM_FLAG_SAMEFIELDS) {
+            si->fields_left = si->master_fields_count;
+            si->master_fields_ptr = si->master_fields_start;
+        } else {
+            si->lp_ele = lpNext(si->lp,si->lp_ele);
+            si->fields_left = lpGetInteger(si->lp_ele);
+        }
+
+        if (si->entry_flags & STREAM_ITEM_FLAG_DELETED) continue;
+        if (streamCompareID(id,&si->start_id) < 0) continue;
+        if (streamCompareID(id,&si->end_id) > 0) return 0;
+        *numfields = si->fields_left;
+        return 1;
+    }
+}
+
+void streamIteratorGetField(streamIterator *si, unsigned char **field, int64_t *field_len,
+                            unsigned char **value, int64_t *value_len) {
+    if (si->entry_flags & STREAM_ITEM_FLAG_SAMEFIELDS) {
+        *field = lpGet(si->master_fields_ptr,field_len,si->field_buf);
+        si->master_fields_ptr = lpNext(si->lp,si->master_fields_ptr);
+    } else {
+        si->lp_ele = lpNext(si->lp,si->lp_ele);
+        *field = lpGet(si->lp_ele,field_len,si->field_buf);
+    }
+    si->lp_ele = lpNext(si->lp,si->lp_ele);
+    *value = lpGet(si->lp_ele,value_len,si->value_buf);
+    si->fields_left--;
+}
+
+void streamIteratorStop(streamIterator *si) {
+    raxStop(&si->ri);
+}
+
+/*-----------------------------------------------------------------------------
+ * Consumer groups
+ *----------------------------------------------------------------------------*/
+
+static streamCG *streamLookupCG(stream *s, sds groupname) {
+    void *cg;
+
+    if (s->cgroups == NULL) return NULL;
+    return raxFind(s->cgroups,(unsigned char*)groupname,sdslen(groupname),&cg) ? cg : NULL;
+}
+
+/* 创建消费组，已经存在时返回NULL */
+static streamCG *streamCreateCG(stream *s, sds groupname, const streamID *id) {
+    streamCG *cg;
+
+    if (s->cgroups == NULL) s->cgroups = raxNew();
+    if (raxFind(s->cgroups,(unsigned char*)groupname,sdslen(groupname),NULL)) return NULL;
+
+    cg = zmalloc(sizeof(*cg));
+    cg->last_id = *id;
+    cg->pel = raxNew();
+    cg->consumers = raxNew();
+    raxInsert(s->cgroups,(unsigned char*)groupname,sdslen(groupname),cg,NULL);
+    return cg;
+}
+
+static streamConsumer *streamLookupConsumer(streamCG *cg, sds name) {
+    void *consumer;
+
+    return raxFind(cg->consumers,(unsigned char*)name,sdslen(name),&consumer) ? consumer : NULL;
+}
+
+/* 创建消费者，已经存在时返回NULL */
+static streamConsumer *streamCreateConsumer(streamCG *cg, sds name) {
+    streamConsumer *consumer;
+
+    if (raxFind(cg->consumers,(unsigned char*)name,sdslen(name),NULL)) return NULL;
+    consumer = zmalloc(sizeof(*consumer));
+    consumer->name = sdsdup(name);
+    consumer->pel = raxNew();
+    consumer->seen_time = mstime();
+    raxInsert(cg->consumers,(unsigned char*)name,sdslen(name),consumer,NULL);
+    return consumer;
+}
+
+/* 删除消费者及其未确认的元素，返回删除的未确认元素数量 */
+static uint64_t streamDelConsumer(streamCG *cg, streamConsumer *consumer) {
+    raxIterator ri;
+    uint64_t pending = raxSize(consumer->pel);
+
+    raxStart(&ri,consumer->pel);
+    raxSeek(&ri,"^",NULL,0);
+    while (raxNext(&ri)) {
+        raxRemove(cg->pel,ri.key,ri.key_len,NULL);
+        zfree(ri.data);
+    }
+    raxStop(&ri);
+    raxRemove(cg->consumers,(unsigned char*)consumer->name,sdslen(consumer->name),NULL);
+    streamFreeConsumer(consumer);
+    return pending;
+}
+
+/* 把id交付给consumer：不在PEL中时创建streamNACK，已经在PEL中时转移给consumer并重新计数 */
+static void streamDeliverToConsumer(streamCG *cg, streamConsumer *consumer, const streamID *id) {
+    unsigned char buf[16];
+    void *ptr;
+    streamNACK *nack;
+
+    streamEncodeID(buf,id);
+    if (raxFind(cg->pel,buf,sizeof(buf),&ptr)) {
+        nack = ptr;
+        raxRemove(nack->consumer->pel,buf,sizeof(buf),NULL);
+    } else {
+        nack = zmalloc(sizeof(*nack));
+        raxInsert(cg->pel,buf,sizeof(buf),nack,NULL);
+    }
+    nack->delivery_time = mstime();
+    nack->delivery_count = 1;
+    nack->consumer = consumer;
+    raxInsert(consumer->pel,buf,sizeof(buf),nack,NULL);
+}
+
+/*-----------------------------------------------------------------------------
+ * Stream commands implementation
+ *----------------------------------------------------------------------------*/
+
+/* 解析"ms-seq"形式的ID，省略序号时使用missing_seq。strict为0时接受"-"、"+"，
+ * seq_auto不为NULL时接受"ms-*"并设置*seq_auto为1 */
+static int streamParseID(robj *o, streamID *id, uint64_t missing_seq, int strict, int *seq_auto) {
+    char buf[128], *dash;
+    sds s = o->ptr;
+    size_t len = sdslen(s);
+    unsigned long long ms, seq;
+
+    if (seq_auto) *seq_auto = 0;
+    if (len == 0 || len > sizeof(buf)-1) return C_ERR;
+    if (!strict && len == 1 && (s[0] == '-' || s[0] == '+')) {
+        id->ms = id->seq = s[0] == '-' ? 0 : UINT64_MAX;
+        return C_OK;
+    }
+
+    memcpy(buf,s,len+1);
+    dash = strchr(buf,'-');
+    if (dash) *dash = '\0';
+    if (!string2ull(buf,&ms)) return C_ERR;
+    if (dash == NULL) {
+        seq = missing_seq;
+    } else if (seq_auto && strcmp(dash+1,"*") == 0) {
+        seq = 0;
+        *seq_auto = 1;
+    } else if (!string2ull(dash+1,&seq)) {
+        return C_ERR;
+    }
+    id->ms = ms;
+    id->seq = seq;
+    return C_OK;
+}
+
+static int streamParseIDOrReply(client *c, robj *o, streamID *id, uint64_t missing_seq, int strict) {
+    if (streamParseID(o,id,missing_seq,strict,NULL) == C_ERR) {
+        addReplyError(c,"Invalid stream ID specified as stream command argument");
+        return C_ERR;
+    }
+    return C_OK;
+}
+
+/* 解析argv[*i]开始的"MAXLEN|MINID [=|~] threshold"，成功时*i指向threshold */
+static int streamParseTrimArgsOrReply(client *c, int *i, streamTrimArgs *args) {
+    int j = *i;
+    char *opt = c->argv[j]->ptr;
+
+    args->strategy = !strcasecmp(opt,"maxlen") ? TRIM_STRATEGY_MAXLEN : TRIM_STRATEGY_MINID;
+    args->approx = 0;
+    if (j+1 < c->argc) {
+        char *next = c->argv[j+1]->ptr;
+        if (next[0] == '~' && next[1] == '\0') {
+            args->approx = 1;
+            j++;
+        } else if (next[0] == '=' && next[1] == '\0') {
+            j++;
+        }
+    }
+    if (++j >= c->argc) {
+        addReply(c,shared.syntaxerr);
+        return C_ERR;
+    }
+
+    if (args->strategy == TRIM_STRATEGY_MAXLEN) {
+        if (getLongLongFromObjectOrReply(c,c->argv[j],&args->maxlen,NULL) != C_OK)
+            return C_ERR;
+        if (args->maxlen < 0) {
+            addReplyError(c,"The MAXLEN argument must be >= 0.");
+            return C_ERR;
+        }
+    } else if (streamParseIDOrReply(c,c->argv[j],&args->minid,0,1) != C_OK) {
+        return C_ERR;
+    }
+    *i = j;
+    return C_OK;
+}
+
+static robj *createStreamKey(robj *key) {
+    robj *o = createStreamObject();
+    dbAdd(server.db,key,o);
+    return o;
+}
+
+/* XADD key [NOMKSTREAM] [MAXLEN|MINID [=|~] threshold] *|id field value [field value ...] */
+void xaddCommand(client *c) {
+    streamTrimArgs trim = {TRIM_STRATEGY_NONE,0,0,{0,0}};
+    streamID id;
+    int id_given = 0, seq_auto = 0, nomkstream = 0, i;
+    robj *o;
+    stream *s;
+
+    for (i = 2; i < c->argc; i++) {
+        char *opt = c->argv[i]->ptr;
+
+        if (!strcasecmp(opt,"nomkstream")) {
+            nomkstream = 1;
+        } else if (!strcasecmp(opt,"maxlen") || !strcasecmp(opt,"minid")) {
+            if (streamParseTrimArgsOrReply(c,&i,&trim) != C_OK) return;
+        } else if (opt[0] == '*' && opt[1] == '\0') {
+            break;
+        } else {
+            if (streamParseID(c->argv[i],&id,0,1,&seq_auto) != C_OK) {
+                addReplyError(c,"Invalid stream ID specified as stream command argument");
+                return;
+            }
+            id_given = 1;
+            break;
+        }
+    }
+
+    /* ID之后必须有至少一对field/value */
+    if (i >= c->argc || (c->argc-i-1) == 0 || (c->argc-i-1) % 2 != 0) {
+        addReplyError(c,"wrong number of arguments for 'xadd' command");
+        return;
+    }
+    if (id_given && !seq_auto && id.ms == 0 && id.seq == 0) {
+        addReplyError(c,"The ID specified in XADD must be greater than 0-0");
+        return;
+    }
+
+    o = lookupKeyWrite(server.db,c->argv[1]);
+    if (o != NULL && checkType(c,o,OBJ_STREAM)) return;
+    if (o == NULL && nomkstream) {
+        addReply(c,shared.nullbulk);
+        return;
+    }
+
+    /* 先确定ID，失败时不创建key */
+    streamID last = o ? ((stream*)o->ptr)->last_id : (streamID){0,0};
+    if (!id_given) {
+        uint64_t now = (uint64_t)mstime();
+        if (now > last.ms) {
+            id.ms = now;
+            id.seq = 0;
+        } else {
+            id = last;
+            if (streamIncrID(&id) != C_OK) {
+                addReplyError(c,"The stream has exhausted the last possible ID, unable to add more items");
+                return;
+            }
+        }
+    } else if (seq_auto) {
+        if (id.ms == last.ms) {
+            if (last.seq == UINT64_MAX) {
+                addReplyError(c,"The ID specified in XADD is equal or smaller than the target stream top item");
+                return;
+            }
+            id.seq = last.seq+1;
+        } else if (id.ms < last.ms) {
+            addReplyError(c,"The ID specified in XADD is equal or smaller than the target stream top item");
+            return;
+        }
+    } else if (streamCompareID(&id,&last) <= 0) {
+        addReplyError(c,"The ID specified in XADD is equal or smaller than the target stream top item");
+        return;
+    }
+
+    if (o == NULL) o = createStreamKey(c->argv[1]);
+    s = o->ptr;
+    streamAppendItem(s,c->argv+i+1,(c->argc-i-1)/2,&id);
+    if (trim.strategy != TRIM_STRATEGY_NONE) streamTrim(s,&trim);
+    addReplyStreamID(c,&id);
+}
+
+/* 回复一个元素：[id, [field, value, ...]] */
+static void addReplyStreamEntry(client *c, streamIterator *si, const streamID *id, int64_t numfields) {
+    addReplyArrayLen(c,2);
+    addReplyStreamID(c,id);
+    addReplyArrayLen(c,numfields*2);
+    while (numfields--) {
+        unsigned char *field, *value;
+        int64_t field_len, value_len;
+
+        streamIteratorGetField(si,&field,&field_len,&value,&value_len);
+        addReplyBulkCBuffer(c,field,field_len);
+        addReplyBulkCBuffer(c,value,value_len);
+    }
+}
+
+/* 回复[start, end]中最多count个元素，count为0代表不限制。
+ * group不为NULL时为XREADGROUP读取新元素：推进消费组的last_id，noack为0时把元素加入PEL */
+static size_t streamReplyWithRange(client *c, stream *s, const streamID *start, const streamID *end,
+                                   size_t count, streamCG *group, streamConsumer *consumer, int noack) {
+    void *arraylen_ptr = addReplyDeferredLen(c);
+    size_t arraylen = 0;
+    streamIterator si;
+    streamID id;
+    int64_t numfields;
+
+    streamIteratorStart(&si,s,start,end);
+    while (streamIteratorGetID(&si,&id,&numfields)) {
+        if (group) {
+            if (streamCompareID(&id,&group->last_id) > 0) group->last_id = id;
+            if (!noack) streamDeliverToConsumer(group,consumer,&id);
+        }
+        addReplyStreamEntry(c,&si,&id,numfields);
+        if (++arraylen == count) break;
+    }
+    streamIteratorStop(&si);
+    setDeferredArrayLen(c,arraylen_ptr,(long)arraylen);
+    return arraylen;
+}
+
+/* XREADGROUP的历史读取：回复consumer的PEL中ID大于start的元素，已经被删除的元素回复[id, nil] */
+static size_t streamReplyWithConsumerPEL(client *c, stream *s, const streamID *start,
+                                         size_t count, streamConsumer *consumer) {
+    raxIterator ri;
+    unsigned char buf[16];
+    void *arraylen_ptr = addReplyDeferredLen(c);
+    size_t arraylen = 0;
+    mstime_t now = mstime();
+
+    streamEncodeID(buf,start);
+    raxStart(&ri,consumer->pel);
+    raxSeek(&ri,">",buf,sizeof(buf));
+    while ((count == 0 || arraylen < count) && raxNext(&ri)) {
+        streamNACK *nack = ri.data;
+        streamIterator si;
+        streamID id, thisid;
+        int64_t numfields;
+
+        streamDecodeID(ri.key,&thisid);
+        streamIteratorStart(&si,s,&thisid,&thisid);
+        if (streamIteratorGetID(&si,&id,&numfields)) {
+            addReplyStreamEntry(c,&si,&id,numfields);
+            nack->delivery_time = now;
+            nack->delivery_count++;
+        } else {
+            addReplyArrayLen(c,2);
+            addReplyStreamID(c,&thisid);
+            addReply(c,shared.nullarray);
+        }
+        streamIteratorStop(&si);
+        arraylen++;
+    }
+    raxStop(&ri);
+    setDeferredArrayLen(c,arraylen_ptr,(long)arraylen);
+    return arraylen;
+}
+
+/* XRANGE key start end [COUNT count] */
+void xrangeCommand(client *c) {
+    robj *o;
+    streamID start, end;
+    long long count = -1;
+    char *startarg = c->argv[2]->ptr, *endarg = c->argv[3]->ptr;
+    int exclusive_start = startarg[0] == '(', exclusive_end = endarg[0] == '(';
+    robj *startobj = c->argv[2], *endobj = c->argv[3];
+    robj tmp_start, tmp_end;
+
+    /* "("开头代表不包含该ID */
+    if (exclusive_start) {
+        initStaticStringObject(tmp_start,sdsnewlen(startarg+1,sdslen(startarg)-1));
+        startobj = &tmp_start;
+    }
+    if (exclusive_end) {
+        initStaticStringObject(tmp_end,sdsnewlen(endarg+1,sdslen(endarg)-1));
+        endobj = &tmp_end;
+    }
+
+    int err = streamParseIDOrReply(c,startobj,&start,0,exclusive_start) != C_OK ||
+              streamParseIDOrReply(c,endobj,&end,UINT64_MAX,exclusive_end) != C_OK;
+    if (exclusive_start) sdsfree(tmp_start.ptr);
+    if (exclusive_end) sdsfree(tmp_end.ptr);
+    if (err) return;
+
+    if (exclusive_start && streamIncrID(&start) != C_OK) {
+        addReplyError(c,"invalid start ID for the interval");
+        return;
+    }
+    if (exclusive_end && streamDecrID(&end) != C_OK) {
+        addReplyError(c,"invalid end ID for the interval");
+        return;
+    }
+
+    if (c->argc == 6 && !strcasecmp(c->argv[4]->ptr,"count")) {
+        if (getLongLongFromObjectOrReply(c,c->argv[5],&count,NULL) != C_OK) return;
+        if (count < 0) count = 0;
+    } else if (c->argc != 4) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,o,OBJ_STREAM)) return;
+
+    if (count == 0) {
+        addReply(c,shared.emptyarray);
+        return;
+    }
+    streamReplyWithRange(c,o->ptr,&start,&end,count > 0 ? (size_t)count : 0,NULL,NULL,0);
+}
+
+/* XLEN key */
+void xlenCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_STREAM)) return;
+    addReplyLongLong(c,(long long)((stream*)o->ptr)->length);
+}
+
+/* XTRIM key MAXLEN|MINID [=|~] threshold */
+void xtrimCommand(client *c) {
+    streamTrimArgs trim;
+    robj *o;
+    int i = 2;
+    char *opt = c->argv[2]->ptr;
+
+    if (strcasecmp(opt,"maxlen") && strcasecmp(opt,"minid")) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+    if (streamParseTrimArgsOrReply(c,&i,&trim) != C_OK) return;
+    if (i != c->argc-1) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_STREAM)) return;
+    addReplyLongLong(c,streamTrim(o->ptr,&trim));
+}
+
+/* XREAD [COUNT count] STREAMS key [key ...] id [id ...]
+ * XREADGROUP GROUP group consumer [COUNT count] [NOACK] STREAMS key [key ...] id [id ...]
+ *
+ * 没有阻塞客户端的机制，不支持BLOCK。先校验所有参数再回复，没有任何可回复的key时回复nil */
+static void xreadGenericCommand(client *c, int xreadgroup) {
+    long long count = 0;
+    int streams_arg = 0, noack = 0, i;
+    int numkeys, emitted = 0;
+    sds groupname = NULL, consumername = NULL;
+    streamID *ids;
+    streamCG **groups = NULL;
+    robj **objs;
+    int *serve;
+
+    for (i = 1; i < c->argc; i++) {
+        char *opt = c->argv[i]->ptr;
+        int moreargs = c->argc-i-1;
+
+        if (!strcasecmp(opt,"streams")) {
+            streams_arg = i+1;
+            break;
+        } else if (!strcasecmp(opt,"count") && moreargs) {
+            if (getLongLongFromObjectOrReply(c,c->argv[++i],&count,NULL) != C_OK) return;
+            if (count < 0) count = 0;
+        } else if (!strcasecmp(opt,"block") && moreargs) {
+            addReplyError(c,"BLOCK is not supported");
+            return;
+        } else if (xreadgroup && !strcasecmp(opt,"group") && moreargs >= 2) {
+            groupname = c->argv[i+1]->ptr;
+            consumername = c->argv[i+2]->ptr;
+            i += 2;
+        } else if (xreadgroup && !strcasecmp(opt,"noack")) {
+            noack = 1;
+        } else {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+    }
+
+    if (streams_arg == 0 || (c->argc-streams_arg) % 2 != 0 || c->argc == streams_arg) {
+        addReplyErrorFormat(c,"Unbalanced '%s' list of streams: for each stream key an ID%s must be specified.",
+                            xreadgroup ? "xreadgroup" : "xread", xreadgroup ? " or '>'" : " or '$'");
+        return;
+    }
+    if (xreadgroup && groupname == NULL) {
+        addReplyError(c,"Missing GROUP option for XREADGROUP");
+        return;
+    }
+
+    numkeys = (c->argc-streams_arg)/2;
+    ids = zmalloc(sizeof(streamID)*numkeys);
+    objs = zmalloc(sizeof(robj*)*numkeys);
+    serve = zmalloc(sizeof(int)*numkeys);
+    if (xreadgroup) groups = zmalloc(sizeof(streamCG*)*numkeys);
+
+    /* 第一遍：查找key并解析ID，serve[i]为1代表需要回复这个key */
+    for (i = 0; i < numkeys; i++) {
+        robj *key = c->argv[streams_arg+i];
+        robj *idobj = c->argv[streams_arg+numkeys+i];
+        char *idstr = idobj->ptr;
+        robj *o = lookupKeyRead(server.db,key);
+
+        if (o && checkType(c,o,OBJ_STREAM)) goto cleanup;
+        objs[i] = o;
+        serve[i] = 0;
+
+        if (xreadgroup) {
+            streamCG *cg = o ? streamLookupCG(o->ptr,groupname) : NULL;
+            if (cg == NULL) {
+                addReplyErrorFormat(c,"-NOGROUP No such key '%s' or consumer group '%s' in XREADGROUP with GROUP option",
+                                    (char*)key->ptr,groupname);
+                goto cleanup;
+            }
+            groups[i] = cg;
+            if (idstr[0] == '>' && idstr[1] == '\0') {
+                /* 新元素：大于消费组last_id的元素 */
+                ids[i] = cg->last_id;
+                serve[i] = ((stream*)o->ptr)->length &&
+                           streamCompareID(&((stream*)o->ptr)->last_id,&ids[i]) > 0 ? 1 : 0;
+                continue;
+            }
+            if (streamParseIDOrReply(c,idobj,&ids[i],0,1) != C_OK) goto cleanup;
+            /* 历史元素：总是回复 */
+            serve[i] = 2;
+            continue;
+        }
+
+        if (idstr[0] == '$' && idstr[1] == '\0') {
+            if (o) {
+                ids[i] = ((stream*)o->ptr)->last_id;
+            } else {
+                ids[i].ms = 0;
+                ids[i].seq = 0;
+            }
+            continue;
+        }
+        if (streamParseIDOrReply(c,idobj,&ids[i],0,1) != C_OK) goto cleanup;
+        serve[i] = o && ((stream*)o->ptr)->length &&
+                   streamCompareID(&((stream*)o->ptr)->last_id,&ids[i]) > 0;
+    }
+
+    for (i = 0; i < numkeys; i++) emitted += serve[i] ? 1 : 0;
+    if (emitted == 0) {
+        addReply(c,shared.nullarray);
+        goto cleanup;
+    }
+
+    addReplyArrayLen(c,emitted);
+    for (i = 0; i < numkeys; i++) {
+        stream *s;
+        streamConsumer *consumer = NULL;
+
+        if (!serve[i]) continue;
+        s = objs[i]->ptr;
+        addReplyArrayLen(c,2);
+        addReplyBulk(c,c->argv[streams_arg+i]);
+
+        if (xreadgroup) {
+            consumer = streamLookupConsumer(groups[i],consumername);
+            if (consumer == NULL) consumer = streamCreateConsumer(groups[i],consumername);
+            consumer->seen_time = mstime();
+            if (serve[i] == 2) {
+                streamReplyWithConsumerPEL(c,s,&ids[i],(size_t)count,consumer);
+                continue;
+            }
+        }
+
+        /* 读取大于ids[i]的元素，serve[i]为1时ids[i]一定小于last_id，加1不会溢出 */
+        streamIncrID(&ids[i]);
+        streamReplyWithRange(c,s,&ids[i],NULL,(size_t)count,
+                             xreadgroup ? groups[i] : NULL,consumer,noack);
+    }
+
+cleanup:
+    zfree(ids);
+    zfree(objs);
+    zfree(serve);
+    zfree(groups);
+}
+
+/* XREAD [COUNT count] STREAMS key [key ...] id [id ...] */
+void xreadCommand(client *c) {
+    xreadGenericCommand(c,0);
+}
+
+/* XREADGROUP GROUP group consumer [COUNT count] [NOACK] STREAMS key [key ...] id [id ...] */
+void xreadgroupCommand(client *c) {
+    xreadGenericCommand(c,1);
+}
+
+/* XGROUP CREATE key group id|$ [MKSTREAM]
+ * XGROUP SETID key group id|$
+ * XGROUP DESTROY key group
+ * XGROUP CREATECONSUMER key group consumer
+ * XGROUP DELCONSUMER key group consumer */
+void xgroupCommand(client *c) {
+    char *opt = c->argv[1]->ptr;
+    robj *o;
+    stream *s = NULL;
+    streamCG *cg = NULL;
+    sds groupname;
+    streamID id;
+    int mkstream = 0;
+
+    if (c->argc < 4) goto syntax;
+    groupname = c->argv[3]->ptr;
+
+    if (!strcasecmp(opt,"create")) {
+        if (c->argc == 6 && !strcasecmp(c->argv[5]->ptr,"mkstream")) mkstream = 1;
+        else if (c->argc != 5) goto syntax;
+    } else if (!strcasecmp(opt,"setid")) {
+        if (c->argc != 5) goto syntax;
+    } else if (!strcasecmp(opt,"destroy")) {
+        if (c->argc != 4) goto syntax;
+    } else if (!strcasecmp(opt,"createconsumer") || !strcasecmp(opt,"delconsumer")) {
+        if (c->argc != 5) goto syntax;
+    } else {
+        goto syntax;
+    }
+
+    o = lookupKeyWrite(server.db,c->argv[2]);
+    if (o) {
+        if (checkType(c,o,OBJ_STREAM)) return;
+        s = o->ptr;
+    }
+
+    if (!strcasecmp(opt,"create") || !strcasecmp(opt,"setid")) {
+        char *idstr = c->argv[4]->ptr;
+
+        if (idstr[0] == '$' && idstr[1] == '\0') {
+            if (s) id = s->last_id;
+            else id.ms = id.seq = 0;
+        } else if (streamParseIDOrReply(c,c->argv[4],&id,0,1) != C_OK) {
+            return;
+        }
+    }
+
+    if (s == NULL) {
+        if (!mkstream) {
+            addReplyError(c,"The XGROUP subcommand requires the key to exist. "
+                            "Note that for CREATE you may want to use the MKSTREAM "
+                            "option to create an empty stream automatically.");
+            return;
+        }
+        o = createStreamKey(c->argv[2]);
+        s = o->ptr;
+    }
+
+    if (!strcasecmp(opt,"create")) {
+        if (streamCreateCG(s,groupname,&id) == NULL) {
+            addReplyError(c,"-BUSYGROUP Consumer Group name already exists");
+            return;
+        }
+        addReply(c,shared.ok);
+        return;
+    }
+
+    cg = streamLookupCG(s,groupname);
+    if (cg == NULL) {
+        addReplyErrorFormat(c,"-NOGROUP No such consumer group '%s' for key name '%s'",
+                            groupname,(char*)c->argv[2]->ptr);
+        return;
+    }
+
+    if (!strcasecmp(opt,"setid")) {
+        cg->last_id = id;
+        addReply(c,shared.ok);
+    } else if (!strcasecmp(opt,"destroy")) {
+        raxRemove(s->cgroups,(unsigned char*)groupname,sdslen(groupname),NULL);
+        streamFreeCG(cg);
+        addReply(c,shared.cone);
+    } else if (!strcasecmp(opt,"createconsumer")) {
+        addReply(c,streamCreateConsumer(cg,c->argv[4]->ptr) ? shared.cone : shared.czero);
+    } else {
+        streamConsumer *consumer = streamLookupConsumer(cg,c->argv[4]->ptr);
+        addReplyLongLong(c,consumer ? (long long)streamDelConsumer(cg,consumer) : 0);
+    }
+    return;
+
+syntax:
+    addReplyErrorFormat(c,"Unknown subcommand or wrong number of arguments for '%s'.",opt);
+}
+
+/* XACK key group id [id ...] */
+void xackCommand(client *c) {
+    robj *o;
+    streamCG *cg = NULL;
+    streamID *ids;
+    long long acked = 0;
+    int j, numids = c->argc-3;
+
+    /* 先校验所有ID，避免只确认了一部分 */
+    ids = zmalloc(sizeof(streamID)*numids);
+    for (j = 0; j < numids; j++) {
+        if (streamParseIDOrReply(c,c->argv[j+3],&ids[j],0,1) != C_OK) {
+            zfree(ids);
+            return;
+        }
+    }
+
+    o = lookupKeyRead(server.db,c->argv[1]);
+    if (o) {
+        if (checkType(c,o,OBJ_STREAM)) {
+            zfree(ids);
+            return;
+        }
+        cg = streamLookupCG(o->ptr,c->argv[2]->ptr);
+    }
+
+    for (j = 0; cg && j < numids; j++) {
+        unsigned char buf[16];
+        void *ptr;
+
+        streamEncodeID(buf,&ids[j]);
+        if (raxFind(cg->pel,buf,sizeof(buf),&ptr)) {
+            streamNACK *nack = ptr;
+            raxRemove(cg->pel,buf,sizeof(buf),NULL);
+            raxRemove(nack->consumer->pel,buf,sizeof(buf),NULL);
+            zfree(nack);
+            acked++;
+        }
+    }
+    zfree(ids);
+    addReplyLongLong(c,acked);
+}
+
+/* XPENDING key group [[IDLE min-idle-time] start end count [consumer]]
+ *
+ * 不带范围时回复概要：[未确认数量, 最小ID, 最大ID, [[消费者, 未确认数量], ...]] */
+void xpendingCommand(client *c) {
+    robj *o;
+    streamCG *cg = NULL;
+    sds groupname = c->argv[2]->ptr;
+    long long minidle = 0, count = 0;
+    streamID start, end;
+    int justinfo = c->argc == 3, startarg = 3;
+
+    if (!justinfo) {
+        if (c->argc >= 6 && !strcasecmp(c->argv[3]->ptr,"idle")) {
+            if (getLongLongFromObjectOrReply(c,c->argv[4],&minidle,NULL) != C_OK) return;
+            startarg += 2;
+        }
+        if (c->argc-startarg != 3 && c->argc-startarg != 4) {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+        if (streamParseIDOrReply(c,c->argv[startarg],&start,0,0) != C_OK ||
+            streamParseIDOrReply(c,c->argv[startarg+1],&end,UINT64_MAX,0) != C_OK ||
+            getLongLongFromObjectOrReply(c,c->argv[startarg+2],&count,NULL) != C_OK) return;
+        if (count < 0) count = 0;
+    }
+
+    o = lookupKeyRead(server.db,c->argv[1]);
+    if (o) {
+        if (checkType(c,o,OBJ_STREAM)) return;
+        cg = streamLookupCG(o->ptr,groupname);
+    }
+    if (cg == NULL) {
+        addReplyErrorFormat(c,"-NOGROUP No such key '%s' or consumer group '%s'",
+                            (char*)c->argv[1]->ptr,groupname);
+        return;
+    }
+
+    if (justinfo) {
+        raxIterator ri;
+        streamID id;
+
+        addReplyArrayLen(c,4);
+        addReplyLongLong(c,(long long)raxSize(cg->pel));
+        if (raxSize(cg->pel) == 0) {
+            addReply(c,shared.nullbulk);
+            addReply(c,shared.nullbulk);
+            addReply(c,shared.nullarray);
+            return;
+        }
+
+        raxStart(&ri,cg->pel);
+        raxSeek(&ri,"^",NULL,0);
+        raxNext(&ri);
+        streamDecodeID(ri.key,&id);
+        addReplyStreamID(c,&id);
+        raxSeek(&ri,"$",NULL,0);
+        raxNext(&ri);
+        streamDecodeID(ri.key,&id);
+        addReplyStreamID(c,&id);
+
+        void *arraylen_ptr = addReplyDeferredLen(c);
+        long arraylen = 0;
+        raxStop(&ri);
+        raxStart(&ri,cg->consumers);
+        raxSeek(&ri,"^",NULL,0);
+        while (raxNext(&ri)) {
+            streamConsumer *consumer = ri.data;
+            if (raxSize(consumer->pel) == 0) continue;
+            addReplyArrayLen(c,2);
+            addReplyBulkCBuffer(c,ri.key,ri.key_len);
+            addReplyBulkLongLong(c,(long long)raxSize(consumer->pel));
+            arraylen++;
+        }
+        raxStop(&ri);
+        setDeferredArrayLen(c,arraylen_ptr,arraylen);
+        return;
+    }
+
+    /* 扩展形式：[[ID, 消费者, 距上次交付的毫秒数, 交付次数], ...] */
+    rax *pel = cg->pel;
+    if (c->argc-startarg == 4) {
+        streamConsumer *consumer = streamLookupConsumer(cg,c->argv[startarg+3]->ptr);
+        if (consumer == NULL) {
+            addReply(c,shared.emptyarray);
+            return;
+        }
+        pel = consumer->pel;
+    }
+
+    raxIterator ri;
+    unsigned char startkey[16], endkey[16];
+    void *arraylen_ptr = addReplyDeferredLen(c);
+    long arraylen = 0;
+    mstime_t now = mstime();
+
+    streamEncodeID(startkey,&start);
+    streamEncodeID(endkey,&end);
+    raxStart(&ri,pel);
+    raxSeek(&ri,">=",startkey,sizeof(startkey));
+    while (arraylen < count && raxNext(&ri) && memcmp(ri.key,endkey,ri.key_len) <= 0) {
+        streamNACK *nack = ri.data;
+        streamID id;
+        mstime_t idle = now - nack->delivery_time;
+
+        if (idle < minidle) continue;
+        streamDecodeID(ri.key,&id);
+        addReplyArrayLen(c,4);
+        addReplyStreamID(c,&id);
+        addReplyBulkCBuffer(c,nack->consumer->name,sdslen(nack->consumer->name));
+        addReplyLongLong(c,idle < 0 ? 0 : idle);
+        addReplyLongLong(c,(long long)nack->delivery_count);
+        arraylen++;
+    }
+    raxStop(&ri);
+    setDeferredArrayLen(c,arraylen_ptr,arraylen);
+}
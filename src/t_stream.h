@@ -0,0 +1,25 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_STREAM_H
+#define RESP_SERVER_T_STREAM_H
+
+#include "server.h"
+
+/* stream的listpack节点超过stream-node-max-bytes字节或stream-node-max-entries个元素时，
+ * 新元素写入新的节点，0代表不限制 */
+#define CONFIG_DEFAULT_STREAM_NODE_MAX_BYTES 4096
+#define CONFIG_DEFAULT_STREAM_NODE_MAX_ENTRIES 100
+
+void xaddCommand(client *c);
+void xrangeCommand(client *c);
+void xlenCommand(client *c);
+void xtrimCommand(client *c);
+void xreadCommand(client *c);
+void xgroupCommand(client *c);
+void xreadgroupCommand(client *c);
+void xackCommand(client *c);
+void xpendingCommand(client *c);
+
+#endif //RESP_SERVER_T_STREAM_H
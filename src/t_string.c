@@ -0,0 +1,201 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 字符串类型命令。写入前调用tryObjectEncoding，整数与不超过7字节的字符串编码为标记指针，
+// 其余整数使用INT编码，短字符串使用EMBSTR编码，回复时直接使用键空间中的对象，不做额外复制。
+
+#include <unistd.h>
+#include "server.h"
+#include "db.h"
+#include "t_string.h"
+#include "reply.h"
+#include "util.h"
+
+/*-----------------------------------------------------------------------------
+ * String Commands
+ *----------------------------------------------------------------------------*/
+
+/* SET key value [NX] [XX] [EX <seconds>] [PX <milliseconds>] */
+void setCommand(client *c) {
+    int j, flags = OBJ_SET_NO_FLAGS;
+    long long milliseconds = 0; /* initialized to avoid any harmness warning */
+    robj *o, *expire = NULL;
+
+    for (j = 3; j < c->argc; j++) {
+        char *a = c->argv[j]->ptr;
+        robj *next = (j == c->argc-1) ? NULL : c->argv[j+1];
+
+        if ((a[0] == 'n' || a[0] == 'N') &&
+            (a[1] == 'x' || a[1] == 'X') && a[2] == '\0' &&
+            !(flags & OBJ_SET_XX))
+        {
+            flags |= OBJ_SET_NX;
+        } else if ((a[0] == 'x' || a[0] == 'X') &&
+                   (a[1] == 'x' || a[1] == 'X') && a[2] == '\0' &&
+                   !(flags & OBJ_SET_NX))
+        {
+            flags |= OBJ_SET_XX;
+        } else if ((a[0] == 'e' || a[0] == 'E') &&
+                   (a[1] == 'x' || a[1] == 'X') && a[2] == '\0' &&
+                   !(flags & OBJ_SET_PX) && next)
+        {
+            flags |= OBJ_SET_EX;
+            expire = next;
+            j++;
+        } else if ((a[0] == 'p' || a[0] == 'P') &&
+                   (a[1] == 'x' || a[1] == 'X') && a[2] == '\0' &&
+                   !(flags & OBJ_SET_EX) && next)
+        {
+            flags |= OBJ_SET_PX;
+            expire = next;
+            j++;
+        } else {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+    }
+
+    if (expire) {
+        if (getLongLongFromObjectOrReply(c, expire, &milliseconds, NULL) != C_OK)
+            return;
+        if (milliseconds <= 0 ||
+            ((flags & OBJ_SET_EX) && milliseconds > LLONG_MAX/1000) ||
+            server.mstime > LLONG_MAX - ((flags & OBJ_SET_EX) ? milliseconds*1000 : milliseconds))
+        {
+            addReplyError(c,"invalid expire time in set");
+            return;
+        }
+        if (flags & OBJ_SET_EX) milliseconds *= 1000;
+    }
+
+    if (flags & (OBJ_SET_NX|OBJ_SET_XX)) {
+        o = lookupKeyWrite(server.db,c->argv[1]);
+        if (((flags & OBJ_SET_NX) && o != NULL) ||
+            ((flags & OBJ_SET_XX) && o == NULL))
+        {
+            addReply(c,shared.nullbulk);
+            return;
+        }
+    }
+
+    c->argv[2] = tryObjectEncoding(c->argv[2]);
+    setKey(server.db,c->argv[1],c->argv[2]);
+    if (expire) setExpire(server.db,c->argv[1],server.mstime+milliseconds);
+    addReply(c,shared.ok);
+}
+
+/* GET key */
+void getCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.nullbulk)) == NULL)
+        return;
+
+    if (checkType(c,o,OBJ_STRING)) return;
+    addReplyBulk(c,o);
+}
+
+/* MGET key [key ...] */
+void mgetCommand(client *c) {
+    int j;
+
+    addReplyArrayLen(c,c->argc-1);
+    for (j = 1; j < c->argc; j++) {
+        robj *o = lookupKeyRead(server.db,c->argv[j]);
+        if (o == NULL || objType(o) != OBJ_STRING) {
+            addReply(c,shared.nullbulk);
+        } else {
+            addReplyBulk(c,o);
+        }
+    }
+}
+
+/* MSET key value [key value ...] */
+void msetCommand(client *c) {
+    int j;
+
+    if ((c->argc % 2) == 0) {
+        addReplyError(c,"wrong number of arguments for MSET");
+        return;
+    }
+
+    for (j = 1; j < c->argc; j += 2) {
+        c->argv[j+1] = tryObjectEncoding(c->argv[j+1]);
+        setKey(server.db,c->argv[j],c->argv[j+1]);
+    }
+    addReply(c,shared.ok);
+}
+
+static void incrDecrCommand(client *c, long long incr) {
+    long long value, oldvalue;
+    robj *o, *new;
+
+    o = lookupKeyWrite(server.db,c->argv[1]);
+    if (o != NULL && checkType(c,o,OBJ_STRING)) return;
+    if (getLongLongFromObjectOrReply(c,o,&value,NULL) != C_OK) return;
+
+    oldvalue = value;
+    if ((incr < 0 && oldvalue < 0 && incr < (LLONG_MIN-oldvalue)) ||
+        (incr > 0 && oldvalue > 0 && incr > (LLONG_MAX-oldvalue))) {
+        addReplyError(c,"increment or decrement would overflow");
+        return;
+    }
+    value += incr;
+
+    /* Update the value in place when the object is private and INT encoded,
+     * saving an allocation per call on counters. */
+    if (o && !objIsTagged(o) && o->refcount == 1 && o->encoding == OBJ_ENCODING_INT &&
+        (value < 0 || value >= OBJ_SHARED_INTEGERS) &&
+        value >= LONG_MIN && value <= LONG_MAX)
+    {
+        new = o;
+        o->ptr = (void*)((long)value);
+    } else {
+        new = createStringObjectFromLongLongForValue(value);
+        if (o) {
+            dbOverwrite(server.db,c->argv[1],new);
+        } else {
+            dbAdd(server.db,c->argv[1],new);
+        }
+    }
+    addReplyLongLong(c,value);
+}
+
+/* INCR key */
+void incrCommand(client *c) {
+    incrDecrCommand(c,1);
+}
+
+/* DECR key */
+void decrCommand(client *c) {
+    incrDecrCommand(c,-1);
+}
+
+/* INCRBY key increment */
+void incrbyCommand(client *c) {
+    long long incr;
+
+    if (getLongLongFromObjectOrReply(c, c->argv[2], &incr, NULL) != C_OK) return;
+    incrDecrCommand(c,incr);
+}
+
+/* DECRBY key decrement */
+void decrbyCommand(client *c) {
+    long long incr;
+
+    if (getLongLongFromObjectOrReply(c, c->argv[2], &incr, NULL) != C_OK) return;
+    if (incr == LLONG_MIN) {
+        addReplyError(c,"decrement would overflow");
+        return;
+    }
+    incrDecrCommand(c,-incr);
+}
+
+/* STRLEN key */
+void strlenCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_STRING)) return;
+    addReplyLongLong(c,stringObjectLen(o));
+}
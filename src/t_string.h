@@ -0,0 +1,26 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_STRING_H
+#define RESP_SERVER_T_STRING_H
+
+#include "server.h"
+
+#define OBJ_SET_NO_FLAGS 0
+#define OBJ_SET_NX (1<<0)     /* Set if key not exists. */
+#define OBJ_SET_XX (1<<1)     /* Set if key exists. */
+#define OBJ_SET_EX (1<<2)     /* Set if time in seconds is given */
+#define OBJ_SET_PX (1<<3)     /* Set if time in ms in given */
+
+void getCommand(client *c);
+void setCommand(client *c);
+void mgetCommand(client *c);
+void msetCommand(client *c);
+void incrCommand(client *c);
+void decrCommand(client *c);
+void incrbyCommand(client *c);
+void decrbyCommand(client *c);
+void strlenCommand(client *c);
+
+#endif //RESP_SERVER_T_STRING_H
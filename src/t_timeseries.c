@@ -0,0 +1,250 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 时间序列类型命令，样本为(毫秒时间戳, double)，按时间戳严格递增追加，编码见timeseries.c。
+//
+// TSRANGE不带AGGREGATION时按批解码后逐个回复样本；带AGGREGATION时由tsAggregate()按桶聚合，
+// 每个桶回复一次，解码过程中不为样本分配内存。
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "server.h"
+#include "db.h"
+#include "t_timeseries.h"
+#include "reply.h"
+#include "timeseries.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/* 时间戳为非负的毫秒数，allow_range为1时"-"、"+"代表最小与最大时间戳 */
+static int getTimestampFromObjectOrReply(client *c, robj *o, int64_t *timestamp, int allow_range) {
+    long long value;
+    sds s = o->ptr;
+
+    if (allow_range && sdslen(s) == 1 && (s[0] == '-' || s[0] == '+')) {
+        *timestamp = s[0] == '-' ? 0 : INT64_MAX;
+        return C_OK;
+    }
+    if (getLongLongFromObject(o,&value) != C_OK || value < 0) {
+        addReplyError(c,"invalid timestamp");
+        return C_ERR;
+    }
+    *timestamp = value;
+    return C_OK;
+}
+
+static int getChunkSizeFromObjectOrReply(client *c, robj *o, size_t *chunk_size) {
+    long long value;
+
+    if (getLongLongFromObject(o,&value) != C_OK || value < 64 || value > 1<<20) {
+        addReplyError(c,"CHUNK_SIZE must be between 64 and 1048576");
+        return C_ERR;
+    }
+    *chunk_size = (size_t)value;
+    return C_OK;
+}
+
+/* TSCREATE key [CHUNK_SIZE bytes] */
+void tscreateCommand(client *c) {
+    size_t chunk_size = server.ts_chunk_size;
+
+    if (c->argc == 4 && !strcasecmp(c->argv[2]->ptr,"chunk_size")) {
+        if (getChunkSizeFromObjectOrReply(c,c->argv[3],&chunk_size) != C_OK) return;
+    } else if (c->argc != 2) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+
+    if (lookupKeyWrite(server.db,c->argv[1]) != NULL) {
+        addReplyError(c,"key already exists");
+        return;
+    }
+    dbAdd(server.db,c->argv[1],createTimeseriesObject(chunk_size));
+    addReply(c,shared.ok);
+}
+
+/* TSADD key timestamp|* value [timestamp|* value ...]
+ *
+ * 先校验所有样本再写入，时间戳必须大于已有的最后一个样本并且严格递增。回复写入的样本数量 */
+void tsaddCommand(client *c) {
+    robj *o;
+    timeseries *ts = NULL;
+    int64_t *timestamps, last = -1, t;
+    double *values, v;
+    int j, n = (c->argc-2)/2;
+
+    if ((c->argc-2) % 2 != 0) {
+        addReplyError(c,"wrong number of arguments for 'tsadd' command");
+        return;
+    }
+
+    o = lookupKeyWrite(server.db,c->argv[1]);
+    if (o != NULL) {
+        if (checkType(c,o,OBJ_TIMESERIES)) return;
+        ts = o->ptr;
+        if (tsLast(ts,&t,&v)) last = t;
+    }
+
+    timestamps = zmalloc(sizeof(int64_t)*n);
+    values = zmalloc(sizeof(double)*n);
+    for (j = 0; j < n; j++) {
+        robj *tobj = c->argv[2+j*2];
+        sds s = tobj->ptr;
+
+        if (sdslen(s) == 1 && s[0] == '*') {
+            timestamps[j] = mstime();
+        } else if (getTimestampFromObjectOrReply(c,tobj,&timestamps[j],0) != C_OK) {
+            goto cleanup;
+        }
+        if (getDoubleFromObjectOrReply(c,c->argv[3+j*2],&values[j],NULL) != C_OK) goto cleanup;
+        if (timestamps[j] <= last) {
+            addReplyError(c,"timestamp must be greater than the latest sample");
+            goto cleanup;
+        }
+        last = timestamps[j];
+    }
+
+    if (o == NULL) {
+        o = createTimeseriesObject(server.ts_chunk_size);
+        dbAdd(server.db,c->argv[1],o);
+        ts = o->ptr;
+    }
+    for (j = 0; j < n; j++) tsAppend(ts,timestamps[j],values[j]);
+    addReplyLongLong(c,n);
+
+cleanup:
+    zfree(timestamps);
+    zfree(values);
+}
+
+/* TSGET key
+ * 回复最后一个样本[timestamp, value]，没有样本时回复空数组 */
+void tsgetCommand(client *c) {
+    robj *o;
+    int64_t t;
+    double v;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,o,OBJ_TIMESERIES)) return;
+
+    if (!tsLast(o->ptr,&t,&v)) {
+        addReply(c,shared.emptyarray);
+        return;
+    }
+    addReplyArrayLen(c,2);
+    addReplyLongLong(c,t);
+    addReplyDouble(c,v);
+}
+
+static void tsrangeBucketCallback(void *privdata, int64_t bucket, double value) {
+    client *c = privdata;
+
+    addReplyArrayLen(c,2);
+    addReplyLongLong(c,bucket);
+    addReplyDouble(c,value);
+}
+
+/* TSRANGE key from to [COUNT count] [AGGREGATION min|max|sum|avg|count bucket]
+ *
+ * from、to为毫秒时间戳，"-"、"+"代表最早与最新。带AGGREGATION时按bucket毫秒对齐分桶，
+ * 回复每个有样本的桶的[桶起始时间戳, 聚合值]，COUNT限制桶的数量 */
+void tsrangeCommand(client *c) {
+    robj *o;
+    int64_t from, to, bucket = 0;
+    long long count = 0;
+    int agg = TS_AGG_NONE, j;
+
+    if (getTimestampFromObjectOrReply(c,c->argv[2],&from,1) != C_OK ||
+        getTimestampFromObjectOrReply(c,c->argv[3],&to,1) != C_OK) return;
+
+    for (j = 4; j < c->argc; j++) {
+        char *opt = c->argv[j]->ptr;
+        int moreargs = c->argc-j-1;
+
+        if (!strcasecmp(opt,"count") && moreargs) {
+            if (getLongLongFromObjectOrReply(c,c->argv[++j],&count,NULL) != C_OK) return;
+            if (count <= 0) {
+                addReplyError(c,"COUNT must be positive");
+                return;
+            }
+        } else if (!strcasecmp(opt,"aggregation") && moreargs >= 2) {
+            char *type = c->argv[j+1]->ptr;
+            long long value;
+
+            if (!strcasecmp(type,"min")) agg = TS_AGG_MIN;
+            else if (!strcasecmp(type,"max")) agg = TS_AGG_MAX;
+            else if (!strcasecmp(type,"sum")) agg = TS_AGG_SUM;
+            else if (!strcasecmp(type,"avg")) agg = TS_AGG_AVG;
+            else if (!strcasecmp(type,"count")) agg = TS_AGG_COUNT;
+            else {
+                addReplyError(c,"unknown aggregation type");
+                return;
+            }
+            if (getLongLongFromObject(c->argv[j+2],&value) != C_OK || value <= 0) {
+                addReplyError(c,"bucket must be a positive integer");
+                return;
+            }
+            bucket = value;
+            j += 2;
+        } else {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+    }
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,o,OBJ_TIMESERIES)) return;
+
+    void *arraylen_ptr = addReplyDeferredLen(c);
+    long arraylen = 0;
+
+    if (agg != TS_AGG_NONE) {
+        arraylen = (long)tsAggregate(o->ptr,from,to,agg,bucket,(uint64_t)count,tsrangeBucketCallback,c);
+    } else {
+        int64_t timestamps[TS_ITER_BATCH];
+        double values[TS_ITER_BATCH];
+        tsIterator it;
+        size_t n, k;
+
+        tsIteratorInit(&it,o->ptr,from,to);
+        while ((n = tsIteratorNext(&it,timestamps,values,TS_ITER_BATCH)) != 0) {
+            for (k = 0; k < n && (count == 0 || arraylen < count); k++) {
+                addReplyArrayLen(c,2);
+                addReplyLongLong(c,timestamps[k]);
+                addReplyDouble(c,values[k]);
+                arraylen++;
+            }
+            if (count && arraylen == count) break;
+        }
+    }
+    setDeferredArrayLen(c,arraylen_ptr,arraylen);
+}
+
+/* TSINFO key */
+void tsinfoCommand(client *c) {
+    robj *o;
+    timeseries *ts;
+    size_t bytes;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.nullarray)) == NULL ||
+        checkType(c,o,OBJ_TIMESERIES)) return;
+
+    ts = o->ptr;
+    bytes = tsBytes(ts);
+    addReplyArrayLen(c,14);
+    addReplyBulkCString(c,"samples");
+    addReplyLongLong(c,(long long)ts->count);
+    addReplyBulkCString(c,"first_timestamp");
+    addReplyLongLong(c,ts->numchunks ? ts->chunks[0]->first_ts : 0);
+    addReplyBulkCString(c,"last_timestamp");
+    addReplyLongLong(c,ts->numchunks ? ts->chunks[ts->numchunks-1]->last_ts : 0);
+    addReplyBulkCString(c,"chunks");
+    addReplyLongLong(c,(long long)ts->numchunks);
+    addReplyBulkCString(c,"chunk_size");
+    addReplyLongLong(c,(long long)ts->chunk_size);
+    addReplyBulkCString(c,"memory_usage");
+    addReplyLongLong(c,(long long)bytes);
+    addReplyBulkCString(c,"bytes_per_sample");
+    addReplyDouble(c,ts->count ? (double)bytes/ts->count : 0);
+}
@@ -0,0 +1,19 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_TIMESERIES_H
+#define RESP_SERVER_T_TIMESERIES_H
+
+#include "server.h"
+
+/* 新建时间序列时每个块位流的最大字节数 */
+#define CONFIG_DEFAULT_TS_CHUNK_SIZE 4096
+
+void tscreateCommand(client *c);
+void tsaddCommand(client *c);
+void tsgetCommand(client *c);
+void tsrangeCommand(client *c);
+void tsinfoCommand(client *c);
+
+#endif //RESP_SERVER_T_TIMESERIES_H
@@ -0,0 +1,455 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 向量类型命令：VCREATE指定维度、分量类型(float32/int8)与距离度量，VADD/VDEL按id写入与删除，
+// VKNN查询最近的k个向量，索引与距离内核见vecindex.c。
+//
+// VKNN默认使用HNSW近似搜索，耗时只与EF有关；带EXACT时扫描所有向量。向量数量*维度超过
+// VECTOR_SCAN_SYNC_MAX的扫描以增量任务执行(见blocked.c)，每轮事件循环扫描一段并与之前的
+// 结果合并，扫描期间其他客户端可以继续读写，扫描到的向量以扫描时的状态为准。
+
+#include <unistd.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+#include <strings.h>
+#include "server.h"
+#include "db.h"
+#include "t_vector.h"
+#include "reply.h"
+#include "object.h"
+#include "blocked.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/*-----------------------------------------------------------------------------
+ * Vector set
+ *----------------------------------------------------------------------------*/
+
+vectorSet *vectorSetNew(uint32_t dim, int type, int metric, uint32_t M, uint32_t ef_construction) {
+    vectorSet *vs = zmalloc(sizeof(*vs));
+
+    vs->index = vecNew(dim,type,metric,M,ef_construction);
+    vs->dict = dictCreate(&zsetDictType,NULL);
+    vs->ids = NULL;
+    vs->idcap = 0;
+    return vs;
+}
+
+void vectorSetFree(vectorSet *vs) {
+    uint32_t j;
+
+    for (j = 0; j < vs->index->numslots; j++) sdsfree(vs->ids[j]);
+    zfree(vs->ids);
+    dictRelease(vs->dict);
+    vecFree(vs->index);
+    zfree(vs);
+}
+
+/* 写入已编码的向量，id已存在时替换原来的向量。返回1代表新增，0代表替换 */
+static int vectorSetAdd(vectorSet *vs, sds id, const void *vec) {
+    dictEntry *de = dictFind(vs->dict,id);
+    int added = de == NULL;
+    uint32_t slot;
+
+    if (!added) {
+        slot = (uint32_t)dictGetUnsignedIntegerVal(de);
+        id = vs->ids[slot];
+        vecDelete(vs->index,slot);
+        vs->ids[slot] = NULL;
+    } else {
+        id = sdsdup(id);
+    }
+
+    slot = vecInsert(vs->index,vec);
+    if (vs->idcap < vs->index->capslots) {
+        vs->ids = zrealloc(vs->ids,sizeof(sds)*vs->index->capslots);
+        memset(vs->ids+vs->idcap,0,sizeof(sds)*(vs->index->capslots-vs->idcap));
+        vs->idcap = vs->index->capslots;
+    }
+    vs->ids[slot] = id;
+    if (added) de = dictAddRaw(vs->dict,id,NULL);
+    dictSetUnsignedIntegerVal(de,slot);
+    return added;
+}
+
+static int vectorSetDel(vectorSet *vs, sds id) {
+    dictEntry *de = dictFind(vs->dict,id);
+    uint32_t slot;
+
+    if (de == NULL) return 0;
+    slot = (uint32_t)dictGetUnsignedIntegerVal(de);
+    dictDelete(vs->dict,id);
+    vecDelete(vs->index,slot);
+    sdsfree(vs->ids[slot]);
+    vs->ids[slot] = NULL;
+    return 1;
+}
+
+/* 解析dim个分量并编码为索引中的格式，失败时回复错误 */
+static int getVectorFromObjectsOrReply(client *c, vectorSet *vs, robj **argv, int argc, void *out) {
+    vecIndex *vi = vs->index;
+    float *values;
+    int j;
+
+    if ((uint32_t)argc != vi->dim) {
+        addReplyErrorFormat(c,"vector must have %u components",vi->dim);
+        return C_ERR;
+    }
+    values = zmalloc(sizeof(float)*vi->dim);
+    for (j = 0; j < argc; j++) {
+        if (vi->type == VEC_INT8) {
+            long long v;
+
+            if (getLongLongFromObject(argv[j],&v) != C_OK || v < -128 || v > 127) {
+                addReplyError(c,"INT8 components must be integers between -128 and 127");
+                goto err;
+            }
+            values[j] = (float)v;
+        } else {
+            double v;
+
+            if (getDoubleFromObject(argv[j],&v) != C_OK || isinf(v) || fabs(v) > FLT_MAX) {
+                addReplyError(c,"FLOAT32 components must be finite floats");
+                goto err;
+            }
+            values[j] = (float)v;
+        }
+    }
+    if (!vecEncode(vi,values,out)) {
+        addReplyError(c,"zero vector can't be used with the COSINE metric");
+        goto err;
+    }
+    zfree(values);
+    return C_OK;
+
+err:
+    zfree(values);
+    return C_ERR;
+}
+
+static const char *vectorTypeName(int type) {
+    return type == VEC_INT8 ? "int8" : "float32";
+}
+
+static const char *vectorMetricName(int metric) {
+    if (metric == VEC_METRIC_IP) return "ip";
+    if (metric == VEC_METRIC_COSINE) return "cosine";
+    return "l2";
+}
+
+/* 距离是float，按float的有效位数回复，避免转为double后多出的尾数 */
+static void addReplyDistance(client *c, float distance) {
+    char buf[32];
+    int len = snprintf(buf,sizeof(buf),"%.9g",distance);
+
+    addReplyBulkCBuffer(c,buf,len);
+}
+
+/*-----------------------------------------------------------------------------
+ * Incremental exact search
+ *----------------------------------------------------------------------------*/
+
+/* 已合并的结果，id复制一份，扫描期间向量被删除或替换不影响已有的结果 */
+typedef struct vectorNeighbor {
+    sds id;
+    float distance;
+} vectorNeighbor;
+
+typedef struct vectorScanJob {
+    robj *o;                    /* 持有引用，扫描期间key被删除时对象不会被释放 */
+    void *query;                /* 已编码的查询向量 */
+    size_t k;
+    uint32_t pos;               /* 下一个扫描的slot */
+    vecResult *step;            /* 一段扫描的结果 */
+    vectorNeighbor *top;        /* 按距离升序 */
+    vectorNeighbor *merged;
+    size_t numtop;
+} vectorScanJob;
+
+static void vectorScanJobFree(void *privdata) {
+    vectorScanJob *job = privdata;
+    size_t j;
+
+    for (j = 0; j < job->numtop; j++) sdsfree(job->top[j].id);
+    decrRefCount(job->o);
+    zfree(job->query);
+    zfree(job->step);
+    zfree(job->top);
+    zfree(job->merged);
+    zfree(job);
+}
+
+/* 把一段扫描的n个结果合并到job->top中 */
+static void vectorScanMerge(vectorScanJob *job, vectorSet *vs, size_t n) {
+    size_t i = 0, j = 0, m = 0;
+    vectorNeighbor *tmp;
+
+    while (m < job->k && (i < job->numtop || j < n)) {
+        if (j == n || (i < job->numtop && job->top[i].distance <= job->step[j].distance)) {
+            job->merged[m++] = job->top[i++];
+        } else {
+            job->merged[m].id = sdsdup(vs->ids[job->step[j].slot]);
+            job->merged[m++].distance = job->step[j++].distance;
+        }
+    }
+    for (; i < job->numtop; i++) sdsfree(job->top[i].id);
+    tmp = job->top;
+    job->top = job->merged;
+    job->merged = tmp;
+    job->numtop = m;
+}
+
+static int vectorScanJobProc(client *c, void *privdata, long long deadline) {
+    vectorScanJob *job = privdata;
+    vectorSet *vs = job->o->ptr;
+    vecIndex *vi = vs->index;
+    uint32_t step = VECTOR_SCAN_STEP/vi->dim ? VECTOR_SCAN_STEP/vi->dim : 1, end;
+    size_t n, j;
+
+    do {
+        end = vi->numslots-job->pos > step ? job->pos+step : vi->numslots;
+        n = vecSearchFlat(vi,job->query,job->pos,end,job->k,job->step);
+        vectorScanMerge(job,vs,n);
+        job->pos = end;
+    } while (job->pos < vi->numslots && ustime() < deadline);
+
+    if (job->pos < vi->numslots) return 0;
+    addReplyArrayLen(c,job->numtop*2);
+    for (j = 0; j < job->numtop; j++) {
+        addReplyBulkCBuffer(c,job->top[j].id,sdslen(job->top[j].id));
+        addReplyDistance(c,job->top[j].distance);
+    }
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------
+ * Commands
+ *----------------------------------------------------------------------------*/
+
+/* VCREATE key DIM dim [TYPE FLOAT32|INT8] [METRIC L2|IP|COSINE] [M m] [EF_CONSTRUCTION ef] */
+void vcreateCommand(client *c) {
+    long long dim = 0, M = VECTOR_DEFAULT_M, efc = VECTOR_DEFAULT_EF_CONSTRUCTION;
+    int type = VEC_FLOAT32, metric = VEC_METRIC_L2, j;
+
+    for (j = 2; j < c->argc; j++) {
+        char *opt = c->argv[j]->ptr, *arg;
+
+        if (j+1 == c->argc) {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+        arg = c->argv[++j]->ptr;
+        if (!strcasecmp(opt,"dim")) {
+            if (getLongLongFromObject(c->argv[j],&dim) != C_OK || dim < 1 || dim > VEC_MAX_DIM) {
+                addReplyErrorFormat(c,"DIM must be between 1 and %d",VEC_MAX_DIM);
+                return;
+            }
+        } else if (!strcasecmp(opt,"type")) {
+            if (!strcasecmp(arg,"float32")) type = VEC_FLOAT32;
+            else if (!strcasecmp(arg,"int8")) type = VEC_INT8;
+            else {
+                addReplyError(c,"TYPE must be FLOAT32 or INT8");
+                return;
+            }
+        } else if (!strcasecmp(opt,"metric")) {
+            if (!strcasecmp(arg,"l2")) metric = VEC_METRIC_L2;
+            else if (!strcasecmp(arg,"ip")) metric = VEC_METRIC_IP;
+            else if (!strcasecmp(arg,"cosine")) metric = VEC_METRIC_COSINE;
+            else {
+                addReplyError(c,"METRIC must be L2, IP or COSINE");
+                return;
+            }
+        } else if (!strcasecmp(opt,"m")) {
+            if (getLongLongFromObject(c->argv[j],&M) != C_OK || M < 2 || M > VECTOR_MAX_M) {
+                addReplyErrorFormat(c,"M must be between 2 and %d",VECTOR_MAX_M);
+                return;
+            }
+        } else if (!strcasecmp(opt,"ef_construction")) {
+            if (getLongLongFromObject(c->argv[j],&efc) != C_OK || efc < 1 || efc > VECTOR_MAX_EF) {
+                addReplyErrorFormat(c,"EF_CONSTRUCTION must be between 1 and %d",VECTOR_MAX_EF);
+                return;
+            }
+        } else {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+    }
+    if (dim == 0) {
+        addReplyError(c,"DIM is required");
+        return;
+    }
+
+    if (lookupKeyWrite(server.db,c->argv[1]) != NULL) {
+        addReplyError(c,"key already exists");
+        return;
+    }
+    dbAdd(server.db,c->argv[1],createVectorObject((uint32_t)dim,type,metric,(uint32_t)M,(uint32_t)efc));
+    addReply(c,shared.ok);
+}
+
+/* VADD key id v1 ... vdim
+ * 回复1代表新增，0代表替换了已有的向量 */
+void vaddCommand(client *c) {
+    robj *o;
+    vectorSet *vs;
+    void *vec;
+
+    if ((o = lookupKeyWrite(server.db,c->argv[1])) == NULL) {
+        addReplyError(c,"no such vector index, use VCREATE first");
+        return;
+    }
+    if (checkType(c,o,OBJ_VECTOR)) return;
+    vs = o->ptr;
+
+    vec = zmalloc(vs->index->stride);
+    if (getVectorFromObjectsOrReply(c,vs,c->argv+3,c->argc-3,vec) == C_OK)
+        addReply(c,vectorSetAdd(vs,c->argv[2]->ptr,vec) ? shared.cone : shared.czero);
+    zfree(vec);
+}
+
+/* VDEL key id [id ...]
+ * 回复删除的向量数量 */
+void vdelCommand(client *c) {
+    robj *o;
+    long long deleted = 0;
+    int j;
+
+    if ((o = lookupKeyWrite(server.db,c->argv[1])) == NULL) {
+        addReply(c,shared.czero);
+        return;
+    }
+    if (checkType(c,o,OBJ_VECTOR)) return;
+
+    for (j = 2; j < c->argc; j++) deleted += vectorSetDel(o->ptr,c->argv[j]->ptr);
+    addReplyLongLong(c,deleted);
+}
+
+/* VKNN key k [EF ef] [EXACT] VALUES v1 ... vdim
+ *
+ * 回复最近的k个向量[id, distance, ...]，按距离升序。距离越小越相似：L2为欧氏距离的平方，
+ * IP为内积的相反数，COSINE为1-余弦相似度。EF为HNSW搜索宽度，越大召回率越高，
+ * EXACT扫描所有向量，结果是精确的 */
+void vknnCommand(client *c) {
+    robj *o;
+    vectorSet *vs;
+    long long k, ef = VECTOR_DEFAULT_EF;
+    int exact = 0, values = 0, j;
+    void *query;
+    vecResult *res;
+    size_t n;
+
+    if (getLongLongFromObjectOrReply(c,c->argv[2],&k,NULL) != C_OK) return;
+    if (k <= 0) {
+        addReplyError(c,"k must be positive");
+        return;
+    }
+    for (j = 3; j < c->argc && !values; j++) {
+        char *opt = c->argv[j]->ptr;
+
+        if (!strcasecmp(opt,"ef") && j+1 < c->argc) {
+            if (getLongLongFromObject(c->argv[++j],&ef) != C_OK || ef < 1 || ef > VECTOR_MAX_EF) {
+                addReplyErrorFormat(c,"EF must be between 1 and %d",VECTOR_MAX_EF);
+                return;
+            }
+        } else if (!strcasecmp(opt,"exact")) {
+            exact = 1;
+        } else if (!strcasecmp(opt,"values")) {
+            values = j+1;
+        } else {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+    }
+    if (!values) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,o,OBJ_VECTOR)) return;
+    vs = o->ptr;
+
+    query = zmalloc(vs->index->stride);
+    if (getVectorFromObjectsOrReply(c,vs,c->argv+values,c->argc-values,query) != C_OK) {
+        zfree(query);
+        return;
+    }
+    if ((uint64_t)k > vs->index->count) k = vs->index->count;
+    if (k == 0) {
+        zfree(query);
+        addReply(c,shared.emptyarray);
+        return;
+    }
+
+    /* 大的精确搜索挂起客户端，分多轮事件循环扫描 */
+    if (exact && (uint64_t)vs->index->count*vs->index->dim > VECTOR_SCAN_SYNC_MAX) {
+        vectorScanJob *job = zmalloc(sizeof(*job));
+
+        job->o = o;
+        incrRefCount(o);
+        job->query = query;
+        job->k = (size_t)k;
+        job->pos = 0;
+        job->step = zmalloc(sizeof(vecResult)*k);
+        job->top = zmalloc(sizeof(vectorNeighbor)*k);
+        job->merged = zmalloc(sizeof(vectorNeighbor)*k);
+        job->numtop = 0;
+        blockClientOnJob(c,vectorScanJobProc,vectorScanJobFree,job);
+        return;
+    }
+
+    res = zmalloc(sizeof(vecResult)*k);
+    if (exact)
+        n = vecSearchFlat(vs->index,query,0,vs->index->numslots,(size_t)k,res);
+    else
+        n = vecSearch(vs->index,query,(size_t)k,(size_t)ef,res);
+    addReplyArrayLen(c,(long)n*2);
+    for (j = 0; j < (int)n; j++) {
+        sds id = vs->ids[res[j].slot];
+
+        addReplyBulkCBuffer(c,id,sdslen(id));
+        addReplyDistance(c,res[j].distance);
+    }
+    zfree(res);
+    zfree(query);
+}
+
+/* VCARD key */
+void vcardCommand(client *c) {
+    robj *o;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,o,OBJ_VECTOR)) return;
+    addReplyLongLong(c,((vectorSet *)o->ptr)->index->count);
+}
+
+/* VINFO key */
+void vinfoCommand(client *c) {
+    robj *o;
+    vecIndex *vi;
+
+    if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.nullarray)) == NULL ||
+        checkType(c,o,OBJ_VECTOR)) return;
+
+    vi = ((vectorSet *)o->ptr)->index;
+    addReplyArrayLen(c,18);
+    addReplyBulkCString(c,"dim");
+    addReplyLongLong(c,vi->dim);
+    addReplyBulkCString(c,"type");
+    addReplyBulkCString(c,vectorTypeName(vi->type));
+    addReplyBulkCString(c,"metric");
+    addReplyBulkCString(c,vectorMetricName(vi->metric));
+    addReplyBulkCString(c,"vectors");
+    addReplyLongLong(c,vi->count);
+    addReplyBulkCString(c,"m");
+    addReplyLongLong(c,vi->M);
+    addReplyBulkCString(c,"ef_construction");
+    addReplyLongLong(c,vi->ef_construction);
+    addReplyBulkCString(c,"max_level");
+    addReplyLongLong(c,vi->max_level);
+    addReplyBulkCString(c,"index_memory");
+    addReplyLongLong(c,(long long)vecBytes(vi));
+    addReplyBulkCString(c,"kernel");
+    addReplyBulkCString(c,vecKernelName());
+}
@@ -0,0 +1,40 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_VECTOR_H
+#define RESP_SERVER_T_VECTOR_H
+
+#include "server.h"
+#include "vecindex.h"
+
+/* VCREATE未指定时的HNSW参数，以及VKNN未指定EF时的搜索宽度 */
+#define VECTOR_DEFAULT_M 16
+#define VECTOR_MAX_M 128
+#define VECTOR_DEFAULT_EF_CONSTRUCTION 200
+#define VECTOR_MAX_EF 100000
+#define VECTOR_DEFAULT_EF 64
+
+/* 精确搜索的向量数量*维度超过该值时以增量任务执行，每轮事件循环只扫描一段 */
+#define VECTOR_SCAN_SYNC_MAX (1<<20)
+#define VECTOR_SCAN_STEP (1<<16)    /* 每次检查时间前扫描的分量数量 */
+
+/* 向量集合：id到slot的映射与向量索引，id的sds由ids与dict共享 */
+typedef struct vectorSet {
+    vecIndex *index;
+    dict *dict;                 /* id -> slot */
+    sds *ids;                   /* slot -> id，空闲slot为NULL */
+    uint32_t idcap;
+} vectorSet;
+
+vectorSet *vectorSetNew(uint32_t dim, int type, int metric, uint32_t M, uint32_t ef_construction);
+void vectorSetFree(vectorSet *vs);
+
+void vcreateCommand(client *c);
+void vaddCommand(client *c);
+void vdelCommand(client *c);
+void vknnCommand(client *c);
+void vcardCommand(client *c);
+void vinfoCommand(client *c);
+
+#endif //RESP_SERVER_T_VECTOR_H
@@ -0,0 +1,949 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// zset类型命令。小zset使用listpack编码，member与score依次保存，按score升序排列；
+// 元素数量超过zset-max-listpack-entries或member长度超过zset-max-listpack-value时
+// 转换为OBJ_ENCODING_BTREE：按排名有序的B+树(见zbtree.c)加上member到score的dict，
+// 两者共享member。转换是单向的。
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <strings.h>
+#include "server.h"
+#include "db.h"
+#include "t_zset.h"
+#include "reply.h"
+#include "util.h"
+#include "listpack.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/* Input flags. */
+#define ZADD_IN_NONE 0
+#define ZADD_IN_INCR (1<<0)    /* Increment the score instead of setting it. */
+#define ZADD_IN_NX (1<<1)      /* Don't touch elements not already existing. */
+#define ZADD_IN_XX (1<<2)      /* Only touch elements already existing. */
+#define ZADD_IN_GT (1<<3)      /* Only update existing when new scores are higher. */
+#define ZADD_IN_LT (1<<4)      /* Only update existing when new scores are lower. */
+
+/* Output flags. */
+#define ZADD_OUT_NOP (1<<0)     /* Operation not performed because of conditionals.*/
+#define ZADD_OUT_NAN (1<<1)     /* Only touch elements already existing. */
+#define ZADD_OUT_ADDED (1<<2)   /* The element was new and was added. */
+#define ZADD_OUT_UPDATED (1<<3) /* The element already existed, score updated. */
+
+#define MAX_D2STRING_CHARS 128
+
+static void zsetConvert(robj *zobj, int encoding);
+
+/* Populate the rangespec according to the objects min and max. */
+static int zslParseRange(robj *min, robj *max, zrangespec *spec) {
+    char *eptr;
+    spec->minex = spec->maxex = 0;
+
+    /* Parse the min-max interval. If one of the values is prefixed
+     * by the "(" character, it's considered "open". For instance
+     * ZRANGEBYSCORE zset (1.5 (2.5 will match min < x < max
+     * ZRANGEBYSCORE zset 1.5 2.5 will instead match min <= x <= max */
+    if (((char*)min->ptr)[0] == '(') {
+        spec->min = strtod((char*)min->ptr+1,&eptr);
+        if (eptr[0] != '\0' || isnan(spec->min)) return C_ERR;
+        spec->minex = 1;
+    } else {
+        spec->min = strtod((char*)min->ptr,&eptr);
+        if (eptr[0] != '\0' || isnan(spec->min)) return C_ERR;
+    }
+    if (((char*)max->ptr)[0] == '(') {
+        spec->max = strtod((char*)max->ptr+1,&eptr);
+        if (eptr[0] != '\0' || isnan(spec->max)) return C_ERR;
+        spec->maxex = 1;
+    } else {
+        spec->max = strtod((char*)max->ptr,&eptr);
+        if (eptr[0] != '\0' || isnan(spec->max)) return C_ERR;
+    }
+
+    return C_OK;
+}
+
+/*-----------------------------------------------------------------------------
+ * Listpack-backed sorted set API
+ *----------------------------------------------------------------------------*/
+
+static double zzlStrtod(unsigned char *vstr, unsigned int vlen) {
+    char buf[128];
+    if (vlen > sizeof(buf)-1)
+        vlen = sizeof(buf)-1;
+    memcpy(buf,vstr,vlen);
+    buf[vlen] = '\0';
+    return strtod(buf,NULL);
+}
+
+static double zzlGetScore(unsigned char *sptr) {
+    unsigned char *vstr;
+    int64_t vlen;
+
+    serverAssert(sptr != NULL);
+    vstr = lpGet(sptr,&vlen,NULL);
+    if (vstr) return zzlStrtod(vstr,vlen);
+    return (double)vlen;
+}
+
+/* Compare element in sorted set with given element. */
+static int zzlCompareElements(unsigned char *eptr, unsigned char *cstr, unsigned int clen) {
+    unsigned char *vstr;
+    int64_t vlen;
+    unsigned char vbuf[LP_INTBUF_SIZE];
+    int minlen, cmp;
+
+    vstr = lpGet(eptr,&vlen,vbuf);
+    minlen = (vlen < clen) ? vlen : clen;
+    cmp = memcmp(vstr,cstr,minlen);
+    if (cmp == 0) return vlen-clen;
+    return cmp;
+}
+
+static unsigned int zzlLength(unsigned char *zl) {
+    return lpLength(zl)/2;
+}
+
+/* Move to next entry based on the values in eptr and sptr. Both are set to
+ * NULL when there is no next entry. */
+static void zzlNext(unsigned char *zl, unsigned char **eptr, unsigned char **sptr) {
+    unsigned char *_eptr, *_sptr;
+    serverAssert(*eptr != NULL && *sptr != NULL);
+
+    _eptr = lpNext(zl,*sptr);
+    if (_eptr != NULL) {
+        _sptr = lpNext(zl,_eptr);
+        serverAssert(_sptr != NULL);
+    } else {
+        /* No next entry. */
+        _sptr = NULL;
+    }
+
+    *eptr = _eptr;
+    *sptr = _sptr;
+}
+
+/* Find pointer to the first element contained in the specified range.
+ * Returns NULL when no element is contained in the range. */
+static unsigned char *zzlFirstInRange(unsigned char *zl, zrangespec *range) {
+    unsigned char *eptr = lpFirst(zl), *sptr;
+    double score;
+
+    while (eptr != NULL) {
+        sptr = lpNext(zl,eptr);
+        serverAssert(sptr != NULL);
+
+        score = zzlGetScore(sptr);
+        if (zbtValueGteMin(score,range)) {
+            /* Check if score <= max. */
+            if (zbtValueLteMax(score,range))
+                return eptr;
+            return NULL;
+        }
+
+        /* Move to next element. */
+        eptr = lpNext(zl,sptr);
+    }
+
+    return NULL;
+}
+
+static unsigned char *zzlFind(unsigned char *lp, sds ele, double *score) {
+    unsigned char *eptr, *sptr;
+
+    if ((eptr = lpFirst(lp)) == NULL) return NULL;
+    eptr = lpFind(lp,eptr,(unsigned char*)ele,sdslen(ele),1);
+    if (eptr) {
+        sptr = lpNext(lp,eptr);
+        serverAssert(sptr != NULL);
+
+        /* Matching element, pull out score. */
+        if (score != NULL) *score = zzlGetScore(sptr);
+        return eptr;
+    }
+    return NULL;
+}
+
+/* Delete (element,score) pair from listpack. Use local copy of eptr because we
+ * don't want to modify the one given as argument. */
+static unsigned char *zzlDelete(unsigned char *zl, unsigned char *eptr) {
+    return lpDeleteRangeWithEntry(zl,&eptr,2);
+}
+
+static unsigned char *zzlInsertAt(unsigned char *zl, unsigned char *eptr, sds ele, double score) {
+    unsigned char *sptr;
+    char scorebuf[MAX_D2STRING_CHARS];
+    int scorelen;
+
+    scorelen = d2string(scorebuf,sizeof(scorebuf),score);
+    if (eptr == NULL) {
+        zl = lpAppend(zl,(unsigned char*)ele,sdslen(ele));
+        zl = lpAppend(zl,(unsigned char*)scorebuf,scorelen);
+    } else {
+        /* Insert member before the element 'eptr'. */
+        zl = lpInsert(zl,(unsigned char*)ele,sdslen(ele),eptr,LP_BEFORE,&sptr);
+
+        /* Insert score after the member. */
+        zl = lpInsert(zl,(unsigned char*)scorebuf,scorelen,sptr,LP_AFTER,NULL);
+    }
+    return zl;
+}
+
+/* Insert (element,score) pair in listpack. This function assumes the element is
+ * not yet present in the list. */
+static unsigned char *zzlInsert(unsigned char *zl, sds ele, double score) {
+    unsigned char *eptr = lpFirst(zl), *sptr;
+    double s;
+
+    while (eptr != NULL) {
+        sptr = lpNext(zl,eptr);
+        serverAssert(sptr != NULL);
+        s = zzlGetScore(sptr);
+
+        if (s > score) {
+            /* First element with score larger than score for element to be
+             * inserted. This means we should take its spot in the list to
+             * maintain ordering. */
+            zl = zzlInsertAt(zl,eptr,ele,score);
+            break;
+        } else if (s == score) {
+            /* Ensure lexicographical ordering for elements. */
+            if (zzlCompareElements(eptr,(unsigned char*)ele,sdslen(ele)) > 0) {
+                zl = zzlInsertAt(zl,eptr,ele,score);
+                break;
+            }
+        }
+
+        /* Move to next element. */
+        eptr = lpNext(zl,sptr);
+    }
+
+    /* Push on tail of list when it was not yet inserted. */
+    if (eptr == NULL)
+        zl = zzlInsertAt(zl,NULL,ele,score);
+    return zl;
+}
+
+/*-----------------------------------------------------------------------------
+ * Common sorted set API
+ *----------------------------------------------------------------------------*/
+
+static unsigned long zsetLength(const robj *zobj) {
+    if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
+        return zzlLength(zobj->ptr);
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        return ((const zset*)zobj->ptr)->zbt->length;
+    }
+    serverPanic("Unknown sorted set encoding");
+    return 0;
+}
+
+static void zsetDictAdd(dict *d, sds ele, double score) {
+    dictEntry *de = dictAddRaw(d,ele,NULL);
+
+    serverAssert(de != NULL);
+    dictSetDoubleVal(de,score);
+}
+
+static void zsetConvert(robj *zobj, int encoding) {
+    zset *zs;
+    unsigned char *zl = zobj->ptr, *eptr, *sptr;
+    unsigned char vbuf[LP_INTBUF_SIZE];
+    unsigned char *vstr;
+    int64_t vlen;
+    double score;
+    sds ele;
+
+    if (zobj->encoding == encoding) return;
+    if (zobj->encoding != OBJ_ENCODING_LISTPACK || encoding != OBJ_ENCODING_BTREE)
+        serverPanic("Unknown sorted set encoding");
+
+    zs = zmalloc(sizeof(*zs));
+    zs->dict = dictCreate(&zsetDictType,NULL);
+    zs->zbt = zbtCreate();
+    dictExpand(zs->dict,zzlLength(zl));
+
+    eptr = lpFirst(zl);
+    if (eptr != NULL) {
+        sptr = lpNext(zl,eptr);
+        serverAssert(sptr != NULL);
+    }
+
+    while (eptr != NULL) {
+        score = zzlGetScore(sptr);
+        vstr = lpGet(eptr,&vlen,vbuf);
+        ele = sdsnewlen(vstr,vlen);
+
+        zbtInsert(zs->zbt,score,ele);
+        zsetDictAdd(zs->dict,ele,score);
+        zzlNext(zl,&eptr,&sptr);
+    }
+
+    lpFree(zl);
+    zobj->ptr = zs;
+    zobj->encoding = OBJ_ENCODING_BTREE;
+}
+
+/* Return (by reference) the score of the specified member of the sorted set
+ * storing it into *score. If the element does not exist C_ERR is returned
+ * otherwise C_OK is returned and *score is correctly populated. */
+static int zsetScore(robj *zobj, sds member, double *score) {
+    if (!zobj || !member) return C_ERR;
+
+    if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
+        if (zzlFind(zobj->ptr,member,score) == NULL) return C_ERR;
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        dictEntry *de = dictFind(zs->dict,member);
+        if (de == NULL) return C_ERR;
+        *score = dictGetDoubleVal(de);
+    } else {
+        serverPanic("Unknown sorted set encoding");
+    }
+    return C_OK;
+}
+
+/* Add a new element or update the score of an existing element in a sorted
+ * set, regardless of its encoding.
+ *
+ * The set of flags change the command behavior.
+ *
+ * The input flags are the following:
+ *
+ * ZADD_IN_INCR: Increment the current element score by 'score' instead of updating
+ *               the current element score. If the element does not exist, we
+ *               assume 0 as previous score.
+ * ZADD_IN_NX:   Perform the operation only if the element does not exist.
+ * ZADD_IN_XX:   Perform the operation only if the element already exist.
+ * ZADD_IN_GT:   Perform the operation on existing elements only if the new score is
+ *               greater than the current score.
+ * ZADD_IN_LT:   Perform the operation on existing elements only if the new score is
+ *               less than the current score.
+ *
+ * When ZADD_IN_INCR is used, the new score of the element is stored in
+ * '*newscore' if 'newscore' is not NULL.
+ *
+ * The returned flags are the following:
+ *
+ * ZADD_OUT_NAN:     The resulting score is not a number.
+ * ZADD_OUT_ADDED:   The element was added (not present before the call).
+ * ZADD_OUT_UPDATED: The element score was updated.
+ * ZADD_OUT_NOP:     No operation was performed because of NX or XX.
+ *
+ * Return value:
+ *
+ * The function returns 1 on success, and sets the appropriate flags
+ * ADDED or UPDATED to signal what happened during the operation (note that
+ * none could be set if we re-added an element using the same score it used
+ * to have, or in the case a zero increment is used).
+ *
+ * The function returns 0 on error, currently only when the increment
+ * produces a NAN condition, or when the 'score' value is NAN since the
+ * start.
+ *
+ * The command as a side effect of adding a new element may convert the sorted
+ * set internal encoding from listpack to B+tree.
+ *
+ * Memory management of 'ele':
+ *
+ * The function does not take ownership of the 'ele' SDS string, but copies
+ * it if needed. */
+static int zsetAdd(robj *zobj, double score, sds ele, int in_flags, int *out_flags, double *newscore) {
+    /* Turn options into simple to check vars. */
+    int incr = (in_flags & ZADD_IN_INCR) != 0;
+    int nx = (in_flags & ZADD_IN_NX) != 0;
+    int xx = (in_flags & ZADD_IN_XX) != 0;
+    int gt = (in_flags & ZADD_IN_GT) != 0;
+    int lt = (in_flags & ZADD_IN_LT) != 0;
+    *out_flags = 0; /* We'll return our response flags. */
+    double curscore;
+
+    /* NaN as input is an error regardless of all the other parameters. */
+    if (isnan(score)) {
+        *out_flags = ZADD_OUT_NAN;
+        return 0;
+    }
+
+    /* Update the sorted set according to its encoding. */
+    if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *eptr;
+
+        if ((eptr = zzlFind(zobj->ptr,ele,&curscore)) != NULL) {
+            /* NX? Return, same element already exists. */
+            if (nx) {
+                *out_flags |= ZADD_OUT_NOP;
+                return 1;
+            }
+
+            /* Prepare the score for the increment if needed. */
+            if (incr) {
+                score += curscore;
+                if (isnan(score)) {
+                    *out_flags |= ZADD_OUT_NAN;
+                    return 0;
+                }
+            }
+
+            /* GT/LT? Only update if score is greater/less than current. */
+            if ((lt && score >= curscore) || (gt && score <= curscore)) {
+                *out_flags |= ZADD_OUT_NOP;
+                return 1;
+            }
+
+            if (newscore) *newscore = score;
+
+            /* Remove and re-insert when score changed. */
+            if (score != curscore) {
+                zobj->ptr = zzlDelete(zobj->ptr,eptr);
+                zobj->ptr = zzlInsert(zobj->ptr,ele,score);
+                *out_flags |= ZADD_OUT_UPDATED;
+            }
+            return 1;
+        } else if (!xx) {
+            /* Check if the element is too large or the list
+             * becomes too long *before* executing zzlInsert. */
+            if (zzlLength(zobj->ptr)+1 > server.zset_max_listpack_entries ||
+                sdslen(ele) > server.zset_max_listpack_value ||
+                !lpSafeToAdd(zobj->ptr,sdslen(ele)))
+            {
+                zsetConvert(zobj,OBJ_ENCODING_BTREE);
+            } else {
+                zobj->ptr = zzlInsert(zobj->ptr,ele,score);
+                if (newscore) *newscore = score;
+                *out_flags |= ZADD_OUT_ADDED;
+                return 1;
+            }
+        } else {
+            *out_flags |= ZADD_OUT_NOP;
+            return 1;
+        }
+    }
+
+    /* Note that the above block handling listpack would have either returned or
+     * converted the key to B+tree. */
+    if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        dictEntry *de;
+
+        de = dictFind(zs->dict,ele);
+        if (de != NULL) {
+            /* NX? Return, same element already exists. */
+            if (nx) {
+                *out_flags |= ZADD_OUT_NOP;
+                return 1;
+            }
+
+            curscore = dictGetDoubleVal(de);
+
+            /* Prepare the score for the increment if needed. */
+            if (incr) {
+                score += curscore;
+                if (isnan(score)) {
+                    *out_flags |= ZADD_OUT_NAN;
+                    return 0;
+                }
+            }
+
+            /* GT/LT? Only update if score is greater/less than current. */
+            if ((lt && score >= curscore) || (gt && score <= curscore)) {
+                *out_flags |= ZADD_OUT_NOP;
+                return 1;
+            }
+
+            if (newscore) *newscore = score;
+
+            /* Remove and re-insert when score changes. */
+            if (score != curscore) {
+                zbtUpdateScore(zs->zbt,curscore,ele,score);
+                dictSetDoubleVal(de,score);
+                *out_flags |= ZADD_OUT_UPDATED;
+            }
+            return 1;
+        } else if (!xx) {
+            ele = sdsdup(ele);
+            zbtInsert(zs->zbt,score,ele);
+            zsetDictAdd(zs->dict,ele,score);
+            *out_flags |= ZADD_OUT_ADDED;
+            if (newscore) *newscore = score;
+            return 1;
+        } else {
+            *out_flags |= ZADD_OUT_NOP;
+            return 1;
+        }
+    } else {
+        serverPanic("Unknown sorted set encoding");
+    }
+    return 0; /* Never reached. */
+}
+
+/* Delete the element 'ele' from the sorted set encoded as a B+tree+dict,
+ * returning 1 if the element existed and was deleted, 0 otherwise (the
+ * element was not there). */
+static int zsetRemoveFromBtree(zset *zs, sds ele) {
+    dictEntry *de;
+    double score;
+
+    de = dictUnlink(zs->dict,ele);
+    if (de != NULL) {
+        /* Get the score in order to delete from the B+tree later. */
+        score = dictGetDoubleVal(de);
+
+        /* Delete from the hash table. The member is shared with the
+         * B+tree, which frees it below. */
+        dictFreeUnlinkedEntry(zs->dict,de);
+
+        /* Delete from B+tree. */
+        int retval = zbtDelete(zs->zbt,score,ele,NULL);
+        serverAssert(retval);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Delete the element 'ele' from the sorted set, returning 1 if the element
+ * existed and was deleted, 0 otherwise (the element was not there). */
+static int zsetDel(robj *zobj, sds ele) {
+    if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *eptr;
+
+        if ((eptr = zzlFind(zobj->ptr,ele,NULL)) != NULL) {
+            zobj->ptr = zzlDelete(zobj->ptr,eptr);
+            return 1;
+        }
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        if (zsetRemoveFromBtree(zs,ele)) return 1;
+    } else {
+        serverPanic("Unknown sorted set encoding");
+    }
+    return 0; /* No such element found. */
+}
+
+/* Given a sorted set object returns the 0-based rank of the object or
+ * -1 if the object does not exist. The B+tree computes it in O(log(N))
+ * from the element counts of the inner nodes. */
+static long zsetRank(robj *zobj, sds ele) {
+    unsigned long llen;
+    unsigned long rank;
+
+    llen = zsetLength(zobj);
+
+    if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *zl = zobj->ptr;
+        unsigned char *eptr, *sptr;
+
+        eptr = lpFirst(zl);
+        serverAssert(eptr != NULL);
+        sptr = lpNext(zl,eptr);
+        serverAssert(sptr != NULL);
+
+        rank = 1;
+        while(eptr != NULL) {
+            if (lpCompare(eptr,(unsigned char*)ele,sdslen(ele)))
+                break;
+            rank++;
+            zzlNext(zl,&eptr,&sptr);
+        }
+
+        if (eptr != NULL) return rank-1;
+        return -1;
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        dictEntry *de;
+        double score;
+
+        de = dictFind(zs->dict,ele);
+        if (de != NULL) {
+            score = dictGetDoubleVal(de);
+            rank = zbtGetRank(zs->zbt,score,ele);
+            /* Existing elements always have a rank. */
+            serverAssert(rank != 0 && rank <= llen);
+            return rank-1;
+        }
+        return -1;
+    } else {
+        serverPanic("Unknown sorted set encoding");
+    }
+    return -1;
+}
+
+/* Reply with 'count' elements of a listpack encoded sorted set, starting
+ * at 'eptr'. */
+static void zsetReplyListpackRange(client *c, unsigned char *zl, unsigned char *eptr,
+                                   unsigned long count, int withscores) {
+    unsigned char *sptr = lpNext(zl,eptr);
+
+    while (count--) {
+        unsigned char *vstr;
+        int64_t vlen;
+
+        serverAssert(eptr != NULL && sptr != NULL);
+        vstr = lpGet(eptr,&vlen,NULL);
+        if (vstr)
+            addReplyBulkCBuffer(c,vstr,vlen);
+        else
+            addReplyBulkLongLong(c,vlen);
+        if (withscores) addReplyDouble(c,zzlGetScore(sptr));
+        zzlNext(zl,&eptr,&sptr);
+    }
+}
+
+/* Reply with 'count' elements of a B+tree starting at position 'idx' of
+ * the leaf 'l'. The elements are read from the arrays of one leaf after
+ * the other. */
+static void zsetReplyBtreeRange(client *c, zbtLeaf *l, int idx, unsigned long count,
+                                int withscores) {
+    while (count) {
+        serverAssert(l != NULL);
+        for (; idx < l->hdr.n && count; idx++, count--) {
+            addReplyBulkCBuffer(c,l->ele[idx],sdslen(l->ele[idx]));
+            if (withscores) addReplyDouble(c,l->score[idx]);
+        }
+        l = l->next;
+        idx = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * Sorted set commands
+ *----------------------------------------------------------------------------*/
+
+/* This generic command implements both ZADD and ZINCRBY. */
+static void zaddGenericCommand(client *c, int flags) {
+    static char *nanerr = "resulting score is not a number (NaN)";
+    robj *key = c->argv[1];
+    robj *zobj;
+    sds ele;
+    double score = 0, *scores = NULL;
+    int j, elements, ch = 0;
+    int scoreidx = 0;
+    /* The following vars are used in order to track what the command actually
+     * did during the execution, to reply to the client. */
+    int added = 0;      /* Number of new elements added. */
+    int updated = 0;    /* Number of elements with updated score. */
+    int processed = 0;  /* Number of elements processed, may remain zero with
+                           options like XX. */
+
+    /* Parse options. At the end 'scoreidx' is set to the argument position
+     * of the score of the first score-element pair. */
+    scoreidx = 2;
+    while(scoreidx < c->argc) {
+        char *opt = c->argv[scoreidx]->ptr;
+        if (!strcasecmp(opt,"nx")) flags |= ZADD_IN_NX;
+        else if (!strcasecmp(opt,"xx")) flags |= ZADD_IN_XX;
+        else if (!strcasecmp(opt,"ch")) ch = 1; /* Return num of elements added or updated. */
+        else if (!strcasecmp(opt,"incr")) flags |= ZADD_IN_INCR;
+        else if (!strcasecmp(opt,"gt")) flags |= ZADD_IN_GT;
+        else if (!strcasecmp(opt,"lt")) flags |= ZADD_IN_LT;
+        else break;
+        scoreidx++;
+    }
+
+    /* Turn options into simple to check vars. */
+    int incr = (flags & ZADD_IN_INCR) != 0;
+    int nx = (flags & ZADD_IN_NX) != 0;
+    int xx = (flags & ZADD_IN_XX) != 0;
+    int gt = (flags & ZADD_IN_GT) != 0;
+    int lt = (flags & ZADD_IN_LT) != 0;
+
+    /* After the options, we expect to have an even number of args, since
+     * we expect any number of score-element pairs. */
+    elements = c->argc-scoreidx;
+    if (elements % 2 || !elements) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+    elements /= 2; /* Now this holds the number of score-element pairs. */
+
+    /* Check for incompatible options. */
+    if (nx && xx) {
+        addReplyError(c,
+            "XX and NX options at the same time are not compatible");
+        return;
+    }
+
+    if ((gt && nx) || (lt && nx) || (gt && lt)) {
+        addReplyError(c,
+            "GT, LT, and/or NX options at the same time are not compatible");
+        return;
+    }
+    /* Note that XX is compatible with either GT or LT */
+
+    if (incr && elements > 1) {
+        addReplyError(c,
+            "INCR option supports a single increment-element pair");
+        return;
+    }
+
+    /* Start parsing all the scores, we need to emit any syntax error
+     * before executing additions to the sorted set, as the command should
+     * either execute fully or nothing at all. */
+    scores = zmalloc(sizeof(double)*elements);
+    for (j = 0; j < elements; j++) {
+        if (getDoubleFromObjectOrReply(c,c->argv[scoreidx+j*2],&scores[j],NULL)
+            != C_OK) goto cleanup;
+    }
+
+    /* Lookup the key and create the sorted set if does not exist. */
+    zobj = lookupKeyWrite(server.db,key);
+    if (zobj != NULL && checkType(c,zobj,OBJ_ZSET)) goto cleanup;
+    if (zobj == NULL) {
+        if (xx) goto reply_to_client; /* No key + XX option: nothing to do. */
+        if (server.zset_max_listpack_entries == 0 ||
+            server.zset_max_listpack_value < sdslen(c->argv[scoreidx+1]->ptr))
+        {
+            zobj = createZsetObject();
+        } else {
+            zobj = createZsetListpackObject();
+        }
+        dbAdd(server.db,key,zobj);
+    }
+
+    for (j = 0; j < elements; j++) {
+        double newscore = scores[j];
+        score = scores[j];
+        int retflags = 0;
+
+        ele = c->argv[scoreidx+1+j*2]->ptr;
+        int retval = zsetAdd(zobj, score, ele, flags, &retflags, &newscore);
+        if (retval == 0) {
+            addReplyError(c,nanerr);
+            goto cleanup;
+        }
+        if (retflags & ZADD_OUT_ADDED) added++;
+        if (retflags & ZADD_OUT_UPDATED) updated++;
+        if (!(retflags & ZADD_OUT_NOP)) processed++;
+        score = newscore;
+    }
+
+reply_to_client:
+    if (incr) { /* ZINCRBY or INCR option. */
+        if (processed)
+            addReplyDouble(c,score);
+        else
+            addReply(c,shared.nullbulk);
+    } else { /* ZADD. */
+        addReplyLongLong(c,ch ? added+updated : added);
+    }
+
+cleanup:
+    zfree(scores);
+}
+
+/* ZADD key [NX|XX] [GT|LT] [CH] [INCR] score member [score member ...] */
+void zaddCommand(client *c) {
+    zaddGenericCommand(c,ZADD_IN_NONE);
+}
+
+/* ZINCRBY key increment member */
+void zincrbyCommand(client *c) {
+    zaddGenericCommand(c,ZADD_IN_INCR);
+}
+
+/* ZREM key member [member ...] */
+void zremCommand(client *c) {
+    robj *key = c->argv[1];
+    robj *zobj;
+    int deleted = 0, j;
+
+    if ((zobj = lookupKeyReadOrReply(c,key,shared.czero)) == NULL ||
+        checkType(c,zobj,OBJ_ZSET)) return;
+
+    for (j = 2; j < c->argc; j++) {
+        if (zsetDel(zobj,c->argv[j]->ptr)) deleted++;
+        if (zsetLength(zobj) == 0) {
+            dbDelete(server.db,key);
+            break;
+        }
+    }
+    addReplyLongLong(c,deleted);
+}
+
+/* ZCARD key */
+void zcardCommand(client *c) {
+    robj *zobj;
+
+    if ((zobj = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
+        checkType(c,zobj,OBJ_ZSET)) return;
+
+    addReplyLongLong(c,zsetLength(zobj));
+}
+
+/* ZSCORE key member */
+void zscoreCommand(client *c) {
+    robj *zobj;
+    double score;
+
+    if ((zobj = lookupKeyReadOrReply(c,c->argv[1],shared.nullbulk)) == NULL ||
+        checkType(c,zobj,OBJ_ZSET)) return;
+
+    if (zsetScore(zobj,c->argv[2]->ptr,&score) == C_ERR) {
+        addReply(c,shared.nullbulk);
+    } else {
+        addReplyDouble(c,score);
+    }
+}
+
+/* ZRANK key member */
+void zrankCommand(client *c) {
+    robj *zobj;
+    long rank;
+
+    if ((zobj = lookupKeyReadOrReply(c,c->argv[1],shared.nullbulk)) == NULL ||
+        checkType(c,zobj,OBJ_ZSET)) return;
+
+    rank = zsetRank(zobj,c->argv[2]->ptr);
+    if (rank >= 0) {
+        addReplyLongLong(c,rank);
+    } else {
+        addReply(c,shared.nullbulk);
+    }
+}
+
+/* ZRANGE key start stop [WITHSCORES] */
+void zrangeCommand(client *c) {
+    robj *zobj;
+    int withscores = 0;
+    long long start, end, llen, rangelen;
+
+    if (c->argc == 5 && !strcasecmp(c->argv[4]->ptr,"withscores")) {
+        withscores = 1;
+    } else if (c->argc >= 5) {
+        addReply(c,shared.syntaxerr);
+        return;
+    }
+    if (getLongLongFromObjectOrReply(c,c->argv[2],&start,NULL) != C_OK ||
+        getLongLongFromObjectOrReply(c,c->argv[3],&end,NULL) != C_OK) return;
+
+    if ((zobj = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,zobj,OBJ_ZSET)) return;
+
+    /* Sanitize indexes. */
+    llen = zsetLength(zobj);
+    if (start < 0) start = llen+start;
+    if (end < 0) end = llen+end;
+    if (start < 0) start = 0;
+
+    /* Invariant: start >= 0, so this test will be true when end < 0.
+     * The range is empty when start > end or start >= length. */
+    if (start > end || start >= llen) {
+        addReply(c,shared.emptyarray);
+        return;
+    }
+    if (end >= llen) end = llen-1;
+    rangelen = (end-start)+1;
+
+    addReplyArrayLen(c,withscores ? rangelen*2 : rangelen);
+    if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *zl = zobj->ptr;
+
+        zsetReplyListpackRange(c,zl,lpSeek(zl,2*start),rangelen,withscores);
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        zbtLeaf *l;
+        int idx;
+
+        /* The first element is found by rank in O(log(N)). */
+        l = zbtGetElementByRank(zs->zbt,start+1,&idx);
+        zsetReplyBtreeRange(c,l,idx,rangelen,withscores);
+    } else {
+        serverPanic("Unknown sorted set encoding");
+    }
+}
+
+/* ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count] */
+void zrangebyscoreCommand(client *c) {
+    zrangespec range;
+    robj *zobj;
+    long long offset = 0, limit = -1;
+    int withscores = 0;
+    unsigned long rangelen = 0;
+    int pos = 4;
+
+    if (zslParseRange(c->argv[2],c->argv[3],&range) != C_OK) {
+        addReplyError(c,"min or max is not a float");
+        return;
+    }
+
+    /* Parse optional extra arguments. */
+    while (pos < c->argc) {
+        int remaining = c->argc-pos;
+
+        if (!strcasecmp(c->argv[pos]->ptr,"withscores")) {
+            pos++;
+            withscores = 1;
+        } else if (remaining >= 3 && !strcasecmp(c->argv[pos]->ptr,"limit")) {
+            if ((getLongLongFromObjectOrReply(c,c->argv[pos+1],&offset,NULL) != C_OK) ||
+                (getLongLongFromObjectOrReply(c,c->argv[pos+2],&limit,NULL) != C_OK))
+                return;
+            pos += 3;
+        } else {
+            addReply(c,shared.syntaxerr);
+            return;
+        }
+    }
+
+    if ((zobj = lookupKeyReadOrReply(c,c->argv[1],shared.emptyarray)) == NULL ||
+        checkType(c,zobj,OBJ_ZSET)) return;
+
+    /* A negative offset or a zero limit never match anything. */
+    if (offset < 0 || limit == 0) {
+        addReply(c,shared.emptyarray);
+        return;
+    }
+
+    if (zobj->encoding == OBJ_ENCODING_LISTPACK) {
+        unsigned char *zl = zobj->ptr;
+        unsigned char *eptr, *sptr, *first;
+
+        /* The reply length is needed first: count the matching elements,
+         * then reply with them. */
+        eptr = zzlFirstInRange(zl,&range);
+        sptr = eptr ? lpNext(zl,eptr) : NULL;
+        while (eptr && offset) {
+            zzlNext(zl,&eptr,&sptr);
+            offset--;
+        }
+        first = eptr;
+        while (eptr && (limit < 0 || rangelen < (unsigned long)limit) &&
+               zbtValueLteMax(zzlGetScore(sptr),&range))
+        {
+            rangelen++;
+            zzlNext(zl,&eptr,&sptr);
+        }
+
+        addReplyArrayLen(c,withscores ? rangelen*2 : rangelen);
+        if (rangelen) zsetReplyListpackRange(c,zl,first,rangelen,withscores);
+    } else if (zobj->encoding == OBJ_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        unsigned long firstrank, lastrank;
+        zbtLeaf *l;
+        int idx;
+
+        /* Both ends of the range come with their rank, so the length of
+         * the reply and the element at the offset are found in O(log(N))
+         * without walking the range. */
+        if (zbtFirstInRange(zs->zbt,&range,&idx,&firstrank) != NULL &&
+            zbtLastInRange(zs->zbt,&range,&idx,&lastrank) != NULL &&
+            (unsigned long long)offset <= lastrank-firstrank)
+        {
+            firstrank += offset;
+            rangelen = lastrank-firstrank+1;
+            if (limit >= 0 && (unsigned long long)limit < rangelen) rangelen = limit;
+        }
+
+        addReplyArrayLen(c,withscores ? rangelen*2 : rangelen);
+        if (rangelen) {
+            l = zbtGetElementByRank(zs->zbt,firstrank,&idx);
+            zsetReplyBtreeRange(c,l,idx,rangelen,withscores);
+        }
+    } else {
+        serverPanic("Unknown sorted set encoding");
+    }
+}
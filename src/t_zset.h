@@ -0,0 +1,24 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_T_ZSET_H
+#define RESP_SERVER_T_ZSET_H
+
+#include "server.h"
+
+/* 小zset使用listpack编码，元素数量超过zset-max-listpack-entries或
+ * 任一member长度超过zset-max-listpack-value时转换为B+树与dict */
+#define CONFIG_DEFAULT_ZSET_MAX_LISTPACK_ENTRIES 128
+#define CONFIG_DEFAULT_ZSET_MAX_LISTPACK_VALUE 64
+
+void zaddCommand(client *c);
+void zincrbyCommand(client *c);
+void zremCommand(client *c);
+void zcardCommand(client *c);
+void zscoreCommand(client *c);
+void zrankCommand(client *c);
+void zrangeCommand(client *c);
+void zrangebyscoreCommand(client *c);
+
+#endif //RESP_SERVER_T_ZSET_H
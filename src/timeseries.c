@@ -0,0 +1,546 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 时间序列的Gorilla编码。时间戳的二阶差分按大小写入1~68位：
+//   0                  '0'
+//   [-63, 64]          '10'   + 7位
+//   [-255, 256]        '110'  + 9位
+//   [-2047, 2048]      '1110' + 12位
+//   其它               '1111' + 64位
+// 值与上一个值的XOR为0时写入'0'；有效位落在上一个XOR的前导0与末尾0之间时写入'10'与这个窗口
+// 内的位；否则写入'11'、5位前导0数量、6位有效位长度减1以及有效位。固定间隔、缓慢变化的指标
+// 通常每个样本1~2字节。
+//
+// 位流以64位字保存，高位在前。解码时每次取出从读取位置开始的64位，根据前缀一次消耗整段编码，
+// 块末尾多分配一个字，读取不需要检查边界。tsDecoderNext()把一批样本解码到调用者的数组中，
+// 解码循环只使用局部变量，不分配内存。
+
+#include <string.h>
+#include "timeseries.h"
+#include "zmalloc.h"
+
+#define TS_MAX_SAMPLE_BITS (68+77)  /* 一个样本编码后的最大位数 */
+#define TS_CHUNK_INIT_WORDS 8       /* 新块位流的初始容量，写满后按倍数扩大到chunk_size */
+#define TS_NO_WINDOW 64             /* 还没有上一个XOR窗口，last_leading不会小于等于实际前导0数量 */
+
+static inline uint64_t tsDoubleBits(double value) {
+    uint64_t bits;
+
+    memcpy(&bits,&value,sizeof(bits));
+    return bits;
+}
+
+static inline double tsBitsDouble(uint64_t bits) {
+    double value;
+
+    memcpy(&value,&bits,sizeof(value));
+    return value;
+}
+
+/* 取出从pos开始的64位，高位对齐 */
+static inline uint64_t tsPeek(const uint64_t *data, uint64_t pos) {
+    size_t w = pos >> 6;
+    unsigned off = pos & 63;
+    uint64_t v = data[w] << off;
+
+    if (off) v |= data[w+1] >> (64-off);
+    return v;
+}
+
+/* 写入value的低n位，1 <= n <= 64 */
+static inline void tsWriteBits(tsChunk *c, uint64_t value, unsigned n) {
+    size_t w = c->bits >> 6;
+    unsigned free = 64 - (c->bits & 63);
+
+    if (n < 64) value &= (1ULL << n)-1;
+    if (n <= free) {
+        c->data[w] |= value << (free-n);
+    } else {
+        c->data[w] |= value >> (n-free);
+        c->data[w+1] |= value << (64-(n-free));
+    }
+    c->bits += n;
+}
+
+static size_t tsChunkAllocSize(uint32_t words) {
+    return sizeof(tsChunk) + sizeof(uint64_t)*(words+1);
+}
+
+static tsChunk *tsChunkNew(uint32_t words) {
+    tsChunk *c = zcalloc(tsChunkAllocSize(words));
+
+    c->words = words;
+    c->last_leading = TS_NO_WINDOW;
+    return c;
+}
+
+/* 把块的容量调整为words个字，扩大时新增的部分清0 */
+static tsChunk *tsChunkResize(tsChunk *c, uint32_t words) {
+    uint32_t old = c->words;
+
+    c = zrealloc(c,tsChunkAllocSize(words));
+    if (words > old) memset(c->data+old+1,0,sizeof(uint64_t)*(words-old));
+    c->words = words;
+    return c;
+}
+
+timeseries *tsNew(size_t chunk_size) {
+    timeseries *ts = zmalloc(sizeof(*ts));
+
+    ts->chunks = NULL;
+    ts->numchunks = 0;
+    ts->cap = 0;
+    ts->count = 0;
+    ts->chunk_size = chunk_size;
+    return ts;
+}
+
+void tsFree(timeseries *ts) {
+    size_t j;
+
+    for (j = 0; j < ts->numchunks; j++) zfree(ts->chunks[j]);
+    zfree(ts->chunks);
+    zfree(ts);
+}
+
+/* 追加样本，timestamp不大于最后一个样本的时间戳时返回0 */
+int tsAppend(timeseries *ts, int64_t timestamp, double value) {
+    tsChunk *c = ts->numchunks ? ts->chunks[ts->numchunks-1] : NULL;
+    uint32_t max_words = (uint32_t)(ts->chunk_size/8);
+    uint64_t bits = tsDoubleBits(value);
+
+    if (c && timestamp <= c->last_ts) return 0;
+
+    if (c && c->bits + TS_MAX_SAMPLE_BITS > (uint64_t)c->words*64) {
+        if (c->words < max_words) {
+            uint32_t words = c->words*2 < max_words ? c->words*2 : max_words;
+            c = ts->chunks[ts->numchunks-1] = tsChunkResize(c,words);
+        } else {
+            c = NULL;
+        }
+        if (c && c->bits + TS_MAX_SAMPLE_BITS > (uint64_t)c->words*64) c = NULL;
+        if (c == NULL) {
+            /* 写满的块去掉未使用的容量 */
+            tsChunk *full = ts->chunks[ts->numchunks-1];
+            ts->chunks[ts->numchunks-1] = tsChunkResize(full,(uint32_t)((full->bits+63)/64));
+        }
+    }
+
+    if (c == NULL) {
+        uint32_t words = TS_CHUNK_INIT_WORDS < max_words ? TS_CHUNK_INIT_WORDS : max_words;
+
+        if (ts->numchunks == ts->cap) {
+            ts->cap = ts->cap ? ts->cap*2 : 4;
+            ts->chunks = zrealloc(ts->chunks,sizeof(tsChunk*)*ts->cap);
+        }
+        c = tsChunkNew(words);
+        ts->chunks[ts->numchunks++] = c;
+
+        c->first_ts = c->last_ts = timestamp;
+        c->last_delta = 0;
+        c->last_value = bits;
+        c->min = c->max = c->sum = value;
+        c->count = 1;
+        tsWriteBits(c,bits,64);
+        ts->count++;
+        return 1;
+    }
+
+    int64_t delta = timestamp - c->last_ts;
+    int64_t dod = delta - c->last_delta;
+    if (dod == 0) {
+        tsWriteBits(c,0,1);
+    } else if (dod >= -63 && dod <= 64) {
+        tsWriteBits(c,(0x2ULL << 7) | (uint64_t)(dod+63),9);
+    } else if (dod >= -255 && dod <= 256) {
+        tsWriteBits(c,(0x6ULL << 9) | (uint64_t)(dod+255),12);
+    } else if (dod >= -2047 && dod <= 2048) {
+        tsWriteBits(c,(0xeULL << 12) | (uint64_t)(dod+2047),16);
+    } else {
+        tsWriteBits(c,0xf,4);
+        tsWriteBits(c,(uint64_t)dod,64);
+    }
+
+    uint64_t xor = bits ^ c->last_value;
+    if (xor == 0) {
+        tsWriteBits(c,0,1);
+    } else {
+        unsigned leading = __builtin_clzll(xor), trailing = __builtin_ctzll(xor);
+
+        if (leading > 31) leading = 31;
+        if (leading >= c->last_leading && trailing >= c->last_trailing) {
+            tsWriteBits(c,0x2,2);
+            tsWriteBits(c,xor >> c->last_trailing,64-c->last_leading-c->last_trailing);
+        } else {
+            unsigned len = 64-leading-trailing;
+
+            tsWriteBits(c,(0x3ULL << 11) | ((uint64_t)leading << 6) | (len-1),13);
+            tsWriteBits(c,xor >> trailing,len);
+            c->last_leading = leading;
+            c->last_trailing = trailing;
+        }
+    }
+
+    c->last_ts = timestamp;
+    c->last_delta = delta;
+    c->last_value = bits;
+    if (value < c->min) c->min = value;
+    if (value > c->max) c->max = value;
+    c->sum += value;
+    c->count++;
+    ts->count++;
+    return 1;
+}
+
+/* 最后一个样本，没有样本时返回0 */
+int tsLast(timeseries *ts, int64_t *timestamp, double *value) {
+    tsChunk *c;
+
+    if (ts->numchunks == 0) return 0;
+    c = ts->chunks[ts->numchunks-1];
+    *timestamp = c->last_ts;
+    *value = tsBitsDouble(c->last_value);
+    return 1;
+}
+
+/* 时间序列占用的内存 */
+size_t tsBytes(timeseries *ts) {
+    size_t bytes = sizeof(*ts) + sizeof(tsChunk*)*ts->cap, j;
+
+    for (j = 0; j < ts->numchunks; j++) bytes += tsChunkAllocSize(ts->chunks[j]->words);
+    return bytes;
+}
+
+static void tsDecoderInit(tsDecoder *d, const tsChunk *c) {
+    d->chunk = c;
+    d->left = c->count;
+    d->pos = 0;
+}
+
+/* 解码最多max个样本，返回解码的数量 */
+static size_t tsDecoderNext(tsDecoder *d, int64_t *timestamps, double *values, size_t max) {
+    const uint64_t *data = d->chunk->data;
+    uint64_t pos = d->pos, value = d->last_value;
+    int64_t t = d->last_ts, delta = d->last_delta;
+    unsigned leading = d->last_leading, trailing = d->last_trailing;
+    size_t n = 0;
+
+    if (max > d->left) max = d->left;
+    if (max && d->left == d->chunk->count) {
+        t = d->chunk->first_ts;
+        delta = 0;
+        value = data[0];
+        pos = 64;
+        leading = TS_NO_WINDOW;
+        trailing = 0;
+        timestamps[0] = t;
+        values[0] = tsBitsDouble(value);
+        n = 1;
+    }
+
+    for (; n < max; n++) {
+        uint64_t w = tsPeek(data,pos);
+        int64_t dod;
+
+        /* 前缀中1的数量，最多4个 */
+        switch (__builtin_clzll(~w | (1ULL << 59))) {
+        case 0: dod = 0; pos += 1; break;
+        case 1: dod = (int64_t)((w << 2) >> 57) - 63; pos += 9; break;
+        case 2: dod = (int64_t)((w << 3) >> 55) - 255; pos += 12; break;
+        case 3: dod = (int64_t)((w << 4) >> 52) - 2047; pos += 16; break;
+        default: dod = (int64_t)tsPeek(data,pos+4); pos += 68; break;
+        }
+        delta += dod;
+        t += delta;
+
+        w = tsPeek(data,pos);
+        if ((w >> 63) == 0) {
+            pos += 1;
+        } else {
+            unsigned len;
+
+            if ((w >> 62) == 3) {
+                leading = (unsigned)(w >> 57) & 31;
+                len = ((unsigned)(w >> 51) & 63) + 1;
+                trailing = 64-leading-len;
+                pos += 13;
+            } else {
+                len = 64-leading-trailing;
+                pos += 2;
+            }
+            value ^= (tsPeek(data,pos) >> (64-len)) << trailing;
+            pos += len;
+        }
+
+        timestamps[n] = t;
+        values[n] = tsBitsDouble(value);
+    }
+
+    d->pos = pos;
+    d->last_ts = t;
+    d->last_delta = delta;
+    d->last_value = value;
+    d->last_leading = leading;
+    d->last_trailing = trailing;
+    d->left -= n;
+    return n;
+}
+
+/* 第一个last_ts >= from的块 */
+static size_t tsFindChunk(timeseries *ts, int64_t from) {
+    size_t lo = 0, hi = ts->numchunks;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi-lo)/2;
+        if (ts->chunks[mid]->last_ts < from) lo = mid+1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void tsIteratorInit(tsIterator *it, timeseries *ts, int64_t from, int64_t to) {
+    it->ts = ts;
+    it->from = from;
+    it->to = to;
+    it->chunk = tsFindChunk(ts,from);
+    it->dec.left = 0;
+}
+
+/* 把接下来最多max个样本写入timestamps、values，返回0代表遍历结束 */
+size_t tsIteratorNext(tsIterator *it, int64_t *timestamps, double *values, size_t max) {
+    size_t n = 0;
+
+    while (n < max) {
+        size_t got, j, k;
+
+        if (it->dec.left == 0) {
+            if (it->chunk >= it->ts->numchunks) break;
+            if (it->ts->chunks[it->chunk]->first_ts > it->to) {
+                it->chunk = it->ts->numchunks;
+                break;
+            }
+            tsDecoderInit(&it->dec,it->ts->chunks[it->chunk++]);
+        }
+
+        got = tsDecoderNext(&it->dec,timestamps+n,values+n,max-n);
+        for (j = k = n; j < n+got; j++) {
+            if (timestamps[j] < it->from) continue;
+            if (timestamps[j] > it->to) {
+                it->dec.left = 0;
+                it->chunk = it->ts->numchunks;
+                break;
+            }
+            timestamps[k] = timestamps[j];
+            values[k] = values[j];
+            k++;
+        }
+        n = k;
+    }
+    return n;
+}
+
+/* 桶内的聚合状态 */
+typedef struct tsBucket {
+    int64_t start;
+    int64_t last;           /* 桶中最后一个时间戳(包含)，靠近INT64_MAX的桶截断到INT64_MAX */
+    double min, max, sum;
+    uint64_t count;
+} tsBucket;
+
+/* timestamp到所在桶起点的距离，在[0, bucket)中 */
+static inline int64_t tsBucketOffset(int64_t timestamp, int64_t bucket) {
+    int64_t r = timestamp % bucket;
+
+    return r < 0 ? r+bucket : r;
+}
+
+/* 桶的起点，起点小于INT64_MIN时截断到INT64_MIN */
+static inline int64_t tsBucketStart(int64_t timestamp, int64_t bucket) {
+    int64_t r = tsBucketOffset(timestamp,bucket);
+
+    return timestamp < INT64_MIN+r ? INT64_MIN : timestamp-r;
+}
+
+static inline int64_t tsBucketLast(int64_t timestamp, int64_t bucket) {
+    int64_t left = bucket-1-tsBucketOffset(timestamp,bucket);
+
+    return timestamp > INT64_MAX-left ? INT64_MAX : timestamp+left;
+}
+
+static double tsBucketValue(const tsBucket *b, int agg) {
+    switch (agg) {
+    case TS_AGG_MIN: return b->min;
+    case TS_AGG_MAX: return b->max;
+    case TS_AGG_SUM: return b->sum;
+    case TS_AGG_AVG: return b->sum / (double)b->count;
+    default: return (double)b->count;
+    }
+}
+
+/* 按bucket毫秒分桶聚合[from, to]中的样本，从第一个有样本的桶开始依次回调，最多回调max_buckets次
+ * (0为不限制)，返回回调次数。
+ *
+ * 完全落在[from, to]与同一个桶中的块直接合并块头中的min/max/sum/count；其余的块按批解码到
+ * 栈上的数组中，再对每个样本同时更新四个聚合值，循环中没有按聚合方式的分支 */
+uint64_t tsAggregate(timeseries *ts, int64_t from, int64_t to, int agg, int64_t bucket,
+                     uint64_t max_buckets, tsBucketCallback *cb, void *privdata) {
+    int64_t timestamps[TS_ITER_BATCH];
+    double values[TS_ITER_BATCH];
+    tsBucket b = {0,0,0,0,0,0};
+    uint64_t emitted = 0;
+    size_t i;
+
+    for (i = tsFindChunk(ts,from); i < ts->numchunks; i++) {
+        const tsChunk *c = ts->chunks[i];
+        tsDecoder d;
+        size_t n, j;
+
+        if (c->first_ts > to) break;
+
+        if (c->first_ts >= from && c->last_ts <= to &&
+            tsBucketStart(c->first_ts,bucket) == tsBucketStart(c->last_ts,bucket))
+        {
+            if (b.count && c->first_ts > b.last) {
+                cb(privdata,b.start,tsBucketValue(&b,agg));
+                if (++emitted == max_buckets) return emitted;
+                b.count = 0;
+            }
+            if (b.count == 0) {
+                b.start = tsBucketStart(c->first_ts,bucket);
+                b.last = tsBucketLast(c->first_ts,bucket);
+                b.min = c->min;
+                b.max = c->max;
+                b.sum = 0;
+            }
+            if (c->min < b.min) b.min = c->min;
+            if (c->max > b.max) b.max = c->max;
+            b.sum += c->sum;
+            b.count += c->count;
+            continue;
+        }
+
+        tsDecoderInit(&d,c);
+        while ((n = tsDecoderNext(&d,timestamps,values,TS_ITER_BATCH)) != 0) {
+            for (j = 0; j < n; j++) {
+                int64_t t = timestamps[j];
+                double v = values[j];
+
+                if (t < from) continue;
+                if (t > to) goto done;
+                if (t > b.last || b.count == 0) {
+                    if (b.count) {
+                        cb(privdata,b.start,tsBucketValue(&b,agg));
+                        if (++emitted == max_buckets) return emitted;
+                    }
+                    b.start = tsBucketStart(t,bucket);
+                    b.last = tsBucketLast(t,bucket);
+                    b.min = b.max = v;
+                    b.sum = 0;
+                    b.count = 0;
+                }
+                b.min = v < b.min ? v : b.min;
+                b.max = v > b.max ? v : b.max;
+                b.sum += v;
+                b.count++;
+            }
+        }
+    }
+
+done:
+    if (b.count) {
+        cb(privdata,b.start,tsBucketValue(&b,agg));
+        emitted++;
+    }
+    return emitted;
+}
+
+/* ------------------------------- Benchmark ---------------------------------*/
+
+#ifdef TIMESERIES_BENCHMARK_MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+static double benchmarkSeconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static void benchmarkCallback(void *privdata, int64_t bucket, double value) {
+    double *acc = privdata;
+
+    (void)bucket;
+    *acc += value;
+}
+
+/* timeseries-benchmark [samples]
+ * 写入每秒一个、缓慢变化的样本，统计每个样本的字节数、写入速度，以及解码与按分钟聚合的速度，
+ * 最后统计整数计数器每个样本的字节数 */
+int main(int argc, char **argv) {
+    size_t samples = argc >= 2 ? strtoul(argv[1],NULL,10) : 10000000, j;
+    timeseries *ts = tsNew(4096);
+    int64_t timestamps[TS_ITER_BATCH], t = 1700000000000LL;
+    double values[TS_ITER_BATCH], start, elapsed, acc = 0, v = 20.0;
+    tsIterator it;
+    size_t n, decoded = 0;
+    int rounds = 5, r;
+
+    srand(1);
+    start = benchmarkSeconds();
+    for (j = 0; j < samples; j++) {
+        /* 偶尔有几毫秒的抖动，值保留两位小数 */
+        t += 1000 + (rand() % 16 == 0 ? rand() % 5 : 0);
+        if (rand() % 4 == 0) v = round((v + (rand() % 21 - 10) / 100.0) * 100) / 100;
+        tsAppend(ts,t,v);
+    }
+    elapsed = benchmarkSeconds()-start;
+    printf("append    %8.2f M samples/s, %.3f bytes/sample, %zu chunks\n",
+        samples/elapsed/1e6, (double)tsBytes(ts)/samples, ts->numchunks);
+
+    start = benchmarkSeconds();
+    for (r = 0; r < rounds; r++) {
+        tsIteratorInit(&it,ts,0,INT64_MAX);
+        while ((n = tsIteratorNext(&it,timestamps,values,TS_ITER_BATCH)) != 0) {
+            decoded += n;
+            acc += values[n-1];
+        }
+    }
+    elapsed = benchmarkSeconds()-start;
+    printf("decode    %8.2f M samples/s (%zu)\n", decoded/elapsed/1e6, decoded/rounds);
+
+    static const char *names[] = {"", "min", "max", "sum", "avg", "count"};
+    static const int64_t buckets[] = {60000, 3600000LL*24*365};
+    for (size_t k = 0; k < sizeof(buckets)/sizeof(buckets[0]); k++) {
+        for (int agg = TS_AGG_MIN; agg <= TS_AGG_COUNT; agg++) {
+            uint64_t emitted = 0;
+
+            start = benchmarkSeconds();
+            for (r = 0; r < rounds; r++)
+                emitted += tsAggregate(ts,0,INT64_MAX,agg,buckets[k],0,benchmarkCallback,&acc);
+            elapsed = benchmarkSeconds()-start;
+            printf("agg %-5s bucket %-12lld %8.2f M samples/s (%llu buckets)\n", names[agg],
+                (long long)buckets[k], samples*rounds/elapsed/1e6, (unsigned long long)emitted/rounds);
+        }
+    }
+    printf("(%g)\n", acc);
+    tsFree(ts);
+
+    /* 整数计数器：每秒增加0~9 */
+    ts = tsNew(4096);
+    t = 1700000000000LL;
+    v = 0;
+    for (j = 0; j < samples; j++) {
+        t += 1000 + (rand() % 16 == 0 ? rand() % 5 : 0);
+        v += rand() % 10;
+        tsAppend(ts,t,v);
+    }
+    printf("counter   %.3f bytes/sample\n", (double)tsBytes(ts)/samples);
+    tsFree(ts);
+    return 0;
+}
+
+#endif
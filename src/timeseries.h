@@ -0,0 +1,81 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_TIMESERIES_H
+#define RESP_SERVER_TIMESERIES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* 时间序列：按时间戳递增追加的(毫秒时间戳, double)样本，分块保存。
+ * 块内按Gorilla编码为位流：第一个样本的时间戳在块头中、值写入64位原始值；之后时间戳写入
+ * 二阶差分(与上一个间隔的差)，值写入与上一个值的XOR，只保存XOR中去掉前后0的有效位。
+ * 块头同时记录块内样本的min/max/sum，聚合时整个块落在同一个桶中的块不需要解码 */
+typedef struct tsChunk {
+    int64_t first_ts;
+    int64_t last_ts;
+    int64_t last_delta;         /* 最后两个样本的时间戳间隔 */
+    uint64_t last_value;        /* 最后一个值的位表示 */
+    double min, max, sum;
+    uint64_t bits;              /* 已写入的位数 */
+    uint32_t count;             /* 样本数量 */
+    uint32_t words;             /* data的容量，不含末尾的填充字 */
+    uint8_t last_leading;       /* 上一个非0 XOR的前导0与末尾0的数量 */
+    uint8_t last_trailing;
+    uint64_t data[];            /* 高位在前的位流，末尾多一个填充字，读取时可以越过结尾 */
+} tsChunk;
+
+typedef struct timeseries {
+    tsChunk **chunks;           /* 按时间顺序 */
+    size_t numchunks;
+    size_t cap;
+    uint64_t count;             /* 样本数量 */
+    size_t chunk_size;          /* 每个块位流的最大字节数 */
+} timeseries;
+
+/* 聚合方式 */
+#define TS_AGG_NONE 0
+#define TS_AGG_MIN 1
+#define TS_AGG_MAX 2
+#define TS_AGG_SUM 3
+#define TS_AGG_AVG 4
+#define TS_AGG_COUNT 5
+
+#define TS_ITER_BATCH 256       /* tsIteratorNext()每次最多解码的样本数量 */
+
+/* 块的解码状态 */
+typedef struct tsDecoder {
+    const tsChunk *chunk;
+    uint32_t left;              /* 尚未解码的样本数量 */
+    uint64_t pos;               /* 位流的读取位置 */
+    int64_t last_ts;
+    int64_t last_delta;
+    uint64_t last_value;
+    uint8_t last_leading;
+    uint8_t last_trailing;
+} tsDecoder;
+
+/* 按时间顺序遍历[from, to]中的样本 */
+typedef struct tsIterator {
+    timeseries *ts;
+    int64_t from;
+    int64_t to;
+    size_t chunk;               /* 下一个块的下标 */
+    tsDecoder dec;              /* 当前块，dec.left为0时进入下一个块 */
+} tsIterator;
+
+/* tsAggregate()每个桶回调一次，bucket为桶的起始时间戳 */
+typedef void tsBucketCallback(void *privdata, int64_t bucket, double value);
+
+timeseries *tsNew(size_t chunk_size);
+void tsFree(timeseries *ts);
+int tsAppend(timeseries *ts, int64_t timestamp, double value);
+int tsLast(timeseries *ts, int64_t *timestamp, double *value);
+size_t tsBytes(timeseries *ts);
+void tsIteratorInit(tsIterator *it, timeseries *ts, int64_t from, int64_t to);
+size_t tsIteratorNext(tsIterator *it, int64_t *timestamps, double *values, size_t max);
+uint64_t tsAggregate(timeseries *ts, int64_t from, int64_t to, int agg, int64_t bucket,
+                     uint64_t max_buckets, tsBucketCallback *cb, void *privdata);
+
+#endif //RESP_SERVER_TIMESERIES_H
@@ -0,0 +1,167 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// TinyLFU准入策略。单纯的LRU淘汰下，一次对冷数据的扫描就会把热点key全部挤出内存。
+// 开启后所有key的访问频率记录在一个紧凑的count-min sketch中(每个key 4个4位计数器)，
+// 超出maxmemory需要淘汰时，最近新增的key需要与淘汰候选比较频率，只有比候选更常被访问才会
+// 被接纳，否则直接淘汰新增的key本身。计数器周期性减半，使频率反映最近的访问情况。
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "tinylfu.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/* A warm candidate that loses against the victim is still admitted with
+ * a probability of 1/TINYLFU_ADMIT_RANDOM, so that an attacker can't pin
+ * a victim in memory by raising its frequency through collisions. */
+#define TINYLFU_WARM_FREQ 6
+#define TINYLFU_ADMIT_RANDOM 128
+
+static unsigned long tinylfuTableSize(long long capacity) {
+    unsigned long size = 1;
+
+    while (size < (unsigned long)capacity) size <<= 1;
+    return size;
+}
+
+static void tinylfuFree(tinylfu *lfu) {
+    zfree(lfu->table);
+    sdsfree(lfu->candidate);
+    zfree(lfu);
+}
+
+static tinylfu *tinylfuCreate(long long capacity) {
+    tinylfu *lfu = zmalloc(sizeof(*lfu));
+    unsigned long size = tinylfuTableSize(capacity);
+
+    lfu->table = zcalloc(sizeof(uint64_t)*size);
+    lfu->mask = size-1;
+    lfu->additions = 0;
+    lfu->sample_size = (unsigned long)capacity*TINYLFU_RESET_FACTOR;
+    lfu->candidate = sdsempty();
+    lfu->has_candidate = 0;
+    return lfu;
+}
+
+/* 设置准入策略，见MAXMEMORY_ADMISSION_*。关闭时释放sketch */
+int tinylfuSetAdmission(long long policy) {
+    server.maxmemory_admission = (int)policy;
+    if (policy == MAXMEMORY_ADMISSION_TINYLFU) {
+        if (server.tinylfu == NULL)
+            server.tinylfu = tinylfuCreate(server.tinylfu_capacity);
+    } else if (server.tinylfu) {
+        tinylfuFree(server.tinylfu);
+        server.tinylfu = NULL;
+    }
+    return C_OK;
+}
+
+/* sketch占用的字节数，未开启时为0 */
+size_t tinylfuMemoryUsage(void) {
+    tinylfu *lfu = server.tinylfu;
+
+    if (lfu == NULL) return 0;
+    return sizeof(*lfu) + sizeof(uint64_t)*(lfu->mask+1);
+}
+
+/* 设置sketch按多少个key分配空间，已开启时会重建sketch并清空已有统计 */
+int tinylfuSetCapacity(long long capacity) {
+    server.tinylfu_capacity = (int)capacity;
+    if (server.tinylfu) {
+        tinylfuFree(server.tinylfu);
+        server.tinylfu = tinylfuCreate(capacity);
+    }
+    return C_OK;
+}
+
+/* Halve all the counters at once: shifting the whole word right by one
+ * moves the low bit of every counter into its neighbour, masking it out
+ * leaves every 4 bit counter divided by two. */
+static void tinylfuReset(tinylfu *lfu) {
+    unsigned long j;
+
+    for (j = 0; j <= lfu->mask; j++)
+        lfu->table[j] = (lfu->table[j] >> 1) & 0x7777777777777777ULL;
+    lfu->additions /= 2;
+}
+
+/* The 4 counters of a key are derived from a single 64 bit hash by double
+ * hashing: the low 4 bits select the counter inside the word and the rest
+ * selects the word. */
+#define tinylfuCounterPos(lfu, hash, h2, i, word, shift) do { \
+    uint64_t _h = (hash) + (uint64_t)(i)*(h2); \
+    (word) = (_h >> 4) & (lfu)->mask; \
+    (shift) = (int)(_h & 15) << 2; \
+} while(0)
+
+static int tinylfuFrequency(tinylfu *lfu, sds key) {
+    uint64_t hash = dictGenWyHashFunction(key,(int)sdslen(key));
+    uint64_t h2 = (hash >> 32) | 1;
+    unsigned long word;
+    int i, shift, freq = TINYLFU_COUNTER_MAX;
+
+    for (i = 0; i < TINYLFU_DEPTH; i++) {
+        int count;
+
+        tinylfuCounterPos(lfu,hash,h2,i,word,shift);
+        count = (int)((lfu->table[word] >> shift) & 0xf);
+        if (count < freq) freq = count;
+    }
+    return freq;
+}
+
+/* 记录一次key访问，由键空间的查找及写入路径调用 */
+void tinylfuRecordAccess(sds key) {
+    tinylfu *lfu = server.tinylfu;
+    uint64_t hash, h2;
+    unsigned long word;
+    int i, shift, added = 0;
+
+    if (lfu == NULL) return;
+    hash = dictGenWyHashFunction(key,(int)sdslen(key));
+    h2 = (hash >> 32) | 1;
+    for (i = 0; i < TINYLFU_DEPTH; i++) {
+        tinylfuCounterPos(lfu,hash,h2,i,word,shift);
+        if (((lfu->table[word] >> shift) & 0xf) < TINYLFU_COUNTER_MAX) {
+            lfu->table[word] += 1ULL << shift;
+            added = 1;
+        }
+    }
+    if (added && ++lfu->additions >= lfu->sample_size) tinylfuReset(lfu);
+}
+
+/* 记录新增的key，下一次需要淘汰时它要先通过准入比较。只保留最近一个 */
+void tinylfuSetCandidate(sds key) {
+    tinylfu *lfu = server.tinylfu;
+
+    if (lfu == NULL) return;
+    lfu->candidate = sdscpylen(lfu->candidate,key,sdslen(key));
+    lfu->has_candidate = 1;
+}
+
+void tinylfuClearCandidate(void) {
+    if (server.tinylfu) server.tinylfu->has_candidate = 0;
+}
+
+/* 返回等待准入的key，没有时返回NULL */
+sds tinylfuGetCandidate(void) {
+    tinylfu *lfu = server.tinylfu;
+
+    if (lfu == NULL || !lfu->has_candidate) return NULL;
+    return lfu->candidate;
+}
+
+/* Return 1 if the candidate should stay in memory in place of the victim,
+ * 0 if the candidate is the one to evict. */
+int tinylfuAdmit(sds candidate, sds victim) {
+    tinylfu *lfu = server.tinylfu;
+    int cfreq, vfreq;
+
+    serverAssert(lfu != NULL);
+    cfreq = tinylfuFrequency(lfu,candidate);
+    vfreq = tinylfuFrequency(lfu,victim);
+    if (cfreq > vfreq) return 1;
+    if (cfreq < TINYLFU_WARM_FREQ) return 0;
+    return (random() % TINYLFU_ADMIT_RANDOM) == 0;
+}
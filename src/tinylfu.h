@@ -0,0 +1,44 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_TINYLFU_H
+#define RESP_SERVER_TINYLFU_H
+
+#include "server.h"
+
+/* Admission policies applied on top of maxmemory-policy. */
+#define MAXMEMORY_ADMISSION_NONE 0
+#define MAXMEMORY_ADMISSION_TINYLFU 1
+
+#define CONFIG_DEFAULT_MAXMEMORY_ADMISSION MAXMEMORY_ADMISSION_NONE
+#define CONFIG_DEFAULT_TINYLFU_CAPACITY (1<<18)   /* 预计的key数量 */
+#define TINYLFU_MAX_CAPACITY (1<<26)
+
+/* Every key maps to 4 counters of 4 bits, 16 counters are packed in a
+ * 64 bit word and the table has one word per expected key (8 bytes per
+ * key). Counters saturate at 15 and are all halved after
+ * TINYLFU_RESET_FACTOR*capacity increments, so that the sketch ages. */
+#define TINYLFU_DEPTH 4
+#define TINYLFU_COUNTER_MAX 15
+#define TINYLFU_RESET_FACTOR 10
+
+typedef struct tinylfu {
+    uint64_t *table;            /* 4位计数器表 */
+    unsigned long mask;         /* 表长度-1，表长度为2的幂 */
+    unsigned long additions;    /* 上次减半以来计数器增加的次数 */
+    unsigned long sample_size;  /* additions达到该值时所有计数器减半 */
+    sds candidate;              /* 最近一次新增的key，等待与淘汰候选比较 */
+    int has_candidate;
+} tinylfu;
+
+int tinylfuSetAdmission(long long policy);
+int tinylfuSetCapacity(long long capacity);
+void tinylfuRecordAccess(sds key);
+void tinylfuSetCandidate(sds key);
+void tinylfuClearCandidate(void);
+sds tinylfuGetCandidate(void);
+int tinylfuAdmit(sds candidate, sds victim);
+size_t tinylfuMemoryUsage(void);
+
+#endif //RESP_SERVER_TINYLFU_H
@@ -763,6 +763,31 @@ unsigned long getTimeZone(void) {
 #endif
 }
 
+/* Get random bytes from /dev/urandom. When the device is not available
+ * fall back to a weak xorshift generator seeded with the time and the PID,
+ * good enough for seeding hash functions. */
+void getRandomBytes(unsigned char *p, size_t len) {
+    FILE *fp = fopen("/dev/urandom","r");
+
+    if (fp != NULL) {
+        size_t nread = fread(p,1,len,fp);
+        fclose(fp);
+        if (nread == len) return;
+    }
+
+    struct timeval tv;
+    uint64_t x;
+
+    gettimeofday(&tv,NULL);
+    x = ((uint64_t)tv.tv_sec << 32) ^ (uint64_t)tv.tv_usec ^ ((uint64_t)getpid() << 16);
+    while (len--) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        *p++ = (unsigned char)x;
+    }
+}
+
 /* Return true if the specified path is just a file basename without any
  * relative or absolute path. This function just checks that no / or \
  * character exists inside the specified path, that's enough in the
@@ -0,0 +1,1022 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// 向量索引：float32/int8定长向量的精确(扫描)搜索与HNSW近似搜索。
+//
+// 距离内核与bitops.c一样在x86上用target属性单独编译AVX2+FMA与AVX-512(F+BW)版本，
+// 第一次使用时按CPU支持的指令集选择，其余平台使用标量版本。int8向量按int16展开后用
+// madd以int32累加，结果是精确的整数。
+//
+// HNSW的实现参照论文(Malkov & Yashunin)：插入时从入口逐层贪心下降，在新向量所在的每一层
+// 以ef_construction为宽度搜索候选，按启发式规则选出M个邻居并建立双向连接，邻居表满时按同样
+// 的规则裁剪。删除时用被删除向量的邻居修复指向它的邻居表；没有被修复的单向边会指向空闲或
+// 被复用的slot，搜索时跳过空闲slot与层数不够的slot，复用的slot只是多了一条普通的边。
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "vecindex.h"
+#include "zmalloc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECINDEX_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+#define VEC_INIT_SLOTS 16
+
+typedef float (vecFloatFunction)(const float *a, const float *b, size_t dim);
+typedef int32_t (vecInt8Function)(const int8_t *a, const int8_t *b, size_t dim);
+
+/* 一组距离内核：内积与欧氏距离的平方 */
+typedef struct vecKernels {
+    const char *name;
+    vecFloatFunction *dot;
+    vecFloatFunction *l2;
+    vecInt8Function *dot8;
+    vecInt8Function *l28;
+} vecKernels;
+
+/*-----------------------------------------------------------------------------
+ * Scalar kernels
+ *----------------------------------------------------------------------------*/
+
+/* 四个累加器，没有-ffast-math时编译器不会重排浮点加法，分开累加可以让乘加并行 */
+static float vecDotScalar(const float *a, const float *b, size_t dim) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+
+    for (; i+4 <= dim; i += 4) {
+        s0 += a[i]*b[i];
+        s1 += a[i+1]*b[i+1];
+        s2 += a[i+2]*b[i+2];
+        s3 += a[i+3]*b[i+3];
+    }
+    for (; i < dim; i++) s0 += a[i]*b[i];
+    return (s0+s1)+(s2+s3);
+}
+
+static float vecL2Scalar(const float *a, const float *b, size_t dim) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0, d0, d1, d2, d3;
+    size_t i = 0;
+
+    for (; i+4 <= dim; i += 4) {
+        d0 = a[i]-b[i];
+        d1 = a[i+1]-b[i+1];
+        d2 = a[i+2]-b[i+2];
+        d3 = a[i+3]-b[i+3];
+        s0 += d0*d0;
+        s1 += d1*d1;
+        s2 += d2*d2;
+        s3 += d3*d3;
+    }
+    for (; i < dim; i++) {
+        d0 = a[i]-b[i];
+        s0 += d0*d0;
+    }
+    return (s0+s1)+(s2+s3);
+}
+
+static int32_t vecDot8Scalar(const int8_t *a, const int8_t *b, size_t dim) {
+    int32_t s = 0;
+    size_t i;
+
+    for (i = 0; i < dim; i++) s += (int32_t)a[i]*b[i];
+    return s;
+}
+
+static int32_t vecL28Scalar(const int8_t *a, const int8_t *b, size_t dim) {
+    int32_t s = 0, d;
+    size_t i;
+
+    for (i = 0; i < dim; i++) {
+        d = (int32_t)a[i]-b[i];
+        s += d*d;
+    }
+    return s;
+}
+
+#ifdef VECINDEX_X86_DISPATCH
+
+/*-----------------------------------------------------------------------------
+ * AVX2 kernels
+ *----------------------------------------------------------------------------*/
+
+__attribute__((target("avx2,fma")))
+static inline float vecHsumAVX2(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1));
+
+    s = _mm_add_ps(s,_mm_movehl_ps(s,s));
+    s = _mm_add_ss(s,_mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2,fma")))
+static inline int32_t vecHsum32AVX2(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),_mm256_extracti128_si256(v,1));
+
+    s = _mm_add_epi32(s,_mm_shuffle_epi32(s,_MM_SHUFFLE(1,0,3,2)));
+    s = _mm_add_epi32(s,_mm_shuffle_epi32(s,_MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2,fma")))
+static float vecDotAVX2(const float *a, const float *b, size_t dim) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i+32 <= dim; i += 32) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i),s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+8),_mm256_loadu_ps(b+i+8),s1);
+        s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+16),_mm256_loadu_ps(b+i+16),s2);
+        s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+24),_mm256_loadu_ps(b+i+24),s3);
+    }
+    for (; i+8 <= dim; i += 8)
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i),s0);
+    float s = vecHsumAVX2(_mm256_add_ps(_mm256_add_ps(s0,s1),_mm256_add_ps(s2,s3)));
+    for (; i < dim; i++) s += a[i]*b[i];
+    return s;
+}
+
+__attribute__((target("avx2,fma")))
+static float vecL2AVX2(const float *a, const float *b, size_t dim) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps(), d;
+    size_t i = 0;
+
+    for (; i+32 <= dim; i += 32) {
+        d = _mm256_sub_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i));
+        s0 = _mm256_fmadd_ps(d,d,s0);
+        d = _mm256_sub_ps(_mm256_loadu_ps(a+i+8),_mm256_loadu_ps(b+i+8));
+        s1 = _mm256_fmadd_ps(d,d,s1);
+        d = _mm256_sub_ps(_mm256_loadu_ps(a+i+16),_mm256_loadu_ps(b+i+16));
+        s2 = _mm256_fmadd_ps(d,d,s2);
+        d = _mm256_sub_ps(_mm256_loadu_ps(a+i+24),_mm256_loadu_ps(b+i+24));
+        s3 = _mm256_fmadd_ps(d,d,s3);
+    }
+    for (; i+8 <= dim; i += 8) {
+        d = _mm256_sub_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i));
+        s0 = _mm256_fmadd_ps(d,d,s0);
+    }
+    float s = vecHsumAVX2(_mm256_add_ps(_mm256_add_ps(s0,s1),_mm256_add_ps(s2,s3)));
+    for (; i < dim; i++) s += (a[i]-b[i])*(a[i]-b[i]);
+    return s;
+}
+
+/* 每次16个int8扩展为int16，madd得到相邻两个乘积之和的int32 */
+__attribute__((target("avx2,fma")))
+static int32_t vecDot8AVX2(const int8_t *a, const int8_t *b, size_t dim) {
+    __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256(), va, vb;
+    size_t i = 0;
+
+    for (; i+32 <= dim; i += 32) {
+        va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a+i)));
+        vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b+i)));
+        s0 = _mm256_add_epi32(s0,_mm256_madd_epi16(va,vb));
+        va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a+i+16)));
+        vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b+i+16)));
+        s1 = _mm256_add_epi32(s1,_mm256_madd_epi16(va,vb));
+    }
+    for (; i+16 <= dim; i += 16) {
+        va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a+i)));
+        vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b+i)));
+        s0 = _mm256_add_epi32(s0,_mm256_madd_epi16(va,vb));
+    }
+    int32_t s = vecHsum32AVX2(_mm256_add_epi32(s0,s1));
+    for (; i < dim; i++) s += (int32_t)a[i]*b[i];
+    return s;
+}
+
+__attribute__((target("avx2,fma")))
+static int32_t vecL28AVX2(const int8_t *a, const int8_t *b, size_t dim) {
+    __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256(), d;
+    size_t i = 0;
+
+    for (; i+32 <= dim; i += 32) {
+        d = _mm256_sub_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a+i))),
+                             _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b+i))));
+        s0 = _mm256_add_epi32(s0,_mm256_madd_epi16(d,d));
+        d = _mm256_sub_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a+i+16))),
+                             _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b+i+16))));
+        s1 = _mm256_add_epi32(s1,_mm256_madd_epi16(d,d));
+    }
+    for (; i+16 <= dim; i += 16) {
+        d = _mm256_sub_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a+i))),
+                             _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b+i))));
+        s0 = _mm256_add_epi32(s0,_mm256_madd_epi16(d,d));
+    }
+    int32_t s = vecHsum32AVX2(_mm256_add_epi32(s0,s1));
+    for (; i < dim; i++) s += ((int32_t)a[i]-b[i])*((int32_t)a[i]-b[i]);
+    return s;
+}
+
+/*-----------------------------------------------------------------------------
+ * AVX-512 kernels
+ *----------------------------------------------------------------------------*/
+
+/* 末尾不足16个的分量用掩码加载，不需要标量循环 */
+__attribute__((target("avx512f,avx512bw")))
+static float vecDotAVX512(const float *a, const float *b, size_t dim) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+
+    for (; i+32 <= dim; i += 32) {
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i),_mm512_loadu_ps(b+i),s0);
+        s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i+16),_mm512_loadu_ps(b+i+16),s1);
+    }
+    for (; i < dim; i += 16) {
+        __mmask16 m = dim-i >= 16 ? 0xffff : (__mmask16)((1u << (dim-i))-1);
+        s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m,a+i),_mm512_maskz_loadu_ps(m,b+i),s0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0,s1));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static float vecL2AVX512(const float *a, const float *b, size_t dim) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps(), d;
+    size_t i = 0;
+
+    for (; i+32 <= dim; i += 32) {
+        d = _mm512_sub_ps(_mm512_loadu_ps(a+i),_mm512_loadu_ps(b+i));
+        s0 = _mm512_fmadd_ps(d,d,s0);
+        d = _mm512_sub_ps(_mm512_loadu_ps(a+i+16),_mm512_loadu_ps(b+i+16));
+        s1 = _mm512_fmadd_ps(d,d,s1);
+    }
+    for (; i < dim; i += 16) {
+        __mmask16 m = dim-i >= 16 ? 0xffff : (__mmask16)((1u << (dim-i))-1);
+        d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m,a+i),_mm512_maskz_loadu_ps(m,b+i));
+        s0 = _mm512_fmadd_ps(d,d,s0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0,s1));
+}
+
+/* 每次掩码加载64个int8，前后两半分别扩展为int16后madd */
+__attribute__((target("avx512f,avx512bw")))
+static int32_t vecDot8AVX512(const int8_t *a, const int8_t *b, size_t dim) {
+    __m512i s0 = _mm512_setzero_si512(), s1 = _mm512_setzero_si512(), va, vb;
+    size_t i = 0;
+
+    for (; i < dim; i += 64) {
+        __mmask64 m = dim-i >= 64 ? ~0ULL : (1ULL << (dim-i))-1;
+
+        va = _mm512_maskz_loadu_epi8(m,a+i);
+        vb = _mm512_maskz_loadu_epi8(m,b+i);
+        s0 = _mm512_add_epi32(s0,_mm512_madd_epi16(
+                _mm512_cvtepi8_epi16(_mm512_castsi512_si256(va)),
+                _mm512_cvtepi8_epi16(_mm512_castsi512_si256(vb))));
+        s1 = _mm512_add_epi32(s1,_mm512_madd_epi16(
+                _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(va,1)),
+                _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(vb,1))));
+    }
+    return _mm512_reduce_add_epi32(_mm512_add_epi32(s0,s1));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static int32_t vecL28AVX512(const int8_t *a, const int8_t *b, size_t dim) {
+    __m512i s0 = _mm512_setzero_si512(), s1 = _mm512_setzero_si512(), va, vb, d;
+    size_t i = 0;
+
+    for (; i < dim; i += 64) {
+        __mmask64 m = dim-i >= 64 ? ~0ULL : (1ULL << (dim-i))-1;
+
+        va = _mm512_maskz_loadu_epi8(m,a+i);
+        vb = _mm512_maskz_loadu_epi8(m,b+i);
+        d = _mm512_sub_epi16(_mm512_cvtepi8_epi16(_mm512_castsi512_si256(va)),
+                             _mm512_cvtepi8_epi16(_mm512_castsi512_si256(vb)));
+        s0 = _mm512_add_epi32(s0,_mm512_madd_epi16(d,d));
+        d = _mm512_sub_epi16(_mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(va,1)),
+                             _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(vb,1)));
+        s1 = _mm512_add_epi32(s1,_mm512_madd_epi16(d,d));
+    }
+    return _mm512_reduce_add_epi32(_mm512_add_epi32(s0,s1));
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------
+ * Kernel dispatch
+ *----------------------------------------------------------------------------*/
+
+static const vecKernels vecKernelsScalar = {
+    "scalar", vecDotScalar, vecL2Scalar, vecDot8Scalar, vecL28Scalar
+};
+#ifdef VECINDEX_X86_DISPATCH
+static const vecKernels vecKernelsAVX2 = {
+    "avx2", vecDotAVX2, vecL2AVX2, vecDot8AVX2, vecL28AVX2
+};
+static const vecKernels vecKernelsAVX512 = {
+    "avx512", vecDotAVX512, vecL2AVX512, vecDot8AVX512, vecL28AVX512
+};
+#endif
+
+static const vecKernels *kernels = NULL;
+
+static void vecSelectKernels(void) {
+    kernels = &vecKernelsScalar;
+#ifdef VECINDEX_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        kernels = &vecKernelsAVX512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        kernels = &vecKernelsAVX2;
+    }
+#endif
+}
+
+/* 当前使用的内核："avx512"、"avx2"或"scalar" */
+const char *vecKernelName(void) {
+    if (kernels == NULL) vecSelectKernels();
+    return kernels->name;
+}
+
+/*-----------------------------------------------------------------------------
+ * Distance
+ *----------------------------------------------------------------------------*/
+
+static inline const unsigned char *vecAt(vecIndex *vi, uint32_t slot) {
+    return vi->vectors+(size_t)slot*vi->stride;
+}
+
+/* 查询向量q(已编码)到slot的距离，qnorm只在int8余弦度量时使用 */
+static inline float vecDistance(vecIndex *vi, const void *q, float qnorm, uint32_t slot) {
+    const void *v = vecAt(vi,slot);
+    float dot;
+
+    if (vi->type == VEC_FLOAT32) {
+        if (vi->metric == VEC_METRIC_L2) return kernels->l2(q,v,vi->dim);
+        dot = kernels->dot(q,v,vi->dim);
+        /* float32向量在插入与查询时已归一化，内积就是余弦相似度 */
+        return vi->metric == VEC_METRIC_IP ? -dot : 1-dot;
+    }
+    if (vi->metric == VEC_METRIC_L2) return (float)kernels->l28(q,v,vi->dim);
+    dot = (float)kernels->dot8(q,v,vi->dim);
+    if (vi->metric == VEC_METRIC_IP) return -dot;
+    return 1-dot/(qnorm*vi->norms[slot]);
+}
+
+static float vecQueryNorm(vecIndex *vi, const void *q) {
+    if (vi->type != VEC_INT8 || vi->metric != VEC_METRIC_COSINE) return 0;
+    return sqrtf((float)kernels->dot8(q,q,vi->dim));
+}
+
+/* 两个已保存的向量之间的距离 */
+static inline float vecDistanceSlots(vecIndex *vi, uint32_t a, uint32_t b) {
+    return vecDistance(vi,vecAt(vi,a),vi->norms ? vi->norms[a] : 0,b);
+}
+
+/*-----------------------------------------------------------------------------
+ * Heap
+ *----------------------------------------------------------------------------*/
+
+/* 按distance的最大堆，候选集合以相反数入堆当作最小堆使用 */
+static void vecHeapSiftUp(vecResult *h, size_t i) {
+    vecResult r = h[i];
+
+    while (i > 0) {
+        size_t parent = (i-1)/2;
+
+        if (h[parent].distance >= r.distance) break;
+        h[i] = h[parent];
+        i = parent;
+    }
+    h[i] = r;
+}
+
+static void vecHeapSiftDown(vecResult *h, size_t n, size_t i) {
+    vecResult r = h[i];
+
+    while (1) {
+        size_t child = i*2+1;
+
+        if (child >= n) break;
+        if (child+1 < n && h[child+1].distance > h[child].distance) child++;
+        if (h[child].distance <= r.distance) break;
+        h[i] = h[child];
+        i = child;
+    }
+    h[i] = r;
+}
+
+static void vecHeapPop(vecResult *h, size_t *n) {
+    h[0] = h[--*n];
+    if (*n) vecHeapSiftDown(h,*n,0);
+}
+
+static void vecHeapPush(vecResult **h, size_t *cap, size_t *n, float distance, uint32_t slot) {
+    if (*n == *cap) {
+        *cap = *cap ? *cap*2 : 64;
+        *h = zrealloc(*h,sizeof(vecResult)*(*cap));
+    }
+    (*h)[*n].distance = distance;
+    (*h)[*n].slot = slot;
+    vecHeapSiftUp(*h,(*n)++);
+}
+
+static int vecResultCompare(const void *a, const void *b) {
+    const vecResult *ra = a, *rb = b;
+
+    if (ra->distance != rb->distance) return ra->distance < rb->distance ? -1 : 1;
+    return ra->slot < rb->slot ? -1 : ra->slot > rb->slot;
+}
+
+/*-----------------------------------------------------------------------------
+ * Graph
+ *----------------------------------------------------------------------------*/
+
+/* slot第level层的邻居表[count, id...] */
+static inline uint32_t *vecLinks(vecIndex *vi, uint32_t slot, int level) {
+    return vi->links[slot]+(level ? (1+vi->M0)+(size_t)(level-1)*(1+vi->M) : 0);
+}
+
+static inline uint32_t vecMaxLinks(vecIndex *vi, int level) {
+    return level ? vi->M : vi->M0;
+}
+
+/* 邻居表中的slot可能已被删除或被层数更低的向量复用 */
+static inline int vecValidAt(vecIndex *vi, uint32_t slot, int level) {
+    return vi->links[slot] != NULL && vi->levels[slot] >= level;
+}
+
+static uint32_t vecNewEpoch(vecIndex *vi) {
+    if (++vi->visited_epoch == 0) {
+        memset(vi->visited,0,sizeof(uint32_t)*vi->capslots);
+        vi->visited_epoch = 1;
+    }
+    return vi->visited_epoch;
+}
+
+static int vecRandomLevel(vecIndex *vi) {
+    double u;
+    int level;
+
+    /* xorshift64* */
+    vi->rng ^= vi->rng >> 12;
+    vi->rng ^= vi->rng << 25;
+    vi->rng ^= vi->rng >> 27;
+    u = ((vi->rng*0x2545F4914F6CDD1DULL) >> 11)*(1.0/9007199254740992.0);
+    if (u <= 0) u = 1.0/9007199254740992.0;
+    level = (int)(-log(u)*vi->level_mult);
+    return level < VEC_MAX_LEVEL ? level : VEC_MAX_LEVEL-1;
+}
+
+/* 从cur开始在level层贪心地移动到更近的邻居，直到没有更近的邻居 */
+static uint32_t vecGreedy(vecIndex *vi, const void *q, float qnorm, uint32_t cur,
+                          float *curdist, int level)
+{
+    int changed = 1;
+
+    while (changed) {
+        uint32_t *ll = vecLinks(vi,cur,level), j;
+
+        changed = 0;
+        for (j = 1; j <= ll[0]; j++) {
+            uint32_t n = ll[j];
+            float d;
+
+            if (!vecValidAt(vi,n,level)) continue;
+            d = vecDistance(vi,q,qnorm,n);
+            if (d < *curdist) {
+                *curdist = d;
+                cur = n;
+                changed = 1;
+            }
+        }
+    }
+    return cur;
+}
+
+/* 从ep中的入口开始在level层搜索离q最近的ef个向量，结果保存在vi->results中(最大堆)，返回数量 */
+static size_t vecSearchLayer(vecIndex *vi, const void *q, float qnorm, const vecResult *ep,
+                             size_t numep, int level, size_t ef)
+{
+    uint32_t epoch = vecNewEpoch(vi), j, numnext, *next = vi->next;
+    size_t ncand = 0, nres = 0, i;
+
+    for (i = 0; i < numep; i++) {
+        if (vi->visited[ep[i].slot] == epoch) continue;
+        vi->visited[ep[i].slot] = epoch;
+        vecHeapPush(&vi->candidates,&vi->candcap,&ncand,-ep[i].distance,ep[i].slot);
+        vecHeapPush(&vi->results,&vi->rescap,&nres,ep[i].distance,ep[i].slot);
+        if (nres > ef) vecHeapPop(vi->results,&nres);
+    }
+
+    while (ncand) {
+        float cdist = -vi->candidates[0].distance;
+        uint32_t c = vi->candidates[0].slot, *ll;
+
+        if (nres >= ef && cdist > vi->results[0].distance) break;
+        vecHeapPop(vi->candidates,&ncand);
+
+        /* 先找出未访问的邻居并预取整个向量，计算距离时不必逐个等待内存 */
+        ll = vecLinks(vi,c,level);
+        numnext = 0;
+        for (j = 1; j <= ll[0]; j++) {
+            uint32_t n = ll[j];
+
+            if (vi->visited[n] == epoch) continue;
+            vi->visited[n] = epoch;
+            if (!vecValidAt(vi,n,level)) continue;
+            next[numnext++] = n;
+            for (i = 0; i < vi->stride; i += 64) __builtin_prefetch(vecAt(vi,n)+i);
+        }
+        for (j = 0; j < numnext; j++) {
+            uint32_t n = next[j];
+            float d;
+
+            d = vecDistance(vi,q,qnorm,n);
+            if (nres < ef || d < vi->results[0].distance) {
+                vecHeapPush(&vi->candidates,&vi->candcap,&ncand,-d,n);
+                vecHeapPush(&vi->results,&vi->rescap,&nres,d,n);
+                if (nres > ef) vecHeapPop(vi->results,&nres);
+            }
+        }
+    }
+    return nres;
+}
+
+/* 启发式选择邻居：cand按距离升序，依次选择离base比离所有已选邻居都近的候选，
+ * 保留不同方向上的邻居，out可以与cand指向的向量有重叠 */
+static uint32_t vecSelectNeighbors(vecIndex *vi, const vecResult *cand, size_t n,
+                                   uint32_t max, uint32_t *out)
+{
+    uint32_t m = 0, j;
+    size_t i;
+
+    for (i = 0; i < n && m < max; i++) {
+        int good = 1;
+
+        for (j = 0; j < m; j++) {
+            if (vecDistanceSlots(vi,cand[i].slot,out[j]) < cand[i].distance) {
+                good = 0;
+                break;
+            }
+        }
+        if (good) out[m++] = cand[i].slot;
+    }
+    return m;
+}
+
+/* 重新选择slot在level层的邻居，候选为vi->scratch[0..n) */
+static void vecShrinkLinks(vecIndex *vi, uint32_t slot, int level, size_t n) {
+    uint32_t *ll = vecLinks(vi,slot,level);
+
+    qsort(vi->scratch,n,sizeof(vecResult),vecResultCompare);
+    ll[0] = vecSelectNeighbors(vi,vi->scratch,n,vecMaxLinks(vi,level),ll+1);
+}
+
+/* 在n的level层邻居表中加入slot，表满时按启发式规则裁剪 */
+static void vecConnect(vecIndex *vi, uint32_t n, uint32_t slot, int level, float distance) {
+    uint32_t *ll = vecLinks(vi,n,level), j;
+    size_t k = 0;
+
+    if (ll[0] < vecMaxLinks(vi,level)) {
+        ll[++ll[0]] = slot;
+        return;
+    }
+    for (j = 1; j <= ll[0]; j++) {
+        if (!vecValidAt(vi,ll[j],level)) continue;
+        vi->scratch[k].slot = ll[j];
+        vi->scratch[k++].distance = vecDistanceSlots(vi,n,ll[j]);
+    }
+    vi->scratch[k].slot = slot;
+    vi->scratch[k++].distance = distance;
+    vecShrinkLinks(vi,n,level,k);
+}
+
+/*-----------------------------------------------------------------------------
+ * Index API
+ *----------------------------------------------------------------------------*/
+
+vecIndex *vecNew(uint32_t dim, int type, int metric, uint32_t M, uint32_t ef_construction) {
+    vecIndex *vi = zcalloc(sizeof(*vi));
+
+    if (kernels == NULL) vecSelectKernels();
+    vi->dim = dim;
+    vi->type = type;
+    vi->metric = metric;
+    vi->stride = type == VEC_FLOAT32 ? sizeof(float)*dim : dim;
+    vi->M = M;
+    vi->M0 = M*2;
+    vi->ef_construction = ef_construction;
+    vi->level_mult = 1/log((double)(M > 1 ? M : 2));
+    vi->max_level = -1;
+    vi->entry = VEC_NONE;
+    vi->rng = 0x9E3779B97F4A7C15ULL;
+    vi->scratch = zmalloc(sizeof(vecResult)*(vi->M0*2+1));
+    vi->next = zmalloc(sizeof(uint32_t)*vi->M0);
+    return vi;
+}
+
+void vecFree(vecIndex *vi) {
+    uint32_t j;
+
+    for (j = 0; j < vi->numslots; j++) zfree(vi->links[j]);
+    zfree(vi->vectors);
+    zfree(vi->norms);
+    zfree(vi->levels);
+    zfree(vi->links);
+    zfree(vi->freelist);
+    zfree(vi->visited);
+    zfree(vi->candidates);
+    zfree(vi->results);
+    zfree(vi->scratch);
+    zfree(vi->next);
+    zfree(vi);
+}
+
+/* 把客户端给出的分量转换为索引中保存的格式，int8的分量由调用者保证为[-128, 127]中的整数。
+ * 余弦度量下零向量没有方向，返回0，否则返回1 */
+int vecEncode(vecIndex *vi, const float *in, void *out) {
+    uint32_t j;
+
+    if (vi->type == VEC_INT8) {
+        int8_t *v = out;
+        int nonzero = 0;
+
+        for (j = 0; j < vi->dim; j++) {
+            v[j] = (int8_t)in[j];
+            nonzero |= v[j];
+        }
+        return vi->metric != VEC_METRIC_COSINE || nonzero;
+    }
+
+    float *v = out;
+    memcpy(v,in,sizeof(float)*vi->dim);
+    if (vi->metric == VEC_METRIC_COSINE) {
+        double norm = 0;
+
+        for (j = 0; j < vi->dim; j++) norm += (double)v[j]*v[j];
+        if (norm == 0) return 0;
+        norm = 1/sqrt(norm);
+        for (j = 0; j < vi->dim; j++) v[j] = (float)(v[j]*norm);
+    }
+    return 1;
+}
+
+static uint32_t vecAllocSlot(vecIndex *vi) {
+    if (vi->numfree) return vi->freelist[--vi->numfree];
+    if (vi->numslots == vi->capslots) {
+        uint32_t cap = vi->capslots ? vi->capslots*2 : VEC_INIT_SLOTS;
+
+        vi->vectors = zrealloc(vi->vectors,vi->stride*cap);
+        if (vi->type == VEC_INT8 && vi->metric == VEC_METRIC_COSINE)
+            vi->norms = zrealloc(vi->norms,sizeof(float)*cap);
+        vi->levels = zrealloc(vi->levels,cap);
+        vi->links = zrealloc(vi->links,sizeof(uint32_t *)*cap);
+        vi->freelist = zrealloc(vi->freelist,sizeof(uint32_t)*cap);
+        vi->visited = zrealloc(vi->visited,sizeof(uint32_t)*cap);
+        memset(vi->visited+vi->capslots,0,sizeof(uint32_t)*(cap-vi->capslots));
+        vi->capslots = cap;
+    }
+    return vi->numslots++;
+}
+
+/* 插入已编码的向量，返回分配的slot */
+uint32_t vecInsert(vecIndex *vi, const void *vec) {
+    uint32_t slot = vecAllocSlot(vi), cur, j;
+    int level = vecRandomLevel(vi), l;
+    const void *q;
+    float qnorm, curdist;
+    vecResult *w;
+    size_t nw;
+
+    memcpy(vi->vectors+(size_t)slot*vi->stride,vec,vi->stride);
+    q = vecAt(vi,slot);
+    qnorm = vecQueryNorm(vi,q);
+    if (vi->norms) vi->norms[slot] = qnorm;
+    vi->levels[slot] = (uint8_t)level;
+    vi->links[slot] = zcalloc(sizeof(uint32_t)*((1+vi->M0)+(size_t)level*(1+vi->M)));
+    vi->count++;
+
+    if (vi->entry == VEC_NONE) {
+        vi->entry = slot;
+        vi->max_level = level;
+        return slot;
+    }
+
+    /* 在新向量的层数以上只做贪心下降 */
+    cur = vi->entry;
+    curdist = vecDistance(vi,q,qnorm,cur);
+    for (l = vi->max_level; l > level; l--) cur = vecGreedy(vi,q,qnorm,cur,&curdist,l);
+
+    /* 每一层的搜索结果作为下一层的入口 */
+    w = zmalloc(sizeof(vecResult)*(vi->ef_construction+1));
+    w[0].distance = curdist;
+    w[0].slot = cur;
+    nw = 1;
+    for (l = level < vi->max_level ? level : vi->max_level; l >= 0; l--) {
+        uint32_t *ll = vecLinks(vi,slot,l);
+
+        nw = vecSearchLayer(vi,q,qnorm,w,nw,l,vi->ef_construction);
+        memcpy(w,vi->results,sizeof(vecResult)*nw);
+        qsort(w,nw,sizeof(vecResult),vecResultCompare);
+        ll[0] = vecSelectNeighbors(vi,w,nw,vi->M,ll+1);
+        for (j = 1; j <= ll[0]; j++) {
+            uint32_t n = ll[j];
+            size_t k;
+
+            /* w已排序，邻居的距离直接从w中取 */
+            for (k = 0; w[k].slot != n; k++);
+            vecConnect(vi,n,slot,l,w[k].distance);
+        }
+    }
+    zfree(w);
+
+    if (level > vi->max_level) {
+        vi->max_level = level;
+        vi->entry = slot;
+    }
+    return slot;
+}
+
+/* 删除slot：指向它的邻居改为从两者的邻居中重新选择，slot放入空闲链表 */
+void vecDelete(vecIndex *vi, uint32_t slot) {
+    int l;
+    uint32_t j, k;
+
+    for (l = 0; l <= vi->levels[slot]; l++) {
+        uint32_t *dl = vecLinks(vi,slot,l);
+
+        for (j = 1; j <= dl[0]; j++) {
+            uint32_t n = dl[j], *nl, epoch;
+            size_t cnt = 0;
+            int linked = 0;
+
+            if (n == slot || !vecValidAt(vi,n,l)) continue;
+            nl = vecLinks(vi,n,l);
+            for (k = 1; k <= nl[0]; k++) if (nl[k] == slot) linked = 1;
+            if (!linked) continue;
+
+            /* 候选为n原有的邻居加上被删除向量的邻居，用访问标记去重 */
+            epoch = vecNewEpoch(vi);
+            vi->visited[slot] = vi->visited[n] = epoch;
+            for (k = 1; k <= nl[0]; k++) {
+                uint32_t c = nl[k];
+
+                if (vi->visited[c] == epoch || !vecValidAt(vi,c,l)) continue;
+                vi->visited[c] = epoch;
+                vi->scratch[cnt].slot = c;
+                vi->scratch[cnt++].distance = vecDistanceSlots(vi,n,c);
+            }
+            for (k = 1; k <= dl[0]; k++) {
+                uint32_t c = dl[k];
+
+                if (vi->visited[c] == epoch || !vecValidAt(vi,c,l)) continue;
+                vi->visited[c] = epoch;
+                vi->scratch[cnt].slot = c;
+                vi->scratch[cnt++].distance = vecDistanceSlots(vi,n,c);
+            }
+            vecShrinkLinks(vi,n,l,cnt);
+        }
+    }
+
+    zfree(vi->links[slot]);
+    vi->links[slot] = NULL;
+    vi->freelist[vi->numfree++] = slot;
+    vi->count--;
+
+    /* 入口被删除时选择剩余向量中层数最高的一个，这种情况很少，直接遍历所有slot */
+    if (vi->entry == slot) {
+        vi->entry = VEC_NONE;
+        vi->max_level = -1;
+        for (j = 0; j < vi->numslots; j++) {
+            if (vi->links[j] && (int)vi->levels[j] > vi->max_level) {
+                vi->entry = j;
+                vi->max_level = vi->levels[j];
+            }
+        }
+    }
+}
+
+/* HNSW近似搜索：返回最多k个结果，按距离升序写入res，ef越大召回率越高、速度越慢 */
+size_t vecSearch(vecIndex *vi, const void *query, size_t k, size_t ef, vecResult *res) {
+    vecResult ep;
+    float qnorm;
+    size_t n;
+    int l;
+
+    if (vi->entry == VEC_NONE || k == 0) return 0;
+    if (ef < k) ef = k;
+    qnorm = vecQueryNorm(vi,query);
+    ep.slot = vi->entry;
+    ep.distance = vecDistance(vi,query,qnorm,ep.slot);
+    for (l = vi->max_level; l > 0; l--) ep.slot = vecGreedy(vi,query,qnorm,ep.slot,&ep.distance,l);
+
+    n = vecSearchLayer(vi,query,qnorm,&ep,1,0,ef);
+    qsort(vi->results,n,sizeof(vecResult),vecResultCompare);
+    if (n > k) n = k;
+    memcpy(res,vi->results,sizeof(vecResult)*n);
+    return n;
+}
+
+/* 精确搜索：扫描[from, to)中的所有slot，返回最多k个结果，按距离升序写入res。
+ * 调用者可以分段扫描后合并结果，避免一次扫描大量向量 */
+size_t vecSearchFlat(vecIndex *vi, const void *query, uint32_t from, uint32_t to,
+                     size_t k, vecResult *res)
+{
+    float qnorm = vecQueryNorm(vi,query), d;
+    size_t n = 0;
+    uint32_t j;
+
+    if (to > vi->numslots) to = vi->numslots;
+    if (k == 0) return 0;
+    for (j = from; j < to; j++) {
+        if (vi->links[j] == NULL) continue;
+        d = vecDistance(vi,query,qnorm,j);
+        if (n < k) {
+            res[n].distance = d;
+            res[n].slot = j;
+            vecHeapSiftUp(res,n++);
+        } else if (d < res[0].distance) {
+            res[0].distance = d;
+            res[0].slot = j;
+            vecHeapSiftDown(res,n,0);
+        }
+    }
+    qsort(res,n,sizeof(vecResult),vecResultCompare);
+    return n;
+}
+
+/* 索引占用的内存 */
+size_t vecBytes(vecIndex *vi) {
+    size_t bytes = sizeof(*vi), perslot;
+    uint32_t j;
+
+    perslot = vi->stride+sizeof(uint8_t)+sizeof(uint32_t *)+sizeof(uint32_t)*2+
+              (vi->norms ? sizeof(float) : 0);
+    bytes += perslot*vi->capslots;
+    bytes += sizeof(vecResult)*(vi->candcap+vi->rescap+vi->M0*2+1)+sizeof(uint32_t)*vi->M0;
+    for (j = 0; j < vi->numslots; j++) {
+        if (vi->links[j] == NULL) continue;
+        bytes += sizeof(uint32_t)*((1+vi->M0)+(size_t)vi->levels[j]*(1+vi->M));
+    }
+    return bytes;
+}
+
+/* ------------------------------- Benchmark ---------------------------------*/
+
+#ifdef VECINDEX_BENCHMARK_MAIN
+
+#include <stdio.h>
+#include <time.h>
+
+static double benchmarkSeconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static uint64_t benchmarkRng = 88172645463325252ULL;
+
+static double benchmarkUniform(void) {
+    benchmarkRng ^= benchmarkRng << 13;
+    benchmarkRng ^= benchmarkRng >> 7;
+    benchmarkRng ^= benchmarkRng << 17;
+    return (benchmarkRng >> 11)*(1.0/9007199254740992.0);
+}
+
+static double benchmarkGaussian(void) {
+    double u = benchmarkUniform(), v = benchmarkUniform();
+
+    if (u <= 0) u = 1e-12;
+    return sqrt(-2*log(u))*cos(6.283185307179586*v);
+}
+
+/* 数据为若干个高斯簇，比均匀随机的向量更接近实际的embedding */
+static void benchmarkGenerate(float *out, size_t count, uint32_t dim, const float *centers,
+                              int numcenters)
+{
+    size_t i;
+    uint32_t j;
+
+    for (i = 0; i < count; i++) {
+        const float *c = centers+(size_t)(benchmarkUniform()*numcenters)*dim;
+
+        for (j = 0; j < dim; j++) out[i*dim+j] = c[j]+(float)(benchmarkGaussian()*0.35);
+    }
+}
+
+static void benchmarkQuantize(const float *in, int8_t *out, size_t n, float scale) {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        float v = roundf(in[i]*scale);
+
+        out[i] = (int8_t)(v > 127 ? 127 : v < -128 ? -128 : v);
+    }
+}
+
+static vecIndex *benchmarkBuild(int type, const void *data, size_t count, uint32_t dim,
+                                uint32_t M, uint32_t efc, double *elapsed)
+{
+    vecIndex *vi = vecNew(dim,type,VEC_METRIC_L2,M,efc);
+    double start = benchmarkSeconds();
+    size_t i;
+
+    for (i = 0; i < count; i++) vecInsert(vi,(const char *)data+i*vi->stride);
+    *elapsed = benchmarkSeconds()-start;
+    return vi;
+}
+
+static void benchmarkFlat(vecIndex *vi, const vecKernels *kset, const void *queries,
+                          int numqueries, size_t k, uint32_t *truth)
+{
+    vecResult *res = zmalloc(sizeof(vecResult)*k);
+    double start, elapsed;
+    int i;
+    size_t j, n;
+
+    kernels = kset;
+    start = benchmarkSeconds();
+    for (i = 0; i < numqueries; i++) {
+        n = vecSearchFlat(vi,(const char *)queries+i*vi->stride,0,vi->numslots,k,res);
+        if (truth) for (j = 0; j < n; j++) truth[i*k+j] = res[j].slot;
+    }
+    elapsed = benchmarkSeconds()-start;
+    printf("  flat %-7s %9.0f queries/sec %7.2f GB/s\n", kset->name, numqueries/elapsed,
+        (double)vi->count*vi->stride*numqueries/elapsed/1e9);
+    zfree(res);
+}
+
+static void benchmarkHnsw(vecIndex *vi, const void *queries, int numqueries, size_t k,
+                          const uint32_t *truth)
+{
+    static const size_t efs[] = {10, 20, 40, 80, 160, 320};
+    vecResult *res = zmalloc(sizeof(vecResult)*k);
+    size_t e, j, m, n, hits;
+    double start, elapsed;
+    int i;
+
+    for (e = 0; e < sizeof(efs)/sizeof(efs[0]); e++) {
+        hits = 0;
+        start = benchmarkSeconds();
+        for (i = 0; i < numqueries; i++) {
+            n = vecSearch(vi,(const char *)queries+i*vi->stride,k,efs[e],res);
+            for (j = 0; j < n; j++)
+                for (m = 0; m < k; m++) if (res[j].slot == truth[i*k+m]) hits++;
+        }
+        elapsed = benchmarkSeconds()-start;
+        printf("  hnsw ef=%-4zu recall@%zu %.4f %9.0f queries/sec\n", efs[e], k,
+            (double)hits/(numqueries*k), numqueries/elapsed);
+    }
+    zfree(res);
+}
+
+static void benchmarkType(const char *title, int type, const void *data, const void *queries,
+                          size_t count, uint32_t dim, int numqueries, size_t k)
+{
+    static const uint32_t Ms[] = {8, 16, 32};
+    uint32_t *truth = zmalloc(sizeof(uint32_t)*numqueries*k);
+    const vecKernels *best = kernels;
+    vecIndex *vi;
+    double elapsed;
+    size_t j;
+
+    for (j = 0; j < sizeof(Ms)/sizeof(Ms[0]); j++) {
+        vi = benchmarkBuild(type,data,count,dim,Ms[j],200,&elapsed);
+        if (j == 0) {
+            printf("%s, %zu vectors of %u dimensions:\n", title, count, dim);
+            benchmarkFlat(vi,&vecKernelsScalar,queries,numqueries,k,truth);
+#ifdef VECINDEX_X86_DISPATCH
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                benchmarkFlat(vi,&vecKernelsAVX2,queries,numqueries,k,NULL);
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+                benchmarkFlat(vi,&vecKernelsAVX512,queries,numqueries,k,NULL);
+#endif
+            kernels = best;
+        }
+        printf("  hnsw M=%u ef_construction=200: built in %.2f s (%.0f inserts/sec), %.1f MB\n",
+            Ms[j], elapsed, count/elapsed, vecBytes(vi)/1048576.0);
+        benchmarkHnsw(vi,queries,numqueries,k,truth);
+        vecFree(vi);
+    }
+    zfree(truth);
+}
+
+/* vecindex-benchmark [count] [dim] [queries]
+ * 在count个dim维的向量(L2距离)中搜索前10个最近邻，分别报告各内核精确搜索的吞吐量，
+ * 以及HNSW在不同ef下的召回率与吞吐量，召回率以精确搜索的结果为准 */
+int main(int argc, char **argv) {
+    size_t count = argc >= 2 ? strtoul(argv[1],NULL,10) : 100000;
+    uint32_t dim = argc >= 3 ? (uint32_t)strtoul(argv[2],NULL,10) : 128;
+    int numqueries = argc >= 4 ? atoi(argv[3]) : 1000, numcenters = 64, j;
+    float *centers = malloc(sizeof(float)*numcenters*dim);
+    float *data = malloc(sizeof(float)*count*dim);
+    float *queries = malloc(sizeof(float)*numqueries*dim);
+    int8_t *data8 = malloc(count*dim), *queries8 = malloc((size_t)numqueries*dim);
+
+    for (j = 0; j < numcenters*(int)dim; j++) centers[j] = (float)benchmarkGaussian();
+    benchmarkGenerate(data,count,dim,centers,numcenters);
+    benchmarkGenerate(queries,numqueries,dim,centers,numcenters);
+    benchmarkQuantize(data,data8,count*dim,32);
+    benchmarkQuantize(queries,queries8,(size_t)numqueries*dim,32);
+
+    printf("Kernel: %s\n", vecKernelName());
+    benchmarkType("float32",VEC_FLOAT32,data,queries,count,dim,numqueries,10);
+    benchmarkType("int8",VEC_INT8,data8,queries8,count,dim,numqueries,10);
+    return 0;
+}
+
+#endif
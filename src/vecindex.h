@@ -0,0 +1,77 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_VECINDEX_H
+#define RESP_SERVER_VECINDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* 向量分量类型 */
+#define VEC_FLOAT32 0
+#define VEC_INT8 1
+
+/* 距离度量，距离越小越相似：
+ * VEC_METRIC_L2为欧氏距离的平方；VEC_METRIC_IP为内积的相反数；VEC_METRIC_COSINE为1-余弦相似度 */
+#define VEC_METRIC_L2 0
+#define VEC_METRIC_IP 1
+#define VEC_METRIC_COSINE 2
+
+#define VEC_MAX_DIM 32768       /* int8的L2距离以int32累加，维度不超过32768时不会溢出 */
+#define VEC_MAX_LEVEL 16        /* HNSW的最大层数 */
+#define VEC_NONE UINT32_MAX
+
+/* 搜索结果，slot为向量在索引中的位置 */
+typedef struct vecResult {
+    float distance;
+    uint32_t slot;
+} vecResult;
+
+/* 向量索引：定长的向量保存在按slot编号的连续数组中，删除的slot放入空闲链表由之后的插入复用。
+ * 近似搜索使用HNSW图：每个向量随机分配层数，第0层最多M0=2*M个邻居，其他层最多M个邻居。
+ * 第l层的邻居表为[count, id...]，所有层的邻居表一次分配，links为NULL代表slot空闲。
+ * 余弦度量下float32向量插入时归一化，int8向量另外保存模长 */
+typedef struct vecIndex {
+    uint32_t dim;
+    int type;
+    int metric;
+    size_t stride;              /* 每个向量的字节数 */
+    unsigned char *vectors;
+    float *norms;               /* int8余弦度量时每个向量的模长，否则为NULL */
+    uint8_t *levels;
+    uint32_t **links;
+    uint32_t numslots;          /* 已使用过的slot数量，[0, numslots)中可能有空闲slot */
+    uint32_t capslots;
+    uint32_t count;             /* 向量数量 */
+    uint32_t *freelist;
+    uint32_t numfree;
+    uint32_t M;
+    uint32_t M0;
+    uint32_t ef_construction;
+    double level_mult;          /* 1/ln(M)，层数服从以此为参数的指数分布 */
+    int max_level;
+    uint32_t entry;             /* 最高层的入口，索引为空时为VEC_NONE */
+    uint64_t rng;
+    uint32_t *visited;          /* 搜索时的访问标记，等于visited_epoch代表本次搜索已访问 */
+    uint32_t visited_epoch;
+    vecResult *candidates;      /* 搜索时复用的堆 */
+    size_t candcap;
+    vecResult *results;
+    size_t rescap;
+    vecResult *scratch;         /* 重新选择邻居时的候选，容量为2*M0+1 */
+    uint32_t *next;             /* 搜索时待计算距离的邻居，容量为M0 */
+} vecIndex;
+
+vecIndex *vecNew(uint32_t dim, int type, int metric, uint32_t M, uint32_t ef_construction);
+void vecFree(vecIndex *vi);
+int vecEncode(vecIndex *vi, const float *in, void *out);
+uint32_t vecInsert(vecIndex *vi, const void *vec);
+void vecDelete(vecIndex *vi, uint32_t slot);
+size_t vecSearch(vecIndex *vi, const void *query, size_t k, size_t ef, vecResult *res);
+size_t vecSearchFlat(vecIndex *vi, const void *query, uint32_t from, uint32_t to,
+                     size_t k, vecResult *res);
+size_t vecBytes(vecIndex *vi);
+const char *vecKernelName(void);
+
+#endif //RESP_SERVER_VECINDEX_H
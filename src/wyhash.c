@@ -0,0 +1,147 @@
+/*
+   wyhash C implementation
+
+   Author: Wang Yi <godspeed_china@yeah.net>
+
+   This is free and unencumbered software released into the public domain
+   (The Unlicense). See <http://unlicense.org/>.
+
+   ----------------------------------------------------------------------------
+
+   This version is derived from the "final version 4" of wyhash, modified
+   in the following ways:
+
+   1. Only the 64 bit hash is kept, always with the default secret. The
+      prototype is the same as siphash() in siphash.c: the 16 bytes key is
+      folded into the 64 bit seed, so the two functions can be used with
+      the same per process random seed.
+   2. Provide a batch variant, wyhash_batch(), that hashes many keys with
+      the same seed. The seed is mixed once for the whole batch, and the
+      hash is inlined in the loop, so that the CPU can overlap the hashes
+      of consecutive keys, that are independent.
+   3. Always read the input as little endian, like siphash.c does, so the
+      hash is the same on every architecture.
+
+   wyhash is much faster than SipHash on short keys, but it is not a
+   cryptographic PRF: SipHash is still the right choice for hash tables
+   indexed by keys controlled by the clients.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include "endianconv.h"
+
+static const uint64_t wyhash_secret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+    0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+/* 128 bit product of A and B, the low half in A and the high half in B. */
+static inline void wyhash_mum(uint64_t *A, uint64_t *B) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *A;
+
+    r *= *B;
+    *A = (uint64_t)r;
+    *B = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *A >> 32, hb = *B >> 32, la = (uint32_t)*A, lb = (uint32_t)*B;
+    uint64_t rh = ha*hb, rm0 = ha*lb, rm1 = hb*la, rl = la*lb, t = rl+(rm0<<32);
+    uint64_t c = t < rl, lo, hi;
+
+    lo = t+(rm1<<32);
+    c += lo < t;
+    hi = rh+(rm0>>32)+(rm1>>32)+c;
+    *A = lo;
+    *B = hi;
+#endif
+}
+
+static inline uint64_t wyhash_mix(uint64_t A, uint64_t B) {
+    wyhash_mum(&A,&B);
+    return A^B;
+}
+
+static inline uint64_t wyhash_r8(const uint8_t *p) {
+    uint64_t v;
+
+    memcpy(&v,p,8);
+    return intrev64ifbe(v);
+}
+
+static inline uint64_t wyhash_r4(const uint8_t *p) {
+    uint32_t v;
+
+    memcpy(&v,p,4);
+    return intrev32ifbe(v);
+}
+
+/* Read 1 to 3 bytes. */
+static inline uint64_t wyhash_r3(const uint8_t *p, size_t k) {
+    return (((uint64_t)p[0])<<16)|(((uint64_t)p[k>>1])<<8)|p[k-1];
+}
+
+static inline uint64_t wyhash_seed(const uint8_t *k) {
+    uint64_t seed = wyhash_r8(k) ^ wyhash_r8(k+8);
+
+    return seed ^ wyhash_mix(seed^wyhash_secret[0],wyhash_secret[1]);
+}
+
+/* Hash with a seed already mixed by wyhash_seed(). */
+static inline uint64_t wyhash_seeded(const uint8_t *p, size_t len, uint64_t seed) {
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (wyhash_r4(p)<<32)|wyhash_r4(p+((len>>3)<<2));
+            b = (wyhash_r4(p+len-4)<<32)|wyhash_r4(p+len-4-((len>>3)<<2));
+        } else if (len > 0) {
+            a = wyhash_r3(p,len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+
+            do {
+                seed = wyhash_mix(wyhash_r8(p)^wyhash_secret[1],wyhash_r8(p+8)^seed);
+                see1 = wyhash_mix(wyhash_r8(p+16)^wyhash_secret[2],wyhash_r8(p+24)^see1);
+                see2 = wyhash_mix(wyhash_r8(p+32)^wyhash_secret[3],wyhash_r8(p+40)^see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1^see2;
+        }
+        while (i > 16) {
+            seed = wyhash_mix(wyhash_r8(p)^wyhash_secret[1],wyhash_r8(p+8)^seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wyhash_r8(p+i-16);
+        b = wyhash_r8(p+i-8);
+    }
+    a ^= wyhash_secret[1];
+    b ^= seed;
+    wyhash_mum(&a,&b);
+    return wyhash_mix(a^wyhash_secret[0]^len,b^wyhash_secret[1]);
+}
+
+uint64_t wyhash(const uint8_t *in, const size_t inlen, const uint8_t *k) {
+    return wyhash_seeded(in,inlen,wyhash_seed(k));
+}
+
+/* Store in out[j] the hash of the 'count' keys in[j] of inlen[j] bytes. */
+void wyhash_batch(const uint8_t *const *in, const size_t *inlen, int count,
+                  const uint8_t *k, uint64_t *out)
+{
+    uint64_t seed = wyhash_seed(k);
+    int j;
+
+    for (j = 0; j < count; j++)
+        out[j] = wyhash_seeded(in[j],inlen[j],seed);
+}
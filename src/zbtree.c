@@ -0,0 +1,986 @@
+//
+// Created by yukino on 2026/10/18.
+//
+// zset使用的按排名有序的B+树(order-statistic B+ tree)。元素按(score, member)排序，
+// 内部节点记录每个子树的元素数量，插入、删除、排名计算与按排名查找都是O(log n)。
+// 与跳表相比，元素连续保存在叶子节点的数组中，范围查询按数组顺序读取，每个元素的额外
+// 内存也更少(跳表每个节点平均约1.33层，每层16字节，外加回退指针与单独的一次分配)。
+
+#include <unistd.h>
+#include <string.h>
+#include "zbtree.h"
+#include "zmalloc.h"
+#include "log.h"
+
+/*-----------------------------------------------------------------------------
+ * Nodes
+ *----------------------------------------------------------------------------*/
+
+static int zbtCompare(double s1, sds e1, double s2, sds e2) {
+    if (s1 < s2) return -1;
+    if (s1 > s2) return 1;
+    return sdscmp(e1,e2);
+}
+
+static zbtLeaf *zbtCreateLeaf(void) {
+    zbtLeaf *l = zmalloc(sizeof(*l));
+
+    l->hdr.leaf = 1;
+    l->hdr.n = 0;
+    l->prev = l->next = NULL;
+    return l;
+}
+
+static zbtInner *zbtCreateInner(void) {
+    zbtInner *x = zmalloc(sizeof(*x));
+
+    x->hdr.leaf = 0;
+    x->hdr.n = 0;
+    x->ele[0] = NULL;
+    return x;
+}
+
+static void zbtFreeNode(zbtNode *x) {
+    int j;
+
+    if (x->leaf) {
+        zbtLeaf *l = (zbtLeaf*)x;
+
+        for (j = 0; j < x->n; j++) sdsfree(l->ele[j]);
+    } else {
+        zbtInner *in = (zbtInner*)x;
+
+        for (j = 0; j < x->n; j++) zbtFreeNode(in->child[j]);
+        for (j = 1; j < x->n; j++) sdsfree(in->ele[j]);
+    }
+    zfree(x);
+}
+
+/* Return the number of elements in the subtree rooted at 'x'. */
+static unsigned long zbtNodeCount(zbtNode *x) {
+    zbtInner *in = (zbtInner*)x;
+    unsigned long count = 0;
+    int j;
+
+    if (x->leaf) return x->n;
+    for (j = 0; j < x->n; j++) count += in->count[j];
+    return count;
+}
+
+/* Return the index of the first element of the leaf not smaller than
+ * (score, ele). */
+static int zbtLeafLowerBound(zbtLeaf *l, double score, sds ele) {
+    int lo = 0, hi = l->hdr.n;
+
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+
+        if (zbtCompare(l->score[mid],l->ele[mid],score,ele) < 0)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Return the index of the child that may contain (score, ele), that is
+ * the last child whose lower bound is not greater than the element. */
+static int zbtInnerChild(zbtInner *x, double score, sds ele) {
+    int lo = 1, hi = x->hdr.n;
+
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+
+        if (zbtCompare(x->score[mid],x->ele[mid],score,ele) <= 0)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo-1;
+}
+
+static void zbtLeafInsertAt(zbtLeaf *l, int pos, double score, sds ele) {
+    int n = l->hdr.n;
+
+    memmove(l->score+pos+1,l->score+pos,sizeof(double)*(n-pos));
+    memmove(l->ele+pos+1,l->ele+pos,sizeof(sds)*(n-pos));
+    l->score[pos] = score;
+    l->ele[pos] = ele;
+    l->hdr.n++;
+}
+
+static void zbtLeafRemoveAt(zbtLeaf *l, int pos) {
+    int n = l->hdr.n;
+
+    memmove(l->score+pos,l->score+pos+1,sizeof(double)*(n-pos-1));
+    memmove(l->ele+pos,l->ele+pos+1,sizeof(sds)*(n-pos-1));
+    l->hdr.n--;
+}
+
+/* Insert 'child' at position 'pos' (>= 1) with its element count and its
+ * lower bound. The inner node takes the ownership of 'ele'. */
+static void zbtInnerInsertAt(zbtInner *x, int pos, zbtNode *child, unsigned long count,
+                             double score, sds ele) {
+    int n = x->hdr.n;
+
+    memmove(x->child+pos+1,x->child+pos,sizeof(zbtNode*)*(n-pos));
+    memmove(x->count+pos+1,x->count+pos,sizeof(unsigned long)*(n-pos));
+    memmove(x->score+pos+1,x->score+pos,sizeof(double)*(n-pos));
+    memmove(x->ele+pos+1,x->ele+pos,sizeof(sds)*(n-pos));
+    x->child[pos] = child;
+    x->count[pos] = count;
+    x->score[pos] = score;
+    x->ele[pos] = ele;
+    x->hdr.n++;
+}
+
+/* Remove the child at position 'pos' (>= 1). Its lower bound is not
+ * released, the caller either frees it or moves it elsewhere. */
+static void zbtInnerRemoveAt(zbtInner *x, int pos) {
+    int n = x->hdr.n;
+
+    memmove(x->child+pos,x->child+pos+1,sizeof(zbtNode*)*(n-pos-1));
+    memmove(x->count+pos,x->count+pos+1,sizeof(unsigned long)*(n-pos-1));
+    memmove(x->score+pos,x->score+pos+1,sizeof(double)*(n-pos-1));
+    memmove(x->ele+pos,x->ele+pos+1,sizeof(sds)*(n-pos-1));
+    x->hdr.n--;
+}
+
+static void zbtSetLowerBound(zbtInner *x, int pos, double score, sds ele) {
+    x->score[pos] = score;
+    x->ele[pos] = sdscpylen(x->ele[pos],ele,sdslen(ele));
+}
+
+/*-----------------------------------------------------------------------------
+ * Insertion
+ *----------------------------------------------------------------------------*/
+
+/* Insert the element in the subtree rooted at 'x'. If the node has to be
+ * split the new right sibling is returned, and its lower bound is stored in
+ * '*sepscore' and '*sepele'. Otherwise NULL is returned. */
+static zbtNode *zbtInsertNode(zbtNode *x, double score, sds ele,
+                              double *sepscore, sds *sepele) {
+    if (x->leaf) {
+        zbtLeaf *l = (zbtLeaf*)x, *r;
+        int pos = zbtLeafLowerBound(l,score,ele);
+        int half = ZBT_LEAF_CAP/2;
+
+        if (x->n < ZBT_LEAF_CAP) {
+            zbtLeafInsertAt(l,pos,score,ele);
+            return NULL;
+        }
+
+        /* Split the leaf, the upper half moves to a new leaf on its right. */
+        r = zbtCreateLeaf();
+        memcpy(r->score,l->score+half,sizeof(double)*(ZBT_LEAF_CAP-half));
+        memcpy(r->ele,l->ele+half,sizeof(sds)*(ZBT_LEAF_CAP-half));
+        r->hdr.n = ZBT_LEAF_CAP-half;
+        l->hdr.n = half;
+        r->next = l->next;
+        if (r->next) r->next->prev = r;
+        r->prev = l;
+        l->next = r;
+        if (pos <= half)
+            zbtLeafInsertAt(l,pos,score,ele);
+        else
+            zbtLeafInsertAt(r,pos-half,score,ele);
+        *sepscore = r->score[0];
+        *sepele = sdsdup(r->ele[0]);
+        return (zbtNode*)r;
+    } else {
+        zbtInner *in = (zbtInner*)x, *r;
+        int c = zbtInnerChild(in,score,ele);
+        int half = ZBT_INNER_CAP/2;
+        unsigned long count;
+        zbtNode *split;
+        double s;
+        sds e;
+
+        in->count[c]++;
+        split = zbtInsertNode(in->child[c],score,ele,&s,&e);
+        if (split == NULL) return NULL;
+        count = zbtNodeCount(split);
+        in->count[c] -= count;
+        if (x->n < ZBT_INNER_CAP) {
+            zbtInnerInsertAt(in,c+1,split,count,s,e);
+            return NULL;
+        }
+
+        /* Split the inner node. The lower bound of the first child of the
+         * new right node is moved up to the parent. */
+        r = zbtCreateInner();
+        memcpy(r->child,in->child+half,sizeof(zbtNode*)*(ZBT_INNER_CAP-half));
+        memcpy(r->count,in->count+half,sizeof(unsigned long)*(ZBT_INNER_CAP-half));
+        memcpy(r->score,in->score+half,sizeof(double)*(ZBT_INNER_CAP-half));
+        memcpy(r->ele,in->ele+half,sizeof(sds)*(ZBT_INNER_CAP-half));
+        r->hdr.n = ZBT_INNER_CAP-half;
+        in->hdr.n = half;
+        if (c+1 <= half)
+            zbtInnerInsertAt(in,c+1,split,count,s,e);
+        else
+            zbtInnerInsertAt(r,c+1-half,split,count,s,e);
+        *sepscore = r->score[0];
+        *sepele = r->ele[0];
+        r->ele[0] = NULL;
+        return (zbtNode*)r;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * Deletion
+ *----------------------------------------------------------------------------*/
+
+/* Merge the leaves i and i+1 of 'p', or move one element from the larger
+ * to the smaller if they don't fit in a single leaf. */
+static void zbtRebalanceLeaves(zbtInner *p, int i) {
+    zbtLeaf *l = (zbtLeaf*)p->child[i], *r = (zbtLeaf*)p->child[i+1];
+    int ln = l->hdr.n, rn = r->hdr.n;
+
+    if (ln+rn <= ZBT_LEAF_CAP) {
+        memcpy(l->score+ln,r->score,sizeof(double)*rn);
+        memcpy(l->ele+ln,r->ele,sizeof(sds)*rn);
+        l->hdr.n = ln+rn;
+        l->next = r->next;
+        if (r->next) r->next->prev = l;
+        p->count[i] += p->count[i+1];
+        sdsfree(p->ele[i+1]);
+        zbtInnerRemoveAt(p,i+1);
+        zfree(r);
+    } else if (ln < rn) {
+        l->score[ln] = r->score[0];
+        l->ele[ln] = r->ele[0];
+        l->hdr.n++;
+        zbtLeafRemoveAt(r,0);
+        p->count[i]++;
+        p->count[i+1]--;
+        zbtSetLowerBound(p,i+1,r->score[0],r->ele[0]);
+    } else {
+        zbtLeafInsertAt(r,0,l->score[ln-1],l->ele[ln-1]);
+        l->hdr.n--;
+        p->count[i]--;
+        p->count[i+1]++;
+        zbtSetLowerBound(p,i+1,r->score[0],r->ele[0]);
+    }
+}
+
+/* Same as zbtRebalanceLeaves() for inner nodes. The lower bound stored in
+ * 'p' for the right node moves down when children change side. */
+static void zbtRebalanceInners(zbtInner *p, int i) {
+    zbtInner *l = (zbtInner*)p->child[i], *r = (zbtInner*)p->child[i+1];
+    int ln = l->hdr.n, rn = r->hdr.n;
+    unsigned long moved;
+
+    if (ln+rn <= ZBT_INNER_CAP) {
+        l->child[ln] = r->child[0];
+        l->count[ln] = r->count[0];
+        l->score[ln] = p->score[i+1];
+        l->ele[ln] = p->ele[i+1];
+        memcpy(l->child+ln+1,r->child+1,sizeof(zbtNode*)*(rn-1));
+        memcpy(l->count+ln+1,r->count+1,sizeof(unsigned long)*(rn-1));
+        memcpy(l->score+ln+1,r->score+1,sizeof(double)*(rn-1));
+        memcpy(l->ele+ln+1,r->ele+1,sizeof(sds)*(rn-1));
+        l->hdr.n = ln+rn;
+        p->count[i] += p->count[i+1];
+        zbtInnerRemoveAt(p,i+1);
+        zfree(r);
+    } else if (ln < rn) {
+        moved = r->count[0];
+        l->child[ln] = r->child[0];
+        l->count[ln] = moved;
+        l->score[ln] = p->score[i+1];
+        l->ele[ln] = p->ele[i+1];
+        l->hdr.n++;
+        p->score[i+1] = r->score[1];
+        p->ele[i+1] = r->ele[1];
+        memmove(r->child,r->child+1,sizeof(zbtNode*)*(rn-1));
+        memmove(r->count,r->count+1,sizeof(unsigned long)*(rn-1));
+        memmove(r->score+1,r->score+2,sizeof(double)*(rn-2));
+        memmove(r->ele+1,r->ele+2,sizeof(sds)*(rn-2));
+        r->hdr.n--;
+        p->count[i] += moved;
+        p->count[i+1] -= moved;
+    } else {
+        moved = l->count[ln-1];
+        memmove(r->child+1,r->child,sizeof(zbtNode*)*rn);
+        memmove(r->count+1,r->count,sizeof(unsigned long)*rn);
+        memmove(r->score+2,r->score+1,sizeof(double)*(rn-1));
+        memmove(r->ele+2,r->ele+1,sizeof(sds)*(rn-1));
+        r->child[0] = l->child[ln-1];
+        r->count[0] = moved;
+        r->score[1] = p->score[i+1];
+        r->ele[1] = p->ele[i+1];
+        r->hdr.n++;
+        p->score[i+1] = l->score[ln-1];
+        p->ele[i+1] = l->ele[ln-1];
+        l->hdr.n--;
+        p->count[i] -= moved;
+        p->count[i+1] += moved;
+    }
+}
+
+/* Rebalance the child 'c' of 'p' if it has too few entries. */
+static void zbtRebalance(zbtInner *p, int c) {
+    zbtNode *x = p->child[c];
+    int i;
+
+    if (x->n >= (x->leaf ? ZBT_LEAF_MIN : ZBT_INNER_MIN) || p->hdr.n < 2) return;
+    i = c > 0 ? c-1 : c;
+    if (x->leaf)
+        zbtRebalanceLeaves(p,i);
+    else
+        zbtRebalanceInners(p,i);
+}
+
+static int zbtDeleteNode(zbtNode *x, double score, sds ele, sds *node) {
+    if (x->leaf) {
+        zbtLeaf *l = (zbtLeaf*)x;
+        int pos = zbtLeafLowerBound(l,score,ele);
+
+        if (pos == x->n || zbtCompare(l->score[pos],l->ele[pos],score,ele) != 0)
+            return 0;
+        if (node)
+            *node = l->ele[pos];
+        else
+            sdsfree(l->ele[pos]);
+        zbtLeafRemoveAt(l,pos);
+        return 1;
+    } else {
+        zbtInner *in = (zbtInner*)x;
+        int c = zbtInnerChild(in,score,ele);
+
+        if (!zbtDeleteNode(in->child[c],score,ele,node)) return 0;
+        in->count[c]--;
+        zbtRebalance(in,c);
+        return 1;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ * Range search
+ *----------------------------------------------------------------------------*/
+
+int zbtValueGteMin(double value, zrangespec *spec) {
+    return spec->minex ? (value > spec->min) : (value >= spec->min);
+}
+
+int zbtValueLteMax(double value, zrangespec *spec) {
+    return spec->maxex ? (value < spec->max) : (value <= spec->max);
+}
+
+/* Return the number of scores smaller than the range (they are a prefix of
+ * the sorted array). The loops are branch free so that the compiler can
+ * vectorize them. */
+static int zbtCountBelowMin(const double *score, int n, zrangespec *range) {
+    double min = range->min;
+    int j, count = 0;
+
+    if (range->minex) {
+        for (j = 0; j < n; j++) count += score[j] <= min;
+    } else {
+        for (j = 0; j < n; j++) count += score[j] < min;
+    }
+    return count;
+}
+
+/* Return the number of scores not greater than the range maximum. */
+static int zbtCountLteMax(const double *score, int n, zrangespec *range) {
+    double max = range->max;
+    int j, count = 0;
+
+    if (range->maxex) {
+        for (j = 0; j < n; j++) count += score[j] < max;
+    } else {
+        for (j = 0; j < n; j++) count += score[j] <= max;
+    }
+    return count;
+}
+
+static int zbtIsEmptyRange(zrangespec *range) {
+    return range->min > range->max ||
+           (range->min == range->max && (range->minex || range->maxex));
+}
+
+/* Find the first element in the specified range. Returns its leaf, storing
+ * the position in '*idx' and the 1-based rank in '*rank', or NULL when no
+ * element is part of the range. */
+zbtLeaf *zbtFirstInRange(zbtree *zbt, zrangespec *range, int *idx, unsigned long *rank) {
+    zbtNode *x = zbt->root;
+    unsigned long traversed = 0;
+    zbtLeaf *l;
+    int i, j;
+
+    if (zbtIsEmptyRange(range)) return NULL;
+    while (!x->leaf) {
+        zbtInner *in = (zbtInner*)x;
+        int c = zbtCountBelowMin(in->score+1,x->n-1,range);
+
+        for (j = 0; j < c; j++) traversed += in->count[j];
+        x = in->child[c];
+    }
+
+    /* The lower bounds are not elements: if the whole leaf is below the
+     * range the first element of the next leaf is the candidate. */
+    l = (zbtLeaf*)x;
+    while ((i = zbtCountBelowMin(l->score,l->hdr.n,range)) == l->hdr.n) {
+        traversed += l->hdr.n;
+        if ((l = l->next) == NULL) return NULL;
+    }
+    if (!zbtValueLteMax(l->score[i],range)) return NULL;
+    *idx = i;
+    *rank = traversed+i+1;
+    return l;
+}
+
+/* Find the last element in the specified range, see zbtFirstInRange(). */
+zbtLeaf *zbtLastInRange(zbtree *zbt, zrangespec *range, int *idx, unsigned long *rank) {
+    zbtNode *x = zbt->root;
+    unsigned long traversed = 0;
+    zbtLeaf *l;
+    int i, j;
+
+    if (zbtIsEmptyRange(range)) return NULL;
+    while (!x->leaf) {
+        zbtInner *in = (zbtInner*)x;
+        int c = zbtCountLteMax(in->score+1,x->n-1,range);
+
+        for (j = 0; j < c; j++) traversed += in->count[j];
+        x = in->child[c];
+    }
+
+    l = (zbtLeaf*)x;
+    while ((i = zbtCountLteMax(l->score,l->hdr.n,range)-1) < 0) {
+        if ((l = l->prev) == NULL) return NULL;
+        traversed -= l->hdr.n;
+    }
+    if (!zbtValueGteMin(l->score[i],range)) return NULL;
+    *idx = i;
+    *rank = traversed+i+1;
+    return l;
+}
+
+/*-----------------------------------------------------------------------------
+ * API
+ *----------------------------------------------------------------------------*/
+
+zbtree *zbtCreate(void) {
+    zbtree *zbt = zmalloc(sizeof(*zbt));
+
+    zbt->root = (zbtNode*)zbtCreateLeaf();
+    zbt->length = 0;
+    return zbt;
+}
+
+void zbtFree(zbtree *zbt) {
+    zbtFreeNode(zbt->root);
+    zfree(zbt);
+}
+
+/* Insert a new element. The element must not already exist (the caller
+ * checks the member in the dict), the tree takes the ownership of 'ele'. */
+void zbtInsert(zbtree *zbt, double score, sds ele) {
+    zbtNode *split;
+    double s;
+    sds e;
+
+    split = zbtInsertNode(zbt->root,score,ele,&s,&e);
+    if (split) {
+        zbtInner *root = zbtCreateInner();
+
+        root->child[0] = zbt->root;
+        root->count[0] = zbtNodeCount(zbt->root);
+        root->child[1] = split;
+        root->count[1] = zbtNodeCount(split);
+        root->score[1] = s;
+        root->ele[1] = e;
+        root->hdr.n = 2;
+        zbt->root = (zbtNode*)root;
+    }
+    zbt->length++;
+}
+
+/* Delete an element with matching score/element from the tree.
+ * The function returns 1 if the node was found and deleted, otherwise
+ * 0 is returned.
+ *
+ * If 'node' is NULL the member is freed, otherwise it is not freed and
+ * '*node' is set to it, so that it can be reused by the caller. */
+int zbtDelete(zbtree *zbt, double score, sds ele, sds *node) {
+    if (!zbtDeleteNode(zbt->root,score,ele,node)) return 0;
+    zbt->length--;
+    if (!zbt->root->leaf && zbt->root->n == 1) {
+        zbtInner *root = (zbtInner*)zbt->root;
+
+        zbt->root = root->child[0];
+        zfree(root);
+    }
+    return 1;
+}
+
+/* Update the score of an element. The element must exist with score
+ * 'curscore'. When the element stays between its neighbours in the same
+ * leaf the score is updated in place, otherwise it is removed and inserted
+ * again reusing the same member. */
+void zbtUpdateScore(zbtree *zbt, double curscore, sds ele, double newscore) {
+    zbtNode *x = zbt->root;
+    zbtLeaf *l;
+    sds node;
+    int pos;
+
+    while (!x->leaf) {
+        zbtInner *in = (zbtInner*)x;
+
+        x = in->child[zbtInnerChild(in,curscore,ele)];
+    }
+    l = (zbtLeaf*)x;
+    pos = zbtLeafLowerBound(l,curscore,ele);
+    serverAssert(pos < x->n && zbtCompare(l->score[pos],l->ele[pos],curscore,ele) == 0);
+
+    /* The first element is left alone, since moving it before the lower
+     * bound stored in the parent would break the search. */
+    if (pos > 0 && pos < x->n-1 &&
+        zbtCompare(newscore,ele,l->score[pos-1],l->ele[pos-1]) > 0 &&
+        zbtCompare(newscore,ele,l->score[pos+1],l->ele[pos+1]) < 0)
+    {
+        l->score[pos] = newscore;
+        return;
+    }
+
+    zbtDelete(zbt,curscore,ele,&node);
+    zbtInsert(zbt,newscore,node);
+}
+
+/* Find the rank for an element by both score and key.
+ * Returns 0 when the element cannot be found, rank otherwise.
+ * Note that the rank is 1-based. */
+unsigned long zbtGetRank(zbtree *zbt, double score, sds ele) {
+    zbtNode *x = zbt->root;
+    unsigned long rank = 0;
+    zbtLeaf *l;
+    int pos, j;
+
+    while (!x->leaf) {
+        zbtInner *in = (zbtInner*)x;
+        int c = zbtInnerChild(in,score,ele);
+
+        for (j = 0; j < c; j++) rank += in->count[j];
+        x = in->child[c];
+    }
+    l = (zbtLeaf*)x;
+    pos = zbtLeafLowerBound(l,score,ele);
+    if (pos < x->n && zbtCompare(l->score[pos],l->ele[pos],score,ele) == 0)
+        return rank+pos+1;
+    return 0;
+}
+
+/* Find the element by its 1-based rank. Returns its leaf and stores the
+ * position in '*idx', or NULL if the rank is out of range. */
+zbtLeaf *zbtGetElementByRank(zbtree *zbt, unsigned long rank, int *idx) {
+    zbtNode *x = zbt->root;
+
+    if (rank == 0 || rank > zbt->length) return NULL;
+    rank--;
+    while (!x->leaf) {
+        zbtInner *in = (zbtInner*)x;
+        int c = 0;
+
+        while (rank >= in->count[c]) rank -= in->count[c++];
+        x = in->child[c];
+    }
+    *idx = (int)rank;
+    return (zbtLeaf*)x;
+}
+
+/* ------------------------------- Benchmark ---------------------------------*/
+
+#ifdef ZBTREE_BENCHMARK_MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void _serverAssert(const char *estr, const char *file, int line) {
+    fprintf(stderr,"=== ASSERTION FAILED ===\n==> %s:%d '%s' is not true\n",file,line,estr);
+    abort();
+}
+
+static double benchmarkSeconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static uint64_t benchmarkRng = 88172645463325252ULL;
+
+static uint64_t benchmarkRandom(void) {
+    benchmarkRng ^= benchmarkRng << 13;
+    benchmarkRng ^= benchmarkRng >> 7;
+    benchmarkRng ^= benchmarkRng << 17;
+    return benchmarkRng;
+}
+
+/* 作为基准的跳表，与Redis的zskiplist相同：每层概率1/4，最多32层，每层记录span用于计算排名 */
+#define ZSKIPLIST_MAXLEVEL 32
+#define ZSKIPLIST_P 0.25
+
+typedef struct zskiplistNode {
+    sds ele;
+    double score;
+    struct zskiplistNode *backward;
+    struct zskiplistLevel {
+        struct zskiplistNode *forward;
+        unsigned long span;
+    } level[];
+} zskiplistNode;
+
+typedef struct zskiplist {
+    struct zskiplistNode *header, *tail;
+    unsigned long length;
+    int level;
+} zskiplist;
+
+static zskiplistNode *zslCreateNode(int level, double score, sds ele) {
+    zskiplistNode *zn = zmalloc(sizeof(*zn)+level*sizeof(struct zskiplistLevel));
+
+    zn->score = score;
+    zn->ele = ele;
+    return zn;
+}
+
+static zskiplist *zslCreate(void) {
+    zskiplist *zsl = zmalloc(sizeof(*zsl));
+    int j;
+
+    zsl->level = 1;
+    zsl->length = 0;
+    zsl->header = zslCreateNode(ZSKIPLIST_MAXLEVEL,0,NULL);
+    for (j = 0; j < ZSKIPLIST_MAXLEVEL; j++) {
+        zsl->header->level[j].forward = NULL;
+        zsl->header->level[j].span = 0;
+    }
+    zsl->header->backward = NULL;
+    zsl->tail = NULL;
+    return zsl;
+}
+
+static void zslFree(zskiplist *zsl) {
+    zskiplistNode *node = zsl->header->level[0].forward, *next;
+
+    zfree(zsl->header);
+    while (node) {
+        next = node->level[0].forward;
+        sdsfree(node->ele);
+        zfree(node);
+        node = next;
+    }
+    zfree(zsl);
+}
+
+static int zslRandomLevel(void) {
+    int level = 1;
+
+    while ((benchmarkRandom()&0xFFFF) < (ZSKIPLIST_P*0xFFFF)) level++;
+    return (level < ZSKIPLIST_MAXLEVEL) ? level : ZSKIPLIST_MAXLEVEL;
+}
+
+static void zslInsert(zskiplist *zsl, double score, sds ele) {
+    zskiplistNode *update[ZSKIPLIST_MAXLEVEL], *x;
+    unsigned long rank[ZSKIPLIST_MAXLEVEL];
+    int i, level;
+
+    x = zsl->header;
+    for (i = zsl->level-1; i >= 0; i--) {
+        rank[i] = i == (zsl->level-1) ? 0 : rank[i+1];
+        while (x->level[i].forward &&
+               zbtCompare(x->level[i].forward->score,x->level[i].forward->ele,score,ele) < 0)
+        {
+            rank[i] += x->level[i].span;
+            x = x->level[i].forward;
+        }
+        update[i] = x;
+    }
+    level = zslRandomLevel();
+    if (level > zsl->level) {
+        for (i = zsl->level; i < level; i++) {
+            rank[i] = 0;
+            update[i] = zsl->header;
+            update[i]->level[i].span = zsl->length;
+        }
+        zsl->level = level;
+    }
+    x = zslCreateNode(level,score,ele);
+    for (i = 0; i < level; i++) {
+        x->level[i].forward = update[i]->level[i].forward;
+        update[i]->level[i].forward = x;
+        x->level[i].span = update[i]->level[i].span-(rank[0]-rank[i]);
+        update[i]->level[i].span = (rank[0]-rank[i])+1;
+    }
+    for (i = level; i < zsl->level; i++) update[i]->level[i].span++;
+    x->backward = (update[0] == zsl->header) ? NULL : update[0];
+    if (x->level[0].forward)
+        x->level[0].forward->backward = x;
+    else
+        zsl->tail = x;
+    zsl->length++;
+}
+
+static int zslDelete(zskiplist *zsl, double score, sds ele) {
+    zskiplistNode *update[ZSKIPLIST_MAXLEVEL], *x;
+    int i;
+
+    x = zsl->header;
+    for (i = zsl->level-1; i >= 0; i--) {
+        while (x->level[i].forward &&
+               zbtCompare(x->level[i].forward->score,x->level[i].forward->ele,score,ele) < 0)
+            x = x->level[i].forward;
+        update[i] = x;
+    }
+    x = x->level[0].forward;
+    if (!x || zbtCompare(x->score,x->ele,score,ele) != 0) return 0;
+    for (i = 0; i < zsl->level; i++) {
+        if (update[i]->level[i].forward == x) {
+            update[i]->level[i].span += x->level[i].span-1;
+            update[i]->level[i].forward = x->level[i].forward;
+        } else {
+            update[i]->level[i].span -= 1;
+        }
+    }
+    if (x->level[0].forward)
+        x->level[0].forward->backward = x->backward;
+    else
+        zsl->tail = x->backward;
+    while (zsl->level > 1 && zsl->header->level[zsl->level-1].forward == NULL) zsl->level--;
+    zsl->length--;
+    sdsfree(x->ele);
+    zfree(x);
+    return 1;
+}
+
+static unsigned long zslGetRank(zskiplist *zsl, double score, sds ele) {
+    zskiplistNode *x = zsl->header;
+    unsigned long rank = 0;
+    int i;
+
+    for (i = zsl->level-1; i >= 0; i--) {
+        while (x->level[i].forward &&
+               zbtCompare(x->level[i].forward->score,x->level[i].forward->ele,score,ele) <= 0)
+        {
+            rank += x->level[i].span;
+            x = x->level[i].forward;
+        }
+        if (x->ele && zbtCompare(x->score,x->ele,score,ele) == 0) return rank;
+    }
+    return 0;
+}
+
+static zskiplistNode *zslGetElementByRank(zskiplist *zsl, unsigned long rank) {
+    zskiplistNode *x = zsl->header;
+    unsigned long traversed = 0;
+    int i;
+
+    for (i = zsl->level-1; i >= 0; i--) {
+        while (x->level[i].forward && (traversed+x->level[i].span) <= rank) {
+            traversed += x->level[i].span;
+            x = x->level[i].forward;
+        }
+        if (traversed == rank) return x;
+    }
+    return NULL;
+}
+
+static zskiplistNode *zslFirstInRange(zskiplist *zsl, zrangespec *range) {
+    zskiplistNode *x = zsl->header;
+    int i;
+
+    for (i = zsl->level-1; i >= 0; i--) {
+        while (x->level[i].forward && !zbtValueGteMin(x->level[i].forward->score,range))
+            x = x->level[i].forward;
+    }
+    x = x->level[0].forward;
+    if (x == NULL || !zbtValueLteMax(x->score,range)) return NULL;
+    return x;
+}
+
+typedef struct benchmarkResult {
+    double insert, rank, byrank, range, rangebyscore, delete;
+    size_t bytes;
+} benchmarkResult;
+
+/* 元素按ZRANGE的方式读取：score与member的长度都要访问，与回复时相同 */
+static void benchmarkZbtree(benchmarkResult *res, double *scores, sds *members, size_t n,
+                            size_t queries, unsigned long len, double *acc)
+{
+    size_t used = zmalloc_used_memory(), j;
+    zbtree *zbt;
+    double start;
+
+    start = benchmarkSeconds();
+    zbt = zbtCreate();
+    for (j = 0; j < n; j++) zbtInsert(zbt,scores[j],sdsdup(members[j]));
+    res->insert = benchmarkSeconds()-start;
+    res->bytes = zmalloc_used_memory()-used;
+
+    start = benchmarkSeconds();
+    for (j = 0; j < queries; j++) {
+        size_t k = benchmarkRandom()%n;
+        *acc += zbtGetRank(zbt,scores[k],members[k]);
+    }
+    res->rank = benchmarkSeconds()-start;
+
+    start = benchmarkSeconds();
+    for (j = 0; j < queries; j++) {
+        int idx = 0;
+        zbtLeaf *l = zbtGetElementByRank(zbt,benchmarkRandom()%n+1,&idx);
+        *acc += l->score[idx]+sdslen(l->ele[idx]);
+    }
+    res->byrank = benchmarkSeconds()-start;
+
+    start = benchmarkSeconds();
+    for (j = 0; j < queries/len*10+1; j++) {
+        unsigned long remaining = len;
+        int idx = 0;
+        zbtLeaf *l = zbtGetElementByRank(zbt,benchmarkRandom()%(n-len)+1,&idx);
+
+        while (l && remaining--) {
+            *acc += l->score[idx]+sdslen(l->ele[idx]);
+            if (++idx == l->hdr.n) {
+                l = l->next;
+                idx = 0;
+            }
+        }
+    }
+    res->range = benchmarkSeconds()-start;
+
+    start = benchmarkSeconds();
+    for (j = 0; j < queries/len*10+1; j++) {
+        zrangespec range;
+        unsigned long rank, remaining = len;
+        int idx = 0;
+        zbtLeaf *l;
+
+        range.min = (double)(benchmarkRandom()%n);
+        range.max = range.min+len;
+        range.minex = range.maxex = 0;
+        l = zbtFirstInRange(zbt,&range,&idx,&rank);
+        while (l && remaining-- && zbtValueLteMax(l->score[idx],&range)) {
+            *acc += l->score[idx]+sdslen(l->ele[idx]);
+            if (++idx == l->hdr.n) {
+                l = l->next;
+                idx = 0;
+            }
+        }
+    }
+    res->rangebyscore = benchmarkSeconds()-start;
+
+    start = benchmarkSeconds();
+    for (j = n; j > 0; j--) zbtDelete(zbt,scores[j-1],members[j-1],NULL);
+    res->delete = benchmarkSeconds()-start;
+    zbtFree(zbt);
+}
+
+static void benchmarkSkiplist(benchmarkResult *res, double *scores, sds *members, size_t n,
+                              size_t queries, unsigned long len, double *acc)
+{
+    size_t used = zmalloc_used_memory(), j;
+    zskiplist *zsl;
+    double start;
+
+    start = benchmarkSeconds();
+    zsl = zslCreate();
+    for (j = 0; j < n; j++) zslInsert(zsl,scores[j],sdsdup(members[j]));
+    res->insert = benchmarkSeconds()-start;
+    res->bytes = zmalloc_used_memory()-used;
+
+    start = benchmarkSeconds();
+    for (j = 0; j < queries; j++) {
+        size_t k = benchmarkRandom()%n;
+        *acc += zslGetRank(zsl,scores[k],members[k]);
+    }
+    res->rank = benchmarkSeconds()-start;
+
+    start = benchmarkSeconds();
+    for (j = 0; j < queries; j++) {
+        zskiplistNode *x = zslGetElementByRank(zsl,benchmarkRandom()%n+1);
+        *acc += x->score+sdslen(x->ele);
+    }
+    res->byrank = benchmarkSeconds()-start;
+
+    start = benchmarkSeconds();
+    for (j = 0; j < queries/len*10+1; j++) {
+        unsigned long remaining = len;
+        zskiplistNode *x = zslGetElementByRank(zsl,benchmarkRandom()%(n-len)+1);
+
+        while (x && remaining--) {
+            *acc += x->score+sdslen(x->ele);
+            x = x->level[0].forward;
+        }
+    }
+    res->range = benchmarkSeconds()-start;
+
+    start = benchmarkSeconds();
+    for (j = 0; j < queries/len*10+1; j++) {
+        zrangespec range;
+        unsigned long remaining = len;
+        zskiplistNode *x;
+
+        range.min = (double)(benchmarkRandom()%n);
+        range.max = range.min+len;
+        range.minex = range.maxex = 0;
+        x = zslFirstInRange(zsl,&range);
+        while (x && remaining-- && zbtValueLteMax(x->score,&range)) {
+            *acc += x->score+sdslen(x->ele);
+            x = x->level[0].forward;
+        }
+    }
+    res->rangebyscore = benchmarkSeconds()-start;
+
+    start = benchmarkSeconds();
+    for (j = n; j > 0; j--) zslDelete(zsl,scores[j-1],members[j-1]);
+    res->delete = benchmarkSeconds()-start;
+    zslFree(zsl);
+}
+
+/* zbtree-benchmark [elements] [range]
+ * 元素的score为[0, elements)中的随机整数(有重复)，按随机顺序插入，比较B+树与跳表的插入、ZRANK、
+ * 按排名查找、ZRANGE与ZRANGEBYSCORE读取连续range个元素、删除的速度，以及每个元素的内存 */
+int main(int argc, char **argv) {
+    size_t n = argc >= 2 ? strtoul(argv[1],NULL,10) : 1000000, queries = 1000000, j;
+    unsigned long len = argc >= 3 ? strtoul(argv[2],NULL,10) : 1000;
+    double *scores = malloc(sizeof(double)*n), acc = 0;
+    sds *members = malloc(sizeof(sds)*n);
+    benchmarkResult b, s;
+
+    if (n <= len) {
+        fprintf(stderr,"elements must be greater than range\n");
+        return 1;
+    }
+    for (j = 0; j < n; j++) {
+        scores[j] = (double)(benchmarkRandom()%n);
+        members[j] = sdscatprintf(sdsempty(),"member:%zu",j);
+    }
+
+    benchmarkZbtree(&b,scores,members,n,queries,len,&acc);
+    benchmarkSkiplist(&s,scores,members,n,queries,len,&acc);
+
+    printf("%zu elements, %zu lookups, %zu ranges of %lu elements\n", n, queries, queries/len*10+1, len);
+    printf("                 %14s %14s %8s\n", "B+tree", "skiplist", "speedup");
+#define BENCHMARK_ROW(name, field, ops, unit) \
+    printf("%-16s %9.2f %-4s %9.2f %-4s %7.2fx\n", name, (ops)/b.field/1e6, unit, \
+        (ops)/s.field/1e6, unit, s.field/b.field)
+    BENCHMARK_ROW("insert", insert, n, "M/s");
+    BENCHMARK_ROW("ZRANK", rank, queries, "M/s");
+    BENCHMARK_ROW("rank lookup", byrank, queries, "M/s");
+    BENCHMARK_ROW("ZRANGE", range, (double)(queries/len*10+1)*len, "M/s");
+    BENCHMARK_ROW("ZRANGEBYSCORE", rangebyscore, (double)(queries/len*10+1)*len, "M/s");
+    BENCHMARK_ROW("delete", delete, n, "M/s");
+#undef BENCHMARK_ROW
+    printf("bytes/element    %9.1f      %9.1f\n", (double)b.bytes/n, (double)s.bytes/n);
+    printf("(%g)\n", acc);
+
+    for (j = 0; j < n; j++) sdsfree(members[j]);
+    free(members);
+    free(scores);
+    return 0;
+}
+
+#endif
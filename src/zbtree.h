@@ -0,0 +1,65 @@
+//
+// Created by yukino on 2026/10/18.
+//
+
+#ifndef RESP_SERVER_ZBTREE_H
+#define RESP_SERVER_ZBTREE_H
+
+#include "sds.h"
+
+/* 节点容量。元素少于容量的1/4时与相邻节点合并或从相邻节点借一个元素 */
+#define ZBT_LEAF_CAP 32
+#define ZBT_INNER_CAP 32
+#define ZBT_LEAF_MIN (ZBT_LEAF_CAP/4)
+#define ZBT_INNER_MIN (ZBT_INNER_CAP/4)
+
+typedef struct zbtNode {
+    unsigned char leaf;     /* 1为叶子节点，0为内部节点 */
+    unsigned short n;       /* 叶子节点的元素数量或内部节点的子节点数量 */
+} zbtNode;
+
+/* 叶子节点。元素按(score, ele)升序排列，score与ele分别保存在连续数组中，范围查询时
+ * 逐个叶子顺序扫描数组，不需要像跳表那样每个元素跟随一次指针 */
+typedef struct zbtLeaf {
+    zbtNode hdr;
+    struct zbtLeaf *prev, *next;
+    double score[ZBT_LEAF_CAP];
+    sds ele[ZBT_LEAF_CAP];
+} zbtLeaf;
+
+/* 内部节点。count[i]为子树i中的元素数量，用于O(log n)计算排名与按排名查找；
+ * (score[i], ele[i])(i>=1)为子树i中元素的下界，子树i-1中的元素都小于它。
+ * 下界的ele是元素的副本，元素删除后仍然是有效的下界 */
+typedef struct zbtInner {
+    zbtNode hdr;
+    zbtNode *child[ZBT_INNER_CAP];
+    unsigned long count[ZBT_INNER_CAP];
+    double score[ZBT_INNER_CAP];
+    sds ele[ZBT_INNER_CAP];
+} zbtInner;
+
+/* 按排名有序的B+树，元素的member由树持有 */
+typedef struct zbtree {
+    zbtNode *root;
+    unsigned long length;
+} zbtree;
+
+/* Struct to hold an inclusive/exclusive range spec by score comparison. */
+typedef struct {
+    double min, max;
+    int minex, maxex; /* are min or max exclusive? */
+} zrangespec;
+
+zbtree *zbtCreate(void);
+void zbtFree(zbtree *zbt);
+void zbtInsert(zbtree *zbt, double score, sds ele);
+int zbtDelete(zbtree *zbt, double score, sds ele, sds *node);
+void zbtUpdateScore(zbtree *zbt, double curscore, sds ele, double newscore);
+unsigned long zbtGetRank(zbtree *zbt, double score, sds ele);
+zbtLeaf *zbtGetElementByRank(zbtree *zbt, unsigned long rank, int *idx);
+zbtLeaf *zbtFirstInRange(zbtree *zbt, zrangespec *range, int *idx, unsigned long *rank);
+zbtLeaf *zbtLastInRange(zbtree *zbt, zrangespec *range, int *idx, unsigned long *rank);
+int zbtValueGteMin(double value, zrangespec *spec);
+int zbtValueLteMax(double value, zrangespec *spec);
+
+#endif //RESP_SERVER_ZBTREE_H
@@ -2,22 +2,42 @@
 // Created by yukino on 2023/5/1.
 //
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <fcntl.h>
 
 #include "zmalloc.h"
 
+/* 已分配内存总量，使用malloc_usable_size统计，包含分配器的内部碎片 */
+static _Atomic size_t used_memory = 0;
+
+#define update_zmalloc_stat_alloc(__n) atomic_fetch_add_explicit(&used_memory,(__n),memory_order_relaxed)
+#define update_zmalloc_stat_free(__n) atomic_fetch_sub_explicit(&used_memory,(__n),memory_order_relaxed)
+
 void *zmalloc(size_t size) {
     void *ptr = malloc(size);
+    if (ptr) update_zmalloc_stat_alloc(zmalloc_usable(ptr));
     return ptr;
 }
 void *zcalloc(size_t size) {
     void *ptr = calloc(1, size);
+    if (ptr) update_zmalloc_stat_alloc(zmalloc_usable(ptr));
     return ptr;
 }
 
 void *zrealloc(void *ptr, size_t size) {
-    void *_ptr = realloc(ptr, size);
+    size_t oldsize;
+    void *_ptr;
+
+    if (NULL == ptr) return zmalloc(size);
+    oldsize = zmalloc_usable(ptr);
+    _ptr = realloc(ptr, size);
+    if (NULL == _ptr) return NULL;
+    update_zmalloc_stat_free(oldsize);
+    update_zmalloc_stat_alloc(zmalloc_usable(_ptr));
     return _ptr;
 }
 
@@ -25,5 +45,44 @@ void zfree(void *ptr) {
     if (NULL == ptr) {
         return;
     }
+    update_zmalloc_stat_free(zmalloc_usable(ptr));
     free(ptr);
 }
+
+size_t zmalloc_used_memory(void) {
+    return atomic_load_explicit(&used_memory,memory_order_relaxed);
+}
+
+/* 读取/proc/self/stat获取进程常驻内存(RSS)，失败返回0 */
+size_t zmalloc_get_rss(void) {
+    int page = sysconf(_SC_PAGESIZE);
+    size_t rss;
+    char buf[4096];
+    char filename[256];
+    int fd, count;
+    char *p, *x;
+
+    snprintf(filename,256,"/proc/%ld/stat",(long)getpid());
+    if ((fd = open(filename,O_RDONLY)) == -1) return 0;
+    if (read(fd,buf,sizeof(buf)-1) <= 0) {
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    buf[sizeof(buf)-1] = '\0';
+
+    p = buf;
+    count = 23; /* RSS is the 24th field in /proc/<pid>/stat */
+    while(p && count--) {
+        p = strchr(p,' ');
+        if (p) p++;
+    }
+    if (!p) return 0;
+    x = strchr(p,' ');
+    if (!x) return 0;
+    *x = '\0';
+
+    rss = strtoll(p,NULL,10);
+    rss *= page;
+    return rss;
+}
@@ -14,5 +14,7 @@ void *zmalloc(size_t size);
 void *zcalloc(size_t size);
 void *zrealloc(void *ptr, size_t size);
 void zfree(void *ptr);
+size_t zmalloc_used_memory(void);
+size_t zmalloc_get_rss(void);
 
 #endif //RESP_SERVER_ZMALLOC_H